@@ -98,6 +98,7 @@ struct ParsingInfo {
   std::optional<std::string> image = std::nullopt;
   std::optional<std::vector<std::string>> timeStrings = std::nullopt;
   std::optional<unsigned int> numberTransitionSteps = std::nullopt;
+  bool autoTransitionSteps = false;
   std::optional<bool> inPlace = std::nullopt;
 };
 
@@ -122,6 +123,9 @@ void updateParsingInfoWithYamlNode(const std::string &key,
     insertIntoParsingInfo<unsigned int>(value, parsingInfo.transitionLength);
   } else if (key == TYPE) {
     insertIntoParsingInfo<BackgroundSetType>(value, parsingInfo.type);
+  } else if (key == NUM_TRANSITION_STEPS &&
+             value.as<std::string>() == AUTO_STEPS_STRING) {
+    parsingInfo.autoTransitionSteps = true;
   } else if (key == NUM_TRANSITION_STEPS) {
     insertIntoParsingInfo<unsigned int>(value,
                                         parsingInfo.numberTransitionSteps);
@@ -146,6 +150,15 @@ tryCreateTransitionInfoFrom(const ParsingInfo &parsingInfo) {
         parsingInfo.inPlace.value_or(false));
   }
 
+  if (!parsingInfo.numberTransitionSteps.has_value() &&
+      parsingInfo.transitionLength.has_value() &&
+      parsingInfo.autoTransitionSteps) {
+    return std::make_optional<TransitionInfo>(
+        std::chrono::seconds(parsingInfo.transitionLength.value()),
+        BackgroundSetDefaults::transitionSteps,
+        parsingInfo.inPlace.value_or(false), true);
+  }
+
   if (!parsingInfo.numberTransitionSteps.has_value() &&
       parsingInfo.transitionLength.has_value()) {
     logWarning(
@@ -8,7 +8,11 @@
 namespace dynamic_paper {
 
 struct MethodWallUtils {};
+/** Sets the background of an X11 display directly, see
+ * `x11_background_setter.hpp` */
+struct MethodX11 {};
 
-using BackgroundSetMethod = std::variant<MethodWallUtils, std::filesystem::path>;
+using BackgroundSetMethod =
+    std::variant<MethodWallUtils, MethodX11, std::filesystem::path>;
 
 } // namespace dynamic_paper
@@ -41,13 +41,14 @@ void setBackgroundToImage(const std::filesystem::path &imagePath,
   callSetBackground(imageName, backgroundSetModeString(mode));
 }
 
-void setBackgroundToImageUsingScript(const std::filesystem::path &scriptPath,
-                                     const std::filesystem::path &imagePath,
-                                     BackgroundSetMode mode) {
+void setBackgroundToImageUsingScript(
+    const std::filesystem::path &scriptPath,
+    const std::filesystem::path &imagePath, BackgroundSetMode mode,
+    const std::optional<std::string> &output) {
   logTrace("Setting background to image ({})", imagePath.string());
 
   const tl::expected<void, ScriptError> scriptResult =
-      runBackgroundSetScript(scriptPath, imagePath, mode);
+      runBackgroundSetScript(scriptPath, imagePath, mode, output);
 
   if (!scriptResult.has_value()) {
     logError("Error relating to forking occured when running background "
@@ -4,6 +4,7 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <string>
 
 #include <tl/expected.hpp>
@@ -11,6 +12,7 @@
 #include "background_set_enums.hpp"
 #include "file_util.hpp"
 #include "image_compositor.hpp"
+#include "rgb_image.hpp"
 
 namespace dynamic_paper {
 
@@ -34,6 +36,17 @@ concept CanSetBackgroundTrait =
       { func(imagePath, mode) } -> std::convertible_to<void>;
     };
 
+/**
+ * Trait for a background setter that can also show a decoded image. Frames of
+ * a transition are given to it from memory instead of being saved as files.
+ */
+template <typename T>
+concept CanSetBackgroundToFrameTrait =
+    CanSetBackgroundTrait<T> &&
+    requires(T &&func, const RGBImage &frame, const BackgroundSetMode mode) {
+      { func(frame, mode) } -> std::convertible_to<void>;
+    };
+
 /**
  * Changes the background from `commonImageDirectory / beforeImageName` to
  * `commonImageDirectory / afterImageName`. This effect occurs for `duration`
@@ -52,8 +65,11 @@ lerpBackgroundBetweenImages(const std::filesystem::path &commonImageDirectory,
 
 void setBackgroundToImage(const std::filesystem::path &imagePath, BackgroundSetMode mode);
 
-void setBackgroundToImageUsingScript(const std::filesystem::path &scriptPath,
-                                     const std::filesystem::path &imagePath,
-                                     BackgroundSetMode mode);
+/** Sets the background using the script at `scriptPath`, only on the monitor
+ * called `output` if given */
+void setBackgroundToImageUsingScript(
+    const std::filesystem::path &scriptPath,
+    const std::filesystem::path &imagePath, BackgroundSetMode mode,
+    const std::optional<std::string> &output = std::nullopt);
 
 } // namespace dynamic_paper
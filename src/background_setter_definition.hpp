@@ -9,8 +9,10 @@
 
 #include "background_setter.hpp"
 
+#include "step_throughput.hpp"
 #include "time_util.hpp"
 #include "transition_info.hpp"
+#include "transition_schedule.hpp"
 
 namespace dynamic_paper {
 
@@ -20,8 +22,11 @@ tl::expected<void, BackgroundError> lerpBackgroundBetweenImages(
     const std::filesystem::path &commonImageDirectory,
     const std::string &beforeImageName, const std::string &afterImageName,
     const std::filesystem::path &cacheDirectory,
-    const TransitionInfo &transition, const BackgroundSetMode mode,
-    T backgroundSetFunction) {
+    const TransitionInfo &transition,
+    const std::optional<unsigned int> percentageStep,
+    const std::optional<DisplayFit> &fit, const bool cacheDecodedSources,
+    const TransitionFrameFormat frameFormat, const bool packFrames,
+    const BackgroundSetMode mode, T backgroundSetFunction) {
 
   const bool dirCreationResult =
       Files::createDirectoryIfDoesntExist(cacheDirectory);
@@ -29,52 +34,157 @@ tl::expected<void, BackgroundError> lerpBackgroundBetweenImages(
     return tl::make_unexpected(BackgroundError::NoCacheDir);
   }
 
-  const unsigned int denominator = transition.steps + 1;
-  for (unsigned int i = 0; i < transition.steps; i++) {
+  const std::chrono::steady_clock::time_point transitionStart =
+      std::chrono::steady_clock::now();
+
+  // Setters that take decoded images are given each frame from memory, so
+  // frames are never written to a file and decoded again
+  constexpr bool showsFrames =
+      CanSetBackgroundToFrameTrait<T> && GetsCompositeFrames<CompositeImages>;
+
+  // Shared by every step, so the start and end images are decoded and
+  // resampled once
+  typename CompositeImages::Session compositeSession(
+      commonImageDirectory, beforeImageName, afterImageName, cacheDirectory,
+      fit, cacheDecodedSources, frameFormat, packFrames);
+
+  // TODO should check `CompositeImages` is not a testing class instead of
+  // checking exactly the compositors
+  constexpr bool usesRealCompositor =
+      std::is_same_v<CompositeImages, ImageCompositor> ||
+      std::is_same_v<CompositeImages, ImageCompositorInPlace>;
+
+  // Timed so transitions with `auto` steps know how many steps this machine
+  // can show. Only counts time spent compositing images, not looking up ones
+  // already in the cache
+  std::chrono::milliseconds compositeTime{0};
+  const auto timeCompositing = [&compositeTime,
+                                &compositeSession](std::invocable auto block) {
+    if constexpr (usesRealCompositor) {
+      const std::size_t compositedBefore =
+          compositeSession.numberCompositedImages();
+      const std::chrono::milliseconds time = timeToRunCodeBlock(block);
+      if (compositeSession.numberCompositedImages() > compositedBefore) {
+        compositeTime += time;
+      }
+    } else {
+      block();
+    }
+  };
+
+  // Create every image up front so each step only has to set the background
+  const std::vector<unsigned int> percentages =
+      transition.stepPercentages(percentageStep);
+  tl::expected<void, CompositeImageError> prepareResult;
+  timeCompositing([&]() {
+    if constexpr (showsFrames) {
+      prepareResult = compositeSession.prepareCompositedFrames();
+    } else {
+      prepareResult = compositeSession.prepareCompositedImages(percentages);
+    }
+  });
+  if (!prepareResult.has_value()) {
+    return tl::unexpected(BackgroundError::CompositeImageError);
+  }
+
+  // Frames whose time has passed are skipped instead of being shown late, so
+  // the transition ends on time
+  const TransitionSchedule schedule(transitionStart, transition.duration,
+                                    percentages.size());
+
+  bool shownFirstImage = false;
+  std::size_t shownFrames = 0;
+  std::chrono::milliseconds setTime{0};
+  std::size_t droppedFrames = 0;
+  std::chrono::steady_clock::duration maxLateness{0};
+  for (std::size_t step = 0; step < percentages.size(); step++) {
+    const unsigned int percentage = percentages[step];
+
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (schedule.isStale(step, now)) {
+      droppedFrames++;
+      continue;
+    }
+    maxLateness = std::max(maxLateness, schedule.lateness(step, now));
+
     std::optional<tl::expected<void, BackgroundError>> potentialError =
         std::nullopt;
 
-    std::chrono::milliseconds timeElapsed =
-        timeToRunCodeBlock([i, denominator, &commonImageDirectory,
-                            &beforeImageName, &afterImageName, &cacheDirectory,
-                            mode, backgroundSetFunction, &potentialError]() {
-          // modifies `i` so is more in the middle of the range, to avoid
-          // interpolating 0% and 100% images
-          const unsigned int numerator = i + 1;
-
-          const float percentageFloat =
-              static_cast<float>(numerator) / static_cast<float>(denominator);
-          const unsigned int percentage = std::clamp(
-              static_cast<unsigned int>(percentageFloat * 100.0F), 0U, 100U);
-
-          const tl::expected<std::filesystem::path, CompositeImageError>
-              expectedCompositedImage = CompositeImages::getCompositedImage(
-                  commonImageDirectory, beforeImageName, afterImageName,
-                  cacheDirectory, percentage);
-
-          if (!expectedCompositedImage.has_value()) {
-            potentialError =
-                tl::unexpected(BackgroundError::CompositeImageError);
-          }
-
+    if constexpr (showsFrames) {
+      tl::expected<RGBImage, CompositeImageError> frame;
+      timeCompositing([&]() {
+        frame = compositeSession.getCompositedFrame(percentage);
+      });
+
+      if (!frame.has_value()) {
+        potentialError = tl::unexpected(BackgroundError::CompositeImageError);
+      } else {
+        setTime += timeToRunCodeBlock(
+            [&]() { backgroundSetFunction(frame.value(), mode); });
+
+        logTrace("Interpolating to {}%...", percentage);
+      }
+    } else {
+      tl::expected<std::filesystem::path, CompositeImageError>
+          expectedCompositedImage;
+      timeCompositing([&]() {
+        expectedCompositedImage =
+            compositeSession.getCompositedImage(percentage);
+      });
+
+      if (!expectedCompositedImage.has_value()) {
+        potentialError = tl::unexpected(BackgroundError::CompositeImageError);
+      } else {
+        setTime += timeToRunCodeBlock([&]() {
           backgroundSetFunction(expectedCompositedImage.value(), mode);
-
-          logTrace("Interpolating to {}...",
-                   expectedCompositedImage.value().string());
         });
 
+        logTrace("Interpolating to {}...",
+                 expectedCompositedImage.value().string());
+      }
+    }
+
     if (potentialError.has_value() && !potentialError->has_value()) {
       return tl::unexpected(potentialError->error());
     }
+    shownFrames++;
+
+    if (!shownFirstImage) {
+      shownFirstImage = true;
+      logInfo("Transition {} -> {} showed its first image after {}",
+              beforeImageName, afterImageName,
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - transitionStart));
+    }
+
+    if constexpr (usesRealCompositor) {
+      std::this_thread::sleep_until(schedule.stepEnd(step));
+    }
+  }
 
-    // TODO should check `CompositeImages` is not a testing class instead of
-    // checking exactly `ImageCompositor`
-    if constexpr (std::is_same_v<CompositeImages, ImageCompositor>) {
-      std::chrono::milliseconds sleepTime =
-          std::chrono::milliseconds(transition.duration) / transition.steps;
-      sleepTime = std::clamp(sleepTime - timeElapsed,
-                             std::chrono::milliseconds(0), sleepTime);
-      std::this_thread::sleep_for(sleepTime);
+  const std::chrono::steady_clock::duration overrun =
+      std::max(std::chrono::steady_clock::now() - schedule.end(),
+               std::chrono::steady_clock::duration{0});
+  logInfo("Transition {} -> {} dropped {} of {} frames, the latest frame "
+          "was {} late and it ended {} late",
+          beforeImageName, afterImageName, droppedFrames, percentages.size(),
+          std::chrono::duration_cast<std::chrono::milliseconds>(maxLateness),
+          std::chrono::duration_cast<std::chrono::milliseconds>(overrun));
+
+  // Transitions whose images were all in the cache say nothing about how
+  // long compositing takes
+  if constexpr (usesRealCompositor) {
+    const std::size_t compositedImages =
+        compositeSession.numberCompositedImages();
+    if (shownFrames > 0 && compositedImages > 0) {
+      recordStepThroughput(
+          cacheDirectory,
+          {.compositeMilliseconds =
+               static_cast<double>(compositeTime.count()) /
+               static_cast<double>(compositedImages),
+           .setMilliseconds = static_cast<double>(setTime.count()) /
+                              static_cast<double>(shownFrames)});
     }
   }
 
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <filesystem>
 #include <iostream>
 #include <utility>
@@ -8,6 +9,11 @@
 #include "tracy/Tracy.hpp"
 
 #include "src/file_util.hpp"
+#include "src/lerp_kernel.hpp"
+#include "src/native_compositor.hpp"
+#include "src/rgb_image.hpp"
+#include "src/time_util.hpp"
+#include "src/transition_frame_format.hpp"
 
 using namespace dynamic_paper;
 namespace {
@@ -52,6 +58,21 @@ void compositeUsingImageMagick(
   FrameMarkEnd("Comp - Saving Image");
 }
 
+void compositeUsingNativeLerp(const RGBImage &startImage,
+                              const RGBImage &endImage,
+                              const std::filesystem::path &destinationImagePath,
+                              const unsigned int percentage) {
+  ZoneScoped;
+
+  FrameMarkStart("Native - Drawing Image");
+  const RGBImage destImage = lerpRGBImages(startImage, endImage, percentage);
+  FrameMarkEnd("Native - Drawing Image");
+
+  FrameMarkStart("Native - Saving Image");
+  writeRGBImage(destImage, destinationImagePath);
+  FrameMarkEnd("Native - Saving Image");
+}
+
 const std::array<std::pair<uint8_t, std::filesystem::path>, 4> compositeImagesPaths =
     // {
     //         std::make_pair(
@@ -73,6 +94,48 @@ const std::array<std::pair<uint8_t, std::filesystem::path>, 4> compositeImagesPa
         std::make_pair(60, std::filesystem::path("/tmp/composite-60.jpg")),
         std::make_pair(80, std::filesystem::path("/tmp/composite-80.jpg")),
 };
+
+/** Formats frames are compared in, `Source` being the JPEG frames made from
+ * the JPEG benchmarking images */
+constexpr std::array<TransitionFrameFormat, 6> frameFormats = {
+    TransitionFrameFormat::Source, TransitionFrameFormat::Qoi,
+    TransitionFrameFormat::Ppm,    TransitionFrameFormat::Pam,
+    TransitionFrameFormat::Png,    TransitionFrameFormat::WebP};
+
+/** Prints how long it takes to encode a frame in each of `frameFormats`, and
+ * for the background setter to decode it again */
+void benchmarkFrameFormats(const RGBImage &startImage,
+                           const RGBImage &endImage) {
+  ZoneScoped;
+
+  const RGBImage frame = lerpRGBImages(startImage, endImage, 50);
+  const auto frameCount = static_cast<double>(compositeImagesPaths.size());
+
+  std::cout << "\nFrame format   encode      decode      size\n";
+  for (const TransitionFrameFormat format : frameFormats) {
+    const std::filesystem::path path =
+        "/tmp/composite-format" +
+        transitionFrameExtension(format, START_IMG.extension().string());
+
+    const std::chrono::milliseconds encodeTime = timeToRunCodeBlock([&]() {
+      for (std::size_t i = 0; i < compositeImagesPaths.size(); i++) {
+        writeRGBImage(frame, path, format);
+      }
+    });
+    const std::chrono::milliseconds decodeTime = timeToRunCodeBlock([&]() {
+      for (std::size_t i = 0; i < compositeImagesPaths.size(); i++) {
+        const RGBImage decoded = readRGBImage(path);
+      }
+    });
+
+    std::cout << transitionFrameFormatString(format) << "\t\t"
+              << static_cast<double>(encodeTime.count()) / frameCount
+              << " ms\t" << static_cast<double>(decodeTime.count()) / frameCount
+              << " ms\t" << std::filesystem::file_size(path) / 1024
+              << " KiB\n";
+    std::filesystem::remove(path);
+  }
+}
 } // namespace
 
 auto main(int argc, char *argv[]) -> int {
@@ -89,21 +152,77 @@ auto main(int argc, char *argv[]) -> int {
   startImage.read(START_IMG.c_str());
   endImage.read(END_IMG.c_str());
 
+  const RGBImage startRGBImage = readRGBImage(START_IMG);
+  const RGBImage endRGBImage = readRGBImage(
+      END_IMG, std::make_pair(startRGBImage.width, startRGBImage.height));
+
   FrameMarkEnd("Startup");
 
   // ---
 
   FrameMarkStart("Composite Loop");
 
-  for (const std::pair<uint8_t, std::filesystem::path> &percentageAndPath :
-       compositeImagesPaths) {
-    ZoneScoped;
+  const std::chrono::milliseconds magickTime = timeToRunCodeBlock([&]() {
+    for (const std::pair<uint8_t, std::filesystem::path> &percentageAndPath :
+         compositeImagesPaths) {
+      ZoneScoped;
 
-    const auto &percentage = percentageAndPath.first;
-    const auto &path = percentageAndPath.second;
+      const auto &percentage = percentageAndPath.first;
+      const auto &path = percentageAndPath.second;
 
-    compositeUsingImageMagick(startImage, endImage, path, percentage);
-  }
+      compositeUsingImageMagick(startImage, endImage, path, percentage);
+    }
+  });
 
   FrameMarkEnd("Composite Loop");
+
+  // ---
+
+  FrameMarkStart("Native Composite Loop");
+
+  const std::chrono::milliseconds nativeTime = timeToRunCodeBlock([&]() {
+    for (const std::pair<uint8_t, std::filesystem::path> &percentageAndPath :
+         compositeImagesPaths) {
+      ZoneScoped;
+
+      const auto &percentage = percentageAndPath.first;
+      const auto &path = percentageAndPath.second;
+
+      compositeUsingNativeLerp(startRGBImage, endRGBImage, path, percentage);
+    }
+  });
+
+  FrameMarkEnd("Native Composite Loop");
+
+  // ---
+
+  FrameMarkStart("Native Lerp Only");
+
+  RGBImage lerpDestination(startRGBImage.width, startRGBImage.height);
+  const std::chrono::milliseconds lerpOnlyTime = timeToRunCodeBlock([&]() {
+    for (const std::pair<uint8_t, std::filesystem::path> &percentageAndPath :
+         compositeImagesPaths) {
+      lerpPixels(startRGBImage.pixels, endRGBImage.pixels,
+                 lerpDestination.pixels, percentageAndPath.first);
+    }
+  });
+
+  FrameMarkEnd("Native Lerp Only");
+
+  const auto frameCount = static_cast<double>(compositeImagesPaths.size());
+  std::cout << "Lerp kernel: " << lerpKernelString(bestSupportedLerpKernel())
+            << "\n";
+  std::cout << "ImageMagick: " << static_cast<double>(magickTime.count()) / frameCount
+            << " ms / frame\n";
+  std::cout << "Native:      " << static_cast<double>(nativeTime.count()) / frameCount
+            << " ms / frame (" << static_cast<double>(lerpOnlyTime.count()) / frameCount
+            << " ms / frame without encoding)\n";
+  if (nativeTime.count() > 0) {
+    std::cout << "Speedup:     "
+              << static_cast<double>(magickTime.count()) /
+                     static_cast<double>(nativeTime.count())
+              << "x\n";
+  }
+
+  benchmarkFrameFormats(startRGBImage, endRGBImage);
 }
@@ -0,0 +1,116 @@
+#pragma once
+
+/** A number of bytes, and parsing human readable sizes like "2GiB" */
+
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "format.hpp"
+#include "string_util.hpp"
+
+namespace dynamic_paper {
+
+/** An amount of bytes, such as the size of a file */
+struct ByteSize {
+  std::uintmax_t bytes = 0;
+
+  constexpr auto operator<=>(const ByteSize &) const = default;
+};
+
+namespace detail {
+
+constexpr std::uintmax_t KIBIBYTE = 1024;
+constexpr std::uintmax_t KILOBYTE = 1000;
+
+constexpr std::array<std::pair<std::string_view, std::uintmax_t>, 14>
+    BYTE_SIZE_UNITS = {{{"", 1},
+                        {"b", 1},
+                        {"k", KIBIBYTE},
+                        {"kb", KILOBYTE},
+                        {"kib", KIBIBYTE},
+                        {"m", KIBIBYTE * KIBIBYTE},
+                        {"mb", KILOBYTE * KILOBYTE},
+                        {"mib", KIBIBYTE * KIBIBYTE},
+                        {"g", KIBIBYTE * KIBIBYTE * KIBIBYTE},
+                        {"gb", KILOBYTE * KILOBYTE * KILOBYTE},
+                        {"gib", KIBIBYTE * KIBIBYTE * KIBIBYTE},
+                        {"t", KIBIBYTE * KIBIBYTE * KIBIBYTE * KIBIBYTE},
+                        {"tb", KILOBYTE * KILOBYTE * KILOBYTE * KILOBYTE},
+                        {"tib", KIBIBYTE * KIBIBYTE * KIBIBYTE * KIBIBYTE}}};
+
+} // namespace detail
+
+/**
+ * Parses a size such as "2GiB", "500 MB", "1.5g" or "4096" into bytes.
+ *
+ * "KiB", "MiB", "GiB" and "TiB" (or just "K", "M", "G" and "T") are powers of
+ * 1024, while "KB", "MB", "GB" and "TB" are powers of 1000. Units are not case
+ * sensitive. Returns `nullopt` if `text` is not a size.
+ */
+constexpr std::optional<ByteSize> parseByteSize(const std::string &text) {
+  const std::string sizeString = normalize(text);
+
+  std::uintmax_t wholePart = 0;
+  std::uintmax_t fractionPart = 0;
+  std::uintmax_t fractionDenominator = 1;
+  bool seenDigit = false;
+  bool seenPoint = false;
+
+  std::size_t index = 0;
+  for (; index < sizeString.size(); index++) {
+    const char letter = sizeString[index];
+    if (letter == '.' && !seenPoint) {
+      seenPoint = true;
+    } else if (letter >= '0' && letter <= '9') {
+      seenDigit = true;
+      const auto digit = static_cast<std::uintmax_t>(letter - '0');
+      if (seenPoint) {
+        fractionPart = (fractionPart * 10) + digit;
+        fractionDenominator *= 10;
+      } else {
+        wholePart = (wholePart * 10) + digit;
+      }
+    } else {
+      break;
+    }
+  }
+  if (!seenDigit) {
+    return std::nullopt;
+  }
+
+  const std::string unit = trim_copy(sizeString.substr(index));
+  for (const auto &[unitName, multiplier] : detail::BYTE_SIZE_UNITS) {
+    if (unit == unitName) {
+      return ByteSize{.bytes = (wholePart * multiplier) +
+                               ((fractionPart * multiplier) /
+                                fractionDenominator)};
+    }
+  }
+  return std::nullopt;
+}
+
+/** Returns `size` as a human readable string, such as "1.5 GiB" */
+inline std::string byteSizeString(const ByteSize size) {
+  constexpr std::array<std::string_view, 5> UNITS = {"B", "KiB", "MiB", "GiB",
+                                                     "TiB"};
+
+  auto value = static_cast<double>(size.bytes);
+  std::size_t unitIndex = 0;
+  while (value >= static_cast<double>(detail::KIBIBYTE) &&
+         unitIndex + 1 < UNITS.size()) {
+    value /= static_cast<double>(detail::KIBIBYTE);
+    unitIndex++;
+  }
+
+  if (unitIndex == 0) {
+    return dynamic_paper::format("{} B", size.bytes);
+  }
+  return dynamic_paper::format("{:.1f} {}", value, UNITS.at(unitIndex));
+}
+
+} // namespace dynamic_paper
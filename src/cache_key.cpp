@@ -0,0 +1,261 @@
+#include "cache_key.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <unordered_map>
+
+#include "cache_manifest.hpp"
+#include "format.hpp"
+#include "frame_pack.hpp"
+#include "hash.hpp"
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+/** Fingerprints by absolute path of the source image */
+using SourceFingerprints = std::unordered_map<std::string, SourceFingerprint>;
+
+/** Fingerprints read from each cache directory, so the file is only read once
+ * per process */
+struct FingerprintStore {
+  std::mutex mutex;
+  std::unordered_map<std::string, SourceFingerprints> byCacheDirectory;
+};
+
+FingerprintStore &fingerprintStore() {
+  static FingerprintStore store;
+  return store;
+}
+
+/** Size and modification time of `imagePath`, with a `digest` of 0 */
+std::optional<SourceFingerprint>
+fileFingerprint(const std::filesystem::path &imagePath) {
+  std::error_code sizeError;
+  std::error_code timeError;
+  const std::uintmax_t size = std::filesystem::file_size(imagePath, sizeError);
+  const std::filesystem::file_time_type modifiedTime =
+      std::filesystem::last_write_time(imagePath, timeError);
+  if (sizeError || timeError) {
+    return std::nullopt;
+  }
+
+  return SourceFingerprint{
+      .size = size,
+      .modifiedNanoseconds =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              modifiedTime.time_since_epoch())
+              .count(),
+      .digest = 0};
+}
+
+/**
+ * Reads the fingerprints saved in `cacheDirectory`. Each line is formatted:
+ * `{digest in hex} {size} {modification time} {absolute path}`
+ */
+SourceFingerprints
+readSourceFingerprints(const std::filesystem::path &cacheDirectory) {
+  SourceFingerprints fingerprints;
+
+  std::ifstream file(cacheDirectory / SOURCE_FINGERPRINTS_FILE_NAME);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream lineStream(line);
+    SourceFingerprint fingerprint;
+    std::string path;
+    lineStream >> std::hex >> fingerprint.digest >> std::dec >>
+        fingerprint.size >> fingerprint.modifiedNanoseconds >> std::ws;
+    std::getline(lineStream, path);
+    if (lineStream.fail() || path.empty()) {
+      continue;
+    }
+    fingerprints.insert_or_assign(std::move(path), fingerprint);
+  }
+  return fingerprints;
+}
+
+void writeSourceFingerprints(const std::filesystem::path &cacheDirectory,
+                             const SourceFingerprints &fingerprints) {
+  const std::filesystem::path fingerprintsPath =
+      cacheDirectory / SOURCE_FINGERPRINTS_FILE_NAME;
+  const std::filesystem::path partialPath = partialPathFor(fingerprintsPath);
+  {
+    std::ofstream file(partialPath, std::ios::trunc);
+    for (const auto &[path, fingerprint] : fingerprints) {
+      file << dynamic_paper::format("{:016x} {} {} {}\n", fingerprint.digest,
+                                    fingerprint.size,
+                                    fingerprint.modifiedNanoseconds, path);
+    }
+    if (!file) {
+      logDebug("Unable to save source image fingerprints to {}",
+               fingerprintsPath.string());
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(partialPath, fingerprintsPath, error);
+  if (error) {
+    logDebug("Unable to save source image fingerprints to {}: {}",
+             fingerprintsPath.string(), error.message());
+  }
+}
+
+/** Fingerprints of `cacheDirectory` in `store`, read from the cache directory
+ * the first time. Needs `store.mutex` to be locked */
+SourceFingerprints &
+loadedSourceFingerprints(FingerprintStore &store,
+                         const std::filesystem::path &cacheDirectory) {
+  const std::string key = cacheDirectory.lexically_normal().string();
+  auto fingerprints = store.byCacheDirectory.find(key);
+  if (fingerprints == store.byCacheDirectory.end()) {
+    fingerprints =
+        store.byCacheDirectory
+            .emplace(key, readSourceFingerprints(cacheDirectory))
+            .first;
+  }
+  return fingerprints->second;
+}
+
+} // namespace
+
+// ===== Header ===============
+
+std::optional<std::uint64_t>
+sourceImageDigest(const std::filesystem::path &imagePath,
+                  const std::filesystem::path &cacheDirectory) {
+  std::optional<SourceFingerprint> fingerprint = fileFingerprint(imagePath);
+  if (!fingerprint.has_value()) {
+    return std::nullopt;
+  }
+
+  std::error_code error;
+  const std::string absolutePath =
+      std::filesystem::absolute(imagePath, error).lexically_normal().string();
+
+  FingerprintStore &store = fingerprintStore();
+  {
+    const std::scoped_lock lock(store.mutex);
+    const SourceFingerprints &fingerprints =
+        loadedSourceFingerprints(store, cacheDirectory);
+    const auto saved = fingerprints.find(absolutePath);
+    if (saved != fingerprints.end() &&
+        saved->second.size == fingerprint->size &&
+        saved->second.modifiedNanoseconds == fingerprint->modifiedNanoseconds) {
+      return saved->second.digest;
+    }
+  }
+
+  // Hashed without holding the lock so other images can be looked up
+  const std::chrono::time_point hashStart = std::chrono::steady_clock::now();
+  const std::optional<std::uint64_t> digest = xxHash64File(imagePath);
+  if (!digest.has_value()) {
+    return std::nullopt;
+  }
+  fingerprint->digest = digest.value();
+  logDebug("Hashed content of {} in {}", imagePath.string(),
+           std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - hashStart));
+
+  {
+    const std::scoped_lock lock(store.mutex);
+    SourceFingerprints &fingerprints =
+        loadedSourceFingerprints(store, cacheDirectory);
+
+    // Keeps fingerprints other processes saved since the file was read
+    const CacheDirectoryLock directoryLock(cacheDirectory);
+    SourceFingerprints savedFingerprints =
+        readSourceFingerprints(cacheDirectory);
+    savedFingerprints.merge(fingerprints);
+    fingerprints = std::move(savedFingerprints);
+
+    fingerprints.insert_or_assign(absolutePath, fingerprint.value());
+    writeSourceFingerprints(cacheDirectory, fingerprints);
+  }
+
+  return digest;
+}
+
+std::size_t
+forgetMissingSourceImages(const std::filesystem::path &cacheDirectory) {
+  FingerprintStore &store = fingerprintStore();
+  const std::scoped_lock lock(store.mutex);
+
+  SourceFingerprints &fingerprints =
+      loadedSourceFingerprints(store, cacheDirectory);
+  const CacheDirectoryLock directoryLock(cacheDirectory);
+  fingerprints = readSourceFingerprints(cacheDirectory);
+
+  const std::size_t numberForgotten =
+      std::erase_if(fingerprints, [](const auto &pathAndFingerprint) {
+        std::error_code error;
+        return !std::filesystem::exists(pathAndFingerprint.first, error);
+      });
+  if (numberForgotten > 0) {
+    writeSourceFingerprints(cacheDirectory, fingerprints);
+  }
+  return numberForgotten;
+}
+
+unsigned int
+TransitionCacheKey::cachedPercentage(const unsigned int percentage) const {
+  constexpr unsigned int MAX_PERCENT = 100;
+  return reversed ? MAX_PERCENT - percentage : percentage;
+}
+
+std::string TransitionCacheKey::imageFileName(
+    const unsigned int percentage) const {
+  if (displayTag.empty()) {
+    return dynamic_paper::format("{:016x}-{:016x}-{}{}", startDigest, endDigest,
+                                 cachedPercentage(percentage), extension);
+  }
+  return dynamic_paper::format("{:016x}-{:016x}-{}-{}{}", startDigest,
+                               endDigest, displayTag,
+                               cachedPercentage(percentage), extension);
+}
+
+std::string TransitionCacheKey::packFileName() const {
+  if (displayTag.empty()) {
+    return dynamic_paper::format("{:016x}-{:016x}{}{}", startDigest, endDigest,
+                                 extension, FRAME_PACK_EXTENSION);
+  }
+  return dynamic_paper::format("{:016x}-{:016x}-{}{}{}", startDigest,
+                               endDigest, displayTag, extension,
+                               FRAME_PACK_EXTENSION);
+}
+
+std::optional<TransitionCacheKey>
+transitionCacheKey(const std::filesystem::path &startImagePath,
+                   const std::filesystem::path &endImagePath,
+                   std::string extension,
+                   const std::filesystem::path &cacheDirectory,
+                   std::string displayTag) {
+  const std::optional<std::uint64_t> startDigest =
+      sourceImageDigest(startImagePath, cacheDirectory);
+  const std::optional<std::uint64_t> endDigest =
+      sourceImageDigest(endImagePath, cacheDirectory);
+  if (!startDigest.has_value() || !endDigest.has_value()) {
+    return std::nullopt;
+  }
+
+  if (startDigest.value() > endDigest.value()) {
+    return TransitionCacheKey{.startDigest = endDigest.value(),
+                              .endDigest = startDigest.value(),
+                              .extension = std::move(extension),
+                              .reversed = true,
+                              .displayTag = std::move(displayTag)};
+  }
+  return TransitionCacheKey{.startDigest = startDigest.value(),
+                            .endDigest = endDigest.value(),
+                            .extension = std::move(extension),
+                            .reversed = false,
+                            .displayTag = std::move(displayTag)};
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,109 @@
+#pragma once
+
+/**
+ * Naming of cached composite images after the content of the images they are
+ * made from, so a cached image is reused wherever its source images are, and
+ * is never reused once a source image is edited.
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace dynamic_paper {
+
+/** Name of the file in the cache directory that stores the
+ * `SourceFingerprint` of every source image seen */
+constexpr std::string_view SOURCE_FINGERPRINTS_FILE_NAME =
+    ".dynamic_paper_sources";
+
+/** Content of a source image, and the size and modification time it had
+ * when its content was hashed */
+struct SourceFingerprint {
+  std::uintmax_t size = 0;
+  std::int64_t modifiedNanoseconds = 0;
+  std::uint64_t digest = 0;
+
+  bool operator==(const SourceFingerprint &) const = default;
+};
+
+/**
+ * Returns the XXH64 digest of the content of `imagePath`, or `nullopt` if it
+ * can't be read.
+ *
+ * Fingerprints are saved in `cacheDirectory`, so the image is only read again
+ * when its size or modification time changes.
+ */
+std::optional<std::uint64_t>
+sourceImageDigest(const std::filesystem::path &imagePath,
+                  const std::filesystem::path &cacheDirectory);
+
+/** Forgets the fingerprints saved in `cacheDirectory` of images that no longer
+ * exist. Returns how many were forgotten */
+std::size_t
+forgetMissingSourceImages(const std::filesystem::path &cacheDirectory);
+
+/**
+ * Identifies the composite images of a transition in the cache. Transitions
+ * between images with the same content share a key, whatever the images are
+ * called and wherever they are.
+ *
+ * The image `p`% of the way from A to B is the same as the image `100 - p`% of
+ * the way from B to A, so both directions share images. Images are cached for
+ * the direction going from the image with the smaller digest to the larger
+ * one, and the key of the other direction is `reversed`.
+ */
+struct TransitionCacheKey {
+  /** Digest of the image cached transitions start from */
+  std::uint64_t startDigest = 0;
+  /** Digest of the image cached transitions end at */
+  std::uint64_t endDigest = 0;
+  std::string extension;
+  /** Whether the transition goes from the image of `endDigest` to the image
+   * of `startDigest` */
+  bool reversed = false;
+  /** Names the size images are blended at, such as `fill-1920x1080`, or empty
+   * if they are blended at the size of their sources. See
+   * `DisplayFit::cacheTag` */
+  std::string displayTag{};
+
+  /** Percentage of the cached image that is `percentage`% of the way through
+   * the transition */
+  [[nodiscard]] unsigned int cachedPercentage(unsigned int percentage) const;
+
+  /**
+   * File name of the image `percentage`% of the way through the transition,
+   * formatted:
+   * `{start image digest}-{end image digest}-{cached percentage}{extension}`
+   *
+   * or with a `displayTag`:
+   * `{start image digest}-{end image digest}-{display tag}-{cached
+   * percentage}{extension}`
+   */
+  [[nodiscard]] std::string imageFileName(unsigned int percentage) const;
+
+  /**
+   * File name of the `FramePack` holding every cached image of the
+   * transition, formatted:
+   * `{start image digest}-{end image digest}{extension}.frames`
+   *
+   * or with a `displayTag`:
+   * `{start image digest}-{end image digest}-{display
+   * tag}{extension}.frames`
+   */
+  [[nodiscard]] std::string packFileName() const;
+};
+
+/** Returns the key of the transition from `startImagePath` to `endImagePath`
+ * blended at the size named by `displayTag`, or `nullopt` if either can't be
+ * read */
+std::optional<TransitionCacheKey>
+transitionCacheKey(const std::filesystem::path &startImagePath,
+                   const std::filesystem::path &endImagePath,
+                   std::string extension,
+                   const std::filesystem::path &cacheDirectory,
+                   std::string displayTag = "");
+
+} // namespace dynamic_paper
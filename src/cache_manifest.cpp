@@ -0,0 +1,607 @@
+#include "cache_manifest.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "decoded_source_cache.hpp"
+#include "format.hpp"
+#include "hash.hpp"
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+constexpr std::array<char, 8> MANIFEST_MAGIC = {'D', 'P', 'M', 'A',
+                                                'N', 'I', 'F', 'S'};
+constexpr std::uint32_t MANIFEST_VERSION = 1;
+constexpr std::size_t MIN_MANIFEST_CAPACITY = 64;
+
+/** Start of the manifest file. Followed by `capacity` `ManifestSlot`s, then
+ * the file names of the images one after another */
+struct ManifestHeader {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t capacity;
+  std::uint64_t numberImages;
+  std::uint64_t totalBytes;
+  std::uint64_t namesSize;
+};
+
+/** One slot of the manifest's open addressing hash table. A `hash` of 0 means
+ * the slot is empty */
+struct ManifestSlot {
+  std::uint64_t hash;
+  std::uint64_t size;
+  std::int64_t lastUsedNanoseconds;
+  std::uint32_t nameOffset;
+  std::uint32_t nameLength;
+};
+
+static_assert(sizeof(ManifestHeader) == 40 && sizeof(ManifestSlot) == 32,
+              "Manifest layout must not have padding");
+
+/** Hash of `fileName` used to place it in the table, never 0 */
+std::uint64_t slotHash(const std::string_view fileName) {
+  const std::uint64_t hash = xxHash64(fileName);
+  return (hash == 0) ? 1 : hash;
+}
+
+std::int64_t toNanoseconds(const std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+std::chrono::system_clock::time_point
+fromNanoseconds(const std::int64_t nanoseconds) {
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::nanoseconds(nanoseconds)));
+}
+
+/** Number of hex digits a digest is written with in cache file names */
+constexpr std::size_t DIGEST_NAME_LENGTH = 16;
+
+/** Returns `true` if `text` starts with a digest written as in cache file
+ * names */
+bool startsWithDigest(const std::string_view text) {
+  return text.size() >= DIGEST_NAME_LENGTH &&
+         std::ranges::all_of(text.substr(0, DIGEST_NAME_LENGTH), [](char c) {
+           return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+         });
+}
+
+} // namespace
+
+// ===== Mapping ===============
+
+/** A read only mapping of a valid manifest file */
+struct CacheManifest::Mapping {
+  const std::byte *data = nullptr;
+  std::size_t length = 0;
+  ManifestHeader header{};
+
+  Mapping(const std::byte *data, const std::size_t length)
+      : data(data), length(length) {
+    std::memcpy(&header, data, sizeof(ManifestHeader));
+  }
+  ~Mapping() {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    munmap(const_cast<std::byte *>(data), length);
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+  Mapping(Mapping &&) = delete;
+  Mapping &operator=(Mapping &&) = delete;
+
+  /** Maps the manifest file at `path`, or returns `nullptr` if it can't be
+   * read or is damaged */
+  static std::unique_ptr<Mapping> open(const std::filesystem::path &path) {
+    const int fileDescriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0) {
+      return nullptr;
+    }
+
+    struct stat fileStatus {};
+    void *data = MAP_FAILED;
+    if (fstat(fileDescriptor, &fileStatus) == 0 &&
+        static_cast<std::size_t>(fileStatus.st_size) >=
+            sizeof(ManifestHeader)) {
+      data = mmap(nullptr, static_cast<std::size_t>(fileStatus.st_size),
+                  PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    }
+    close(fileDescriptor);
+    if (data == MAP_FAILED) {
+      return nullptr;
+    }
+
+    auto mapping = std::make_unique<Mapping>(
+        static_cast<const std::byte *>(data),
+        static_cast<std::size_t>(fileStatus.st_size));
+    if (!mapping->isValid()) {
+      return nullptr;
+    }
+    return mapping;
+  }
+
+  [[nodiscard]] ManifestSlot slot(const std::size_t index) const {
+    ManifestSlot slot{};
+    std::memcpy(&slot,
+                data + sizeof(ManifestHeader) + (index * sizeof(ManifestSlot)),
+                sizeof(ManifestSlot));
+    return slot;
+  }
+
+  [[nodiscard]] std::string_view name(const ManifestSlot &slot) const {
+    const std::byte *names = data + sizeof(ManifestHeader) +
+                             (header.capacity * sizeof(ManifestSlot));
+    return {reinterpret_cast<const char *>(names) + slot.nameOffset, // NOLINT
+            slot.nameLength};
+  }
+
+  /** Returns `true` if the table and names in the file are consistent */
+  [[nodiscard]] bool isValid() const {
+    if (header.magic != MANIFEST_MAGIC || header.version != MANIFEST_VERSION ||
+        !std::has_single_bit(header.capacity) ||
+        header.numberImages > header.capacity ||
+        length != sizeof(ManifestHeader) +
+                      (header.capacity * sizeof(ManifestSlot)) +
+                      header.namesSize) {
+      return false;
+    }
+
+    for (std::size_t i = 0; i < header.capacity; i++) {
+      const ManifestSlot currentSlot = slot(i);
+      if (currentSlot.hash != 0 &&
+          std::uint64_t{currentSlot.nameOffset} + currentSlot.nameLength >
+              header.namesSize) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** Index of the slot of `fileName` in the table */
+  [[nodiscard]] std::optional<std::size_t>
+  findIndex(const std::string_view fileName) const {
+    const std::uint64_t hash = slotHash(fileName);
+    const std::size_t mask = header.capacity - 1;
+
+    for (std::size_t probe = 0; probe < header.capacity; probe++) {
+      const std::size_t index = (hash + probe) & mask;
+      const ManifestSlot currentSlot = slot(index);
+      if (currentSlot.hash == 0) {
+        return std::nullopt;
+      }
+      if (currentSlot.hash == hash && name(currentSlot) == fileName) {
+        return index;
+      }
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::optional<ManifestSlot>
+  find(const std::string_view fileName) const {
+    const std::optional<std::size_t> index = findIndex(fileName);
+    if (!index.has_value()) {
+      return std::nullopt;
+    }
+    return slot(index.value());
+  }
+
+  [[nodiscard]] CacheManifestEntry entry(const ManifestSlot &slot) const {
+    return {.fileName = std::string(name(slot)),
+            .size = {slot.size},
+            .lastUsed = fromNanoseconds(slot.lastUsedNanoseconds)};
+  }
+};
+
+// ===== Header ===============
+
+std::filesystem::path partialPathFor(const std::filesystem::path &path) {
+  return path.parent_path() /
+         dynamic_paper::format(
+             "{}{}{}-{:x}{}", path.stem().string(), PARTIAL_IMAGE_MARKER,
+             getpid(), std::hash<std::thread::id>{}(std::this_thread::get_id()),
+             path.extension().string());
+}
+
+CacheDirectoryLock::CacheDirectoryLock(
+    const std::filesystem::path &cacheDirectory)
+    : fileDescriptor(open((cacheDirectory / CACHE_MANIFEST_LOCK_FILE_NAME).c_str(),
+                          O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR)) {
+  if (fileDescriptor >= 0 && flock(fileDescriptor, LOCK_EX) != 0) {
+    close(fileDescriptor);
+    fileDescriptor = -1;
+  }
+}
+
+CacheDirectoryLock::~CacheDirectoryLock() {
+  if (fileDescriptor >= 0) {
+    flock(fileDescriptor, LOCK_UN);
+    close(fileDescriptor);
+  }
+}
+
+bool CacheDirectoryLock::isLocked() const { return fileDescriptor >= 0; }
+
+bool isCacheImageFileName(const std::string_view fileName) {
+  if (fileName.contains(PARTIAL_IMAGE_MARKER) || !startsWithDigest(fileName)) {
+    return false;
+  }
+
+  // Composite images and frame packs start with the digests of both sources
+  const std::string_view rest = fileName.substr(DIGEST_NAME_LENGTH);
+  if (rest.starts_with('-') && startsWithDigest(rest.substr(1))) {
+    return true;
+  }
+  // Decoded sources
+  return (rest.starts_with('-') || rest.starts_with('.')) &&
+         rest.ends_with(DECODED_SOURCE_EXTENSION);
+}
+
+std::optional<CacheManifestEntry>
+newCacheManifestEntry(const std::filesystem::path &imagePath) {
+  std::error_code error;
+  const std::uintmax_t size = std::filesystem::file_size(imagePath, error);
+  if (error) {
+    logWarning("Unable to add {} to the cache manifest: {}",
+               imagePath.string(), error.message());
+    return std::nullopt;
+  }
+
+  return CacheManifestEntry{.fileName = imagePath.filename().string(),
+                            .size = {size},
+                            .lastUsed = std::chrono::system_clock::now()};
+}
+
+CacheManifest::CacheManifest(std::filesystem::path cacheDirectory)
+    : cacheDirectory(std::move(cacheDirectory)) {
+  const std::unique_lock lock(mappingMutex);
+  load();
+}
+
+CacheManifest::~CacheManifest() = default;
+
+bool CacheManifest::contains(const std::string_view fileName) const {
+  const std::shared_lock lock(mappingMutex);
+  return mapping != nullptr && mapping->find(fileName).has_value();
+}
+
+std::optional<CacheManifestEntry>
+CacheManifest::find(const std::string_view fileName) const {
+  const std::shared_lock lock(mappingMutex);
+  if (mapping == nullptr) {
+    return std::nullopt;
+  }
+
+  const std::optional<ManifestSlot> slot = mapping->find(fileName);
+  if (!slot.has_value()) {
+    return std::nullopt;
+  }
+  return mapping->entry(slot.value());
+}
+
+std::vector<CacheManifestEntry> CacheManifest::entries() const {
+  const std::shared_lock lock(mappingMutex);
+
+  std::vector<CacheManifestEntry> allEntries;
+  if (mapping == nullptr) {
+    return allEntries;
+  }
+
+  allEntries.reserve(mapping->header.numberImages);
+  for (std::size_t i = 0; i < mapping->header.capacity; i++) {
+    const ManifestSlot slot = mapping->slot(i);
+    if (slot.hash != 0) {
+      allEntries.push_back(mapping->entry(slot));
+    }
+  }
+  return allEntries;
+}
+
+std::size_t CacheManifest::numberImages() const {
+  const std::shared_lock lock(mappingMutex);
+  return (mapping == nullptr) ? 0 : mapping->header.numberImages;
+}
+
+ByteSize CacheManifest::totalSize() const {
+  const std::shared_lock lock(mappingMutex);
+  return {(mapping == nullptr) ? 0 : mapping->header.totalBytes};
+}
+
+void CacheManifest::refresh() {
+  const std::optional<FileVersion> currentVersion = currentFileVersion();
+  {
+    const std::shared_lock lock(mappingMutex);
+    if (currentVersion == loadedVersion) {
+      return;
+    }
+  }
+
+  const std::unique_lock lock(mappingMutex);
+  load();
+}
+
+bool CacheManifest::update(const std::function<void(Entries &)> &change) {
+  const std::unique_lock lock(mappingMutex);
+
+  const CacheDirectoryLock fileLock(cacheDirectory);
+  if (!fileLock.isLocked()) {
+    logWarning("Unable to lock the cache manifest in {}",
+               cacheDirectory.string());
+    return false;
+  }
+
+  // Another process may have changed the manifest since it was last loaded
+  if (mapping == nullptr || currentFileVersion() != loadedVersion) {
+    load();
+  }
+
+  Entries entries = readEntries();
+  change(entries);
+  const bool saved = save(entries);
+  load();
+  return saved;
+}
+
+bool CacheManifest::add(const std::span<const CacheManifestEntry> newEntries) {
+  if (newEntries.empty()) {
+    return true;
+  }
+
+  return update([newEntries](Entries &entries) {
+    for (const CacheManifestEntry &entry : newEntries) {
+      entries.insert_or_assign(entry.fileName, entry);
+    }
+  });
+}
+
+bool CacheManifest::markUsed(const std::span<const std::string> fileNames) {
+  if (fileNames.empty()) {
+    return true;
+  }
+
+  const std::int64_t now = toNanoseconds(std::chrono::system_clock::now());
+  const std::unique_lock lock(mappingMutex);
+
+  const CacheDirectoryLock fileLock(cacheDirectory);
+  if (!fileLock.isLocked()) {
+    logWarning("Unable to lock the cache manifest in {}",
+               cacheDirectory.string());
+    return false;
+  }
+  if (mapping == nullptr || currentFileVersion() != loadedVersion) {
+    load();
+  }
+  if (mapping == nullptr) {
+    return true;
+  }
+
+  // Only the times in the slots change, so they are written over in place
+  // instead of saving the whole manifest again
+  const int fileDescriptor =
+      ::open(manifestPath().c_str(), O_WRONLY | O_CLOEXEC);
+  if (fileDescriptor < 0) {
+    logWarning("Unable to open the cache manifest {}",
+               manifestPath().string());
+    return false;
+  }
+
+  bool written = true;
+  for (const std::string &fileName : fileNames) {
+    const std::optional<std::size_t> index = mapping->findIndex(fileName);
+    if (!index.has_value()) {
+      continue;
+    }
+    const auto offset = static_cast<off_t>(
+        sizeof(ManifestHeader) + (index.value() * sizeof(ManifestSlot)) +
+        offsetof(ManifestSlot, lastUsedNanoseconds));
+    if (pwrite(fileDescriptor, &now, sizeof(now), offset) !=
+        static_cast<ssize_t>(sizeof(now))) {
+      written = false;
+    }
+  }
+  close(fileDescriptor);
+
+  if (!written) {
+    logWarning("Unable to mark images used in the cache manifest {}",
+               manifestPath().string());
+  }
+  // Writing changed the modification time, which is not a change to reload
+  loadedVersion = currentFileVersion();
+  return written;
+}
+
+std::filesystem::path CacheManifest::manifestPath() const {
+  return cacheDirectory / CACHE_MANIFEST_FILE_NAME;
+}
+
+std::optional<CacheManifest::FileVersion>
+CacheManifest::currentFileVersion() const {
+  struct stat fileStatus {};
+  if (stat(manifestPath().c_str(), &fileStatus) != 0) {
+    return std::nullopt;
+  }
+
+#ifdef __APPLE__
+  const timespec &modifiedTime = fileStatus.st_mtimespec;
+#else
+  const timespec &modifiedTime = fileStatus.st_mtim;
+#endif
+
+  constexpr std::int64_t NANOSECONDS_PER_SECOND = 1'000'000'000;
+  return FileVersion{
+      .inode = fileStatus.st_ino,
+      .modifiedNanoseconds =
+          (static_cast<std::int64_t>(modifiedTime.tv_sec) *
+           NANOSECONDS_PER_SECOND) +
+          modifiedTime.tv_nsec,
+      .size = static_cast<std::uintmax_t>(fileStatus.st_size)};
+}
+
+void CacheManifest::load() {
+  mapping = nullptr;
+  loadedVersion = currentFileVersion();
+  if (loadedVersion.has_value()) {
+    mapping = Mapping::open(manifestPath());
+    if (mapping != nullptr) {
+      return;
+    }
+    logWarning("Cache manifest {} is damaged, rebuilding it",
+               manifestPath().string());
+  }
+
+  // Nothing to rebuild if there is no manifest and no images, such as the
+  // first time the cache is used
+  const Entries rebuiltEntries = scanDirectory();
+  if (!loadedVersion.has_value() && rebuiltEntries.empty()) {
+    return;
+  }
+
+  logInfo("Building the cache manifest of {} from {} images",
+          cacheDirectory.string(), rebuiltEntries.size());
+  if (save(rebuiltEntries)) {
+    loadedVersion = currentFileVersion();
+    mapping = Mapping::open(manifestPath());
+  }
+}
+
+bool CacheManifest::save(const Entries &entries) {
+  const std::size_t capacity = std::bit_ceil(
+      std::max<std::size_t>(entries.size() * 2, MIN_MANIFEST_CAPACITY));
+
+  std::vector<ManifestSlot> slots(capacity, ManifestSlot{});
+  std::string names;
+  std::uint64_t totalBytes = 0;
+
+  for (const auto &[fileName, entry] : entries) {
+    const std::uint64_t hash = slotHash(fileName);
+    std::size_t index = hash & (capacity - 1);
+    while (slots[index].hash != 0) {
+      index = (index + 1) & (capacity - 1);
+    }
+
+    slots[index] = {.hash = hash,
+                    .size = entry.size.bytes,
+                    .lastUsedNanoseconds = toNanoseconds(entry.lastUsed),
+                    .nameOffset = static_cast<std::uint32_t>(names.size()),
+                    .nameLength = static_cast<std::uint32_t>(fileName.size())};
+    names += fileName;
+    totalBytes += entry.size.bytes;
+  }
+
+  const ManifestHeader header = {.magic = MANIFEST_MAGIC,
+                                 .version = MANIFEST_VERSION,
+                                 .capacity =
+                                     static_cast<std::uint32_t>(capacity),
+                                 .numberImages = entries.size(),
+                                 .totalBytes = totalBytes,
+                                 .namesSize = names.size()};
+
+  const std::filesystem::path partialPath = partialPathFor(manifestPath());
+  {
+    std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), // NOLINT
+               sizeof(ManifestHeader));
+    file.write(reinterpret_cast<const char *>(slots.data()), // NOLINT
+               static_cast<std::streamsize>(slots.size() *
+                                            sizeof(ManifestSlot)));
+    file.write(names.data(), static_cast<std::streamsize>(names.size()));
+    if (!file) {
+      logWarning("Unable to save the cache manifest to {}",
+                 partialPath.string());
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(partialPath, manifestPath(), error);
+  if (error) {
+    logWarning("Unable to save the cache manifest to {}: {}",
+               manifestPath().string(), error.message());
+    return false;
+  }
+  return true;
+}
+
+CacheManifest::Entries CacheManifest::scanDirectory() const {
+  Entries entries;
+
+  std::error_code error;
+  for (const std::filesystem::directory_entry &directoryEntry :
+       std::filesystem::directory_iterator(cacheDirectory, error)) {
+    std::error_code typeError;
+    if (!directoryEntry.is_regular_file(typeError) ||
+        !isCacheImageFileName(directoryEntry.path().filename().string())) {
+      continue;
+    }
+
+    std::error_code sizeError;
+    std::error_code timeError;
+    const std::uintmax_t size = directoryEntry.file_size(sizeError);
+    const std::filesystem::file_time_type lastUsed =
+        directoryEntry.last_write_time(timeError);
+    if (!sizeError && !timeError) {
+      std::string fileName = directoryEntry.path().filename().string();
+      entries.insert_or_assign(
+          fileName,
+          CacheManifestEntry{.fileName = fileName,
+                             .size = {size},
+                             .lastUsed = std::chrono::time_point_cast<
+                                 std::chrono::system_clock::duration>(
+                                 std::chrono::file_clock::to_sys(lastUsed))});
+    }
+  }
+  return entries;
+}
+
+CacheManifest::Entries CacheManifest::readEntries() const {
+  Entries entries;
+  if (mapping == nullptr) {
+    return entries;
+  }
+
+  for (std::size_t i = 0; i < mapping->header.capacity; i++) {
+    const ManifestSlot slot = mapping->slot(i);
+    if (slot.hash != 0) {
+      CacheManifestEntry entry = mapping->entry(slot);
+      std::string fileName = entry.fileName;
+      entries.insert_or_assign(std::move(fileName), std::move(entry));
+    }
+  }
+  return entries;
+}
+
+CacheManifest &sharedCacheManifest(const std::filesystem::path &cacheDirectory) {
+  static std::mutex manifestsMutex;
+  static std::unordered_map<std::string, std::unique_ptr<CacheManifest>>
+      manifests;
+
+  const std::scoped_lock lock(manifestsMutex);
+  std::unique_ptr<CacheManifest> &sharedManifest =
+      manifests[cacheDirectory.lexically_normal().string()];
+  if (sharedManifest == nullptr) {
+    sharedManifest = std::make_unique<CacheManifest>(cacheDirectory);
+  }
+  return *sharedManifest;
+}
+
+} // namespace dynamic_paper
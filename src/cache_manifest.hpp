@@ -0,0 +1,175 @@
+#pragma once
+
+/**
+ * Index of the images in the cache directory, kept in one memory mapped file
+ * so finding out if an image is cached doesn't need to touch the filesystem.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "byte_size.hpp"
+
+namespace dynamic_paper {
+
+/** Name of the file in the cache directory that stores the `CacheManifest` */
+constexpr std::string_view CACHE_MANIFEST_FILE_NAME =
+    ".dynamic_paper_manifest";
+
+/** Part of the name of files that are still being written to the cache */
+constexpr std::string_view PARTIAL_IMAGE_MARKER = ".partial-";
+
+/** Name of the file locked while the `CacheManifest` is being changed */
+constexpr std::string_view CACHE_MANIFEST_LOCK_FILE_NAME =
+    ".dynamic_paper_manifest.lock";
+
+/** Path next to `path` to write to before renaming it over `path`, so readers
+ * never see half of the file. Keeps the extension of `path` so images are
+ * still encoded in the right format, and is unique to the process and thread
+ * so writers of the same file don't clash */
+std::filesystem::path partialPathFor(const std::filesystem::path &path);
+
+/**
+ * Holds an exclusive `flock` on `CACHE_MANIFEST_LOCK_FILE_NAME` in a cache
+ * directory for as long as it exists. Held while reading, changing and saving
+ * a file that every process using the cache changes, so no change is lost.
+ */
+class CacheDirectoryLock {
+public:
+  explicit CacheDirectoryLock(const std::filesystem::path &cacheDirectory);
+  ~CacheDirectoryLock();
+
+  CacheDirectoryLock(const CacheDirectoryLock &) = delete;
+  CacheDirectoryLock &operator=(const CacheDirectoryLock &) = delete;
+  CacheDirectoryLock(CacheDirectoryLock &&) = delete;
+  CacheDirectoryLock &operator=(CacheDirectoryLock &&) = delete;
+
+  [[nodiscard]] bool isLocked() const;
+
+private:
+  int fileDescriptor;
+};
+
+/** Returns `true` if `fileName` is named like a finished composite image,
+ * frame pack or decoded source, and not a file used to manage the cache, an
+ * image still being written or a file that was put in the cache directory by
+ * something else */
+bool isCacheImageFileName(std::string_view fileName);
+
+/** An image in the cache */
+struct CacheManifestEntry {
+  std::string fileName;
+  ByteSize size;
+  std::chrono::system_clock::time_point lastUsed;
+
+  bool operator==(const CacheManifestEntry &) const = default;
+};
+
+/** Entry for the image just written to `imagePath`, or `nullopt` if it
+ * can't be read */
+std::optional<CacheManifestEntry>
+newCacheManifestEntry(const std::filesystem::path &imagePath);
+
+/**
+ * Every image in a cache directory, and when it was last used.
+ *
+ * The manifest is a hash table written to `CACHE_MANIFEST_FILE_NAME` and
+ * memory mapped, so lookups are a probe of the mapping. Adding and removing
+ * images rewrites the table to a new file that replaces the old one with a
+ * rename, so other threads and processes only ever see a complete manifest.
+ * Transitions add every image they make at once, before they are shown, and
+ * the table is small next to the images it lists, so this costs little next
+ * to making the images. Marking images used only changes their slots, so it
+ * writes over them in place. Changes made by other
+ * processes are seen after calling `refresh`.
+ *
+ * If the file is missing or unreadable the manifest is rebuilt from the images
+ * in the directory.
+ */
+class CacheManifest {
+public:
+  /** Entries of a manifest being changed by `update`, by file name */
+  using Entries = std::unordered_map<std::string, CacheManifestEntry>;
+
+  explicit CacheManifest(std::filesystem::path cacheDirectory);
+  ~CacheManifest();
+
+  CacheManifest(const CacheManifest &) = delete;
+  CacheManifest &operator=(const CacheManifest &) = delete;
+  CacheManifest(CacheManifest &&) = delete;
+  CacheManifest &operator=(CacheManifest &&) = delete;
+
+  /** Returns `true` if the image `fileName` is in the cache */
+  [[nodiscard]] bool contains(std::string_view fileName) const;
+
+  [[nodiscard]] std::optional<CacheManifestEntry>
+  find(std::string_view fileName) const;
+
+  /** Every image in the cache, in no particular order */
+  [[nodiscard]] std::vector<CacheManifestEntry> entries() const;
+
+  [[nodiscard]] std::size_t numberImages() const;
+  [[nodiscard]] ByteSize totalSize() const;
+
+  /** Loads the manifest again if another process replaced it since it was
+   * last loaded */
+  void refresh();
+
+  /**
+   * Applies `change` to the newest version of the manifest and saves it.
+   * Holds a lock so changes from other threads and processes are not lost.
+   * Returns `false` if the manifest couldn't be saved.
+   */
+  bool update(const std::function<void(Entries &)> &change);
+
+  /** Adds images that were just written to the cache directory */
+  bool add(std::span<const CacheManifestEntry> newEntries);
+
+  /** Marks the images `fileNames` as used now, so they are evicted last.
+   * Holds the same lock as `update` */
+  bool markUsed(std::span<const std::string> fileNames);
+
+private:
+  struct Mapping;
+  struct FileVersion {
+    std::uintmax_t inode = 0;
+    std::int64_t modifiedNanoseconds = 0;
+    std::uintmax_t size = 0;
+
+    bool operator==(const FileVersion &) const = default;
+  };
+
+  std::filesystem::path cacheDirectory;
+
+  /** Guards `mapping` and `loadedVersion` */
+  mutable std::shared_mutex mappingMutex;
+  std::unique_ptr<Mapping> mapping;
+  std::optional<FileVersion> loadedVersion;
+
+  [[nodiscard]] std::filesystem::path manifestPath() const;
+  [[nodiscard]] std::optional<FileVersion> currentFileVersion() const;
+
+  /** Maps the manifest file, rebuilding it if it can't be read. Needs a
+   * unique lock on `mappingMutex` */
+  void load();
+  bool save(const Entries &entries);
+  [[nodiscard]] Entries scanDirectory() const;
+  [[nodiscard]] Entries readEntries() const;
+};
+
+/** Manifest of `cacheDirectory` shared by the whole process. Lookups don't
+ * check for changes from other processes, so it is refreshed once when a
+ * transition or cache command starts using it */
+CacheManifest &sharedCacheManifest(const std::filesystem::path &cacheDirectory);
+
+} // namespace dynamic_paper
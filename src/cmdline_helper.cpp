@@ -1,34 +1,60 @@
 #include "cmdline_helper.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <concepts>
+#include <condition_variable>
 #include <cstdio>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <map>
 #include <random>
 #include <ranges>
 #include <stdexcept>
+#include <stop_token>
 #include <string>
 #include <string_view>
 #include <thread>
 #include <unistd.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <tl/expected.hpp>
+#include <yaml-cpp/node/emit.h>
 #include <yaml-cpp/node/node.h>
 
 #include "background_set.hpp"
 #include "background_set_enums.hpp"
 #include "background_setter.hpp"
+#include "cache_key.hpp"
+#include "cache_manifest.hpp"
 #include "config.hpp"
 #include "constants.hpp"
+#include "control_socket.hpp"
+#include "decoded_source_cache.hpp"
 #include "defaults.hpp"
+#include "display_geometry.hpp"
 #include "dynamic_background_set.hpp"
+#include "file_util.hpp"
+#include "file_watcher.hpp"
+#include "frame_pack.hpp"
+#include "image_cache.hpp"
+#include "image_compositor.hpp"
+#include "native_compositor.hpp"
+#include "step_throughput.hpp"
+#include "thread_pool.hpp"
+#include "transition_session.hpp"
 #include "time_from_midnight.hpp"
 #include "time_util_current_time.hpp"
 #include "variant_visitor_templ.hpp"
+#include "wakeup_timer.hpp"
+#include "x11_background_setter.hpp"
 #include "yaml_helper.hpp"
 
 namespace dynamic_paper {
@@ -46,21 +72,33 @@ constexpr std::string_view ANSI_COLOR_RESET = "\x1b[0m";
 
 /**
  *  Parses yaml info in `backgroundSetFile` into a pair that maps the name of
- * each `BackgroundSet` to YAML info that describes it
+ * each `BackgroundSet` to YAML info that describes it, or `nullopt` if the
+ * file can't be parsed
  */
+std::optional<std::unordered_map<std::string, YAML::Node>>
+tryNameAndYAMLInfoFromFile(const std::filesystem::path &backgroundSetFile) {
+  try {
+    return YAML::LoadFile(backgroundSetFile)
+        .as<std::unordered_map<std::string, YAML::Node>>();
+  } catch (const YAML::Exception &e) {
+    logError("Unable to parse background set file {}: {}",
+             backgroundSetFile.string(), e.what());
+    return std::nullopt;
+  }
+}
+
+/** Same as `tryNameAndYAMLInfoFromFile`, but exits the program if unable to
+ * parse the file */
 std::unordered_map<std::string, YAML::Node>
 nameAndYAMLInfoFromFile(const std::filesystem::path &backgroundSetFile) {
-  YAML::Node yaml;
-
-  try {
-    yaml = YAML::LoadFile(backgroundSetFile);
-  } catch (const YAML::ParserException &e) {
+  std::optional<std::unordered_map<std::string, YAML::Node>> yamlMap =
+      tryNameAndYAMLInfoFromFile(backgroundSetFile);
+  if (!yamlMap.has_value()) {
     logFatalError("Unable to parse background set file {}",
                   backgroundSetFile.string());
     exit(1);
   }
-
-  return yaml.as<std::unordered_map<std::string, YAML::Node>>();
+  return std::move(yamlMap.value());
 }
 
 /**
@@ -107,6 +145,32 @@ void printParsingError(const std::string &name,
   }
 }
 
+/** Parses each background set in `yamlMap`, logging the ones that can't be
+ * parsed */
+std::vector<BackgroundSet> backgroundSetsFromYAML(
+    const std::unordered_map<std::string, YAML::Node> &yamlMap,
+    const Config &config) {
+  std::vector<BackgroundSet> backgroundSets;
+  backgroundSets.reserve(yamlMap.size());
+
+  const SolarDay solarDay = config.solarDayProvider.getSolarDay();
+
+  for (const auto &keyValue : yamlMap) {
+    tl::expected<BackgroundSet, BackgroundSetParseErrors> expBackgroundSet =
+        parseFromYAML(keyValue.first, keyValue.second, solarDay);
+
+    if (expBackgroundSet.has_value()) {
+      const BackgroundSet &backgroundSet = expBackgroundSet.value();
+      backgroundSets.push_back(backgroundSet);
+      logInfo("Added background: {}", backgroundSet.getName());
+    } else {
+      printParsingError(keyValue.first, expBackgroundSet.error());
+    }
+  }
+
+  return backgroundSets;
+}
+
 void setupLoggingFromYAML(const YAML::Node &config) {
   std::pair<LogLevel, std::filesystem::path> levelAndFileName =
       loadLoggingInfoFromYAML(config);
@@ -152,10 +216,335 @@ Config createConfigFromYAML(const YAML::Node &configYaml,
   return loadConfigFromYAML(configYaml, findLocationOverHttp);
 }
 
+/** Loads the general config from `file` like `loadConfigFileIntoYAML`, but
+ * returns `nullopt` instead of exiting if it can't be parsed */
+std::optional<Config> tryLoadConfigFromFile(const std::filesystem::path &file) {
+  try {
+    return createConfigFromYAML(YAML::LoadFile(file), true);
+  } catch (const std::exception &e) {
+    logError("Could not parse config file {} due to {}", file.string(),
+             e.what());
+    return std::nullopt;
+  }
+}
+
+/** Removes the least recently used cached images if the cache is over the
+ * size limit in `config` */
+void enforceCacheSizeLimit(const Config &config) {
+  if (config.cacheMaxSize.has_value()) {
+    evictLeastRecentlyUsed(config.imageCacheDirectory,
+                           config.cacheMaxSize.value());
+  }
+}
+
+/**
+ * Starts creating the images of the transition after the event current at
+ * `currentTime`, at a low priority, so the transition starts with every image
+ * already in the cache. The images are made for `mode`, the mode the
+ * transition is shown with. Images not started yet are skipped once the
+ * thread or `setStopToken` is stopped. Returns a default constructed thread if
+ * there is nothing to create.
+ */
+std::jthread prerenderUpcomingTransition(const DynamicBackgroundData &data,
+                                         const DynamicSchedule &schedule,
+                                         const Config &config,
+                                         const TimeFromMidnight currentTime,
+                                         const BackgroundSetMode mode,
+                                         const std::stop_token &setStopToken) {
+  const std::optional<detail::LerpBackgroundEvent> upcomingTransition =
+      getUpcomingTransition(data, schedule, currentTime);
+  if (!upcomingTransition.has_value()) {
+    return {};
+  }
+
+  return std::jthread([event = upcomingTransition.value(), config, mode,
+                       setStopToken](const std::stop_token &threadStopToken) {
+    std::stop_source stopSource;
+    const std::stop_callback stopWithThread(
+        threadStopToken, [&stopSource]() { stopSource.request_stop(); });
+    const std::stop_callback stopWithSet(
+        setStopToken, [&stopSource]() { stopSource.request_stop(); });
+    const std::stop_token stopToken = stopSource.get_token();
+
+    logDebug("Creating images for upcoming transition {} -> {}",
+             event.startImageName, event.endImageName);
+
+    if (!FilesystemHandler::createDirectoryIfDoesntExist(
+            config.imageCacheDirectory)) {
+      return;
+    }
+
+    try {
+      ImageCompositor::Session session(
+          event.commonImageDirectory, event.startImageName, event.endImageName,
+          config.imageCacheDirectory,
+          displayFitFor(config.displaySize, config.method, mode),
+          config.cacheDecodedSources, config.transitionFrameFormat,
+          config.packTransitionFrames);
+      const tl::expected<void, CompositeImageError> result =
+          session.prepareCompositedImages(
+              resolveAutoSteps(event.transition, config.imageCacheDirectory,
+                               config.transitionCpuBudget)
+                  .stepPercentages(config.transitionPercentageStep),
+              backgroundCompositingThreadPool(), stopToken);
+      if (stopToken.stop_requested()) {
+        logDebug("Stopped creating images for upcoming transition {} -> {}",
+                 event.startImageName, event.endImageName);
+        return;
+      }
+      if (!result.has_value()) {
+        logWarning("Unable to create images for upcoming transition {} -> {}",
+                   event.startImageName, event.endImageName);
+      }
+      enforceCacheSizeLimit(config);
+    } catch (const std::exception &e) {
+      logWarning("Unable to create images for upcoming transition {} -> {}: {}",
+                 event.startImageName, event.endImageName, e.what());
+    }
+  });
+}
+
 bool usesInPlaceTransitions(const DynamicBackgroundData &data) {
   return data.transition.has_value() && data.transition->inPlace;
 }
 
+/** Composite images of one transition in the cache, and the images they are
+ * made from. Goes in the direction the images are cached in, which may be
+ * the reverse of the transition */
+struct TransitionImages {
+  std::filesystem::path startImagePath;
+  std::filesystem::path endImagePath;
+  /** How the images are resampled before being blended */
+  std::optional<DisplayFit> fit;
+  /** Extension of the composite images */
+  std::string extension;
+  /** Percentage of each composite image, and its path in the cache. Packed
+   * images all have the path of their `FramePack` */
+  std::vector<std::pair<unsigned int, std::filesystem::path>> images;
+  /** Number of steps of the transition, which can be more than the number of
+   * `images` if steps share an image */
+  std::size_t numberSteps = 0;
+};
+
+/** Returns the composite images that `transition` uses when shown with
+ * `mode`, or `nullopt` if its images can't be read */
+std::optional<TransitionImages>
+getTransitionImages(const detail::LerpBackgroundEvent &transition,
+                    const Config &config, const BackgroundSetMode mode) {
+  const std::optional<DisplayFit> fit =
+      displayFitFor(config.displaySize, config.method, mode);
+  const tl::expected<TransitionCacheKey, CompositeImageError> key =
+      cacheKeyForTransition(transition.commonImageDirectory,
+                            transition.startImageName, transition.endImageName,
+                            config.imageCacheDirectory, fit,
+                            config.transitionFrameFormat);
+  if (!key.has_value()) {
+    return std::nullopt;
+  }
+
+  const TransitionInfo transitionInfo = resolveAutoSteps(
+      transition.transition, config.imageCacheDirectory,
+      config.transitionCpuBudget);
+  TransitionImages transitionImages = {
+      .startImagePath =
+          transition.commonImageDirectory / transition.startImageName,
+      .endImagePath = transition.commonImageDirectory / transition.endImageName,
+      .fit = fit,
+      .extension = key->extension,
+      .images = {},
+      .numberSteps = transitionInfo.steps};
+  if (key->reversed) {
+    std::swap(transitionImages.startImagePath, transitionImages.endImagePath);
+  }
+
+  std::vector<unsigned int> percentages =
+      transitionInfo.stepPercentages(config.transitionPercentageStep);
+  const auto [firstDuplicate, last] = std::ranges::unique(percentages);
+  percentages.erase(firstDuplicate, last);
+
+  for (const unsigned int percentage : percentages) {
+    transitionImages.images.emplace_back(
+        key->cachedPercentage(percentage),
+        config.imageCacheDirectory / (config.packTransitionFrames
+                                          ? key->packFileName()
+                                          : key->imageFileName(percentage)));
+  }
+  return transitionImages;
+}
+
+/** Adds the file names of the decoded start and end image of
+ * `transitionImages` to `fileNames`, if they can be read */
+void insertDecodedSourceNames(const TransitionImages &transitionImages,
+                              const std::filesystem::path &cacheDirectory,
+                              std::unordered_set<std::string> &fileNames) {
+  for (const std::filesystem::path &sourcePath :
+       {transitionImages.startImagePath, transitionImages.endImagePath}) {
+    const std::optional<std::uint64_t> digest =
+        sourceImageDigest(sourcePath, cacheDirectory);
+    if (digest.has_value()) {
+      fileNames.insert(
+          decodedSourceFileName(digest.value(), transitionImages.fit));
+    }
+  }
+}
+
+/** Composite images of one transition that are not in the cache yet */
+struct MissingTransitionImages {
+  std::shared_ptr<TransitionSession> session;
+  std::string extension;
+  std::vector<std::pair<unsigned int, std::filesystem::path>> images;
+};
+
+/**
+ * Returns the composite images of every transition in `data` that are not in
+ * the cache, leaving out images in `queuedImages`. Adds the file names of the
+ * images returned to `queuedImages`, so transitions sharing images only
+ * create them once.
+ */
+std::vector<MissingTransitionImages>
+getMissingTransitionImages(const DynamicBackgroundData &data,
+                           const Config &config,
+                           std::unordered_set<std::string> &queuedImages) {
+  std::vector<MissingTransitionImages> missingImages;
+  const CacheManifest &manifest =
+      sharedCacheManifest(config.imageCacheDirectory);
+
+  for (const detail::LerpBackgroundEvent &event : getAllTransitions(data)) {
+    std::optional<TransitionImages> transitionImages =
+        getTransitionImages(event, config, data.mode);
+    if (!transitionImages.has_value()) {
+      continue;
+    }
+
+    std::vector<std::pair<unsigned int, std::filesystem::path>> &images =
+        transitionImages->images;
+
+    // Packed images share one file, so are looked up in the pack instead
+    std::optional<FramePack> framePack = std::nullopt;
+    if (config.packTransitionFrames && !images.empty() &&
+        manifest.contains(images.front().second.filename().string())) {
+      framePack = FramePack::map(images.front().second);
+    }
+
+    std::erase_if(images, [&config, &manifest, &queuedImages, &framePack](
+                              const auto &percentageAndPath) {
+      const auto &[percentage, path] = percentageAndPath;
+      const std::string fileName = path.filename().string();
+      if (config.packTransitionFrames) {
+        return (framePack.has_value() && framePack->contains(percentage)) ||
+               !queuedImages
+                    .insert(dynamic_paper::format("{}#{}", fileName, percentage))
+                    .second;
+      }
+      return manifest.contains(fileName) || !queuedImages.insert(fileName).second;
+    });
+
+    if (!images.empty()) {
+      missingImages.push_back(
+          {.session = std::make_shared<TransitionSession>(
+               transitionImages->startImagePath,
+               transitionImages->endImagePath, transitionImages->fit,
+               config.cacheDecodedSources
+                   ? std::make_optional(config.imageCacheDirectory)
+                   : std::nullopt),
+           .extension = transitionImages->extension,
+           .images = std::move(images)});
+    }
+  }
+
+  return missingImages;
+}
+
+/** Moves the images of transitions that are packed in the same `FramePack`
+ * into the first of them, so each pack is written once */
+void mergeTransitionsSharingPack(
+    std::vector<MissingTransitionImages> &missingImages) {
+  std::unordered_map<std::string, std::size_t> transitionWithPack;
+  std::vector<MissingTransitionImages> mergedImages;
+  for (MissingTransitionImages &transition : missingImages) {
+    const auto [existing, inserted] = transitionWithPack.try_emplace(
+        transition.images.front().second.string(), mergedImages.size());
+    if (inserted) {
+      mergedImages.push_back(std::move(transition));
+    } else {
+      std::ranges::move(
+          transition.images,
+          std::back_inserter(mergedImages.at(existing->second).images));
+    }
+  }
+  missingImages = std::move(mergedImages);
+}
+
+/**
+ * Creates the images of `transition`, which all go in one `FramePack`, and
+ * adds them to the pack in one write. Returns the manifest entry of the pack,
+ * or `nullopt` if nothing was added to it.
+ */
+std::optional<CacheManifestEntry>
+writeMissingFramePack(const MissingTransitionImages &transition,
+                      const TransitionFrameFormat frameFormat,
+                      std::atomic<std::size_t> &finishedImages,
+                      std::atomic<std::size_t> &failedImages) {
+  const std::filesystem::path &packPath = transition.images.front().second;
+
+  std::vector<PackedFrame> frames;
+  for (const auto &[percentage, path] : transition.images) {
+    try {
+      tl::expected<std::vector<std::uint8_t>, CompositeImageError> frame =
+          transition.session->encodeFrame(percentage, transition.extension,
+                                          frameFormat);
+      if (frame.has_value()) {
+        frames.push_back(
+            {.percentage = percentage, .data = std::move(frame.value())});
+      } else {
+        failedImages++;
+      }
+    } catch (const std::exception &e) {
+      logError("Error creating composite image: {}", e.what());
+      failedImages++;
+    }
+    finishedImages++;
+  }
+
+  if (frames.empty()) {
+    return std::nullopt;
+  }
+  if (!writeFramePack(frames, FramePack::map(packPath), packPath)) {
+    failedImages += frames.size();
+    return std::nullopt;
+  }
+  return newCacheManifestEntry(packPath);
+}
+
+/** Returns the dynamic data of every background set that caches composite
+ * images */
+std::vector<DynamicBackgroundData>
+getCachingBackgroundSets(const std::vector<BackgroundSet> &backgroundSets) {
+  std::vector<DynamicBackgroundData> cachingSets;
+  for (const BackgroundSet &backgroundSet : backgroundSets) {
+    std::optional<DynamicBackgroundData> dynamicData =
+        backgroundSet.getDynamicBackgroundData();
+    if (dynamicData.has_value() &&
+        !usesInPlaceTransitions(dynamicData.value())) {
+      cachingSets.push_back(std::move(dynamicData.value()));
+    }
+  }
+  return cachingSets;
+}
+
+/** Prints a progress bar on the current line of stdout, replacing what was
+ * there */
+void printProgressBar(const std::size_t done, const std::size_t total) {
+  constexpr std::size_t PROGRESS_BAR_WIDTH = 40;
+
+  const std::size_t filled =
+      (total == 0) ? PROGRESS_BAR_WIDTH : (done * PROGRESS_BAR_WIDTH) / total;
+
+  std::cout << '\r' << '[' << std::string(filled, '#')
+            << std::string(PROGRESS_BAR_WIDTH - filled, ' ') << "] " << done
+            << '/' << total << " images" << std::flush;
+}
+
 void printStaticBackgroundInfo(const StaticBackgroundData &data,
                                const BackgroundSet &backgroundSet) {
   std::cout << ANSI_BOLD << ANSI_COLOR_CYAN << "\n"
@@ -249,7 +638,8 @@ void printDynamicBackgroundInfo(const DynamicBackgroundData &data,
   std::cout << "\n";
 }
 
-auto backgroundSetterScriptFunc(const Config &config) {
+auto backgroundSetterScriptFunc(const Config &config,
+                                const std::optional<std::string> &output) {
   const std::filesystem::path *script =
       std::get_if<std::filesystem::path>(&config.method);
   if (script == nullptr) {
@@ -257,74 +647,823 @@ auto backgroundSetterScriptFunc(const Config &config) {
                            "config method is not a script");
   }
 
-  return [script](const std::filesystem::path &imagePath,
-                  const BackgroundSetMode mode) {
-    setBackgroundToImageUsingScript(*script, imagePath, mode);
+  return [script, output](const std::filesystem::path &imagePath,
+                          const BackgroundSetMode mode) {
+    setBackgroundToImageUsingScript(*script, imagePath, mode, output);
   };
 }
 
+/** Calls `fn` with the function that sets the background using the method in
+ * `config`, only on the monitor called `output` if given. Wallutils always
+ * sets the background of every monitor */
+template <typename F>
+void withBackgroundSetter(const Config &config, F &&fn,
+                          const std::optional<std::string> &output =
+                              std::nullopt) {
+  std::visit(
+      overloaded{
+          [&fn](const MethodWallUtils /* method */) {
+            fn(&setBackgroundToImage);
+          },
+          [&fn, &output](const MethodX11 /* method */) {
+            fn(X11BackgroundSetter{.output = output});
+          },
+          [&fn, &config, &output](const std::filesystem::path & /* path */) {
+            fn(backgroundSetterScriptFunc(config, output));
+          },
+      },
+      config.method);
+}
+
+/** Returns `true` if transitions give their frames to the background setter
+ * from memory, so their images are not cached */
+bool showsTransitionFramesFromMemory(const Config &config) {
+  return std::holds_alternative<MethodX11>(config.method);
+}
+
+/** Images of a background set that can't be shown */
+struct BackgroundSetProblems {
+  std::vector<std::filesystem::path> missingFiles;
+  /** Files that exist but can't be read as images */
+  std::vector<std::filesystem::path> unreadableFiles;
+
+  [[nodiscard]] bool empty() const {
+    return missingFiles.empty() && unreadableFiles.empty();
+  }
+};
+
+/** Finds images of `data` that are missing or are not images. Only the
+ * header of each image is read, so large images are checked quickly */
 template <typename T>
   requires(std::is_same_v<T, DynamicBackgroundData> ||
            std::is_same_v<T, StaticBackgroundData>)
-inline std::vector<std::filesystem::path>
-missingFilesFromBackgroundSetData(const T &data) {
-  std::vector<std::filesystem::path> missingFiles;
+inline BackgroundSetProblems problemsFromBackgroundSetData(const T &data) {
+  BackgroundSetProblems problems;
 
   const std::filesystem::path dir = data.imageDirectory;
   for (const std::string_view name : data.imageNames) {
     const std::filesystem::path imagePath = dir / name;
     if (!std::filesystem::exists(imagePath)) {
-      missingFiles.push_back(imagePath);
+      problems.missingFiles.push_back(imagePath);
+    } else if (!readImageSize(imagePath).has_value()) {
+      problems.unreadableFiles.push_back(imagePath);
     }
   }
 
-  return missingFiles;
+  return problems;
 }
 
-std::vector<std::filesystem::path>
-getMissingFilesInBackgroundSet(const BackgroundSet &backgroundSet) {
+BackgroundSetProblems getBackgroundSetProblems(const BackgroundSet &backgroundSet) {
   const std::optional<StaticBackgroundData> optStatic =
       backgroundSet.getStaticBackgroundData();
   if (optStatic.has_value()) {
-    return missingFilesFromBackgroundSetData<StaticBackgroundData>(
+    return problemsFromBackgroundSetData<StaticBackgroundData>(
         optStatic.value());
   }
 
   const std::optional<DynamicBackgroundData> optDynamic =
       backgroundSet.getDynamicBackgroundData();
   if (optDynamic.has_value()) {
-    return missingFilesFromBackgroundSetData<DynamicBackgroundData>(
+    return problemsFromBackgroundSetData<DynamicBackgroundData>(
         optDynamic.value());
   }
+  return {};
+}
+
+/**
+ * Calls `setBackground` until `stopToken` is stopped, after which images are
+ * dropped. A transition still running when its set is replaced then doesn't
+ * draw over what replaced it
+ */
+template <typename Setter> struct StoppableBackgroundSetter {
+  Setter setBackground;
+  std::stop_token stopToken;
+
+  void operator()(const std::filesystem::path &imagePath,
+                  const BackgroundSetMode mode) const {
+    if (!stopToken.stop_requested()) {
+      setBackground(imagePath, mode);
+    }
+  }
+
+  void operator()(const RGBImage &frame, const BackgroundSetMode mode) const
+    requires std::invocable<const Setter &, const RGBImage &, BackgroundSetMode>
+  {
+    if (!stopToken.stop_requested()) {
+      setBackground(frame, mode);
+    }
+  }
+};
+
+/**
+ * Shows the event of `data` current now on `output`, and starts creating the
+ * images of its next transition in `prerenderThread`. Nothing more is shown
+ * once `stopToken` is stopped. Returns how long until the next event.
+ */
+std::chrono::seconds showCurrentDynamicEvent(
+    const DynamicBackgroundData &data, DynamicScheduleCache &schedules,
+    std::jthread &prerenderThread, const Config &config,
+    const std::optional<std::string> &output,
+    const std::optional<BackgroundSetMode> mode,
+    const std::stop_token &stopToken = {}) {
+  const TimeFromMidnight currentTime = getCurrentTime();
+  logDebug("Current time is {}", currentTime);
+
+  const DynamicSchedule &schedule = schedules.scheduleFor(getCurrentDay());
+  std::chrono::seconds sleepTime{};
+
+  withBackgroundSetter(
+      config,
+      [&](auto methodSetter) {
+        StoppableBackgroundSetter<decltype(methodSetter)> setBackground{
+            .setBackground = std::move(methodSetter), .stopToken = stopToken};
+        using Setter = decltype(setBackground);
+        if (usesInPlaceTransitions(data)) {
+          sleepTime = data.updateBackground<Setter, FilesystemHandler,
+                                            ImageCompositorInPlace>(
+                          schedule, currentTime, config,
+                          std::move(setBackground), mode) +
+                      std::chrono::seconds(1);
+        } else {
+          sleepTime = data.updateBackground(schedule, currentTime, config,
+                                            setBackground, mode) +
+                      std::chrono::seconds(1);
+        }
+      },
+      output);
+
+  if (!usesInPlaceTransitions(data) &&
+      !showsTransitionFramesFromMemory(config) &&
+      !stopToken.stop_requested()) {
+    enforceCacheSizeLimit(config);
+    prerenderThread =
+        prerenderUpcomingTransition(data, schedule, config, currentTime,
+                                    mode.value_or(data.mode), stopToken);
+  }
+  return sleepTime;
+}
+
+/** Returns `config` with the display size set to the size of the monitor
+ * called `output`, so transitions shown on it are blended at its size. Sizes
+ * set in the config are kept */
+Config configForOutput(const Config &config,
+                       const std::optional<std::string> &output) {
+  Config outputConfig = config;
+  if (!output.has_value()) {
+    return outputConfig;
+  }
+
+  if (std::holds_alternative<MethodWallUtils>(config.method)) {
+    logWarning("Wallutils sets the background of every monitor, so it is not "
+               "only shown on {}",
+               output.value());
+  }
+
+  const std::optional<MonitorArea> area = queryMonitorArea(output.value());
+  if (!area.has_value()) {
+    logWarning("Unable to find monitor {}, so backgrounds shown on it cover "
+               "the whole screen",
+               output.value());
+  } else if (!config.displaySize.has_value()) {
+    outputConfig.displaySize = area->geometry;
+  }
+  return outputConfig;
+}
+
+/** Returns `config`, followed by `config` for each connected monitor whose
+ * transitions are blended at another size. The daemon shows sets on one
+ * monitor at its size using `configForOutput`, so the cache commands also
+ * look at the images made for each monitor */
+std::vector<Config> configsForEveryOutput(const Config &config) {
+  std::vector<Config> configs = {config};
+  if (config.displaySize.has_value()) {
+    return configs;
+  }
+
+  const std::optional<DisplayFit> fit =
+      displayFitFor(config.displaySize, config.method, BackgroundSetMode::Fill);
+  std::vector<DisplayGeometry> seenGeometries;
+  if (fit.has_value()) {
+    seenGeometries.push_back(fit->display);
+  }
+  for (const DisplayGeometry &geometry : queryMonitorGeometries()) {
+    if (std::ranges::find(seenGeometries, geometry) != seenGeometries.end()) {
+      continue;
+    }
+    seenGeometries.push_back(geometry);
+    Config outputConfig = config;
+    outputConfig.displaySize = geometry;
+    configs.push_back(std::move(outputConfig));
+  }
+  return configs;
+}
+
+std::string bindingDescription(const DaemonSetBinding &binding) {
+  return binding.output.has_value()
+             ? dynamic_paper::format("{} on {}", binding.setName,
+                                     binding.output.value())
+             : binding.setName;
 }
 
+/** A dynamic background set shown by the daemon, and the threads showing it
+ */
+struct DaemonSlot {
+  DaemonSlot(DaemonSetBinding binding, DynamicBackgroundData data,
+             Config config, const std::optional<BackgroundSetMode> mode,
+             std::stop_source stopSource = {})
+      : binding(std::move(binding)), data(std::move(data)),
+        config(std::move(config)), mode(mode), schedules(this->data),
+        stopSource(std::move(stopSource)) {}
+  ~DaemonSlot() = default;
+
+  DaemonSlot(const DaemonSlot &) = delete;
+  DaemonSlot &operator=(const DaemonSlot &) = delete;
+  DaemonSlot(DaemonSlot &&) = delete;
+  DaemonSlot &operator=(DaemonSlot &&) = delete;
+
+  DaemonSetBinding binding;
+  DynamicBackgroundData data;
+  Config config;
+  std::optional<BackgroundSetMode> mode;
+  DynamicScheduleCache schedules;
+
+  /** Stopped once the set is no longer shown. Shared with the slots it
+   * replaced when the set was parsed again */
+  std::stop_source stopSource;
+  std::jthread prerenderThread;
+};
+
+/** How long the daemon waits to show a set again after showing it failed */
+constexpr std::chrono::seconds FAILED_UPDATE_RETRY_TIME(60);
+
+/**
+ * Shows background sets and images on monitors until the program is stopped.
+ * What is shown can be changed while it runs, from any thread.
+ *
+ * The next event of every dynamic set is kept in one `WakeupQueue`, and a set
+ * only has a thread running while it shows an event.
+ */
+class Daemon {
+public:
+  Daemon(Config config, std::filesystem::path configFile)
+      : configFile(std::move(configFile)), config(std::move(config)) {}
+  ~Daemon() = default;
+
+  Daemon(const Daemon &) = delete;
+  Daemon &operator=(const Daemon &) = delete;
+  Daemon(Daemon &&) = delete;
+  Daemon &operator=(Daemon &&) = delete;
+
+  /** Shows the set in `binding` in place of what its monitor showed, or in
+   * place of everything if it has no output */
+  ControlResponse showSet(const DaemonSetBinding &binding,
+                          const std::optional<BackgroundSetMode> mode) {
+    std::optional<BackgroundSet> backgroundSet;
+    std::optional<Config> currentConfig;
+    {
+      const std::scoped_lock lock(mutex);
+      const auto found = backgroundSets.find(binding.setName);
+      if (found == backgroundSets.end()) {
+        return {.ok = false,
+                .message = dynamic_paper::format(
+                    "Unable to show background set with name {}",
+                    binding.setName)};
+      }
+      backgroundSet = found->second;
+      currentConfig = config;
+    }
+
+    const Config outputConfig =
+        configForOutput(currentConfig.value(), binding.output);
+    const std::optional<StaticBackgroundData> staticData =
+        backgroundSet->getStaticBackgroundData();
+    std::optional<DynamicBackgroundData> dynamicData =
+        backgroundSet->getDynamicBackgroundData();
+
+    // Destroyed once `mutex` is unlocked, as it waits for their threads
+    std::vector<std::shared_ptr<DaemonSlot>> replacedSlots;
+    {
+      const std::scoped_lock lock(mutex);
+      Shown &shownOnOutput = replaceShown(binding.output, replacedSlots);
+      shownOnOutput.description = bindingDescription(binding);
+      shownOnOutput.set = binding;
+      shownOnOutput.mode = mode;
+
+      if (dynamicData.has_value()) {
+        const SlotId slotId = nextSlotId++;
+        slots.emplace(slotId, std::make_shared<DaemonSlot>(
+                                  binding, std::move(dynamicData.value()),
+                                  outputConfig, mode));
+        shownOnOutput.slot = slotId;
+        queue.schedule(slotId, std::chrono::system_clock::now());
+      }
+    }
+
+    if (staticData.has_value()) {
+      withBackgroundSetter(
+          outputConfig,
+          [&staticData, &outputConfig, mode](const auto &setBackground) {
+            staticData->show(outputConfig, setBackground, mode);
+          },
+          binding.output);
+    }
+    wakeupTimer.interrupt();
+
+    logInfo("Showing {}", bindingDescription(binding));
+    return {.ok = true,
+            .message = "Showing: " + bindingDescription(binding)};
+  }
+
+  /** Shows the image at `imagePath` in place of what `output` showed, or in
+   * place of everything if `nullopt` */
+  ControlResponse showImage(const std::filesystem::path &imagePath,
+                            const std::optional<BackgroundSetMode> mode,
+                            const std::optional<std::string> &output) {
+    if (!std::filesystem::is_regular_file(imagePath)) {
+      return {.ok = false,
+              .message = dynamic_paper::format("No image at {}",
+                                               imagePath.string())};
+    }
+
+    std::optional<Config> currentConfig;
+    {
+      const std::scoped_lock lock(mutex);
+      currentConfig = config;
+    }
+    const Config outputConfig = configForOutput(currentConfig.value(), output);
+    std::vector<std::shared_ptr<DaemonSlot>> replacedSlots;
+    {
+      const std::scoped_lock lock(mutex);
+      replaceShown(output, replacedSlots).description = imagePath.string();
+    }
+
+    withBackgroundSetter(
+        outputConfig,
+        [&imagePath, mode](const auto &setBackground) {
+          setBackground(imagePath, mode.value_or(BackgroundSetMode::Scale));
+        },
+        output);
+
+    logInfo("Showing image {}", imagePath.string());
+    return {.ok = true, .message = "Showing: " + imagePath.string()};
+  }
+
+  /** Shows a set chosen at random out of every parsed set on every monitor,
+   * or if `image` an image chosen out of the images of every set */
+  ControlResponse showRandom(const bool image,
+                             const std::optional<BackgroundSetMode> mode) {
+    std::random_device randomDevice;
+    std::mt19937 generator(randomDevice());
+
+    std::optional<std::string> setName;
+    std::vector<std::pair<std::filesystem::path, BackgroundSetMode>> images;
+    {
+      const std::scoped_lock lock(mutex);
+      if (image) {
+        const auto addImages = [&images](const auto &data) {
+          for (const std::string &imageName : data.imageNames) {
+            images.emplace_back(data.imageDirectory / imageName, data.mode);
+          }
+        };
+        for (const auto &[name, backgroundSet] : backgroundSets) {
+          if (const auto staticData = backgroundSet.getStaticBackgroundData()) {
+            addImages(staticData.value());
+          } else if (const auto dynamicData =
+                         backgroundSet.getDynamicBackgroundData()) {
+            addImages(dynamicData.value());
+          }
+        }
+      } else if (!backgroundSets.empty()) {
+        std::uniform_int_distribution<std::size_t> distribution(
+            0, backgroundSets.size() - 1);
+        setName = std::next(backgroundSets.begin(),
+                            static_cast<std::ptrdiff_t>(
+                                distribution(generator)))
+                      ->first;
+      }
+    }
+
+    if (setName.has_value()) {
+      return showSet({.setName = setName.value()}, mode);
+    }
+    if (images.empty()) {
+      return {.ok = false,
+              .message = "No background sets were parsed to choose from"};
+    }
+    std::uniform_int_distribution<std::size_t> distribution(0,
+                                                            images.size() - 1);
+    const auto &[imagePath, imageMode] = images.at(distribution(generator));
+    return showImage(imagePath, mode.value_or(imageMode), std::nullopt);
+  }
+
+  /** Lists what each monitor shows */
+  ControlResponse status() {
+    const std::scoped_lock lock(mutex);
+    if (shown.empty()) {
+      return {.ok = true, .message = "Nothing shown\n"};
+    }
+    std::string message;
+    for (const Shown &entry : shown) {
+      message += entry.description;
+      message += '\n';
+    }
+    return {.ok = true, .message = message};
+  }
+
+  /**
+   * Parses the background sets that changed since the background set file was
+   * last parsed, or the general config and every set if `reloadConfig`. Shown
+   * sets that were parsed again are swapped for what was parsed, after the
+   * transition they show finishes
+   */
+  ControlResponse reload(const bool reloadConfig) {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::optional<Config> reloadedConfig;
+    {
+      const std::scoped_lock lock(mutex);
+      reloadedConfig = config;
+    }
+    if (reloadConfig) {
+      reloadedConfig = tryLoadConfigFromFile(configFile);
+      if (!reloadedConfig.has_value()) {
+        return {.ok = false,
+                .message = dynamic_paper::format(
+                    "Unable to parse config file {}", configFile.string())};
+      }
+    }
+
+    const std::optional<std::unordered_map<std::string, YAML::Node>> yamlMap =
+        tryNameAndYAMLInfoFromFile(reloadedConfig->backgroundSetConfigFile);
+    if (!yamlMap.has_value()) {
+      return {.ok = false,
+              .message = dynamic_paper::format(
+                  "Unable to parse background set file {}",
+                  reloadedConfig->backgroundSetConfigFile.string())};
+    }
+
+    std::unordered_map<std::string, std::string> texts;
+    for (const auto &[name, node] : yamlMap.value()) {
+      texts.emplace(name, YAML::Dump(node));
+    }
+
+    BackgroundSetChanges changes;
+    {
+      const std::scoped_lock lock(mutex);
+      changes = diffBackgroundSets(
+          reloadConfig ? std::unordered_map<std::string, std::string>{}
+                       : backgroundSetTexts,
+          texts);
+    }
+    std::vector<std::string> namesToParse = std::move(changes.added);
+    std::ranges::copy(changes.changed, std::back_inserter(namesToParse));
+
+    // Times of every set may depend on where the config says the user is
+    const SolarDay solarDay = reloadedConfig->solarDayProvider.getSolarDay();
+    std::unordered_map<std::string, BackgroundSet> parsedSets;
+    for (const std::string &name : namesToParse) {
+      tl::expected<BackgroundSet, BackgroundSetParseErrors> expBackgroundSet =
+          parseFromYAML(name, yamlMap->at(name), solarDay);
+      if (expBackgroundSet.has_value()) {
+        parsedSets.emplace(name, std::move(expBackgroundSet.value()));
+      } else {
+        printParsingError(name, expBackgroundSet.error());
+      }
+    }
+
+    std::vector<std::pair<DaemonSetBinding, std::optional<BackgroundSetMode>>>
+        setsToShowAgain;
+    std::vector<std::shared_ptr<DaemonSlot>> replacedSlots;
+    {
+      const std::scoped_lock lock(mutex);
+      config = std::move(reloadedConfig.value());
+      backgroundSetTexts = std::move(texts);
+      if (reloadConfig) {
+        backgroundSets.clear();
+      }
+      for (const std::string &name : changes.removed) {
+        backgroundSets.erase(name);
+      }
+      for (const std::string &name : namesToParse) {
+        backgroundSets.erase(name);
+      }
+      backgroundSets.merge(parsedSets);
+
+      for (Shown &entry : shown) {
+        if (!entry.set.has_value() ||
+            std::ranges::find(namesToParse, entry.set->setName) ==
+                namesToParse.end()) {
+          continue;
+        }
+
+        const auto backgroundSet = backgroundSets.find(entry.set->setName);
+        if (backgroundSet == backgroundSets.end()) {
+          logWarning("Keeping {} as it was, since it could not be parsed "
+                     "again",
+                     entry.description);
+          continue;
+        }
+        std::optional<DynamicBackgroundData> dynamicData =
+            backgroundSet->second.getDynamicBackgroundData();
+        if (dynamicData.has_value() && entry.slot.has_value()) {
+          replaceSlot(entry.slot.value(), std::move(dynamicData.value()),
+                      replacedSlots);
+        } else {
+          setsToShowAgain.emplace_back(entry.set.value(), entry.mode);
+        }
+      }
+    }
+
+    for (const auto &[binding, mode] : setsToShowAgain) {
+      showSet(binding, mode);
+    }
+    wakeupTimer.interrupt();
+
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    logInfo("Reloaded background sets in {} ms, parsed {} of {} again",
+            duration.count(), namesToParse.size(), yamlMap->size());
+    return {.ok = true,
+            .message = dynamic_paper::format(
+                "Parsed {} of {} background sets again", namesToParse.size(),
+                yamlMap->size())};
+  }
+
+  /** Path of the background set file, which can change when the config is
+   * reloaded */
+  std::filesystem::path backgroundSetFile() {
+    const std::scoped_lock lock(mutex);
+    return config.backgroundSetConfigFile;
+  }
+
+  /** Answers a request from the control socket */
+  ControlResponse handle(const ControlRequest &request) {
+    const std::vector<std::string> &arguments = request.arguments;
+    const auto optionalArgument =
+        [&arguments](const std::size_t index) -> std::optional<std::string> {
+      if (index < arguments.size() && !arguments[index].empty()) {
+        return arguments[index];
+      }
+      return std::nullopt;
+    };
+    const auto modeArgument = [&optionalArgument](const std::size_t index) {
+      return stringToBackgroundSetMode(optionalArgument(index).value_or(""));
+    };
+
+    // Every request that takes a mode has it as its second argument
+    if (optionalArgument(1).has_value() && !modeArgument(1).has_value() &&
+        request.command != ControlCommand::Status &&
+        request.command != ControlCommand::Reload) {
+      return {.ok = false,
+              .message = dynamic_paper::format(
+                  "Unknown mode {}, expected Center, Fill, Tile, or Scale",
+                  arguments[1])};
+    }
+
+    switch (request.command) {
+    case ControlCommand::Show: {
+      const std::optional<DaemonSetBinding> binding =
+          arguments.empty() ? std::nullopt
+                            : parseDaemonSetBinding(arguments.front());
+      if (!binding.has_value() || arguments.size() > 2) {
+        return {.ok = false,
+                .message = "Expected a background set as name or "
+                           "name@output, and optionally a mode"};
+      }
+      return showSet(binding.value(), modeArgument(1));
+    }
+    case ControlCommand::Image: {
+      if (arguments.empty() || arguments.size() > 3) {
+        return {.ok = false,
+                .message = "Expected an image path, and optionally a mode "
+                           "and output"};
+      }
+      return showImage(arguments.front(), modeArgument(1),
+                       optionalArgument(2));
+    }
+    case ControlCommand::Random: {
+      const std::string kind = optionalArgument(0).value_or("set");
+      if ((kind != "set" && kind != "image") || arguments.size() > 2) {
+        return {.ok = false,
+                .message = "Expected set or image, and optionally a mode"};
+      }
+      return showRandom(kind == "image", modeArgument(1));
+    }
+    case ControlCommand::Status:
+      return status();
+    case ControlCommand::Reload:
+      return reload(true);
+    }
+
+    return {.ok = false, .message = "Unknown request"};
+  }
+
+  /** Returns `true` if a dynamic set is shown, so there are events to wait
+   * for */
+  bool showsDynamicSets() {
+    const std::scoped_lock lock(mutex);
+    return !slots.empty();
+  }
+
+  /** Shows the events of the dynamic sets shown as they come. Never returns
+   */
+  [[noreturn]] void run() {
+    while (true) {
+      std::optional<WakeupQueue::TimePoint> nextDeadline;
+      std::vector<std::jthread> finishedThreads;
+      {
+        const std::scoped_lock lock(mutex);
+        for (const SlotId slotId : finishedUpdates) {
+          const auto thread = updateThreads.find(slotId);
+          if (thread != updateThreads.end()) {
+            finishedThreads.push_back(std::move(thread->second));
+            updateThreads.erase(thread);
+          }
+        }
+        finishedUpdates.clear();
+
+        for (const SlotId slotId :
+             queue.popDue(std::chrono::system_clock::now())) {
+          const auto slot = slots.find(slotId);
+          // Sets no longer shown are left in the queue until they are due
+          if (slot != slots.end()) {
+            updateThreads[slotId] = showNextEvent(slotId, slot->second);
+          }
+        }
+        nextDeadline = queue.nextDeadline();
+      }
+      finishedThreads.clear();
+      flushLogger();
+
+      // Every set may be showing a transition, which wakes the timer once
+      // done
+      const WakeupReason reason = wakeupTimer.sleepUntil(nextDeadline.value_or(
+          std::chrono::system_clock::now() + std::chrono::hours(24)));
+      if (reason == WakeupReason::ClockChanged) {
+        logInfo("Clock changed or resumed from suspend, updating backgrounds");
+        const std::scoped_lock lock(mutex);
+        for (const SlotId slotId : slots | std::views::keys) {
+          if (queue.contains(slotId)) {
+            queue.schedule(slotId, std::chrono::system_clock::now());
+          }
+        }
+      }
+    }
+  }
+
+private:
+  using SlotId = std::size_t;
+
+  /** What the daemon shows on a monitor */
+  struct Shown {
+    /** Name of the monitor, or `nullopt` for every monitor */
+    std::optional<std::string> output;
+    std::string description;
+    /** Set shown and the mode it is shown with, or `nullopt` for an image */
+    std::optional<DaemonSetBinding> set = std::nullopt;
+    std::optional<BackgroundSetMode> mode = std::nullopt;
+    /** Slot showing the events of a dynamic set */
+    std::optional<SlotId> slot = std::nullopt;
+  };
+
+  std::filesystem::path configFile;
+
+  /** Guards every member below */
+  std::mutex mutex;
+  Config config;
+  std::unordered_map<std::string, BackgroundSet> backgroundSets;
+  /** Text of each background set in the file when it was last parsed, to
+   * find the sets that changed */
+  std::unordered_map<std::string, std::string> backgroundSetTexts;
+  std::vector<Shown> shown;
+  /** Dynamic sets being shown. A set no longer shown may still have its
+   * thread finishing, which keeps its slot until then */
+  std::map<SlotId, std::shared_ptr<DaemonSlot>> slots;
+  SlotId nextSlotId = 0;
+  /** Each shown dynamic set is in the queue while it waits for its next
+   * event, and is taken out while its thread shows the event */
+  WakeupQueue queue;
+  /** Slots whose thread is done and can be joined */
+  std::vector<SlotId> finishedUpdates;
+  /** Slot that takes over once the thread of a replaced slot is done */
+  std::unordered_map<SlotId, SlotId> replacements;
+
+  WakeupTimer wakeupTimer;
+  /** Destroyed first, so every thread is joined while the rest still exists
+   */
+  std::unordered_map<SlotId, std::jthread> updateThreads;
+
+  /**
+   * Stops showing what `output` shows, along with what every monitor shows if
+   * it or `output` is `nullopt`, and returns the entry to fill in for what is
+   * shown in its place. `mutex` must be locked.
+   *
+   * The slots that were shown are moved to `replacedSlots`, to be destroyed
+   * after `mutex` is unlocked, since destroying a slot waits for the images
+   * its thread is creating.
+   */
+  Shown &
+  replaceShown(const std::optional<std::string> &output,
+               std::vector<std::shared_ptr<DaemonSlot>> &replacedSlots) {
+    std::erase_if(shown, [this, &output, &replacedSlots](const Shown &entry) {
+      const bool replaced = !output.has_value() ||
+                            !entry.output.has_value() ||
+                            entry.output == output;
+      if (replaced && entry.slot.has_value()) {
+        const auto slot = slots.find(entry.slot.value());
+        slot->second->stopSource.request_stop();
+        replacedSlots.push_back(std::move(slot->second));
+        slots.erase(slot);
+      }
+      return replaced;
+    });
+    return shown.emplace_back(Shown{.output = output, .description = ""});
+  }
+
+  /** Shows `data` with the slot `slotId` shows, in its place. If it is
+   * showing an event, the new slot waits for it to finish. `mutex` must be
+   * locked, and the replaced slot is moved to `replacedSlots` like in
+   * `replaceShown` */
+  void replaceSlot(SlotId &slotId, DynamicBackgroundData data,
+                   std::vector<std::shared_ptr<DaemonSlot>> &replacedSlots) {
+    const SlotId previousId = slotId;
+    const std::shared_ptr<DaemonSlot> &previous =
+        replacedSlots.emplace_back(slots.at(previousId));
+
+    slotId = nextSlotId++;
+    slots.emplace(slotId,
+                  std::make_shared<DaemonSlot>(
+                      previous->binding, std::move(data),
+                      configForOutput(config, previous->binding.output),
+                      previous->mode, previous->stopSource));
+    slots.erase(previousId);
+
+    if (queue.contains(previousId)) {
+      queue.schedule(slotId, std::chrono::system_clock::now());
+    } else {
+      replacements.emplace(previousId, slotId);
+    }
+  }
+
+  /** Starts a thread showing the current event of `slot`, which puts it back
+   * in the queue for its next event once done */
+  std::jthread showNextEvent(const SlotId slotId,
+                             std::shared_ptr<DaemonSlot> slot) {
+    return std::jthread([this, slotId, slot = std::move(slot)]() {
+      const std::stop_token stopToken = slot->stopSource.get_token();
+      std::chrono::seconds sleepTime = FAILED_UPDATE_RETRY_TIME;
+      try {
+        sleepTime = showCurrentDynamicEvent(
+            slot->data, slot->schedules, slot->prerenderThread, slot->config,
+            slot->binding.output, slot->mode, stopToken);
+      } catch (const std::exception &e) {
+        logError("Unable to show {}: {}", bindingDescription(slot->binding),
+                 e.what());
+      }
+      logDebug("{} sleeping for {} seconds...", slot->binding.setName,
+               sleepTime);
+      {
+        const std::scoped_lock lock(mutex);
+        SlotId nextSlot = slotId;
+        for (auto replacement = replacements.find(nextSlot);
+             replacement != replacements.end();
+             replacement = replacements.find(nextSlot)) {
+          nextSlot = replacement->second;
+          replacements.erase(replacement);
+        }
+
+        if (nextSlot != slotId) {
+          if (slots.contains(nextSlot)) {
+            queue.schedule(nextSlot, std::chrono::system_clock::now());
+          }
+        } else if (!stopToken.stop_requested()) {
+          queue.schedule(slotId, wallClockDeadlineAfter(sleepTime));
+        }
+        finishedUpdates.push_back(slotId);
+      }
+      wakeupTimer.interrupt();
+    });
+  }
+};
+
 } // namespace
 
 // ===== Header ====================
 
-void useScriptToSetBackground(const Config &config,
+void setBackgroundUsingMethod(const Config &config,
                               const std::filesystem::path &image,
                               const BackgroundSetMode mode) {
-  const auto backgroundSetterFunc = backgroundSetterScriptFunc(config);
-  backgroundSetterFunc(image, mode);
-}
-
-bool shouldUseScriptToSetBackground(const Config &config) {
-  return std::visit(
-      overloaded{
-          [](const MethodWallUtils /* method */) { return false; },
-          [](const std::filesystem::path & /* path */) { return true; },
-      },
-      config.method);
+  withBackgroundSetter(config, [&image, mode](const auto &setBackground) {
+    setBackground(image, mode);
+  });
 }
 
 Config getConfigAndSetupLogging(const argparse::ArgumentParser &program,
                                 const bool findLocationOverHttp) {
-  const std::filesystem::path conf = program.get(CONFIG_FLAG_NAME);
   const bool logToStdout = program.get<bool>(LOG_TO_STDOUT_FLAG_NAME);
 
   // TODO not taking this value?
-  auto configFilePath = std::filesystem::path(expandPath(conf));
+  auto configFilePath = getConfigFilePath(program);
 
   if (configFilePath == expandPath(DEFAULT_CONFIG_FILE_NAME)) {
     const bool fileCreationResult = FilesystemHandler::createFileIfDoesntExist(
@@ -348,43 +1487,278 @@ Config getConfigAndSetupLogging(const argparse::ArgumentParser &program,
   return createConfigFromYAML(configYaml, findLocationOverHttp);
 }
 
+std::filesystem::path
+getConfigFilePath(const argparse::ArgumentParser &program) {
+  const std::filesystem::path conf = program.get(CONFIG_FLAG_NAME);
+  return {expandPath(conf)};
+}
+
 void showCacheInfo(const Config &config) {
   constexpr std::string_view ANSI_COLOR_CYAN = "\x1b[36m";
   constexpr std::string_view ANSI_COLOR_RESET = "\x1b[0m";
 
   std::cout << "Cache files are stored in " << ANSI_COLOR_CYAN
             << config.imageCacheDirectory.string() << ANSI_COLOR_RESET << "\n";
+
+  const CacheContents contents = getCacheContents(config.imageCacheDirectory);
+  std::cout << "Images: " << contents.numberImages << "\n";
+  std::cout << "Size: " << byteSizeString(contents.size);
+  if (config.cacheMaxSize.has_value()) {
+    std::cout << " / " << byteSizeString(config.cacheMaxSize.value());
+  }
+  std::cout << "\n";
+
+  const CacheStatistics statistics =
+      readCacheStatistics(config.imageCacheDirectory);
+  std::cout << dynamic_paper::format(
+      "Hit rate: {:.1f}% ({} hits, {} misses)\n",
+      statistics.hitRate() * 100.0, statistics.hits, statistics.misses);
+
+  if (!std::filesystem::exists(config.backgroundSetConfigFile)) {
+    return;
+  }
+
+  // Steps share an image when they are in transitions between the same
+  // images, in either direction, or snap to the same percentage
+  std::size_t numberSteps = 0;
+  std::unordered_set<std::string> usedImages;
+  const std::vector<Config> outputConfigs = configsForEveryOutput(config);
+  const std::vector<DynamicBackgroundData> cachingSets =
+      getCachingBackgroundSets(getBackgroundSetsFromFile(config));
+  for (const Config &outputConfig : outputConfigs) {
+    for (const DynamicBackgroundData &dynamicData : cachingSets) {
+      for (const detail::LerpBackgroundEvent &transition :
+           getAllTransitions(dynamicData)) {
+        const std::optional<TransitionImages> transitionImages =
+            getTransitionImages(transition, outputConfig, dynamicData.mode);
+        if (!transitionImages.has_value()) {
+          continue;
+        }
+        numberSteps += transitionImages->numberSteps;
+        for (const auto &[percentage, path] : transitionImages->images) {
+          usedImages.insert(path.filename().string());
+        }
+      }
+    }
+  }
+
+  const CacheManifest &manifest =
+      sharedCacheManifest(config.imageCacheDirectory);
+  const std::size_t cachedImages =
+      std::ranges::count_if(usedImages, [&manifest](const std::string &name) {
+        return manifest.contains(name);
+      });
+  std::cout << dynamic_paper::format(
+      "Background sets use {} images for {} transition steps ({} cached)\n",
+      usedImages.size(), numberSteps, cachedImages);
+  if (config.transitionPercentageStep.has_value()) {
+    std::cout << dynamic_paper::format(
+        "Transition steps are rounded to multiples of {}%\n",
+        config.transitionPercentageStep.value());
+  }
+  for (const Config &outputConfig : outputConfigs) {
+    const std::optional<DisplayFit> fit = displayFitFor(
+        outputConfig.displaySize, outputConfig.method, BackgroundSetMode::Fill);
+    if (fit.has_value()) {
+      std::cout << dynamic_paper::format(
+          "Transitions are blended for a {}x{} display\n", fit->display.width,
+          fit->display.height);
+    }
+  }
+  if (config.cacheDecodedSources) {
+    std::cout << "Decoded source images are kept in the cache\n";
+  }
+  if (config.transitionFrameFormat != TransitionFrameFormat::Source) {
+    std::cout << dynamic_paper::format(
+        "Transition frames are saved as {}\n",
+        transitionFrameFormatString(config.transitionFrameFormat));
+  }
+  if (config.packTransitionFrames) {
+    std::cout << "Frames of each transition are packed into one file\n";
+  }
 }
 
-bool isBeingPiped() { return isatty(fileno(stdin)) == 0; }
+void buildCache(const Config &config, const std::optional<std::size_t> jobs,
+                const std::vector<std::string> &setNames) {
+  constexpr std::chrono::milliseconds PROGRESS_UPDATE_INTERVAL(100);
+
+  std::vector<BackgroundSet> backgroundSets = getBackgroundSetsFromFile(config);
+  for (const std::string &name : setNames) {
+    if (std::ranges::none_of(backgroundSets,
+                             [&name](const BackgroundSet &backgroundSet) {
+                               return backgroundSet.getName() == name;
+                             })) {
+      errorMsg("No background set with name {}", name);
+    }
+  }
 
-/**
- * Parses `BackgroundSet`s from the config file, exiting the program if unable
- * to parse one
- */
-std::vector<BackgroundSet> getBackgroundSetsFromFile(const Config &config) {
-  const std::unordered_map<std::string, YAML::Node> yamlMap =
-      nameAndYAMLInfoFromFile(config.backgroundSetConfigFile);
+  // Made first as the fingerprints of the images are saved in it
+  if (!FilesystemHandler::createDirectoryIfDoesntExist(
+          config.imageCacheDirectory)) {
+    errorMsg("Unable to create cache directory {}",
+             config.imageCacheDirectory.string());
+    return;
+  }
 
-  std::vector<BackgroundSet> backgroundSets;
-  backgroundSets.reserve(yamlMap.size());
+  if (!setNames.empty()) {
+    std::erase_if(backgroundSets, [&setNames](const BackgroundSet &backgroundSet) {
+      return std::ranges::find(setNames, backgroundSet.getName()) ==
+             setNames.end();
+    });
+  }
 
-  const SolarDay solarDay = config.solarDayProvider.getSolarDay();
+  std::vector<MissingTransitionImages> missingImages;
+  std::unordered_set<std::string> queuedImages;
+  const std::vector<DynamicBackgroundData> cachingSets =
+      getCachingBackgroundSets(backgroundSets);
+  for (const Config &outputConfig : configsForEveryOutput(config)) {
+    for (const DynamicBackgroundData &dynamicData : cachingSets) {
+      std::ranges::move(
+          getMissingTransitionImages(dynamicData, outputConfig, queuedImages),
+          std::back_inserter(missingImages));
+    }
+  }
 
-  for (const auto &keyValue : yamlMap) {
-    tl::expected<BackgroundSet, BackgroundSetParseErrors> expBackgroundSet =
-        parseFromYAML(keyValue.first, keyValue.second, solarDay);
+  if (config.packTransitionFrames) {
+    mergeTransitionsSharingPack(missingImages);
+  }
 
-    if (expBackgroundSet.has_value()) {
-      const BackgroundSet &backgroundSet = expBackgroundSet.value();
-      backgroundSets.push_back(backgroundSet);
-      logInfo("Added background: {}", backgroundSet.getName());
-    } else {
-      printParsingError(keyValue.first, expBackgroundSet.error());
+  std::size_t totalImages = 0;
+  for (const MissingTransitionImages &transition : missingImages) {
+    totalImages += transition.images.size();
+  }
+  if (totalImages == 0) {
+    std::cout << "Cache already has every image\n";
+    return;
+  }
+
+  std::atomic<std::size_t> finishedImages = 0;
+  std::atomic<std::size_t> failedImages = 0;
+  std::mutex newEntriesMutex;
+  std::vector<CacheManifestEntry> newEntries;
+
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  {
+    ThreadPool threadPool(std::max<std::size_t>(
+        jobs.value_or(defaultThreadPoolSize()), 1));
+
+    // Each transition is one task that queues its images on its own worker.
+    // Workers finish the transition they started, whose images are already
+    // decoded, before stealing a new one.
+    for (MissingTransitionImages &transition : missingImages) {
+      // Packed images are created by one worker, as the pack is written once
+      if (config.packTransitionFrames) {
+        threadPool.submit([&finishedImages, &failedImages, &newEntriesMutex,
+                           &newEntries,
+                           frameFormat = config.transitionFrameFormat,
+                           transition = std::move(transition)]() {
+          std::optional<CacheManifestEntry> entry = writeMissingFramePack(
+              transition, frameFormat, finishedImages, failedImages);
+          if (entry.has_value()) {
+            const std::scoped_lock lock(newEntriesMutex);
+            newEntries.push_back(std::move(entry.value()));
+          }
+        });
+        continue;
+      }
+
+      threadPool.submit([&threadPool, &finishedImages, &failedImages,
+                         &newEntriesMutex, &newEntries,
+                         frameFormat = config.transitionFrameFormat,
+                         transition = std::move(transition)]() {
+        for (const auto &[percentage, path] : transition.images) {
+          threadPool.submit([&finishedImages, &failedImages, &newEntriesMutex,
+                             &newEntries, frameFormat,
+                             session = transition.session,
+                             percentage = percentage, path = path]() {
+            try {
+              if (session->writeFrame(percentage, path, frameFormat)
+                      .has_value()) {
+                std::optional<CacheManifestEntry> entry =
+                    newCacheManifestEntry(path);
+                if (entry.has_value()) {
+                  const std::scoped_lock lock(newEntriesMutex);
+                  newEntries.push_back(std::move(entry.value()));
+                }
+              } else {
+                failedImages++;
+              }
+            } catch (const std::exception &e) {
+              logError("Error creating composite image: {}", e.what());
+              failedImages++;
+            }
+            finishedImages++;
+          });
+        }
+      });
     }
+
+    while (finishedImages.load() < totalImages) {
+      printProgressBar(finishedImages.load(), totalImages);
+      std::this_thread::sleep_for(PROGRESS_UPDATE_INTERVAL);
+    }
+    printProgressBar(totalImages, totalImages);
+    std::cout << '\n';
   }
 
-  return backgroundSets;
+  sharedCacheManifest(config.imageCacheDirectory).add(newEntries);
+
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  const std::size_t createdImages = totalImages - failedImages.load();
+
+  std::cout << dynamic_paper::format(
+      "Created {} images in {:.1f}s ({:.1f} images/s)\n", createdImages,
+      elapsed.count(), static_cast<double>(createdImages) / elapsed.count());
+  if (failedImages.load() > 0) {
+    errorMsg("Unable to create {} images", failedImages.load());
+  }
+
+  enforceCacheSizeLimit(config);
+}
+
+void cleanCache(const Config &config) {
+  std::unordered_set<std::string> usedImages;
+  const std::vector<DynamicBackgroundData> cachingSets =
+      getCachingBackgroundSets(getBackgroundSetsFromFile(config));
+  for (const Config &outputConfig : configsForEveryOutput(config)) {
+    for (const DynamicBackgroundData &dynamicData : cachingSets) {
+      for (const detail::LerpBackgroundEvent &transition :
+           getAllTransitions(dynamicData)) {
+        const std::optional<TransitionImages> transitionImages =
+            getTransitionImages(transition, outputConfig, dynamicData.mode);
+        if (!transitionImages.has_value()) {
+          continue;
+        }
+        for (const auto &[percentage, path] : transitionImages->images) {
+          usedImages.insert(path.filename().string());
+        }
+        if (config.cacheDecodedSources) {
+          insertDecodedSourceNames(transitionImages.value(),
+                                   config.imageCacheDirectory, usedImages);
+        }
+      }
+    }
+  }
+
+  const CacheContents removed =
+      removeCacheImagesExcept(config.imageCacheDirectory, usedImages);
+  forgetMissingSourceImages(config.imageCacheDirectory);
+
+  std::cout << "Removed " << removed.numberImages << " unused images ("
+            << byteSizeString(removed.size) << ")\n";
+}
+
+bool isBeingPiped() { return isatty(fileno(stdin)) == 0; }
+
+/**
+ * Parses `BackgroundSet`s from the config file, exiting the program if unable
+ * to parse one
+ */
+std::vector<BackgroundSet> getBackgroundSetsFromFile(const Config &config) {
+  return backgroundSetsFromYAML(
+      nameAndYAMLInfoFromFile(config.backgroundSetConfigFile), config);
 }
 
 std::vector<std::pair<std::string_view, BackgroundSetType>>
@@ -535,61 +1909,131 @@ void showBackgroundSet(BackgroundSet &backgroundSet, const Config &config,
       backgroundSet.getStaticBackgroundData();
 
   if (staticData.has_value()) {
-    if (shouldUseScriptToSetBackground(config)) {
-      const auto backgroundSetterFunc = backgroundSetterScriptFunc(config);
-      staticData->show(config, backgroundSetterFunc, mode);
-    } else {
-      staticData->show(config, setBackgroundToImage, mode);
-    }
+    withBackgroundSetter(config, [&staticData, &config,
+                                  mode](const auto &setBackground) {
+      staticData->show(config, setBackground, mode);
+    });
   }
 
   std::optional<DynamicBackgroundData> dynamicData =
       backgroundSet.getDynamicBackgroundData();
   if (dynamicData.has_value()) {
+    std::jthread prerenderThread;
+    DynamicScheduleCache schedules(dynamicData.value());
+    WakeupTimer wakeupTimer;
+
     while (true) {
-      const TimeFromMidnight currentTime = getCurrentTime();
-      logDebug("Current time is {}", currentTime);
-
-      std::chrono::seconds sleepTime{};
-
-      if (usesInPlaceTransitions(dynamicData.value())) {
-        if (shouldUseScriptToSetBackground(config)) {
-          const auto backgroundSetterFunc = backgroundSetterScriptFunc(config);
-          sleepTime =
-              dynamicData
-                  ->updateBackground<decltype(backgroundSetterFunc),
-                                     FilesystemHandler, ImageCompositorInPlace>(
-                      currentTime, config, std::move(backgroundSetterFunc),
-                      mode) +
-              std::chrono::seconds(1);
-        } else {
-          sleepTime =
-              dynamicData
-                  ->updateBackground<decltype(&setBackgroundToImage),
-                                     FilesystemHandler, ImageCompositorInPlace>(
-                      currentTime, config, &setBackgroundToImage, mode) +
-              std::chrono::seconds(1);
-        }
-      } else {
-        if (shouldUseScriptToSetBackground(config)) {
-          const auto backgroundSetterFunc = backgroundSetterScriptFunc(config);
-          sleepTime = dynamicData->updateBackground(
-                          currentTime, config, backgroundSetterFunc, mode) +
-                      std::chrono::seconds(1);
-        } else {
-          sleepTime = dynamicData->updateBackground(
-                          currentTime, config, &setBackgroundToImage, mode) +
-                      std::chrono::seconds(1);
-        }
-      }
+      const std::chrono::seconds sleepTime =
+          showCurrentDynamicEvent(dynamicData.value(), schedules,
+                                  prerenderThread, config, std::nullopt, mode);
 
       logDebug("Sleeping for {} seconds...", sleepTime);
       flushLogger();
-      std::this_thread::sleep_for(sleepTime);
+      if (wakeupTimer.sleepUntil(wallClockDeadlineAfter(sleepTime)) ==
+          WakeupReason::ClockChanged) {
+        logInfo("Clock changed or resumed from suspend, updating background");
+      }
     }
   }
 }
 
+void runDaemon(const std::vector<DaemonSetBinding> &bindings,
+               const Config &config, const std::filesystem::path &configFile,
+               const std::optional<BackgroundSetMode> mode) {
+  tl::expected<std::unique_ptr<ControlServer>, ControlSocketError> server =
+      ControlServer::listen(controlSocketPath());
+  if (!server.has_value()) {
+    if (server.error() == ControlSocketError::AlreadyRunning) {
+      errorMsg("A daemon is already running, change what it shows with the "
+               "show command");
+      return;
+    }
+    logWarning("Unable to listen on {}, so the daemon can't be controlled",
+               controlSocketPath().string());
+  }
+
+  Daemon daemon(config, configFile);
+  const ControlResponse loaded = daemon.reload(false);
+  if (!loaded.ok) {
+    errorMsg("{}", loaded.message);
+    exit(EXIT_FAILURE);
+  }
+  for (const DaemonSetBinding &binding : bindings) {
+    const ControlResponse response = daemon.showSet(binding, mode);
+    if (response.ok) {
+      std::cout << response.message << '\n';
+    } else {
+      errorMsg("{}", response.message);
+    }
+  }
+
+  if (!server.has_value() && !daemon.showsDynamicSets()) {
+    return;
+  }
+
+  std::jthread serverThread;
+  if (server.has_value()) {
+    serverThread = std::jthread([&server, &daemon](
+                                    const std::stop_token &stopToken) {
+      server.value()->serve(stopToken, [&daemon](const ControlRequest &request) {
+        return daemon.handle(request);
+      });
+    });
+  }
+
+  std::jthread watcherThread([&daemon, &configFile](
+                                 const std::stop_token &stopToken) {
+    std::filesystem::path backgroundSetFile = daemon.backgroundSetFile();
+    auto watcher =
+        std::make_unique<FileWatcher>(std::vector{configFile, backgroundSetFile});
+
+    while (true) {
+      const tl::expected<std::vector<std::filesystem::path>, FileWatcherError>
+          expectedChangedFiles = watcher->waitForChanges(stopToken);
+      if (!expectedChangedFiles.has_value()) {
+        logError("Stopped watching {} and {} for changes, watching them again "
+                 "in {}",
+                 configFile.string(), backgroundSetFile.string(),
+                 FILE_POLL_INTERVAL);
+        // Waits before watching them again, so a watcher that keeps failing
+        // doesn't spin
+        std::mutex mutex;
+        std::condition_variable_any stopped;
+        std::unique_lock lock(mutex);
+        if (stopped.wait_for(lock, stopToken, FILE_POLL_INTERVAL,
+                             []() { return false; }) ||
+            stopToken.stop_requested()) {
+          return;
+        }
+        watcher = std::make_unique<FileWatcher>(
+            std::vector{configFile, backgroundSetFile});
+        continue;
+      }
+
+      const std::vector<std::filesystem::path> &changedFiles =
+          expectedChangedFiles.value();
+      if (changedFiles.empty()) {
+        return;
+      }
+
+      const bool configChanged =
+          std::ranges::find(changedFiles, configFile) != changedFiles.end();
+      logInfo("{} changed, reloading", changedFiles.front().string());
+      const ControlResponse response = daemon.reload(configChanged);
+      if (!response.ok) {
+        logError("{}", response.message);
+      }
+
+      if (daemon.backgroundSetFile() != backgroundSetFile) {
+        backgroundSetFile = daemon.backgroundSetFile();
+        watcher = std::make_unique<FileWatcher>(
+            std::vector{configFile, backgroundSetFile});
+      }
+    }
+  });
+  daemon.run();
+}
+
 void printBackgroundSetInfo(const BackgroundSet &backgroundSet) {
   std::optional<StaticBackgroundData> staticData =
       backgroundSet.getStaticBackgroundData();
@@ -611,10 +2055,9 @@ void validateBackgroundSets(const Config &config) {
   unsigned int goodSetCount = 0;
   unsigned int badSetCount = 0;
   for (const BackgroundSet &set : backgroundSets) {
-    const std::vector<std::filesystem::path> missingFiles =
-        getMissingFilesInBackgroundSet(set);
+    const BackgroundSetProblems problems = getBackgroundSetProblems(set);
 
-    if (missingFiles.empty()) {
+    if (problems.empty()) {
       goodSetCount += 1;
     } else {
       // Skip first newline for first entry
@@ -626,9 +2069,12 @@ void validateBackgroundSets(const Config &config) {
                         ? ANSI_COLOR_CYAN
                         : ANSI_COLOR_MAGENTA)
                 << set.getName() << ANSI_COLOR_RESET << "\n";
-      for (const auto &file : missingFiles) {
+      for (const auto &file : problems.missingFiles) {
         std::cout << "missing: " << file << "\n";
       }
+      for (const auto &file : problems.unreadableFiles) {
+        std::cout << "not an image: " << file << "\n";
+      }
       badSetCount++;
     }
   }
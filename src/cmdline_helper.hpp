@@ -7,6 +7,7 @@
 
 #include "background_set.hpp"
 #include "config.hpp"
+#include "daemon.hpp"
 #include "format.hpp"
 
 namespace dynamic_paper {
@@ -39,14 +40,10 @@ std::filesystem::path
 getConfigFileName(const argparse::ArgumentParser &program);
 
 /**
- * Returns `true` if the config says to use a user provided script to set the background
+ * Sets the background to `image` using the method in the config: wallutils,
+ * the X11 display directly, or a user-provided script
  */
-bool shouldUseScriptToSetBackground(const Config &config);
-
-/**
- * Sets the background using a user-provided script
- */
-void useScriptToSetBackground(const Config &config,
+void setBackgroundUsingMethod(const Config &config,
                               const std::filesystem::path &image,
                               BackgroundSetMode mode);
 
@@ -60,11 +57,32 @@ void useScriptToSetBackground(const Config &config,
 Config getConfigAndSetupLogging(const argparse::ArgumentParser &program,
                                 bool findLocationOverHttp);
 
+/** Path of the general config file given in `program`'s arguments */
+std::filesystem::path
+getConfigFilePath(const argparse::ArgumentParser &program);
+
 // ===== Cache ===============
 
 /** Shows information about cached files */
 void showCacheInfo(const Config &config);
 
+/**
+ * Creates every composite image used by the transitions of the dynamic
+ * background sets called `setNames`, or of every background set if
+ * `setNames` is empty. Images already in the cache are skipped.
+ *
+ * Uses `jobs` threads, or `defaultThreadPoolSize()` if `nullopt`. Prints
+ * progress and throughput to stdout.
+ */
+void buildCache(const Config &config, std::optional<std::size_t> jobs,
+                const std::vector<std::string> &setNames);
+
+/**
+ * Removes cached images that are not used by any background set, such as
+ * images of sets or source images that no longer exist
+ */
+void cleanCache(const Config &config);
+
 // ===== Command Line Args ===============
 
 /** Returns `true` if the output from this process is being piped into another
@@ -118,6 +136,21 @@ getRandomImageAndModeFromAllBackgroundSets(const Config &config);
  */
 void showBackgroundSet(BackgroundSet &backgroundSet, const Config &config, std::optional<BackgroundSetMode> mode = std::nullopt);
 
+/**
+ * Shows every background set in `bindings` from this process, each on its
+ * output, until the program is stopped. The next event of every set is kept
+ * in one `WakeupQueue`, and a set only has a thread running while it shows an
+ * event. Will display images with `mode` if provided.
+ *
+ * What is shown can be changed while it runs with requests to the socket at
+ * `controlSocketPath`. Does nothing if another daemon already listens there.
+ * Edits to `configFile` and the background set file are picked up as they
+ * are saved, parsing again only the background sets that changed.
+ */
+void runDaemon(const std::vector<DaemonSetBinding> &bindings,
+               const Config &config, const std::filesystem::path &configFile,
+               std::optional<BackgroundSetMode> mode = std::nullopt);
+
 /** Prints info about `backgroundSet` to stdout. */
 void printBackgroundSetInfo(const BackgroundSet &backgroundSet);
 
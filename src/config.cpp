@@ -21,6 +21,9 @@ namespace dynamic_paper {
 
 namespace {
 
+/** Largest percentage step that still leaves a percentage between 0% and 100% */
+constexpr unsigned int MAX_TRANSITION_PERCENTAGE_STEP = 50;
+
 LocationInfo createLocationInfoFromParsedFields(
     const std::optional<double> optLatitude, const std::optional<double> optLongitude,
     const std::optional<bool> optUseLatitudeAndLongitudeOverLocationSearch) {
@@ -79,10 +82,18 @@ SolarDayProvider createSolarDayProviderFromParsedFields(
 Config::Config(std::filesystem::path backgroundSetConfigFile,
                std::optional<std::filesystem::path> hookScript,
                std::filesystem::path imageCacheDirectory, BackgroundSetMethod method,
-               SolarDayProvider solarDayProvider)
+               SolarDayProvider solarDayProvider, std::optional<ByteSize> cacheMaxSize,
+               std::optional<unsigned int> transitionPercentageStep,
+               std::optional<DisplayGeometry> displaySize, bool cacheDecodedSources,
+               TransitionFrameFormat transitionFrameFormat, bool packTransitionFrames,
+               double transitionCpuBudget)
     : backgroundSetConfigFile(std::move(backgroundSetConfigFile)),
       hookScript(std::move(hookScript)), imageCacheDirectory(std::move(imageCacheDirectory)),
-      method(std::move(method)), solarDayProvider(std::move(solarDayProvider)) {}
+      method(std::move(method)), solarDayProvider(std::move(solarDayProvider)),
+      cacheMaxSize(cacheMaxSize), transitionPercentageStep(transitionPercentageStep),
+      displaySize(displaySize), cacheDecodedSources(cacheDecodedSources),
+      transitionFrameFormat(transitionFrameFormat), packTransitionFrames(packTransitionFrames),
+      transitionCpuBudget(transitionCpuBudget) {}
 
 Config loadConfigFromYAML(const YAML::Node &config, const bool findLocationOverHttp) {
   auto backgroundSetConfigFile = generalConfigParseOrUseDefault<std::filesystem::path>(
@@ -99,6 +110,41 @@ Config loadConfigFromYAML(const YAML::Node &config, const bool findLocationOverH
       config, IMAGE_CACHE_DIR_KEY, ConfigDefaults::imageCacheDirectory());
   imageCacheDir = expandPath(imageCacheDir);
 
+  const auto cacheMaxSize = generalConfigParseOrUseDefault<std::optional<ByteSize>>(
+      config, CACHE_MAX_SIZE_KEY, std::nullopt);
+
+  auto transitionPercentageStep = generalConfigParseOrUseDefault<std::optional<unsigned int>>(
+      config, TRANSITION_PERCENTAGE_STEP_KEY, std::nullopt);
+  if (transitionPercentageStep.has_value() &&
+      (transitionPercentageStep.value() == 0 ||
+       transitionPercentageStep.value() > MAX_TRANSITION_PERCENTAGE_STEP)) {
+    logWarning("{} must be between 1 and {} but was {}; ignoring it",
+               TRANSITION_PERCENTAGE_STEP_KEY, MAX_TRANSITION_PERCENTAGE_STEP,
+               transitionPercentageStep.value());
+    transitionPercentageStep = std::nullopt;
+  }
+
+  const auto displaySize = generalConfigParseOrUseDefault<std::optional<DisplayGeometry>>(
+      config, DISPLAY_SIZE_KEY, std::nullopt);
+
+  const auto cacheDecodedSources =
+      generalConfigParseOrUseDefault<bool>(config, DECODED_SOURCE_CACHE_KEY, false);
+
+  const auto transitionFrameFormat = generalConfigParseOrUseDefault<TransitionFrameFormat>(
+      config, TRANSITION_FRAME_FORMAT_KEY, TransitionFrameFormat::Source);
+
+  const auto packTransitionFrames =
+      generalConfigParseOrUseDefault<bool>(config, PACK_TRANSITION_FRAMES_KEY, false);
+
+  auto transitionCpuBudget = generalConfigParseOrUseDefault<double>(
+      config, TRANSITION_CPU_BUDGET_KEY, ConfigDefaults::transitionCpuBudget);
+  if (transitionCpuBudget <= 0.0 || transitionCpuBudget > 1.0) {
+    logWarning("{} must be above 0 and at most 1 but was {}; using {}",
+               TRANSITION_CPU_BUDGET_KEY, transitionCpuBudget,
+               ConfigDefaults::transitionCpuBudget);
+    transitionCpuBudget = ConfigDefaults::transitionCpuBudget;
+  }
+
   const auto optLatitude =
       generalConfigParseOrUseDefault<std::optional<double>>(config, LATITUDE_KEY, std::nullopt);
   const auto optLongitude =
@@ -117,7 +163,9 @@ Config loadConfigFromYAML(const YAML::Node &config, const bool findLocationOverH
       optLatitude, optLongitude, findLocationOverHttp ? optUseLocationInfoOverSearch : true,
       optSunriseTime, optSunsetTime);
 
-  return {backgroundSetConfigFile, hookScript, imageCacheDir, method, solarDayProvider};
+  return {backgroundSetConfigFile, hookScript, imageCacheDir, method, solarDayProvider,
+          cacheMaxSize, transitionPercentageStep, displaySize, cacheDecodedSources,
+          transitionFrameFormat, packTransitionFrames, transitionCpuBudget};
 };
 
 std::pair<LogLevel, std::filesystem::path> loadLoggingInfoFromYAML(const YAML::Node &config) {
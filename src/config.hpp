@@ -11,8 +11,12 @@
 #include <yaml-cpp/yaml.h>
 
 #include "background_set_method.hpp"
+#include "byte_size.hpp"
+#include "defaults.hpp"
+#include "display_geometry.hpp"
 #include "logger.hpp"
 #include "solar_day_provider.hpp"
+#include "transition_frame_format.hpp"
 
 namespace dynamic_paper {
 
@@ -37,9 +41,43 @@ public:
    */
   SolarDayProvider solarDayProvider;
 
+  /** Most space cached images can take up before the least recently used are
+   * removed. `nullopt` if there is no limit */
+  std::optional<ByteSize> cacheMaxSize;
+
+  /** If set, the percentage of every step of a transition is rounded to a
+   * multiple of this, so transitions share more cached images */
+  std::optional<unsigned int> transitionPercentageStep;
+
+  /** Size of the display backgrounds are shown on, which transitions are
+   * blended at. `nullopt` to ask the display for its size */
+  std::optional<DisplayGeometry> displaySize;
+
+  /** If `true`, the decoded start and end images of transitions are kept in
+   * the cache directory, so they are memory mapped instead of decoded again */
+  bool cacheDecodedSources;
+
+  /** Format the frames of transitions are saved in */
+  TransitionFrameFormat transitionFrameFormat;
+
+  /** Whether the cached frames of each transition are saved together in one
+   * `FramePack` file, instead of one file per frame */
+  bool packTransitionFrames;
+
+  /** Fraction of a transition with `auto` steps, in the range (0..1], that can
+   * be spent compositing and setting the background */
+  double transitionCpuBudget;
+
   Config(std::filesystem::path backgroundSetConfigFile,
          std::optional<std::filesystem::path> hookScript, std::filesystem::path imageCacheDirectory,
-         BackgroundSetMethod method, SolarDayProvider solarDayProvider);
+         BackgroundSetMethod method, SolarDayProvider solarDayProvider,
+         std::optional<ByteSize> cacheMaxSize = std::nullopt,
+         std::optional<unsigned int> transitionPercentageStep = std::nullopt,
+         std::optional<DisplayGeometry> displaySize = std::nullopt,
+         bool cacheDecodedSources = false,
+         TransitionFrameFormat transitionFrameFormat = TransitionFrameFormat::Source,
+         bool packTransitionFrames = false,
+         double transitionCpuBudget = ConfigDefaults::transitionCpuBudget);
 };
 
 // ===== Loading config from files ====================
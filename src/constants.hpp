@@ -6,6 +6,14 @@ namespace dynamic_paper {
 constexpr std::string_view BACKGROUND_SET_CONFIG_FILE = "background_config";
 constexpr std::string_view HOOK_SCRIPT_KEY = "hook_script";
 constexpr std::string_view IMAGE_CACHE_DIR_KEY = "cache_dir";
+constexpr std::string_view CACHE_MAX_SIZE_KEY = "cache_max_size";
+constexpr std::string_view TRANSITION_PERCENTAGE_STEP_KEY =
+    "transition_percentage_step";
+constexpr std::string_view DISPLAY_SIZE_KEY = "display_size";
+constexpr std::string_view DECODED_SOURCE_CACHE_KEY = "decoded_source_cache";
+constexpr std::string_view TRANSITION_FRAME_FORMAT_KEY = "transition_frame_format";
+constexpr std::string_view PACK_TRANSITION_FRAMES_KEY = "pack_transition_frames";
+constexpr std::string_view TRANSITION_CPU_BUDGET_KEY = "transition_cpu_budget";
 constexpr std::string_view LOGGING_KEY = "logging_level";
 constexpr std::string_view LOG_FILE_KEY = "log_file";
 constexpr std::string_view LATITUDE_KEY = "latitude";
@@ -15,6 +23,14 @@ constexpr std::string_view SUNSET_TIME_KEY = "sunset";
 constexpr std::string_view USE_CONFIG_FILE_LOCATION_KEY = "use_config_file_location";
 constexpr std::string_view METHOD_KEY = "method";
 constexpr std::string_view WALLUTILS_STRING = "wallutils";
+constexpr std::string_view X11_STRING = "x11";
+
+constexpr std::string_view SOURCE_FORMAT_STRING = "source";
+constexpr std::string_view QOI_FORMAT_STRING = "qoi";
+constexpr std::string_view PPM_FORMAT_STRING = "ppm";
+constexpr std::string_view PAM_FORMAT_STRING = "pam";
+constexpr std::string_view PNG_FORMAT_STRING = "png";
+constexpr std::string_view WEBP_FORMAT_STRING = "webp";
 
 // Background Set Config
 constexpr std::string_view DYNAMIC_STRING = "dynamic";
@@ -30,6 +46,8 @@ constexpr std::string_view SCALE_STRING = "scale";
 
 constexpr std::string_view SUNWAIT_STRING = "sunwait";
 
+constexpr std::string_view AUTO_STEPS_STRING = "auto";
+
 constexpr std::string_view INFO_LOGGING_STRING = "info";
 constexpr std::string_view WARNING_LOGGING_STRING = "warning";
 constexpr std::string_view ERROR_LOGGING_STRING = "error";
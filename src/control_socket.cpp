@@ -0,0 +1,392 @@
+#include "control_socket.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+constexpr char FIELD_SEPARATOR = '\t';
+constexpr std::string_view OK_STRING = "ok";
+constexpr std::string_view ERROR_STRING = "error";
+
+constexpr std::array CONTROL_COMMANDS = {
+    ControlCommand::Show, ControlCommand::Image, ControlCommand::Random,
+    ControlCommand::Status, ControlCommand::Reload};
+
+/** Address of the socket at `socketPath`, or `nullopt` if the path is too long
+ * for one */
+std::optional<sockaddr_un> socketAddress(const std::filesystem::path &socketPath) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const std::string pathString = socketPath.string();
+  if (pathString.size() >= sizeof(address.sun_path)) {
+    return std::nullopt;
+  }
+  std::memcpy(address.sun_path, pathString.c_str(), pathString.size() + 1);
+  return address;
+}
+
+/** Connects to the socket at `socketPath`, returning -1 with `errno` set if
+ * unable to */
+int connectTo(const std::filesystem::path &socketPath) {
+  const std::optional<sockaddr_un> address = socketAddress(socketPath);
+  if (!address.has_value()) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  const int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (connection == -1) {
+    return -1;
+  }
+  if (connect(connection,
+              reinterpret_cast<const sockaddr *>(&address.value()), // NOLINT
+              sizeof(sockaddr_un)) == -1) {
+    const int connectError = errno;
+    close(connection);
+    errno = connectError;
+    return -1;
+  }
+  return connection;
+}
+
+/** Returns `true` if there is a file at `path` that belongs to someone other
+ * than the user running the program, without following it if it is a link */
+bool isOwnedByOtherUser(const std::filesystem::path &path) {
+  struct stat status {};
+  return lstat(path.c_str(), &status) == 0 && status.st_uid != getuid();
+}
+
+/** Returns `true` if the process on the other end of `connection` is run by
+ * the user running the program */
+bool isPeerUser(const int connection) {
+#ifdef SO_PEERCRED
+  ucred credentials{};
+  socklen_t length = sizeof(credentials);
+  return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials,
+                    &length) == 0 &&
+         credentials.uid == getuid();
+#else
+  uid_t userId = 0;
+  gid_t groupId = 0;
+  return getpeereid(connection, &userId, &groupId) == 0 && userId == getuid();
+#endif
+}
+
+void setTimeouts(const int connection) {
+  const timeval timeout = {.tv_sec = CONTROL_RESPONSE_TIMEOUT.count(),
+                           .tv_usec = 0};
+  setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+bool writeAll(const int connection, std::string_view data) {
+  while (!data.empty()) {
+    const ssize_t written =
+        send(connection, data.data(), data.size(), MSG_NOSIGNAL);
+    if (written == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+
+/** Reads until the other side stops sending, `stopAtNewline` and a newline is
+ * read, or `maxSize` bytes are read. Returns `nullopt` if the connection fails
+ */
+std::optional<std::string> readUntilEnd(const int connection,
+                                        const bool stopAtNewline,
+                                        const std::size_t maxSize) {
+  std::string data;
+  std::array<char, 4096> buffer{};
+  while (data.size() < maxSize) {
+    const ssize_t numberRead = recv(connection, buffer.data(), buffer.size(), 0);
+    if (numberRead == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return std::nullopt;
+    }
+    if (numberRead == 0) {
+      break;
+    }
+    data.append(buffer.data(), static_cast<std::size_t>(numberRead));
+    if (stopAtNewline && data.find('\n') != std::string::npos) {
+      break;
+    }
+  }
+  return data;
+}
+
+} // namespace
+
+// ===== Header ===============
+
+std::string_view controlCommandString(const ControlCommand command) {
+  switch (command) {
+  case ControlCommand::Show:
+    return "show";
+  case ControlCommand::Image:
+    return "image";
+  case ControlCommand::Random:
+    return "random";
+  case ControlCommand::Status:
+    return "status";
+  case ControlCommand::Reload:
+    return "reload";
+  }
+
+  logAssert(false, "Unknown control command");
+  return "";
+}
+
+tl::expected<std::string, ControlSocketError>
+encodeControlRequest(const ControlRequest &request) {
+  std::string line(controlCommandString(request.command));
+  for (const std::string &argument : request.arguments) {
+    if (argument.find_first_of("\t\n") != std::string::npos) {
+      return tl::unexpected(ControlSocketError::InvalidMessage);
+    }
+    line += FIELD_SEPARATOR;
+    line += argument;
+  }
+  line += '\n';
+  return line;
+}
+
+tl::expected<ControlRequest, ControlSocketError>
+parseControlRequest(const std::string_view line) {
+  std::vector<std::string> fields;
+  std::size_t start = 0;
+  while (true) {
+    const std::size_t end = line.find(FIELD_SEPARATOR, start);
+    fields.emplace_back(line.substr(start, end - start));
+    if (end == std::string_view::npos) {
+      break;
+    }
+    start = end + 1;
+  }
+
+  for (const ControlCommand command : CONTROL_COMMANDS) {
+    if (fields.front() == controlCommandString(command)) {
+      return ControlRequest{
+          .command = command,
+          .arguments = std::vector<std::string>(fields.begin() + 1,
+                                                fields.end())};
+    }
+  }
+  return tl::unexpected(ControlSocketError::InvalidMessage);
+}
+
+std::string encodeControlResponse(const ControlResponse &response) {
+  return std::string(response.ok ? OK_STRING : ERROR_STRING) + '\n' +
+         response.message;
+}
+
+tl::expected<ControlResponse, ControlSocketError>
+parseControlResponse(const std::string_view text) {
+  const std::size_t lineEnd = text.find('\n');
+  const std::string_view status = text.substr(0, lineEnd);
+  const std::string message(
+      lineEnd == std::string_view::npos ? "" : text.substr(lineEnd + 1));
+
+  if (status == OK_STRING) {
+    return ControlResponse{.ok = true, .message = message};
+  }
+  if (status == ERROR_STRING) {
+    return ControlResponse{.ok = false, .message = message};
+  }
+  return tl::unexpected(ControlSocketError::InvalidMessage);
+}
+
+std::filesystem::path controlSocketPath() {
+  const char *runtimeDirectory = std::getenv("XDG_RUNTIME_DIR");
+  if (runtimeDirectory != nullptr && runtimeDirectory[0] != '\0') {
+    return std::filesystem::path(runtimeDirectory) / CONTROL_SOCKET_NAME;
+  }
+  return std::filesystem::temp_directory_path() /
+         ("dynamic_paper-" + std::to_string(getuid()) + ".sock");
+}
+
+tl::expected<ControlResponse, ControlSocketError>
+sendControlRequest(const std::filesystem::path &socketPath,
+                   const ControlRequest &request) {
+  const tl::expected<std::string, ControlSocketError> line =
+      encodeControlRequest(request);
+  if (!line.has_value()) {
+    return tl::unexpected(line.error());
+  }
+
+  // In the shared temporary directory the socket could have been made by
+  // another user to read requests
+  if (isOwnedByOtherUser(socketPath)) {
+    return tl::unexpected(ControlSocketError::WrongUser);
+  }
+
+  const int connection = connectTo(socketPath);
+  if (connection == -1) {
+    return tl::unexpected(errno == ENOENT || errno == ECONNREFUSED
+                              ? ControlSocketError::NoDaemon
+                              : ControlSocketError::ConnectionFailed);
+  }
+  if (!isPeerUser(connection)) {
+    close(connection);
+    return tl::unexpected(ControlSocketError::WrongUser);
+  }
+  setTimeouts(connection);
+
+  std::optional<std::string> responseText = std::nullopt;
+  if (writeAll(connection, line.value())) {
+    shutdown(connection, SHUT_WR);
+    responseText = readUntilEnd(connection, false, MAX_CONTROL_REQUEST_SIZE);
+  }
+  close(connection);
+
+  if (!responseText.has_value()) {
+    return tl::unexpected(ControlSocketError::ConnectionFailed);
+  }
+  return parseControlResponse(responseText.value());
+}
+
+tl::expected<std::unique_ptr<ControlServer>, ControlSocketError>
+ControlServer::listen(const std::filesystem::path &socketPath) {
+  const std::optional<sockaddr_un> address = socketAddress(socketPath);
+  if (!address.has_value()) {
+    logError("Path of control socket is too long: {}", socketPath.string());
+    return tl::unexpected(ControlSocketError::UnableToListen);
+  }
+
+  if (isOwnedByOtherUser(socketPath)) {
+    logError("Control socket {} belongs to another user", socketPath.string());
+    return tl::unexpected(ControlSocketError::WrongUser);
+  }
+
+  std::error_code error;
+  if (std::filesystem::exists(socketPath, error)) {
+    const int existing = connectTo(socketPath);
+    if (existing != -1) {
+      close(existing);
+      return tl::unexpected(ControlSocketError::AlreadyRunning);
+    }
+    logDebug("Removing control socket left by a daemon that stopped: {}",
+             socketPath.string());
+    std::filesystem::remove(socketPath, error);
+  }
+
+  const int fileDescriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fileDescriptor == -1) {
+    logError("Unable to create control socket: {}", std::strerror(errno));
+    return tl::unexpected(ControlSocketError::UnableToListen);
+  }
+  if (bind(fileDescriptor,
+           reinterpret_cast<const sockaddr *>(&address.value()), // NOLINT
+           sizeof(sockaddr_un)) == -1 ||
+      ::listen(fileDescriptor, SOMAXCONN) == -1) {
+    logError("Unable to listen on control socket {}: {}", socketPath.string(),
+             std::strerror(errno));
+    close(fileDescriptor);
+    return tl::unexpected(ControlSocketError::UnableToListen);
+  }
+
+  // Only the user can control their daemon
+  std::filesystem::permissions(socketPath,
+                               std::filesystem::perms::owner_read |
+                                   std::filesystem::perms::owner_write,
+                               error);
+
+  return std::unique_ptr<ControlServer>(
+      new ControlServer(socketPath, fileDescriptor));
+}
+
+ControlServer::ControlServer(std::filesystem::path socketPath,
+                             const int fileDescriptor)
+    : socketPath(std::move(socketPath)), fileDescriptor(fileDescriptor) {}
+
+ControlServer::~ControlServer() {
+  close(fileDescriptor);
+  std::error_code error;
+  std::filesystem::remove(socketPath, error);
+}
+
+void ControlServer::serve(const std::stop_token &stopToken,
+                          const Handler &handler) {
+  // Shutting down the socket wakes `accept`
+  const std::stop_callback wakeOnStop(
+      stopToken, [this]() { shutdown(fileDescriptor, SHUT_RDWR); });
+
+  while (!stopToken.stop_requested()) {
+    const int connection = accept4(fileDescriptor, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection == -1) {
+      if (stopToken.stop_requested()) {
+        break;
+      }
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      logError("Stopped accepting requests on control socket: {}",
+               std::strerror(errno));
+      break;
+    }
+
+    answer(connection, handler);
+    close(connection);
+  }
+}
+
+void ControlServer::answer(const int connection, const Handler &handler) const {
+  if (!isPeerUser(connection)) {
+    logWarning("Ignoring request on control socket from another user");
+    return;
+  }
+  setTimeouts(connection);
+
+  const std::optional<std::string> text =
+      readUntilEnd(connection, true, MAX_CONTROL_REQUEST_SIZE);
+  if (!text.has_value()) {
+    logWarning("Unable to read request on control socket");
+    return;
+  }
+  if (text->empty()) {
+    // Checking if the daemon is running, such as by `ControlServer::listen`
+    return;
+  }
+
+  const std::string_view line = std::string_view(text.value())
+                                    .substr(0, text->find('\n'));
+  const tl::expected<ControlRequest, ControlSocketError> request =
+      parseControlRequest(line);
+
+  ControlResponse response;
+  if (request.has_value()) {
+    logDebug("Control request: {}", line);
+    response = handler(request.value());
+  } else {
+    response = {.ok = false, .message = "Unknown request"};
+  }
+
+  if (!writeAll(connection, encodeControlResponse(response))) {
+    logWarning("Unable to answer request on control socket");
+  }
+}
+
+} // namespace dynamic_paper
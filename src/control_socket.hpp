@@ -0,0 +1,148 @@
+#pragma once
+
+/**
+ * Protocol the daemon is controlled with over a Unix domain socket, so
+ * commands run while it is running are handled by it instead of starting the
+ * program again.
+ *
+ * Each connection sends one request as a line of tab separated fields, the
+ * command followed by its arguments. The daemon answers with `ok` or `error`
+ * on the first line, followed by a message, and closes the connection.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+namespace dynamic_paper {
+
+/** Name of the socket in `$XDG_RUNTIME_DIR`, see `controlSocketPath` */
+constexpr std::string_view CONTROL_SOCKET_NAME = "dynamic_paper.sock";
+
+/** Longest request the daemon reads, in bytes */
+constexpr std::size_t MAX_CONTROL_REQUEST_SIZE = 64 * 1024;
+
+/** How long a client waits for the daemon to answer */
+constexpr std::chrono::seconds CONTROL_RESPONSE_TIMEOUT(10);
+
+/** What a request asks the daemon to do */
+enum class ControlCommand : std::uint8_t {
+  /** Show the set given as `name` or `name@output` */
+  Show,
+  /** Show the image at a path, with an optional mode and output */
+  Image,
+  /** Show a random set on every monitor, or a random image out of every set
+   * if the first argument is `image` instead of `set`, with an optional
+   * mode */
+  Random,
+  /** Describe what each set is showing */
+  Status,
+  /** Parse the background set file again */
+  Reload
+};
+
+struct ControlRequest {
+  ControlCommand command;
+  std::vector<std::string> arguments;
+
+  bool operator==(const ControlRequest &) const = default;
+};
+
+struct ControlResponse {
+  bool ok = true;
+  std::string message;
+
+  bool operator==(const ControlResponse &) const = default;
+};
+
+enum class ControlSocketError : std::uint8_t {
+  /** No daemon is listening on the socket */
+  NoDaemon,
+  /** A daemon is already listening on the socket */
+  AlreadyRunning,
+  UnableToListen,
+  /** The connection failed or timed out part way through */
+  ConnectionFailed,
+  /** A request or response doesn't follow the protocol */
+  InvalidMessage,
+  /** The socket, or the process listening on it, belongs to another user */
+  WrongUser
+};
+
+/** Name of `command` in requests */
+std::string_view controlCommandString(ControlCommand command);
+
+/** Encodes `request` as a line. Fails if an argument has a tab or newline */
+tl::expected<std::string, ControlSocketError>
+encodeControlRequest(const ControlRequest &request);
+
+/** Parses a line made by `encodeControlRequest`, without its newline */
+tl::expected<ControlRequest, ControlSocketError>
+parseControlRequest(std::string_view line);
+
+std::string encodeControlResponse(const ControlResponse &response);
+
+tl::expected<ControlResponse, ControlSocketError>
+parseControlResponse(std::string_view text);
+
+/**
+ * Path of the daemon's socket: `CONTROL_SOCKET_NAME` in `$XDG_RUNTIME_DIR`,
+ * or a file named after the user in the temporary directory if it isn't set.
+ */
+std::filesystem::path controlSocketPath();
+
+/** Sends `request` to the daemon listening on `socketPath`, and returns its
+ * response. Fails with `WrongUser` instead of sending it to a socket or
+ * daemon of another user */
+tl::expected<ControlResponse, ControlSocketError>
+sendControlRequest(const std::filesystem::path &socketPath,
+                   const ControlRequest &request);
+
+/**
+ * Listens on a Unix domain socket for requests to the daemon. The socket file
+ * is removed when the server is destroyed.
+ */
+class ControlServer {
+public:
+  using Handler = std::function<ControlResponse(const ControlRequest &)>;
+
+  /**
+   * Listens on `socketPath`. A socket file left behind by a daemon that is no
+   * longer running is replaced, while one a daemon still answers on fails with
+   * `AlreadyRunning`. A file of another user is never replaced, and fails
+   * with `WrongUser`.
+   */
+  static tl::expected<std::unique_ptr<ControlServer>, ControlSocketError>
+  listen(const std::filesystem::path &socketPath);
+
+  ~ControlServer();
+
+  ControlServer(const ControlServer &) = delete;
+  ControlServer &operator=(const ControlServer &) = delete;
+  ControlServer(ControlServer &&) = delete;
+  ControlServer &operator=(ControlServer &&) = delete;
+
+  /** Answers requests with `handler`, one connection at a time, until
+   * `stopToken` is stopped. Connections from other users are closed without
+   * an answer */
+  void serve(const std::stop_token &stopToken, const Handler &handler);
+
+private:
+  ControlServer(std::filesystem::path socketPath, int fileDescriptor);
+
+  std::filesystem::path socketPath;
+  int fileDescriptor;
+
+  void answer(int connection, const Handler &handler) const;
+};
+
+} // namespace dynamic_paper
@@ -0,0 +1,90 @@
+#include "daemon.hpp"
+
+#include <algorithm>
+#include <ranges>
+
+namespace dynamic_paper {
+
+std::optional<DaemonSetBinding> parseDaemonSetBinding(const std::string_view text) {
+  const std::size_t separator = text.rfind(DAEMON_OUTPUT_SEPARATOR);
+  if (separator == std::string_view::npos) {
+    if (text.empty()) {
+      return std::nullopt;
+    }
+    return DaemonSetBinding{.setName = std::string(text)};
+  }
+
+  const std::string_view name = text.substr(0, separator);
+  const std::string_view output = text.substr(separator + 1);
+  if (name.empty() || output.empty()) {
+    return std::nullopt;
+  }
+  return DaemonSetBinding{.setName = std::string(name),
+                          .output = std::string(output)};
+}
+
+BackgroundSetChanges
+diffBackgroundSets(const std::unordered_map<std::string, std::string> &before,
+                   const std::unordered_map<std::string, std::string> &after) {
+  BackgroundSetChanges changes;
+  for (const auto &[name, text] : after) {
+    const auto previous = before.find(name);
+    if (previous == before.end()) {
+      changes.added.push_back(name);
+    } else if (previous->second != text) {
+      changes.changed.push_back(name);
+    }
+  }
+  for (const auto &name : before | std::views::keys) {
+    if (!after.contains(name)) {
+      changes.removed.push_back(name);
+    }
+  }
+
+  std::ranges::sort(changes.added);
+  std::ranges::sort(changes.changed);
+  std::ranges::sort(changes.removed);
+  return changes;
+}
+
+void WakeupQueue::schedule(const std::size_t slot, const TimePoint deadline) {
+  if (slot >= generations.size()) {
+    generations.resize(slot + 1);
+  }
+
+  const std::uint64_t generation = nextGeneration++;
+  generations[slot] = generation;
+  heap.push({.deadline = deadline, .slot = slot, .generation = generation});
+  dropReplacedEntries();
+}
+
+bool WakeupQueue::contains(const std::size_t slot) const {
+  return slot < generations.size() && generations[slot].has_value();
+}
+
+std::optional<WakeupQueue::TimePoint> WakeupQueue::nextDeadline() const {
+  if (heap.empty()) {
+    return std::nullopt;
+  }
+  return heap.top().deadline;
+}
+
+std::vector<std::size_t> WakeupQueue::popDue(const TimePoint now) {
+  std::vector<std::size_t> due;
+  while (!heap.empty() && heap.top().deadline <= now) {
+    due.push_back(heap.top().slot);
+    generations[heap.top().slot] = std::nullopt;
+    heap.pop();
+    dropReplacedEntries();
+  }
+  return due;
+}
+
+void WakeupQueue::dropReplacedEntries() {
+  while (!heap.empty() &&
+         generations[heap.top().slot] != heap.top().generation) {
+    heap.pop();
+  }
+}
+
+} // namespace dynamic_paper
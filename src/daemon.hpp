@@ -0,0 +1,107 @@
+#pragma once
+
+/**
+ * Parts of the daemon, which shows several dynamic background sets from one
+ * process, each on its own output, waking only when one of them has an event.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace dynamic_paper {
+
+/** Separates the name of a background set from the output it is shown on, as
+ * in `name@output` */
+constexpr char DAEMON_OUTPUT_SEPARATOR = '@';
+
+/** A background set the daemon shows, and the output it is shown on */
+struct DaemonSetBinding {
+  std::string setName;
+  /** Name of the monitor, as RandR names it (such as "HDMI-1"), or `nullopt`
+   * to show the set on every monitor */
+  std::optional<std::string> output = std::nullopt;
+
+  bool operator==(const DaemonSetBinding &) const = default;
+};
+
+/** Parses `name` or `name@output` into a `DaemonSetBinding`. Returns
+ * `nullopt` if the name or the output is empty */
+std::optional<DaemonSetBinding> parseDaemonSetBinding(std::string_view text);
+
+/** Background sets that differ between two versions of the background set
+ * file, by name */
+struct BackgroundSetChanges {
+  std::vector<std::string> added;
+  std::vector<std::string> changed;
+  std::vector<std::string> removed;
+
+  bool operator==(const BackgroundSetChanges &) const = default;
+};
+
+/**
+ * Compares two versions of the background set file, each given as the text of
+ * every top-level key by its name, so only the sets that changed are parsed
+ * again. Names are sorted.
+ */
+BackgroundSetChanges
+diffBackgroundSets(const std::unordered_map<std::string, std::string> &before,
+                   const std::unordered_map<std::string, std::string> &after);
+
+/**
+ * Next time each of the daemon's background sets, identified by their index,
+ * has to be woken. Deadlines of every set are kept in one min-heap, so the
+ * daemon sleeps on one timer however many sets it shows.
+ *
+ * A set is in the queue at most once: scheduling it again replaces its
+ * deadline.
+ */
+class WakeupQueue {
+public:
+  using TimePoint = std::chrono::system_clock::time_point;
+
+  /** Wakes `slot` at `deadline`, replacing its deadline if it has one */
+  void schedule(std::size_t slot, TimePoint deadline);
+
+  /** Returns `true` if `slot` has a deadline */
+  [[nodiscard]] bool contains(std::size_t slot) const;
+
+  /** Earliest deadline of any slot, or `nullopt` if the queue is empty */
+  [[nodiscard]] std::optional<TimePoint> nextDeadline() const;
+
+  /** Removes and returns every slot with a deadline at or before `now`,
+   * earliest first */
+  std::vector<std::size_t> popDue(TimePoint now);
+
+  [[nodiscard]] bool empty() const { return heap.empty(); }
+
+private:
+  struct Entry {
+    TimePoint deadline;
+    std::size_t slot;
+    /** Matches the slot's entry in `generations` unless it was replaced */
+    std::uint64_t generation;
+
+    bool operator>(const Entry &other) const {
+      return deadline > other.deadline;
+    }
+  };
+
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+  /** Generation of the entry of each slot in `heap`, or `nullopt` if it has
+   * none */
+  std::vector<std::optional<std::uint64_t>> generations;
+  std::uint64_t nextGeneration = 0;
+
+  /** Pops replaced entries off the top of `heap`, so its top is current */
+  void dropReplacedEntries();
+};
+
+} // namespace dynamic_paper
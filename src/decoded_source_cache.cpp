@@ -0,0 +1,190 @@
+#include "decoded_source_cache.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache_manifest.hpp"
+#include "format.hpp"
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+constexpr std::array<char, 8> DECODED_SOURCE_MAGIC = {'D', 'P', 'S', 'O',
+                                                      'U', 'R', 'C', 'E'};
+constexpr std::uint32_t DECODED_SOURCE_VERSION = 1;
+constexpr std::size_t FALLBACK_PAGE_SIZE = 4096;
+
+/** Start of a decoded source image. The pixels start `pixelOffset` bytes
+ * into the file, which is a multiple of the page size */
+struct DecodedSourceHeader {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t channels;
+  std::uint64_t width;
+  std::uint64_t height;
+  std::uint64_t sourceDigest;
+  std::uint64_t pixelOffset;
+};
+
+static_assert(sizeof(DecodedSourceHeader) == 48,
+              "Decoded source header must not have padding");
+
+std::size_t pageSize() {
+  const long size = sysconf(_SC_PAGESIZE);
+  return (size > 0) ? static_cast<std::size_t>(size) : FALLBACK_PAGE_SIZE;
+}
+
+/** Returns `true` if `header` describes a file of `length` bytes holding the
+ * pixels of the source with `sourceDigest` */
+bool isValidHeader(const DecodedSourceHeader &header, const std::size_t length,
+                   const std::uint64_t sourceDigest) {
+  return header.magic == DECODED_SOURCE_MAGIC &&
+         header.version == DECODED_SOURCE_VERSION &&
+         header.channels == RGBImage::CHANNELS &&
+         header.sourceDigest == sourceDigest &&
+         header.pixelOffset >= sizeof(DecodedSourceHeader) &&
+         length == header.pixelOffset + (header.width * header.height *
+                                         RGBImage::CHANNELS);
+}
+
+} // namespace
+
+// ===== Mapping ===============
+
+/** A read only mapping of a valid decoded source image */
+struct DecodedSource::Mapping {
+  const std::uint8_t *data = nullptr;
+  std::size_t length = 0;
+  std::size_t pixelOffset = 0;
+
+  Mapping(const std::uint8_t *data, const std::size_t length,
+          const std::size_t pixelOffset)
+      : data(data), length(length), pixelOffset(pixelOffset) {}
+  ~Mapping() {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    munmap(const_cast<std::uint8_t *>(data), length);
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+  Mapping(Mapping &&) = delete;
+  Mapping &operator=(Mapping &&) = delete;
+};
+
+// ===== Header ===============
+
+std::string decodedSourceFileName(const std::uint64_t sourceDigest,
+                                  const std::optional<DisplayFit> &fit) {
+  if (!fit.has_value()) {
+    return dynamic_paper::format("{:016x}{}", sourceDigest,
+                                 DECODED_SOURCE_EXTENSION);
+  }
+  return dynamic_paper::format("{:016x}-{}{}", sourceDigest, fit->cacheTag(),
+                               DECODED_SOURCE_EXTENSION);
+}
+
+DecodedSource::DecodedSource(RGBImage image)
+    : imageWidth(image.width), imageHeight(image.height),
+      image(std::move(image)) {}
+
+DecodedSource::DecodedSource(std::unique_ptr<Mapping> mapping,
+                             const std::size_t width, const std::size_t height)
+    : imageWidth(width), imageHeight(height), mapping(std::move(mapping)) {}
+
+DecodedSource::~DecodedSource() = default;
+DecodedSource::DecodedSource(DecodedSource &&) noexcept = default;
+DecodedSource &DecodedSource::operator=(DecodedSource &&) noexcept = default;
+
+std::span<const std::uint8_t> DecodedSource::pixels() const {
+  if (mapping != nullptr) {
+    return {mapping->data + mapping->pixelOffset,
+            mapping->length - mapping->pixelOffset};
+  }
+  return image.pixels;
+}
+
+std::optional<DecodedSource>
+DecodedSource::map(const std::filesystem::path &path,
+                   const std::uint64_t sourceDigest) {
+  const int fileDescriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fileDescriptor < 0) {
+    return std::nullopt;
+  }
+
+  struct stat fileStatus {};
+  void *data = MAP_FAILED;
+  if (fstat(fileDescriptor, &fileStatus) == 0 &&
+      static_cast<std::size_t>(fileStatus.st_size) >=
+          sizeof(DecodedSourceHeader)) {
+    data = mmap(nullptr, static_cast<std::size_t>(fileStatus.st_size),
+                PROT_READ, MAP_SHARED, fileDescriptor, 0);
+  }
+  close(fileDescriptor);
+  if (data == MAP_FAILED) {
+    return std::nullopt;
+  }
+
+  const auto length = static_cast<std::size_t>(fileStatus.st_size);
+  DecodedSourceHeader header{};
+  std::memcpy(&header, data, sizeof(DecodedSourceHeader));
+  auto mapping = std::make_unique<Mapping>(
+      static_cast<const std::uint8_t *>(data), length, header.pixelOffset);
+  if (!isValidHeader(header, length, sourceDigest)) {
+    logDebug("Ignoring damaged or outdated decoded source {}", path.string());
+    return std::nullopt;
+  }
+
+  // Every pixel is read by the first frame of the transition
+  madvise(data, length, MADV_WILLNEED);
+  return DecodedSource(std::move(mapping), header.width, header.height);
+}
+
+bool writeDecodedSource(const RGBImage &image, const std::uint64_t sourceDigest,
+                        const std::filesystem::path &path) {
+  const DecodedSourceHeader header = {.magic = DECODED_SOURCE_MAGIC,
+                                      .version = DECODED_SOURCE_VERSION,
+                                      .channels = RGBImage::CHANNELS,
+                                      .width = image.width,
+                                      .height = image.height,
+                                      .sourceDigest = sourceDigest,
+                                      .pixelOffset = pageSize()};
+
+  const std::filesystem::path partialPath = partialPathFor(path);
+  {
+    std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), // NOLINT
+               sizeof(DecodedSourceHeader));
+    file.seekp(static_cast<std::streamoff>(header.pixelOffset));
+    file.write(reinterpret_cast<const char *>(image.pixels.data()), // NOLINT
+               static_cast<std::streamsize>(image.pixels.size()));
+    if (!file) {
+      logWarning("Unable to save decoded source to {}", path.string());
+      std::error_code error;
+      std::filesystem::remove(partialPath, error);
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(partialPath, path, error);
+  if (error) {
+    logWarning("Unable to save decoded source to {}: {}", path.string(),
+               error.message());
+    std::filesystem::remove(partialPath, error);
+    return false;
+  }
+  return true;
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+ * Source images of transitions saved to the cache directory decoded, as raw
+ * RGB pixels, so transitions can memory map them instead of decoding the same
+ * JPEG or PNG again every day.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "display_geometry.hpp"
+#include "rgb_image.hpp"
+
+namespace dynamic_paper {
+
+/** Extension of decoded source images in the cache directory */
+constexpr std::string_view DECODED_SOURCE_EXTENSION = ".rgb";
+
+/**
+ * Returns the name of the decoded source image made from the source with
+ * `sourceDigest`, resampled with `fit`. Formatted:
+ * `{source digest}-{display tag}.rgb`, or `{source digest}.rgb` without a fit.
+ *
+ * The name changes whenever the content of the source does, so a source that
+ * is edited is decoded again.
+ */
+std::string decodedSourceFileName(std::uint64_t sourceDigest,
+                                  const std::optional<DisplayFit> &fit);
+
+/**
+ * A decoded source image, either decoded into memory or memory mapped from a
+ * decoded source image in the cache.
+ */
+class DecodedSource {
+public:
+  explicit DecodedSource(RGBImage image);
+  ~DecodedSource();
+
+  DecodedSource(const DecodedSource &) = delete;
+  DecodedSource &operator=(const DecodedSource &) = delete;
+  DecodedSource(DecodedSource &&) noexcept;
+  DecodedSource &operator=(DecodedSource &&) noexcept;
+
+  /**
+   * Maps the decoded source image at `path`, or returns `nullopt` if it is
+   * missing, damaged, or was made from a source other than the one with
+   * `sourceDigest`.
+   */
+  static std::optional<DecodedSource> map(const std::filesystem::path &path,
+                                          std::uint64_t sourceDigest);
+
+  [[nodiscard]] std::size_t width() const { return imageWidth; }
+  [[nodiscard]] std::size_t height() const { return imageHeight; }
+  /** `width * height * RGBImage::CHANNELS` bytes, row by row */
+  [[nodiscard]] std::span<const std::uint8_t> pixels() const;
+
+  [[nodiscard]] bool isMapped() const { return mapping != nullptr; }
+
+private:
+  struct Mapping;
+
+  DecodedSource(std::unique_ptr<Mapping> mapping, std::size_t width,
+                std::size_t height);
+
+  std::size_t imageWidth = 0;
+  std::size_t imageHeight = 0;
+  RGBImage image;
+  std::unique_ptr<Mapping> mapping;
+};
+
+/**
+ * Saves `image`, decoded from the source with `sourceDigest`, to `path` so it
+ * can be mapped with `DecodedSource::map`.
+ *
+ * The pixels start on a page boundary after a small header, and the file is
+ * written to a temporary file first and then renamed, so readers never map a
+ * partially written image. Returns `false` if it couldn't be saved.
+ */
+bool writeDecodedSource(const RGBImage &image, std::uint64_t sourceDigest,
+                        const std::filesystem::path &path);
+
+} // namespace dynamic_paper
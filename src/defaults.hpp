@@ -23,6 +23,7 @@ struct ConfigDefaults {
   static constexpr SolarDay solarDay = {
       .sunrise = convertTimeStringToTimeFromMidnightUnchecked("09:00"),
       .sunset = convertTimeStringToTimeFromMidnightUnchecked("21:00")};
+  static constexpr double transitionCpuBudget = 0.5;
 
   static inline std::string logFileName() {
     return (getHomeDirectory() / ".local/share/dynamic_paper/dynamic_paper.log");
@@ -0,0 +1,327 @@
+#include "display_geometry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <X11/Xlib.h>
+#ifdef dynamic_paper_use_xrandr
+#include <X11/extensions/Xrandr.h>
+#endif
+
+#include "format.hpp"
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+/** Size of an area of the display, and when it was asked for */
+struct QueriedGeometry {
+  std::optional<DisplayGeometry> geometry;
+  std::chrono::steady_clock::time_point queryTime;
+};
+
+/** Area of a monitor, and when it was asked for */
+struct QueriedMonitorArea {
+  std::optional<MonitorArea> area;
+  std::chrono::steady_clock::time_point queryTime;
+};
+
+/** Sizes last asked for of each `DisplayArea`, and areas of each monitor by
+ * name */
+struct GeometryStore {
+  std::mutex mutex;
+  std::array<std::optional<QueriedGeometry>, 2> byArea;
+  std::unordered_map<std::string, QueriedMonitorArea> byMonitorName;
+};
+
+GeometryStore &geometryStore() {
+  static GeometryStore store;
+  return store;
+}
+
+DisplayGeometry screenGeometry(Display *display) {
+  const int screen = DefaultScreen(display);
+  return {.width = static_cast<std::size_t>(DisplayWidth(display, screen)),
+          .height = static_cast<std::size_t>(DisplayHeight(display, screen))};
+}
+
+/** Sizes of the monitors of `display`, or `nullopt` if the display doesn't
+ * support RandR */
+std::optional<std::vector<DisplayGeometry>>
+monitorGeometries(Display *display) {
+#ifdef dynamic_paper_use_xrandr
+  int eventBase = 0;
+  int errorBase = 0;
+  if (XRRQueryExtension(display, &eventBase, &errorBase) == False) {
+    return std::nullopt;
+  }
+
+  int numberMonitors = 0;
+  XRRMonitorInfo *monitors = XRRGetMonitors(
+      display, DefaultRootWindow(display), True, &numberMonitors);
+  if (monitors == nullptr) {
+    return std::nullopt;
+  }
+
+  std::vector<DisplayGeometry> geometries;
+  for (const XRRMonitorInfo &monitor :
+       std::span(monitors, static_cast<std::size_t>(numberMonitors))) {
+    geometries.push_back(
+        {.width = static_cast<std::size_t>(monitor.width),
+         .height = static_cast<std::size_t>(monitor.height)});
+  }
+  XRRFreeMonitors(monitors);
+  return geometries;
+#else
+  (void)display;
+  return std::nullopt;
+#endif
+}
+
+/** Size of the monitor with the most pixels, or `nullopt` if the display
+ * doesn't support RandR */
+std::optional<DisplayGeometry> largestMonitorGeometry(Display *display) {
+  const std::optional<std::vector<DisplayGeometry>> geometries =
+      monitorGeometries(display);
+  if (!geometries.has_value() || geometries->empty()) {
+    return std::nullopt;
+  }
+  return std::ranges::max(geometries.value(), {},
+                          [](const DisplayGeometry &geometry) {
+                            return geometry.width * geometry.height;
+                          });
+}
+
+std::optional<MonitorArea> askDisplayForMonitorArea(const std::string &name) {
+#ifdef dynamic_paper_use_xrandr
+  Display *display = XOpenDisplay(nullptr);
+  if (display == nullptr) {
+    logDebug("Unable to open X11 display to find monitor {}", name);
+    return std::nullopt;
+  }
+
+  int eventBase = 0;
+  int errorBase = 0;
+  int numberMonitors = 0;
+  XRRMonitorInfo *monitors =
+      XRRQueryExtension(display, &eventBase, &errorBase) == False
+          ? nullptr
+          : XRRGetMonitors(display, DefaultRootWindow(display), True,
+                           &numberMonitors);
+
+  std::optional<MonitorArea> area = std::nullopt;
+  if (monitors != nullptr) {
+    for (const XRRMonitorInfo &monitor :
+         std::span(monitors, static_cast<std::size_t>(numberMonitors))) {
+      char *monitorName = XGetAtomName(display, monitor.name);
+      const bool matches = monitorName != nullptr && name == monitorName;
+      if (monitorName != nullptr) {
+        XFree(monitorName);
+      }
+      if (matches) {
+        area = MonitorArea{
+            .x = static_cast<std::size_t>(std::max(monitor.x, 0)),
+            .y = static_cast<std::size_t>(std::max(monitor.y, 0)),
+            .geometry = {.width = static_cast<std::size_t>(monitor.width),
+                         .height = static_cast<std::size_t>(monitor.height)}};
+        break;
+      }
+    }
+    XRRFreeMonitors(monitors);
+  }
+  XCloseDisplay(display);
+
+  if (area.has_value()) {
+    logDebug("Monitor {} is {}x{} at ({}, {})", name, area->geometry.width,
+             area->geometry.height, area->x, area->y);
+  }
+  return area;
+#else
+  (void)name;
+  return std::nullopt;
+#endif
+}
+
+std::optional<DisplayGeometry> askDisplayForGeometry(const DisplayArea area) {
+  Display *display = XOpenDisplay(nullptr);
+  if (display == nullptr) {
+    logDebug("Unable to open X11 display to find its size");
+    return std::nullopt;
+  }
+
+  std::optional<DisplayGeometry> geometry = std::nullopt;
+  if (area == DisplayArea::LargestMonitor) {
+    geometry = largestMonitorGeometry(display);
+  }
+  if (!geometry.has_value()) {
+    geometry = screenGeometry(display);
+  }
+  XCloseDisplay(display);
+
+  logDebug("Display size is {}x{}", geometry->width, geometry->height);
+  return geometry;
+}
+
+/** Scales `length` by `scale`, keeping it in the range [1..`maxLength`] */
+std::size_t scaledLength(const std::size_t length, const double scale,
+                         const std::size_t maxLength) {
+  const auto scaled =
+      static_cast<std::size_t>(std::llround(static_cast<double>(length) * scale));
+  return std::clamp<std::size_t>(scaled, 1, maxLength);
+}
+
+} // namespace
+
+// ===== Header ===============
+
+std::optional<DisplayGeometry> queryDisplayGeometry(const DisplayArea area) {
+  GeometryStore &store = geometryStore();
+  const std::scoped_lock lock(store.mutex);
+
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  std::optional<QueriedGeometry> &queried =
+      store.byArea.at(static_cast<std::size_t>(area));
+  if (!queried.has_value() ||
+      now - queried->queryTime >= DISPLAY_GEOMETRY_REQUERY_INTERVAL) {
+    queried = QueriedGeometry{.geometry = askDisplayForGeometry(area),
+                              .queryTime = now};
+  }
+  return queried->geometry;
+}
+
+std::optional<MonitorArea> queryMonitorArea(const std::string &name) {
+  GeometryStore &store = geometryStore();
+  const std::scoped_lock lock(store.mutex);
+
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  const auto queried = store.byMonitorName.find(name);
+  if (queried != store.byMonitorName.end() &&
+      now - queried->second.queryTime < DISPLAY_GEOMETRY_REQUERY_INTERVAL) {
+    return queried->second.area;
+  }
+
+  const std::optional<MonitorArea> area = askDisplayForMonitorArea(name);
+  store.byMonitorName.insert_or_assign(
+      name, QueriedMonitorArea{.area = area, .queryTime = now});
+  return area;
+}
+
+std::vector<DisplayGeometry> queryMonitorGeometries() {
+  Display *display = XOpenDisplay(nullptr);
+  if (display == nullptr) {
+    logDebug("Unable to open X11 display to find the size of its monitors");
+    return {};
+  }
+
+  std::vector<DisplayGeometry> geometries =
+      monitorGeometries(display).value_or(std::vector<DisplayGeometry>{});
+  XCloseDisplay(display);
+  return geometries;
+}
+
+bool SourceRegion::isWholeImage(const std::size_t imageWidth,
+                                const std::size_t imageHeight) const {
+  return x == 0 && y == 0 && cropWidth == imageWidth &&
+         cropHeight == imageHeight && width == imageWidth &&
+         height == imageHeight;
+}
+
+SourceRegion DisplayFit::sourceRegion(const std::size_t imageWidth,
+                                      const std::size_t imageHeight) const {
+  SourceRegion region = {.x = 0,
+                         .y = 0,
+                         .cropWidth = imageWidth,
+                         .cropHeight = imageHeight,
+                         .width = imageWidth,
+                         .height = imageHeight};
+  if (imageWidth == 0 || imageHeight == 0 || display.width == 0 ||
+      display.height == 0) {
+    return region;
+  }
+
+  switch (mode) {
+  case BackgroundSetMode::Center: {
+    region.cropWidth = std::min(imageWidth, display.width);
+    region.cropHeight = std::min(imageHeight, display.height);
+    region.width = region.cropWidth;
+    region.height = region.cropHeight;
+    break;
+  }
+  case BackgroundSetMode::Fill: {
+    const double scale =
+        std::max(static_cast<double>(display.width) /
+                     static_cast<double>(imageWidth),
+                 static_cast<double>(display.height) /
+                     static_cast<double>(imageHeight));
+    region.cropWidth = scaledLength(display.width, 1.0 / scale, imageWidth);
+    region.cropHeight = scaledLength(display.height, 1.0 / scale, imageHeight);
+    region.width = scale < 1.0 ? display.width : region.cropWidth;
+    region.height = scale < 1.0 ? display.height : region.cropHeight;
+    break;
+  }
+  case BackgroundSetMode::Scale: {
+    region.width = std::min(imageWidth, display.width);
+    region.height = std::min(imageHeight, display.height);
+    break;
+  }
+  case BackgroundSetMode::Tile: {
+    break;
+  }
+  }
+
+  region.x = (imageWidth - region.cropWidth) / 2;
+  region.y = (imageHeight - region.cropHeight) / 2;
+  return region;
+}
+
+unsigned int
+DisplayFit::decodeScaleDenominator(const std::size_t imageWidth,
+                                   const std::size_t imageHeight) const {
+  const SourceRegion region = sourceRegion(imageWidth, imageHeight);
+
+  unsigned int denominator = 1;
+  while (denominator < MAX_DECODE_SCALE_DENOMINATOR &&
+         region.cropWidth / (denominator * 2) >= region.width &&
+         region.cropHeight / (denominator * 2) >= region.height) {
+    denominator *= 2;
+  }
+  return denominator;
+}
+
+std::string DisplayFit::cacheTag() const {
+  return dynamic_paper::format("{}-{}x{}", backgroundSetModeString(mode),
+                               display.width, display.height);
+}
+
+std::optional<DisplayFit>
+displayFitFor(const std::optional<DisplayGeometry> &configuredSize,
+              const BackgroundSetMethod &method, const BackgroundSetMode mode) {
+  if (mode == BackgroundSetMode::Tile) {
+    return std::nullopt;
+  }
+
+  // Setting the background using X11 covers the whole screen with one image,
+  // while other methods show the image on each monitor
+  const DisplayArea area = std::holds_alternative<MethodX11>(method)
+                               ? DisplayArea::Screen
+                               : DisplayArea::LargestMonitor;
+  const std::optional<DisplayGeometry> geometry =
+      configuredSize.has_value() ? configuredSize : queryDisplayGeometry(area);
+  if (!geometry.has_value()) {
+    return std::nullopt;
+  }
+  return DisplayFit{.display = geometry.value(), .mode = mode};
+}
+
+} // namespace dynamic_paper
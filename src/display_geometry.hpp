@@ -0,0 +1,175 @@
+#pragma once
+
+/**
+ * Size of the display backgrounds are shown on, and the part of a source
+ * image each `BackgroundSetMode` shows on it, so transitions blend and cache
+ * images at the size they are seen at instead of the size of their sources.
+ */
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "background_set_enums.hpp"
+#include "background_set_method.hpp"
+#include "string_util.hpp"
+
+namespace dynamic_paper {
+
+/** Width and height of a display in pixels */
+struct DisplayGeometry {
+  std::size_t width = 0;
+  std::size_t height = 0;
+
+  bool operator==(const DisplayGeometry &) const = default;
+};
+
+/** Parses a size such as "1920x1080" into a `DisplayGeometry`. Returns
+ * `nullopt` if `text` is not a size, or either side is 0 */
+constexpr std::optional<DisplayGeometry>
+parseDisplayGeometry(const std::string &text) {
+  const std::string sizeString = normalize(text);
+
+  std::array<std::size_t, 2> sides = {0, 0};
+  std::size_t side = 0;
+  bool seenDigit = false;
+  for (const char letter : sizeString) {
+    if (letter >= '0' && letter <= '9') {
+      seenDigit = true;
+      sides.at(side) = (sides.at(side) * 10) + static_cast<std::size_t>(letter - '0');
+    } else if (letter == 'x' && seenDigit && side == 0) {
+      side = 1;
+      seenDigit = false;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  if (side != 1 || sides[0] == 0 || sides[1] == 0) {
+    return std::nullopt;
+  }
+  return DisplayGeometry{.width = sides[0], .height = sides[1]};
+}
+
+/** How long the size of a display is kept before asking the display again */
+constexpr std::chrono::seconds DISPLAY_GEOMETRY_REQUERY_INTERVAL(60);
+
+/** Smallest fraction of their size images are decoded at, see
+ * `DisplayFit::decodeScaleDenominator` */
+constexpr unsigned int MAX_DECODE_SCALE_DENOMINATOR = 8;
+
+/** Position and size of a monitor on the X11 screen, in pixels */
+struct MonitorArea {
+  std::size_t x = 0;
+  std::size_t y = 0;
+  DisplayGeometry geometry;
+
+  bool operator==(const MonitorArea &) const = default;
+};
+
+/** Which part of the X11 display `queryDisplayGeometry` returns the size of */
+enum class DisplayArea : std::uint8_t {
+  /** The monitor with the most pixels, found using RandR */
+  LargestMonitor,
+  /** The whole screen, spanning every monitor */
+  Screen
+};
+
+/**
+ * Returns the size of `area` of the default X11 display, or `nullopt` if
+ * there is no display. Uses the size of the screen for `LargestMonitor` if
+ * the display doesn't support RandR.
+ *
+ * The size is kept for `DISPLAY_GEOMETRY_REQUERY_INTERVAL`, so transitions
+ * that start close together only ask the display once.
+ */
+std::optional<DisplayGeometry> queryDisplayGeometry(DisplayArea area);
+
+/**
+ * Returns where the monitor called `name` by RandR, such as "HDMI-1", is on
+ * the default X11 display. Returns `nullopt` if there is no display, no such
+ * monitor, or the display doesn't support RandR.
+ *
+ * Kept for `DISPLAY_GEOMETRY_REQUERY_INTERVAL` like `queryDisplayGeometry`.
+ */
+std::optional<MonitorArea> queryMonitorArea(const std::string &name);
+
+/** Returns the size of every monitor of the default X11 display, which is
+ * empty if there is no display or it doesn't support RandR. Always asks the
+ * display */
+std::vector<DisplayGeometry> queryMonitorGeometries();
+
+/**
+ * Part of a source image that is shown on a display, and the size it is
+ * resampled to. The region is `cropWidth` x `cropHeight` pixels starting at
+ * (`x`, `y`), and is resized to `width` x `height`.
+ */
+struct SourceRegion {
+  std::size_t x = 0;
+  std::size_t y = 0;
+  std::size_t cropWidth = 0;
+  std::size_t cropHeight = 0;
+  std::size_t width = 0;
+  std::size_t height = 0;
+
+  bool operator==(const SourceRegion &) const = default;
+
+  /** Returns `true` if the region is all of an image of `imageWidth` x
+   * `imageHeight`, at its original size */
+  [[nodiscard]] bool isWholeImage(std::size_t imageWidth,
+                                  std::size_t imageHeight) const;
+};
+
+/** How sources are resampled to what a display of `display` shows with
+ * `mode` */
+struct DisplayFit {
+  DisplayGeometry display;
+  BackgroundSetMode mode = BackgroundSetMode::Fill;
+
+  bool operator==(const DisplayFit &) const = default;
+
+  /**
+   * Returns the part of an image of `imageWidth` x `imageHeight` that is
+   * shown with `mode`, and the size it is shown at:
+   * - Center: the middle of the image, cropped to the display
+   * - Fill: the part covering the display, shrunk to the display if larger
+   * - Scale: the whole image, shrunk on each side larger than the display
+   *
+   * Images are never enlarged, as the background setter does that just as
+   * well when showing them.
+   */
+  [[nodiscard]] SourceRegion sourceRegion(std::size_t imageWidth,
+                                          std::size_t imageHeight) const;
+
+  /**
+   * Returns the largest `n` in 1, 2, 4 or 8 such that an image of `imageWidth`
+   * x `imageHeight` decoded at 1/`n` of its size still has as many pixels as
+   * its `sourceRegion` is shown with. JPEG images can be decoded at these
+   * scales for a fraction of the cost of decoding them at full size.
+   */
+  [[nodiscard]] unsigned int
+  decodeScaleDenominator(std::size_t imageWidth,
+                         std::size_t imageHeight) const;
+
+  /** Names the fit in cache keys, formatted `{mode}-{width}x{height}` */
+  [[nodiscard]] std::string cacheTag() const;
+};
+
+/**
+ * Returns how transitions shown with `mode` resample their sources, or
+ * `nullopt` if they are blended at the size of their sources. Uses
+ * `configuredSize` if given, or otherwise asks the display for the area
+ * `method` sets the background of.
+ *
+ * Tiled backgrounds show every pixel of their sources, so they are never
+ * resampled.
+ */
+std::optional<DisplayFit>
+displayFitFor(const std::optional<DisplayGeometry> &configuredSize,
+              const BackgroundSetMethod &method, BackgroundSetMode mode);
+
+} // namespace dynamic_paper
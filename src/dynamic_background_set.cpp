@@ -2,6 +2,8 @@
 
 #include <random>
 
+#include "format.hpp"
+#include "hash.hpp"
 #include "math_util.hpp"
 #include "time_util.hpp"
 
@@ -15,32 +17,19 @@ namespace {
 
 constexpr std::chrono::hours TWENTY_FOUR_HOURS(24);
 
-// ===== Random Engine ====================
-
-/**
- * Class to be used by `std::shuffle` that uses `std::rand`.
- * Mainly for the ability to control the random order by calling `std::srand`
- *
- * Purposely uses `std::rand` in this case as the integrity of randomness for
- * choosing order of backgrounds is not that important, and is easily manipulatd
- * with `std::srand`.
- */
-class RandUniformRandomBitGenerator {
-public:
-  using result_type = unsigned int;
+/** How late a transition can start and still be shown in full. Later than
+ * this, such as after waking from suspend, it is shortened to end on time */
+constexpr std::chrono::seconds LATE_TRANSITION_TOLERANCE(30);
 
-  static constexpr result_type min() { return 0; }
-  static constexpr result_type max() { return RAND_MAX; }
-  static result_type g() { return std::rand(); }
-
-  result_type operator()() { return g(); }
-};
+// ===== Random Engine ====================
 
 /**
- * Shuffles a vector using `std::rand()` as the source of randomness
+ * Shuffles a vector using `generator` as the source of randomness, so the
+ * order only depends on the seed of `generator`
  */
-template <typename T> void shuffleVector(std::vector<T> &vec) {
-  std::shuffle(vec.begin(), vec.end(), RandUniformRandomBitGenerator());
+template <typename T>
+void shuffleVector(std::vector<T> &vec, std::mt19937 &generator) {
+  std::ranges::shuffle(vec, generator);
 }
 
 // ===== Managing the Event List ====================
@@ -105,7 +94,8 @@ EventList parseTimesAndNamesToEventList(
             .startImageName = beforeTimeName.second,
             .endImageName = afterTimeName.second,
             .transition =
-                TransitionInfo(actualDuration, transition->steps, false)};
+                TransitionInfo(actualDuration, transition->steps, false,
+                               transition->autoSteps)};
 
         eventList.emplace_back(transitionTime, lerpEvent);
       }
@@ -224,11 +214,12 @@ timesAndNamesSortedByTime(const DynamicBackgroundData *dynamicData) {
  * image name chosen randomly.
  */
 std::vector<std::pair<TimeFromMidnight, std::string>>
-timesAndRandomNamesSortedByTime(const DynamicBackgroundData *dynamicData) {
+timesAndRandomNamesSortedByTime(const DynamicBackgroundData *dynamicData,
+                                std::mt19937 &generator) {
   std::vector<std::pair<TimeFromMidnight, std::string>> timesAndNames;
 
   std::vector<std::string> names = dynamicData->imageNames;
-  shuffleVector(names);
+  shuffleVector(names, generator);
 
   timesAndNames.reserve(dynamicData->times.size());
   for (size_t i = 0; i < dynamicData->times.size(); i++) {
@@ -262,6 +253,21 @@ void describeError(const BackgroundError error) {
   }
 }
 
+unsigned int dailyRandomSeed(const DynamicBackgroundData &dynamicData,
+                             const std::chrono::year_month_day day) {
+  XXHash64 hash;
+  hash.update(dynamicData.imageDirectory.string());
+  for (const std::string &imageName : dynamicData.imageNames) {
+    // Separated so names that join to the same string give different seeds
+    hash.update(std::string_view("\0", 1));
+    hash.update(imageName);
+  }
+  hash.update(dynamic_paper::format("|{}-{}-{}", static_cast<int>(day.year()),
+                                    static_cast<unsigned int>(day.month()),
+                                    static_cast<unsigned int>(day.day())));
+  return static_cast<unsigned int>(hash.digest());
+}
+
 unsigned int chooseRandomSeed() {
   std::random_device random_device;
   std::mt19937 generator(random_device());
@@ -286,7 +292,8 @@ bool eventListIsSortedByTime(const EventList &eventList) {
   return true;
 }
 
-EventList getEventList(const DynamicBackgroundData *dynamicData) {
+EventList getEventList(const DynamicBackgroundData *dynamicData,
+                       std::mt19937 &generator) {
   EventList eventList;
 
   switch (dynamicData->order) {
@@ -297,7 +304,7 @@ EventList getEventList(const DynamicBackgroundData *dynamicData) {
   }
   case BackgroundSetOrder::Random: {
     eventList = createEventListFromTimesAndNames(
-        dynamicData, timesAndRandomNamesSortedByTime(dynamicData));
+        dynamicData, timesAndRandomNamesSortedByTime(dynamicData, generator));
     break;
   }
   }
@@ -315,28 +322,49 @@ std::chrono::seconds getEventDuration(const Event &event) {
                     event);
 }
 
-std::pair<TimeAndEvent, TimeFromMidnight>
+Event catchUpEvent(const TimeAndEvent &timeAndEvent,
+                   const TimeFromMidnight currentTime) {
+  const auto *lerpEvent = std::get_if<LerpBackgroundEvent>(&timeAndEvent.second);
+  if (lerpEvent == nullptr) {
+    return timeAndEvent.second;
+  }
+
+  const std::chrono::seconds lateBy = currentTime - timeAndEvent.first;
+  const std::chrono::seconds duration = lerpEvent->transition.duration;
+  if (lateBy <= LATE_TRANSITION_TOLERANCE || lateBy >= duration) {
+    return timeAndEvent.second;
+  }
+
+  // Starts from the image that would be shown by now, keeping only the steps
+  // that were still to come so they are shown as often as they would have been
+  const std::chrono::seconds remaining = duration - lateBy;
+  LerpBackgroundEvent caughtUp = *lerpEvent;
+  caughtUp.transition.duration = remaining;
+  caughtUp.transition.startPercentage =
+      static_cast<unsigned int>((lateBy * 100) / duration);
+  caughtUp.transition.steps = std::max(
+      1U, static_cast<unsigned int>(lerpEvent->transition.steps *
+                                    remaining.count() / duration.count()));
+  logInfo("Transition started {} late, starting it from {}% with {} left",
+          lateBy, caughtUp.transition.startPercentage, remaining);
+
+  return caughtUp;
+}
+
+std::pair<const TimeAndEvent &, TimeFromMidnight>
 getCurrentEventAndNextTime(const EventList &eventList,
                            const TimeFromMidnight time) {
   logAssert(!eventList.empty(), "Event list is empty");
 
-  auto firstAfterTime =
-      std::ranges::find_if(eventList, [time](const TimeAndEvent &timeAndEvent) {
-        return timeAndEvent.first > time;
-      });
+  const auto firstAfterTime =
+      std::ranges::upper_bound(eventList, time, {}, &TimeAndEvent::first);
 
   if (firstAfterTime == eventList.begin() ||
       firstAfterTime == eventList.end()) {
-    const TimeAndEvent &current = eventList.back();
-    const TimeFromMidnight next = eventList.front().first;
-
-    return std::make_pair(current, next);
+    return {eventList.back(), eventList.front().first};
   }
 
-  const TimeAndEvent current = *(firstAfterTime - 1);
-  const TimeFromMidnight next = firstAfterTime->first;
-
-  return std::make_pair(current, next);
+  return {*(firstAfterTime - 1), firstAfterTime->first};
 }
 
 std::chrono::seconds timeUntilNext(const TimeFromMidnight &now,
@@ -365,17 +393,139 @@ std::chrono::seconds timeUntilNext(const TimeFromMidnight &now,
 }
 
 void logPrintEventList(const EventList &eventList) {
-  logInfo("Entire event list:");
+  logDebug("Entire event list:");
   for (const auto &event : eventList) {
-    logInfo("{} : {}", event.first, getEventImageName(event.second));
+    logDebug("{} : {}", event.first, getEventImageName(event.second));
   }
-  logInfo("--------");
+  logDebug("--------");
 }
 
 } // namespace detail
 
+// ===== Header: Schedule ===============
+
+DynamicSchedule::DynamicSchedule(const DynamicBackgroundData &backgroundData,
+                                 const unsigned int seed) {
+  std::mt19937 generator(seed);
+  eventList = detail::getEventList(&backgroundData, generator);
+
+  logAssert(detail::eventListIsSortedByTime(eventList),
+            "Event list is not sorted by time from earliest to latest");
+}
+
+std::pair<const detail::TimeAndEvent &, TimeFromMidnight>
+DynamicSchedule::currentEventAndNextTime(const TimeFromMidnight time) const {
+  return detail::getCurrentEventAndNextTime(eventList, time);
+}
+
+DynamicScheduleCache::DynamicScheduleCache(
+    const DynamicBackgroundData &backgroundData)
+    : backgroundData(&backgroundData) {}
+
+const DynamicSchedule &
+DynamicScheduleCache::scheduleFor(const std::chrono::year_month_day day) {
+  if (schedule.has_value() && builtDay == day &&
+      builtTimes == backgroundData->times) {
+    return schedule.value();
+  }
+
+  const std::chrono::milliseconds buildTime = timeToRunCodeBlock([&]() {
+    schedule.emplace(*backgroundData,
+                     detail::dailyRandomSeed(*backgroundData, day));
+  });
+  builtDay = day;
+  builtTimes = backgroundData->times;
+  builds++;
+  totalBuildTime += buildTime;
+
+  logDebug("Built a schedule of {} events in {} ({} builds taking {} in "
+           "total)",
+           schedule->events().size(), buildTime, builds, totalBuildTime);
+  detail::logPrintEventList(schedule->events());
+
+  return schedule.value();
+}
+
 // ===== Header ===============
 
+std::optional<detail::LerpBackgroundEvent>
+getUpcomingTransition(const DynamicBackgroundData &backgroundData,
+                      const DynamicSchedule &schedule,
+                      const TimeFromMidnight currentTime) {
+  using detail::LerpBackgroundEvent;
+  using detail::TimeAndEvent;
+
+  if (!backgroundData.transition.has_value()) {
+    return std::nullopt;
+  }
+
+  const detail::EventList &eventList = schedule.events();
+  const TimeFromMidnight nextTime =
+      schedule.currentEventAndNextTime(currentTime).second;
+
+  const auto nextEvent =
+      std::ranges::find(eventList, nextTime, &TimeAndEvent::first);
+  if (nextEvent == eventList.end() ||
+      !std::holds_alternative<LerpBackgroundEvent>(nextEvent->second)) {
+    return std::nullopt;
+  }
+
+  return std::get<LerpBackgroundEvent>(nextEvent->second);
+}
+
+std::vector<detail::LerpBackgroundEvent>
+getAllTransitions(const DynamicBackgroundData &backgroundData) {
+  using detail::LerpBackgroundEvent;
+
+  if (!backgroundData.transition.has_value()) {
+    return {};
+  }
+
+  std::vector<LerpBackgroundEvent> transitions;
+  const auto alreadyAdded = [&transitions](const std::string &start,
+                                           const std::string &end) {
+    return std::ranges::any_of(
+        transitions, [&start, &end](const LerpBackgroundEvent &transition) {
+          return transition.startImageName == start &&
+                 transition.endImageName == end;
+        });
+  };
+
+  switch (backgroundData.order) {
+  case BackgroundSetOrder::Linear: {
+    // Linear sets are never shuffled, so the generator is unused
+    std::mt19937 generator;
+    for (const detail::TimeAndEvent &timeAndEvent :
+         detail::getEventList(&backgroundData, generator)) {
+      const auto *transition =
+          std::get_if<LerpBackgroundEvent>(&timeAndEvent.second);
+      if (transition != nullptr &&
+          !alreadyAdded(transition->startImageName,
+                        transition->endImageName)) {
+        transitions.push_back(*transition);
+      }
+    }
+    break;
+  }
+  case BackgroundSetOrder::Random: {
+    for (const std::string &start : backgroundData.imageNames) {
+      for (const std::string &end : backgroundData.imageNames) {
+        if (start != end && !alreadyAdded(start, end)) {
+          transitions.push_back(
+              {.commonImageDirectory = backgroundData.imageDirectory,
+               .startImageName = start,
+               .endImageName = end,
+               .transition = backgroundData.transition.value()});
+        }
+      }
+    }
+    break;
+  }
+  }
+
+  return transitions;
+}
+
 DynamicBackgroundData::DynamicBackgroundData(
     std::filesystem::path imageDirectory, BackgroundSetMode mode,
     std::optional<TransitionInfo> transition, BackgroundSetOrder order,
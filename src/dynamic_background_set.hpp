@@ -6,20 +6,26 @@
  */
 
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <optional>
+#include <random>
 #include <vector>
 
 #include "background_set_enums.hpp"
 #include "background_setter_definition.hpp"
 #include "config.hpp"
+#include "display_geometry.hpp"
 #include "script_executor.hpp"
+#include "step_throughput.hpp"
 #include "time_from_midnight.hpp"
 #include "transition_info.hpp"
 #include "variant_visitor_templ.hpp"
 
 namespace dynamic_paper {
 
+class DynamicSchedule;
+
 /** Type of `BackgroundSet` that shows different wallpapers at different times,
  * and changes over time*/
 struct DynamicBackgroundData {
@@ -56,6 +62,19 @@ struct DynamicBackgroundData {
   updateBackground(TimeFromMidnight currentTime, const Config &config,
                    T &&backgroundSetFunction,
                    std::optional<BackgroundSetMode> optMode) const;
+
+  /** Does the same as `updateBackground`, but finds the current event in
+   * `schedule`, which must have been built from this set, instead of building
+   * the events of the day again.
+   */
+  template <CanSetBackgroundTrait T,
+            ChangesFilesystem Files = FilesystemHandler,
+            GetsCompositeImages CompositeImages = ImageCompositor>
+  [[nodiscard]] std::chrono::seconds
+  updateBackground(const DynamicSchedule &schedule,
+                   TimeFromMidnight currentTime, const Config &config,
+                   T &&backgroundSetFunction,
+                   std::optional<BackgroundSetMode> optMode) const;
 };
 
 // ===== Header Helper ===============
@@ -97,22 +116,99 @@ std::chrono::seconds timeUntilNext(const TimeFromMidnight &now,
                                    std::chrono::seconds eventDuration,
                                    const TimeFromMidnight &later);
 
-/** Gets the list of events to do over the course of the day, sorted by time */
-EventList getEventList(const DynamicBackgroundData *dynamicData);
+/** Gets the list of events to do over the course of the day, sorted by time.
+ * Sets with a random order are shuffled using `generator` */
+EventList getEventList(const DynamicBackgroundData *dynamicData,
+                       std::mt19937 &generator);
 
 /** Returns the amount of time an event takes */
 std::chrono::seconds getEventDuration(const Event &event);
 
-std::pair<TimeAndEvent, TimeFromMidnight>
+/**
+ * Returns the event of `timeAndEvent`, shortened so that it still ends on time
+ * if it is being started late at `currentTime`, such as after waking from
+ * suspend partway through a transition. Late transitions start from the
+ * percentage they would have reached by `currentTime` and keep only the steps
+ * after it. Events started on time are returned as they are.
+ */
+Event catchUpEvent(const TimeAndEvent &timeAndEvent,
+                   TimeFromMidnight currentTime);
+
+/** Returns the event current at `time` and the time of the event after it.
+ * `eventList` must be sorted by time */
+std::pair<const TimeAndEvent &, TimeFromMidnight>
 getCurrentEventAndNextTime(const EventList &eventList, TimeFromMidnight time);
 
 bool eventListIsSortedByTime(const EventList &eventList);
 
 unsigned int chooseRandomSeed();
 
+/** Seed that orders `dynamicData` on `day`. It depends only on the set and the
+ * day, so the order is the same after a restart and can be known ahead of time
+ */
+unsigned int dailyRandomSeed(const DynamicBackgroundData &dynamicData,
+                             std::chrono::year_month_day day);
+
 /** Logs out an easily readable version of the event list */
 void logPrintEventList(const EventList &eventList);
 
+} // namespace detail
+
+// ===== Schedule ===============
+
+/**
+ * The events of a `DynamicBackgroundData` over one day, sorted by time.
+ * Building the events shuffles the images of random sets, sorts the events
+ * and removes ones that overlap, so it is built once and reused every time the
+ * background is updated.
+ */
+class DynamicSchedule {
+public:
+  /** Builds the events of `backgroundData`, using `seed` to choose the order
+   * of sets with `BackgroundSetOrder::Random` */
+  DynamicSchedule(const DynamicBackgroundData &backgroundData,
+                  unsigned int seed);
+
+  [[nodiscard]] const detail::EventList &events() const { return eventList; }
+
+  /** Returns the event current at `time` and the time of the event after it
+   */
+  [[nodiscard]] std::pair<const detail::TimeAndEvent &, TimeFromMidnight>
+  currentEventAndNextTime(TimeFromMidnight time) const;
+
+private:
+  detail::EventList eventList;
+};
+
+/**
+ * Keeps the `DynamicSchedule` of a set between updates of the background,
+ * building it again only when the day or the times of the set change. Sets
+ * with `BackgroundSetOrder::Random` are ordered with `dailyRandomSeed`.
+ */
+class DynamicScheduleCache {
+public:
+  /** `backgroundData` must outlive the cache */
+  explicit DynamicScheduleCache(const DynamicBackgroundData &backgroundData);
+
+  /** Schedule of the set on `day`, building it if it is not already */
+  const DynamicSchedule &scheduleFor(std::chrono::year_month_day day);
+
+  /** Number of times a schedule was built */
+  [[nodiscard]] std::size_t numberBuilds() const { return builds; }
+
+private:
+  const DynamicBackgroundData *backgroundData;
+  std::optional<DynamicSchedule> schedule = std::nullopt;
+  /** Day and times `schedule` was built for */
+  std::chrono::year_month_day builtDay;
+  std::vector<TimeFromMidnight> builtTimes;
+
+  std::size_t builds = 0;
+  std::chrono::milliseconds totalBuildTime{0};
+};
+
+namespace detail {
+
 // --- Event Processing ---
 
 template <CanSetBackgroundTrait T, ChangesFilesystem Files,
@@ -146,13 +242,20 @@ void doEvent(const Event &event, const DynamicBackgroundData *backgroundData,
 
             logTrace("About to start lerping background");
 
+            const BackgroundSetMode mode =
+                optMode.value_or(backgroundData->mode);
+            const TransitionInfo transition =
+                resolveAutoSteps(event.transition, config.imageCacheDirectory,
+                                 config.transitionCpuBudget);
             tl::expected<void, BackgroundError> result =
                 lerpBackgroundBetweenImages<std::decay_t<T>, Files,
                                             CompositeImages>(
                     event.commonImageDirectory, event.startImageName,
                     event.endImageName, config.imageCacheDirectory,
-                    event.transition, optMode.value_or(backgroundData->mode),
-                    std::move(std::forward<T>(backgroundSetFunction)));
+                    transition, config.transitionPercentageStep,
+                    displayFitFor(config.displaySize, config.method, mode),
+                    config.cacheDecodedSources, config.transitionFrameFormat,
+                    config.packTransitionFrames, mode, std::move(std::forward<T>(backgroundSetFunction)));
 
             if (!result.has_value()) {
               describeError(result.error());
@@ -167,26 +270,16 @@ template <CanSetBackgroundTrait T, ChangesFilesystem Files,
           GetsCompositeImages CompositeImages>
 std::chrono::seconds updateBackgroundAndReturnTimeTillNext(
     const TimeFromMidnight currentTime,
-    const DynamicBackgroundData *backgroundData, const Config &config,
-    const unsigned int seed, T &&backgroundSetFunction,
+    const DynamicBackgroundData *backgroundData,
+    const DynamicSchedule &schedule, const Config &config,
+    T &&backgroundSetFunction,
     const std::optional<BackgroundSetMode> optMode) {
 
-  // Reset the random seed on each iteration of the loop to ensure the order
-  // of `random` dynamic backgrounds is consistent between each reconstruction
-  // of the event list.
-  std::srand(seed);
-
-  const EventList eventList = getEventList(backgroundData);
-
-  detail::logPrintEventList(eventList);
-
-  logAssert(eventListIsSortedByTime(eventList),
-            "Event list is not sorted by time from earliest to latest");
+  const std::pair<const TimeAndEvent &, TimeFromMidnight>
+      currentEventAndNextTime = schedule.currentEventAndNextTime(currentTime);
 
-  const std::pair<TimeAndEvent, TimeFromMidnight> currentEventAndNextTime =
-      getCurrentEventAndNextTime(eventList, currentTime);
-
-  const Event &currentEvent = currentEventAndNextTime.first.second;
+  const Event currentEvent =
+      catchUpEvent(currentEventAndNextTime.first, currentTime);
   logTrace("Doing Current Event for time {}",
            currentEventAndNextTime.first.first);
 
@@ -204,6 +297,27 @@ std::chrono::seconds updateBackgroundAndReturnTimeTillNext(
 
 } // namespace detail
 
+/**
+ * Returns the transition in `schedule`, which must have been built from
+ * `backgroundData`, that will happen after the event that is current at
+ * `currentTime`, or `nullopt` if the next event is not a transition. Works for
+ * sets with `BackgroundSetOrder::Random` too, as `schedule` fixes their order.
+ */
+std::optional<detail::LerpBackgroundEvent>
+getUpcomingTransition(const DynamicBackgroundData &backgroundData,
+                      const DynamicSchedule &schedule,
+                      TimeFromMidnight currentTime);
+
+/**
+ * Returns every transition `backgroundData` can do, without duplicates.
+ *
+ * For sets with `BackgroundSetOrder::Linear` these are the transitions in its
+ * event list. Sets with `BackgroundSetOrder::Random` can transition from any of
+ * its images to any other.
+ */
+std::vector<detail::LerpBackgroundEvent>
+getAllTransitions(const DynamicBackgroundData &backgroundData);
+
 // ===== Definition =====
 
 template <CanSetBackgroundTrait T, ChangesFilesystem Files,
@@ -213,15 +327,28 @@ template <CanSetBackgroundTrait T, ChangesFilesystem Files,
     T &&backgroundSetFunction,
     const std::optional<BackgroundSetMode> optMode) const {
 
-  logTrace("Show dynamic background");
-
   const unsigned int seed = detail::chooseRandomSeed();
   logTrace("Random seed is {}", seed);
 
+  const DynamicSchedule schedule(*this, seed);
+  return updateBackground<T, Files, CompositeImages>(
+      schedule, currentTime, config, std::forward<T>(backgroundSetFunction),
+      optMode);
+}
+
+template <CanSetBackgroundTrait T, ChangesFilesystem Files,
+          GetsCompositeImages CompositeImages>
+[[nodiscard]] std::chrono::seconds DynamicBackgroundData::updateBackground(
+    const DynamicSchedule &schedule, const TimeFromMidnight currentTime,
+    const Config &config, T &&backgroundSetFunction,
+    const std::optional<BackgroundSetMode> optMode) const {
+
+  logTrace("Show dynamic background");
+
   return detail::updateBackgroundAndReturnTimeTillNext<T, Files,
                                                        CompositeImages>(
-      currentTime, this, config, seed, std::forward<T>(backgroundSetFunction),
-      optMode);
+      currentTime, this, schedule, config,
+      std::forward<T>(backgroundSetFunction), optMode);
 }
 
 } // namespace dynamic_paper
@@ -0,0 +1,229 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+std::optional<std::filesystem::file_time_type>
+lastWriteTime(const std::filesystem::path &file) {
+  std::error_code error;
+  const std::filesystem::file_time_type time =
+      std::filesystem::last_write_time(file, error);
+  if (error) {
+    return std::nullopt;
+  }
+  return time;
+}
+
+#ifdef __linux__
+constexpr std::uint32_t WATCHED_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+/** Adds the index of each file in `resolvedFiles` named by the events in
+ * `buffer` to `changed` */
+void addChangedFiles(
+    const std::span<const char> buffer,
+    const std::unordered_map<int, std::filesystem::path> &watchedDirectories,
+    const std::vector<std::filesystem::path> &resolvedFiles,
+    std::vector<bool> &changed) {
+  std::size_t offset = 0;
+  while (offset + sizeof(inotify_event) <= buffer.size()) {
+    inotify_event event{};
+    std::memcpy(&event, buffer.data() + offset, sizeof(inotify_event));
+    const char *name = buffer.data() + offset + sizeof(inotify_event);
+    offset += sizeof(inotify_event) + event.len;
+
+    const auto directory = watchedDirectories.find(event.wd);
+    if (event.len == 0 || directory == watchedDirectories.end()) {
+      continue;
+    }
+    const std::filesystem::path file = directory->second / name;
+    for (std::size_t i = 0; i < resolvedFiles.size(); i++) {
+      if (resolvedFiles[i] == file) {
+        changed[i] = true;
+      }
+    }
+  }
+}
+#endif
+
+} // namespace
+
+// ===== Header ===============
+
+FileWatcher::FileWatcher(std::vector<std::filesystem::path> files)
+    : files(std::move(files)) {
+  for (const std::filesystem::path &file : this->files) {
+    std::error_code error;
+    std::filesystem::path resolved = std::filesystem::weakly_canonical(file, error);
+    resolvedFiles.push_back(error ? file : std::move(resolved));
+    writeTimes.push_back(lastWriteTime(file));
+  }
+
+#ifdef __linux__
+  inotifyDescriptor = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if (inotifyDescriptor == -1) {
+    logWarning("Unable to watch files with inotify, checking them every {} "
+               "instead: {}",
+               FILE_POLL_INTERVAL, std::strerror(errno));
+    return;
+  }
+
+  for (const std::filesystem::path &file : resolvedFiles) {
+    const std::filesystem::path directory = file.parent_path();
+    const int watch = inotify_add_watch(inotifyDescriptor,
+                                        directory.c_str(), WATCHED_EVENTS);
+    if (watch == -1) {
+      logWarning("Unable to watch {} for changes: {}", directory.string(),
+                 std::strerror(errno));
+      continue;
+    }
+    watchedDirectories.emplace(watch, directory);
+  }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+  if (inotifyDescriptor != -1) {
+    close(inotifyDescriptor);
+  }
+#endif
+}
+
+tl::expected<std::vector<std::filesystem::path>, FileWatcherError>
+FileWatcher::waitForChanges(const std::stop_token &stopToken) {
+#ifdef __linux__
+  if (inotifyDescriptor == -1) {
+    return waitForChangesByPolling(stopToken);
+  }
+
+  // Woken by the stop token
+  const int stopDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (stopDescriptor == -1) {
+    return waitForChangesByPolling(stopToken);
+  }
+  const std::stop_callback wakeOnStop(stopToken, [stopDescriptor]() {
+    const std::uint64_t increment = 1;
+    [[maybe_unused]] const ssize_t written =
+        write(stopDescriptor, &increment, sizeof(increment));
+  });
+
+  std::vector<bool> changed(files.size(), false);
+  alignas(inotify_event) std::array<char, 4096> buffer{};
+  bool anyChanged = false;
+  bool failed = false;
+
+  while (!stopToken.stop_requested()) {
+    std::array<pollfd, 2> descriptors = {
+        pollfd{.fd = inotifyDescriptor, .events = POLLIN, .revents = 0},
+        pollfd{.fd = stopDescriptor, .events = POLLIN, .revents = 0}};
+    // Once a file changed, waits for it to settle instead of forever
+    const int timeout =
+        anyChanged ? static_cast<int>(FILE_CHANGE_SETTLE_TIME.count()) : -1;
+    const int ready = poll(descriptors.data(), descriptors.size(), timeout);
+    if (ready == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      logWarning("Unable to wait for changes to watched files: {}",
+                 std::strerror(errno));
+      failed = true;
+      break;
+    }
+    if (ready == 0) {
+      break;
+    }
+    if ((descriptors[0].revents & POLLIN) == 0) {
+      continue;
+    }
+
+    ssize_t numberRead = 0;
+    while ((numberRead = read(inotifyDescriptor, buffer.data(),
+                              buffer.size())) > 0) {
+      addChangedFiles(
+          std::span<const char>(buffer.data(),
+                                static_cast<std::size_t>(numberRead)),
+          watchedDirectories, resolvedFiles, changed);
+    }
+    if (numberRead == -1 && errno != EAGAIN && errno != EINTR) {
+      logWarning("Unable to read changes to watched files: {}",
+                 std::strerror(errno));
+      failed = true;
+      break;
+    }
+    anyChanged = std::ranges::find(changed, true) != changed.end();
+  }
+  close(stopDescriptor);
+  if (failed) {
+    return tl::make_unexpected(FileWatcherError::WatchFailed);
+  }
+
+  std::vector<std::filesystem::path> changedFiles;
+  if (!stopToken.stop_requested()) {
+    for (std::size_t i = 0; i < files.size(); i++) {
+      if (changed[i]) {
+        changedFiles.push_back(files[i]);
+      }
+    }
+  }
+  return changedFiles;
+#else
+  return waitForChangesByPolling(stopToken);
+#endif
+}
+
+std::vector<std::filesystem::path>
+FileWatcher::waitForChangesByPolling(const std::stop_token &stopToken) {
+  std::mutex mutex;
+  std::condition_variable_any stopped;
+
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      if (stopped.wait_for(lock, stopToken, FILE_POLL_INTERVAL,
+                           []() { return false; }) ||
+          stopToken.stop_requested()) {
+        return {};
+      }
+    }
+
+    std::vector<std::filesystem::path> changedFiles;
+    for (std::size_t i = 0; i < files.size(); i++) {
+      const std::optional<std::filesystem::file_time_type> writeTime =
+          lastWriteTime(files[i]);
+      if (writeTime != writeTimes[i]) {
+        writeTimes[i] = writeTime;
+        if (writeTime.has_value()) {
+          changedFiles.push_back(files[i]);
+        }
+      }
+    }
+    if (!changedFiles.empty()) {
+      return changedFiles;
+    }
+  }
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,73 @@
+#pragma once
+
+/**
+ * Watching files for changes, so the daemon picks up edits to its config
+ * without being restarted.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stop_token>
+#include <unordered_map>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+namespace dynamic_paper {
+
+/** How long a file must go without changing before its change is reported,
+ * so a file saved in several steps is only reported once */
+constexpr std::chrono::milliseconds FILE_CHANGE_SETTLE_TIME(200);
+/** How often files are checked when they can't be watched with inotify */
+constexpr std::chrono::seconds FILE_POLL_INTERVAL(2);
+
+/** `WatchFailed` is returned once the files can no longer be watched, and the
+ * watcher should be created again */
+enum class FileWatcherError : std::uint8_t { WatchFailed };
+
+/**
+ * Watches files for changes.
+ *
+ * On Linux this watches the directory of each file with inotify, so files
+ * replaced by renaming another over them, as many editors save, are seen.
+ * Elsewhere it falls back to checking when each file was last written.
+ */
+class FileWatcher {
+public:
+  /** Watches `files`, which don't need to exist yet */
+  explicit FileWatcher(std::vector<std::filesystem::path> files);
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+  FileWatcher(FileWatcher &&) = delete;
+  FileWatcher &operator=(FileWatcher &&) = delete;
+
+  /**
+   * Waits until at least one file is changed, and returns the files that
+   * changed, as they were given. Returns an empty vector once `stopToken` is
+   * stopped, and an error if waiting for changes failed.
+   */
+  tl::expected<std::vector<std::filesystem::path>, FileWatcherError>
+  waitForChanges(const std::stop_token &stopToken);
+
+private:
+  std::vector<std::filesystem::path> files;
+  /** Each file with symlinks resolved, in the same order as `files` */
+  std::vector<std::filesystem::path> resolvedFiles;
+
+  /** The inotify instance, or -1 if there isn't one */
+  int inotifyDescriptor = -1;
+  /** Directory each inotify watch descriptor watches */
+  std::unordered_map<int, std::filesystem::path> watchedDirectories;
+
+  /** Last write time of each file, used when there is no inotify instance */
+  std::vector<std::optional<std::filesystem::file_time_type>> writeTimes;
+
+  std::vector<std::filesystem::path>
+  waitForChangesByPolling(const std::stop_token &stopToken);
+};
+
+} // namespace dynamic_paper
@@ -0,0 +1,265 @@
+#include "frame_pack.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache_manifest.hpp"
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+constexpr std::array<char, 8> FRAME_PACK_MAGIC = {'D', 'P', 'F', 'R',
+                                                  'A', 'M', 'E', 'S'};
+constexpr std::uint32_t FRAME_PACK_VERSION = 1;
+
+/** Start of a frame pack, followed by `frameCount` `FramePackIndexEntry`s */
+struct FramePackHeader {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t frameCount;
+};
+
+struct FramePackIndexEntry {
+  std::uint32_t percentage;
+  std::uint32_t reserved;
+  std::uint64_t offset;
+  std::uint64_t length;
+};
+
+static_assert(sizeof(FramePackHeader) == 16,
+              "Frame pack header must not have padding");
+static_assert(sizeof(FramePackIndexEntry) == 24,
+              "Frame pack index entry must not have padding");
+
+/** Replaces `path` with `partialPath`, removing `partialPath` if it can't */
+bool renameOver(const std::filesystem::path &partialPath,
+                const std::filesystem::path &path) {
+  std::error_code error;
+  std::filesystem::rename(partialPath, path, error);
+  if (error) {
+    logWarning("Unable to save {}: {}", path.string(), error.message());
+    std::filesystem::remove(partialPath, error);
+    return false;
+  }
+  return true;
+}
+
+/** Returns the index of the frame pack of `length` bytes starting at `data`,
+ * or `nullopt` if it is damaged */
+std::optional<std::vector<FramePackEntry>>
+readIndex(const std::uint8_t *data, const std::size_t length) {
+  FramePackHeader header{};
+  std::memcpy(&header, data, sizeof(FramePackHeader));
+  if (header.magic != FRAME_PACK_MAGIC ||
+      header.version != FRAME_PACK_VERSION) {
+    return std::nullopt;
+  }
+
+  const std::size_t indexEnd =
+      sizeof(FramePackHeader) +
+      (static_cast<std::size_t>(header.frameCount) *
+       sizeof(FramePackIndexEntry));
+  if (indexEnd > length) {
+    return std::nullopt;
+  }
+
+  std::vector<FramePackEntry> index;
+  index.reserve(header.frameCount);
+  for (std::size_t i = 0; i < header.frameCount; i++) {
+    FramePackIndexEntry entry{};
+    std::memcpy(&entry,
+                data + sizeof(FramePackHeader) +
+                    (i * sizeof(FramePackIndexEntry)),
+                sizeof(FramePackIndexEntry));
+    if (entry.offset < indexEnd || entry.length > length ||
+        entry.offset > length - entry.length ||
+        (!index.empty() && entry.percentage <= index.back().percentage)) {
+      return std::nullopt;
+    }
+    index.push_back({.percentage = entry.percentage,
+                     .offset = entry.offset,
+                     .length = entry.length});
+  }
+  return index;
+}
+
+} // namespace
+
+// ===== Mapping ===============
+
+struct FramePack::Mapping {
+  const std::uint8_t *data = nullptr;
+  std::size_t length = 0;
+
+  Mapping(const std::uint8_t *data, const std::size_t length)
+      : data(data), length(length) {}
+  ~Mapping() {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    munmap(const_cast<std::uint8_t *>(data), length);
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+  Mapping(Mapping &&) = delete;
+  Mapping &operator=(Mapping &&) = delete;
+};
+
+// ===== Header ===============
+
+FramePack::FramePack(std::unique_ptr<Mapping> mapping,
+                     std::vector<FramePackEntry> index)
+    : mapping(std::move(mapping)), index(std::move(index)) {}
+
+FramePack::~FramePack() = default;
+FramePack::FramePack(FramePack &&) noexcept = default;
+FramePack &FramePack::operator=(FramePack &&) noexcept = default;
+
+std::optional<FramePack> FramePack::map(const std::filesystem::path &path) {
+  const int fileDescriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fileDescriptor < 0) {
+    return std::nullopt;
+  }
+
+  struct stat fileStatus {};
+  void *data = MAP_FAILED;
+  if (fstat(fileDescriptor, &fileStatus) == 0 &&
+      static_cast<std::size_t>(fileStatus.st_size) >=
+          sizeof(FramePackHeader)) {
+    data = mmap(nullptr, static_cast<std::size_t>(fileStatus.st_size),
+                PROT_READ, MAP_SHARED, fileDescriptor, 0);
+  }
+  close(fileDescriptor);
+  if (data == MAP_FAILED) {
+    return std::nullopt;
+  }
+
+  const auto length = static_cast<std::size_t>(fileStatus.st_size);
+  auto mapping = std::make_unique<Mapping>(
+      static_cast<const std::uint8_t *>(data), length);
+  std::optional<std::vector<FramePackEntry>> index =
+      readIndex(mapping->data, length);
+  if (!index.has_value()) {
+    logDebug("Ignoring damaged frame pack {}", path.string());
+    return std::nullopt;
+  }
+
+  // Frames are shown in order, one after another
+  madvise(data, length, MADV_SEQUENTIAL);
+  return FramePack(std::move(mapping), std::move(index.value()));
+}
+
+std::optional<FramePackEntry>
+FramePack::find(const unsigned int percentage) const {
+  const auto entry = std::ranges::lower_bound(index, percentage, {},
+                                              &FramePackEntry::percentage);
+  if (entry == index.end() || entry->percentage != percentage) {
+    return std::nullopt;
+  }
+  return *entry;
+}
+
+std::span<const std::uint8_t>
+FramePack::frame(const unsigned int percentage) const {
+  const std::optional<FramePackEntry> entry = find(percentage);
+  if (!entry.has_value()) {
+    return {};
+  }
+  return {mapping->data + entry->offset, entry->length};
+}
+
+bool FramePack::extractFrame(
+    const unsigned int percentage,
+    const std::filesystem::path &destinationImagePath) const {
+  const std::span<const std::uint8_t> data = frame(percentage);
+  if (data.empty()) {
+    return false;
+  }
+
+  const std::filesystem::path partialPath =
+      partialPathFor(destinationImagePath);
+  {
+    std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(data.data()), // NOLINT
+               static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      logWarning("Unable to extract frame to {}",
+                 destinationImagePath.string());
+      std::error_code error;
+      std::filesystem::remove(partialPath, error);
+      return false;
+    }
+  }
+  return renameOver(partialPath, destinationImagePath);
+}
+
+bool writeFramePack(const std::span<const PackedFrame> frames,
+                    const std::optional<FramePack> &existingPack,
+                    const std::filesystem::path &path) {
+  // New frames replace frames of the existing pack with the same percentage
+  std::map<unsigned int, std::span<const std::uint8_t>> framesByPercentage;
+  if (existingPack.has_value()) {
+    for (const FramePackEntry &entry : existingPack->entries()) {
+      framesByPercentage.emplace(entry.percentage,
+                                 existingPack->frame(entry.percentage));
+    }
+  }
+  for (const PackedFrame &frame : frames) {
+    framesByPercentage.insert_or_assign(frame.percentage,
+                                        std::span(frame.data));
+  }
+
+  const FramePackHeader header = {
+      .magic = FRAME_PACK_MAGIC,
+      .version = FRAME_PACK_VERSION,
+      .frameCount = static_cast<std::uint32_t>(framesByPercentage.size())};
+
+  std::vector<FramePackIndexEntry> index;
+  index.reserve(framesByPercentage.size());
+  std::uint64_t offset =
+      sizeof(FramePackHeader) +
+      (framesByPercentage.size() * sizeof(FramePackIndexEntry));
+  for (const auto &[percentage, data] : framesByPercentage) {
+    index.push_back({.percentage = percentage,
+                     .reserved = 0,
+                     .offset = offset,
+                     .length = data.size()});
+    offset += data.size();
+  }
+
+  const std::filesystem::path partialPath = partialPathFor(path);
+  {
+    std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), // NOLINT
+               sizeof(FramePackHeader));
+    file.write(reinterpret_cast<const char *>(index.data()), // NOLINT
+               static_cast<std::streamsize>(index.size() *
+                                            sizeof(FramePackIndexEntry)));
+    for (const auto &[percentage, data] : framesByPercentage) {
+      file.write(reinterpret_cast<const char *>(data.data()), // NOLINT
+                 static_cast<std::streamsize>(data.size()));
+    }
+    if (!file) {
+      logWarning("Unable to save frame pack to {}", path.string());
+      std::error_code error;
+      std::filesystem::remove(partialPath, error);
+      return false;
+    }
+  }
+
+  return renameOver(partialPath, path);
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,104 @@
+#pragma once
+
+/**
+ * Every cached frame of one transition stored in a single file, as an index
+ * followed by the encoded frames one after another, instead of one file per
+ * frame. The file is memory mapped, so a frame is read from its offset in the
+ * mapping without opening another file.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace dynamic_paper {
+
+/** Extension added to the name of frame packs in the cache directory */
+constexpr std::string_view FRAME_PACK_EXTENSION = ".frames";
+
+/** An encoded frame of a transition, and how far through the transition it
+ * is */
+struct PackedFrame {
+  unsigned int percentage = 0;
+  std::vector<std::uint8_t> data;
+};
+
+/** Where a frame is in a frame pack */
+struct FramePackEntry {
+  unsigned int percentage = 0;
+  /** Bytes from the start of the file to the encoded frame */
+  std::size_t offset = 0;
+  std::size_t length = 0;
+};
+
+/** A read only memory mapping of a valid frame pack */
+class FramePack {
+public:
+  ~FramePack();
+
+  FramePack(const FramePack &) = delete;
+  FramePack &operator=(const FramePack &) = delete;
+  FramePack(FramePack &&) noexcept;
+  FramePack &operator=(FramePack &&) noexcept;
+
+  /** Maps the frame pack at `path`, or returns `nullopt` if it is missing or
+   * damaged */
+  static std::optional<FramePack> map(const std::filesystem::path &path);
+
+  /** Where the frame `percentage`% of the way through the transition is, or
+   * `nullopt` if it is not in the pack */
+  [[nodiscard]] std::optional<FramePackEntry>
+  find(unsigned int percentage) const;
+
+  [[nodiscard]] bool contains(unsigned int percentage) const {
+    return find(percentage).has_value();
+  }
+
+  /** Encoded frame `percentage`% of the way through the transition, read from
+   * the mapping, or empty if it is not in the pack */
+  [[nodiscard]] std::span<const std::uint8_t>
+  frame(unsigned int percentage) const;
+
+  /** Every frame in the pack, by increasing percentage */
+  [[nodiscard]] const std::vector<FramePackEntry> &entries() const {
+    return index;
+  }
+
+  /**
+   * Copies the frame `percentage`% of the way through the transition to
+   * `destinationImagePath`, for background setters that only read files.
+   * Written to a temporary file and renamed like other frames. Returns
+   * `false` if the frame is not in the pack or couldn't be written.
+   */
+  bool extractFrame(unsigned int percentage,
+                    const std::filesystem::path &destinationImagePath) const;
+
+private:
+  struct Mapping;
+
+  FramePack(std::unique_ptr<Mapping> mapping,
+            std::vector<FramePackEntry> index);
+
+  std::unique_ptr<Mapping> mapping;
+  std::vector<FramePackEntry> index;
+};
+
+/**
+ * Saves `frames`, and every frame of `existingPack` not in `frames`, to a
+ * frame pack at `path`.
+ *
+ * The frames are written one after another in order of percentage after the
+ * index, and the file is written to a temporary file first and then renamed,
+ * so readers never map a partially written pack. Returns `false` if it
+ * couldn't be saved.
+ */
+bool writeFramePack(std::span<const PackedFrame> frames,
+                    const std::optional<FramePack> &existingPack,
+                    const std::filesystem::path &path);
+
+} // namespace dynamic_paper
@@ -0,0 +1,154 @@
+#include "hash.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+constexpr std::uint64_t PRIME_1 = 11400714785074694791ULL;
+constexpr std::uint64_t PRIME_2 = 14029467366897019727ULL;
+constexpr std::uint64_t PRIME_3 = 1609587929392839161ULL;
+constexpr std::uint64_t PRIME_4 = 9650029242287828579ULL;
+constexpr std::uint64_t PRIME_5 = 2870177450012600261ULL;
+
+/** Reads an unsigned integer stored little endian, as XXH64 defines */
+template <typename T> T readLittleEndian(const std::byte *data) {
+  T value = 0;
+  std::memcpy(&value, data, sizeof(T));
+  if constexpr (std::endian::native == std::endian::big) {
+    value = std::byteswap(value);
+  }
+  return value;
+}
+
+std::uint64_t round(std::uint64_t accumulator, const std::uint64_t input) {
+  accumulator += input * PRIME_2;
+  accumulator = std::rotl(accumulator, 31);
+  return accumulator * PRIME_1;
+}
+
+std::uint64_t mergeRound(std::uint64_t accumulator, const std::uint64_t value) {
+  accumulator ^= round(0, value);
+  return (accumulator * PRIME_1) + PRIME_4;
+}
+
+} // namespace
+
+// ===== Header ===============
+
+XXHash64::XXHash64(const std::uint64_t seed)
+    : seed(seed), accumulators({seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed,
+                                seed - PRIME_1}) {}
+
+void XXHash64::update(std::span<const std::byte> data) {
+  totalLength += data.size();
+
+  if (bufferedBytes > 0) {
+    const std::size_t toCopy =
+        std::min(data.size(), STRIPE_SIZE - bufferedBytes);
+    std::ranges::copy(data.first(toCopy), buffer.begin() + bufferedBytes);
+    bufferedBytes += toCopy;
+    data = data.subspan(toCopy);
+
+    if (bufferedBytes < STRIPE_SIZE) {
+      return;
+    }
+    for (std::size_t lane = 0; lane < accumulators.size(); lane++) {
+      accumulators[lane] = round(
+          accumulators[lane],
+          readLittleEndian<std::uint64_t>(&buffer[lane * sizeof(std::uint64_t)]));
+    }
+    bufferedBytes = 0;
+  }
+
+  while (data.size() >= STRIPE_SIZE) {
+    for (std::size_t lane = 0; lane < accumulators.size(); lane++) {
+      accumulators[lane] = round(
+          accumulators[lane],
+          readLittleEndian<std::uint64_t>(&data[lane * sizeof(std::uint64_t)]));
+    }
+    data = data.subspan(STRIPE_SIZE);
+  }
+
+  std::ranges::copy(data, buffer.begin());
+  bufferedBytes = data.size();
+}
+
+void XXHash64::update(const std::string_view data) {
+  update(std::as_bytes(std::span(data.data(), data.size())));
+}
+
+std::uint64_t XXHash64::digest() const {
+  std::uint64_t hash = 0;
+  if (totalLength >= STRIPE_SIZE) {
+    hash = std::rotl(accumulators[0], 1) + std::rotl(accumulators[1], 7) +
+           std::rotl(accumulators[2], 12) + std::rotl(accumulators[3], 18);
+    for (const std::uint64_t accumulator : accumulators) {
+      hash = mergeRound(hash, accumulator);
+    }
+  } else {
+    hash = seed + PRIME_5;
+  }
+  hash += totalLength;
+
+  std::size_t index = 0;
+  for (; index + sizeof(std::uint64_t) <= bufferedBytes;
+       index += sizeof(std::uint64_t)) {
+    hash ^= round(0, readLittleEndian<std::uint64_t>(&buffer[index]));
+    hash = (std::rotl(hash, 27) * PRIME_1) + PRIME_4;
+  }
+  if (index + sizeof(std::uint32_t) <= bufferedBytes) {
+    hash ^= static_cast<std::uint64_t>(
+                readLittleEndian<std::uint32_t>(&buffer[index])) *
+            PRIME_1;
+    hash = (std::rotl(hash, 23) * PRIME_2) + PRIME_3;
+    index += sizeof(std::uint32_t);
+  }
+  for (; index < bufferedBytes; index++) {
+    hash ^= static_cast<std::uint64_t>(buffer[index]) * PRIME_5;
+    hash = std::rotl(hash, 11) * PRIME_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME_2;
+  hash ^= hash >> 29;
+  hash *= PRIME_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+std::uint64_t xxHash64(const std::string_view data, const std::uint64_t seed) {
+  XXHash64 hasher(seed);
+  hasher.update(data);
+  return hasher.digest();
+}
+
+std::optional<std::uint64_t> xxHash64File(const std::filesystem::path &path) {
+  constexpr std::size_t READ_SIZE = 1 << 20;
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+
+  XXHash64 hasher;
+  std::vector<char> buffer(READ_SIZE);
+  while (file) {
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    hasher.update(std::string_view(buffer.data(),
+                                   static_cast<std::size_t>(file.gcount())));
+  }
+  if (file.bad()) {
+    return std::nullopt;
+  }
+  return hasher.digest();
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,48 @@
+#pragma once
+
+/** Fast non cryptographic hashing, stable between runs and machines so hashes
+ * can be saved to disk */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace dynamic_paper {
+
+/**
+ * Computes the 64 bit xxHash (XXH64) of data given in any number of pieces.
+ * Hashing the pieces one after another gives the same result as hashing them
+ * joined together.
+ */
+class XXHash64 {
+public:
+  explicit XXHash64(std::uint64_t seed = 0);
+
+  void update(std::span<const std::byte> data);
+  void update(std::string_view data);
+
+  /** Hash of everything given to `update` so far */
+  [[nodiscard]] std::uint64_t digest() const;
+
+private:
+  static constexpr std::size_t STRIPE_SIZE = 32;
+
+  std::uint64_t seed;
+  std::array<std::uint64_t, 4> accumulators;
+  std::array<std::byte, STRIPE_SIZE> buffer{};
+  std::size_t bufferedBytes = 0;
+  std::uint64_t totalLength = 0;
+};
+
+/** Returns the XXH64 hash of `data` */
+std::uint64_t xxHash64(std::string_view data, std::uint64_t seed = 0);
+
+/** Returns the XXH64 hash of the content of the file at `path`, or `nullopt`
+ * if it can't be read */
+std::optional<std::uint64_t> xxHash64File(const std::filesystem::path &path);
+
+} // namespace dynamic_paper
@@ -0,0 +1,183 @@
+#include "image_cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+/** Deletes the image `fileName` in `cacheDirectory`, adding it to `removed` if
+ * successful */
+void removeCacheImage(const std::filesystem::path &cacheDirectory,
+                      const std::string &fileName, const ByteSize size,
+                      CacheContents &removed) {
+  const std::filesystem::path imagePath = cacheDirectory / fileName;
+
+  std::error_code error;
+  if (std::filesystem::remove(imagePath, error)) {
+    removed.numberImages++;
+    removed.size.bytes += size.bytes;
+  } else if (error) {
+    logWarning("Unable to remove cached image {}: {}", imagePath.string(),
+               error.message());
+  }
+}
+
+} // namespace
+
+// ===== Header ===============
+
+double CacheStatistics::hitRate() const {
+  const std::uint64_t lookups = hits + misses;
+  if (lookups == 0) {
+    return 0;
+  }
+  return static_cast<double>(hits) / static_cast<double>(lookups);
+}
+
+CacheContents getCacheContents(const std::filesystem::path &cacheDirectory) {
+  CacheManifest &manifest = sharedCacheManifest(cacheDirectory);
+  manifest.refresh();
+  return {.numberImages = manifest.numberImages(),
+          .size = manifest.totalSize()};
+}
+
+CacheContents evictLeastRecentlyUsed(const std::filesystem::path &cacheDirectory,
+                                     const ByteSize maxSize) {
+  CacheManifest &manifest = sharedCacheManifest(cacheDirectory);
+  manifest.refresh();
+  CacheContents evicted;
+  if (manifest.totalSize() <= maxSize) {
+    return evicted;
+  }
+
+  manifest.update([&](CacheManifest::Entries &entries) {
+    std::vector<CacheManifestEntry> images;
+    images.reserve(entries.size());
+    ByteSize totalSize;
+    for (const auto &[fileName, entry] : entries) {
+      images.push_back(entry);
+      totalSize.bytes += entry.size.bytes;
+    }
+
+    std::ranges::sort(images, {}, &CacheManifestEntry::lastUsed);
+    for (const CacheManifestEntry &image : images) {
+      if (totalSize.bytes - evicted.size.bytes <= maxSize.bytes) {
+        break;
+      }
+      removeCacheImage(cacheDirectory, image.fileName, image.size, evicted);
+      entries.erase(image.fileName);
+    }
+  });
+
+  if (evicted.numberImages > 0) {
+    logInfo("Evicted {} images ({}) from the cache to keep it under {}",
+            evicted.numberImages, byteSizeString(evicted.size),
+            byteSizeString(maxSize));
+  }
+  return evicted;
+}
+
+CacheContents
+removeCacheImagesExcept(const std::filesystem::path &cacheDirectory,
+                        const std::unordered_set<std::string> &imagesToKeep) {
+  CacheContents removed;
+
+  sharedCacheManifest(cacheDirectory)
+      .update([&](CacheManifest::Entries &entries) {
+        std::erase_if(entries, [&](const auto &fileNameAndEntry) {
+          const auto &[fileName, entry] = fileNameAndEntry;
+          if (imagesToKeep.contains(fileName)) {
+            return false;
+          }
+          // Files not made by the cache, listed by an older manifest, are
+          // only forgotten
+          if (isCacheImageFileName(fileName)) {
+            removeCacheImage(cacheDirectory, fileName, entry.size, removed);
+          }
+          return true;
+        });
+
+        // Images the manifest doesn't know about, such as ones left by a
+        // process that stopped before adding them. Recent ones may be from a
+        // transition that is added once all of its images are written
+        const std::filesystem::file_time_type writtenBefore =
+            std::filesystem::file_time_type::clock::now() -
+            UNLISTED_IMAGE_GRACE_PERIOD;
+        std::error_code error;
+        for (const std::filesystem::directory_entry &directoryEntry :
+             std::filesystem::directory_iterator(cacheDirectory, error)) {
+          const std::string fileName =
+              directoryEntry.path().filename().string();
+          if (!isCacheImageFileName(fileName) ||
+              imagesToKeep.contains(fileName) || entries.contains(fileName)) {
+            continue;
+          }
+
+          std::error_code sizeError;
+          std::error_code timeError;
+          const std::uintmax_t size = directoryEntry.file_size(sizeError);
+          const std::filesystem::file_time_type writeTime =
+              directoryEntry.last_write_time(timeError);
+          if (!sizeError && !timeError && writeTime < writtenBefore) {
+            removeCacheImage(cacheDirectory, fileName, {size}, removed);
+          }
+        }
+      });
+
+  return removed;
+}
+
+CacheStatistics
+readCacheStatistics(const std::filesystem::path &cacheDirectory) {
+  CacheStatistics statistics;
+
+  std::ifstream file(cacheDirectory / CACHE_STATISTICS_FILE_NAME);
+  if (!(file >> statistics.hits >> statistics.misses)) {
+    return {};
+  }
+  return statistics;
+}
+
+void recordCacheStatistics(const std::filesystem::path &cacheDirectory,
+                           const CacheStatistics &statistics) {
+  if (statistics.hits == 0 && statistics.misses == 0) {
+    return;
+  }
+
+  // Other processes add their statistics between the read and the write
+  const CacheDirectoryLock directoryLock(cacheDirectory);
+  CacheStatistics total = readCacheStatistics(cacheDirectory);
+  total.hits += statistics.hits;
+  total.misses += statistics.misses;
+
+  const std::filesystem::path statisticsPath =
+      cacheDirectory / CACHE_STATISTICS_FILE_NAME;
+  const std::filesystem::path partialPath = partialPathFor(statisticsPath);
+  {
+    std::ofstream file(partialPath, std::ios::trunc);
+    file << total.hits << ' ' << total.misses << '\n';
+    if (!file) {
+      logWarning("Unable to save cache statistics to {}",
+                 statisticsPath.string());
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(partialPath, statisticsPath, error);
+  if (error) {
+    logWarning("Unable to save cache statistics to {}: {}",
+               statisticsPath.string(), error.message());
+  }
+}
+
+} // namespace dynamic_paper
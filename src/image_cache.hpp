@@ -0,0 +1,74 @@
+#pragma once
+
+/**
+ * Management of the directory that composite images are cached in: keeping it
+ * under a size limit, removing images that are no longer used, and tracking
+ * how often images are found in it.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+
+#include "byte_size.hpp"
+#include "cache_manifest.hpp"
+
+namespace dynamic_paper {
+
+/** Name of the file in the cache directory that stores `CacheStatistics` */
+constexpr std::string_view CACHE_STATISTICS_FILE_NAME =
+    ".dynamic_paper_cache_stats";
+
+/** Images missing from the manifest that were written more recently than this
+ * are kept by `removeCacheImagesExcept`, since the transition they are part of
+ * may still be being composited */
+constexpr std::chrono::minutes UNLISTED_IMAGE_GRACE_PERIOD(5);
+
+/** How often images needed for a transition were already in the cache */
+struct CacheStatistics {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+
+  /** Fraction of lookups that were hits in the range [0..1], or 0 if there
+   * were no lookups */
+  [[nodiscard]] double hitRate() const;
+};
+
+/** Number of images, and how much space they take up */
+struct CacheContents {
+  std::size_t numberImages = 0;
+  ByteSize size;
+};
+
+/** Returns how many images are in `cacheDirectory` and their total size,
+ * according to its `CacheManifest` */
+CacheContents getCacheContents(const std::filesystem::path &cacheDirectory);
+
+/**
+ * Deletes the least recently used images in `cacheDirectory` until the images
+ * left take up at most `maxSize`, removing them from its `CacheManifest`.
+ * Returns what was deleted.
+ */
+CacheContents evictLeastRecentlyUsed(const std::filesystem::path &cacheDirectory,
+                                     ByteSize maxSize);
+
+/**
+ * Deletes every image in `cacheDirectory` whose file name is not in
+ * `imagesToKeep`, including images missing from its `CacheManifest` that are
+ * older than `UNLISTED_IMAGE_GRACE_PERIOD`. Only files named like cache
+ * images are deleted. Returns what was deleted.
+ */
+CacheContents
+removeCacheImagesExcept(const std::filesystem::path &cacheDirectory,
+                        const std::unordered_set<std::string> &imagesToKeep);
+
+/** Reads the statistics saved in `cacheDirectory` */
+CacheStatistics readCacheStatistics(const std::filesystem::path &cacheDirectory);
+
+/** Adds `statistics` to the statistics saved in `cacheDirectory` */
+void recordCacheStatistics(const std::filesystem::path &cacheDirectory,
+                           const CacheStatistics &statistics);
+
+} // namespace dynamic_paper
@@ -1,9 +1,16 @@
 #include "image_compositor.hpp"
 
-#include "file_util.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+
+#include <unistd.h>
+
 #include "format.hpp"
 #include "logger.hpp"
-#include "magick_compositor.hpp"
+#include "time_util.hpp"
+#include "transition_session.hpp"
 
 namespace dynamic_paper {
 
@@ -42,32 +49,17 @@ std::string getExtension(const std::string &startName,
   return startPath.extension();
 }
 
-tl::expected<std::filesystem::path, CompositeImageError>
-createCompositeImage(const std::filesystem::path &startImagePath,
-                     const std::filesystem::path &endImagePath,
-                     const std::filesystem::path &destinationImagePath,
-                     const unsigned int percentage) {
-  if (!std::filesystem::exists(startImagePath)) {
-    logWarning(
-        "Trying to make a composite image using {} but it doesn't exist!",
-        startImagePath.string());
-    return tl::unexpected(CompositeImageError::FileDoesntExist);
-  }
-
-  if (!std::filesystem::exists(endImagePath)) {
-    logWarning(
-        "Trying to make a composite image using {} but it doesn't exist!",
-        endImagePath.string());
-    return tl::unexpected(CompositeImageError::FileDoesntExist);
-  }
-  if (std::filesystem::exists(destinationImagePath)) {
-    logWarning("Creating a new composite image that already exists in cache!");
-  }
-
-  compositeUsingImageMagick(startImagePath, endImagePath, destinationImagePath,
-                            percentage);
+bool isWritableDirectory(const char *path) {
+  std::error_code error;
+  return path != nullptr && std::filesystem::is_directory(path, error) &&
+         access(path, W_OK) == 0;
+}
 
-  return destinationImagePath;
+/** Buffer the next in place frame is written to. Shared by every session so
+ * consecutive transitions keep alternating */
+unsigned int nextInPlaceBuffer() {
+  static std::atomic<unsigned int> framesWritten = 0;
+  return framesWritten++ % IN_PLACE_BUFFERS;
 }
 
 } // namespace
@@ -79,14 +71,16 @@ pathForCompositeImage(const std::filesystem::path &commonImageDirectory,
                       const std::string &startImageName,
                       const std::string &endImageName,
                       const unsigned int percentage,
-                      const std::filesystem::path &cacheDirectory) {
+                      const std::filesystem::path &cacheDirectory,
+                      const TransitionFrameFormat frameFormat) {
   const std::optional<std::string> optDirName = basename(commonImageDirectory);
   if (!optDirName.has_value()) {
     return tl::unexpected(CompositeImageError::UnableToCreatePath);
   }
 
   const std::string &dirName = optDirName.value();
-  const std::string extension = getExtension(startImageName, endImageName);
+  const std::string extension = transitionFrameExtension(
+      frameFormat, getExtension(startImageName, endImageName));
 
   if (!filesHaveSameExtension(startImageName, endImageName)) {
     logWarning("{} and {} are not the same type of image!", startImageName,
@@ -107,12 +101,169 @@ pathForCompositeImage(const std::filesystem::path &commonImageDirectory,
   return cacheDirectory / compositeName;
 }
 
+std::filesystem::path inPlaceFrameDirectory() {
+  static const std::filesystem::path directory = []() {
+    const std::array<const char *, 2> candidates = {
+        "/dev/shm", std::getenv("XDG_RUNTIME_DIR")};
+    for (const char *candidate : candidates) {
+      if (isWritableDirectory(candidate)) {
+        return std::filesystem::path(candidate);
+      }
+    }
+    return std::filesystem::temp_directory_path();
+  }();
+  return directory;
+}
+
+std::filesystem::path inPlaceFramePath(const std::string &startImageName,
+                                       const std::string &endImageName,
+                                       const unsigned int buffer,
+                                       const TransitionFrameFormat frameFormat) {
+  // Includes the user, as `/dev/shm` is shared by every user
+  return inPlaceFrameDirectory() /
+         dynamic_paper::format(
+             "{}-{}-{}{}", IN_PLACE_FILE_NAME, getuid(), buffer,
+             transitionFrameExtension(
+                 frameFormat, getExtension(startImageName, endImageName)));
+}
+
+tl::expected<TransitionCacheKey, CompositeImageError>
+cacheKeyForTransition(const std::filesystem::path &commonImageDirectory,
+                      const std::string &startImageName,
+                      const std::string &endImageName,
+                      const std::filesystem::path &cacheDirectory,
+                      const std::optional<DisplayFit> &fit,
+                      const TransitionFrameFormat frameFormat) {
+  std::optional<TransitionCacheKey> key = transitionCacheKey(
+      commonImageDirectory / startImageName,
+      commonImageDirectory / endImageName,
+      transitionFrameExtension(frameFormat,
+                               getExtension(startImageName, endImageName)),
+      cacheDirectory,
+      fit.has_value() ? fit->cacheTag() : "");
+  if (!key.has_value()) {
+    logWarning("Trying to make a composite image using {} and {} but one "
+               "can't be read!",
+               startImageName, endImageName);
+    return tl::unexpected(CompositeImageError::FileDoesntExist);
+  }
+  return std::move(key.value());
+}
+
+// ===== Session ===============
+
+ImageCompositor::Session::Session(std::filesystem::path commonImageDirectory,
+                                  std::string startImageName,
+                                  std::string endImageName,
+                                  std::filesystem::path cacheDirectory,
+                                  std::optional<DisplayFit> fit,
+                                  const bool cacheDecodedSources,
+                                  const TransitionFrameFormat frameFormat,
+                                  const bool packFrames)
+    : commonImageDirectory(std::move(commonImageDirectory)),
+      startImageName(std::move(startImageName)),
+      endImageName(std::move(endImageName)),
+      cacheDirectory(std::move(cacheDirectory)), fit(std::move(fit)),
+      decodedSourceDirectory(
+          cacheDecodedSources
+              ? std::make_optional(this->cacheDirectory)
+              : std::nullopt),
+      frameFormat(frameFormat), packFrames(packFrames),
+      transitionSession(std::make_shared<TransitionSession>(
+          this->commonImageDirectory / this->startImageName,
+          this->commonImageDirectory / this->endImageName, this->fit,
+          decodedSourceDirectory)),
+      manifest(sharedCacheManifest(this->cacheDirectory)) {
+  // Other processes may have added images since the manifest was last used
+  manifest.refresh();
+}
+
+ImageCompositor::Session::~Session() {
+  try {
+    manifest.markUsed(usedImages);
+    recordCacheStatistics(cacheDirectory, statistics);
+  } catch (const std::exception &e) {
+    logWarning("Unable to save cache statistics: {}", e.what());
+  }
+}
+
+tl::expected<void, CompositeImageError>
+ImageCompositor::Session::prepareCompositedImages(
+    const std::vector<unsigned int> &percentages, ThreadPool &threadPool,
+    const std::stop_token &stopToken) {
+  using CompositeResult =
+      tl::expected<std::filesystem::path, CompositeImageError>;
+  std::vector<std::future<CompositeResult>> pendingImages;
+  transitionPercentages = percentages;
+
+  const tl::expected<TransitionCacheKey, CompositeImageError> &key =
+      getCacheKey();
+  if (!key.has_value()) {
+    return tl::unexpected(key.error());
+  }
+  if (packFrames) {
+    return preparePackedImages(key.value(), percentages, threadPool,
+                               stopToken);
+  }
+
+  const std::chrono::milliseconds prepareTime = timeToRunCodeBlock([&]() {
+    for (const unsigned int percentage : percentages) {
+      if (percentage == EMPTY_PERCENT || percentage >= MAX_PERCENT) {
+        continue;
+      }
+
+      const std::string fileName = key->imageFileName(percentage);
+      if (manifest.contains(fileName)) {
+        continue;
+      }
+
+      preparedPercentages.insert(percentage);
+      compositedImages++;
+      pendingImages.push_back(threadPool.submit(
+          [session = transitionSession,
+           cachedPercentage = key->cachedPercentage(percentage),
+           path = cacheDirectory / fileName, format = frameFormat,
+           stopToken]() -> CompositeResult {
+            if (stopToken.stop_requested()) {
+              return tl::unexpected(CompositeImageError::Stopped);
+            }
+            return session->writeFrame(cachedPercentage, path, format);
+          }));
+    }
+
+    for (const std::future<CompositeResult> &pendingImage : pendingImages) {
+      pendingImage.wait();
+    }
+  });
+
+  logDebug("Prepared {} composite images of {} -> {} in {}",
+           pendingImages.size(), startImageName, endImageName, prepareTime);
+
+  std::vector<CacheManifestEntry> newEntries;
+  std::optional<CompositeImageError> firstError = std::nullopt;
+  for (std::future<CompositeResult> &pendingImage : pendingImages) {
+    const CompositeResult result = pendingImage.get();
+    if (!result.has_value()) {
+      firstError = firstError.value_or(result.error());
+      continue;
+    }
+
+    std::optional<CacheManifestEntry> entry =
+        newCacheManifestEntry(result.value());
+    if (entry.has_value()) {
+      newEntries.push_back(std::move(entry.value()));
+    }
+  }
+  manifest.add(newEntries);
+
+  if (firstError.has_value()) {
+    return tl::unexpected(firstError.value());
+  }
+  return {};
+}
+
 tl::expected<std::filesystem::path, CompositeImageError>
-ImageCompositor::getCompositedImage(
-    const std::filesystem::path &commonImageDirectory,
-    const std::string &startImageName, const std::string &endImageName,
-    const std::filesystem::path &cacheDirectory,
-    const unsigned int percentage) {
+ImageCompositor::Session::getCompositedImage(const unsigned int percentage) {
   logAssert(percentage <= MAX_PERCENT,
             "percentage must be in range [0..{}] but was {}", MAX_PERCENT,
             percentage);
@@ -124,29 +275,233 @@ ImageCompositor::getCompositedImage(
     return commonImageDirectory / endImageName;
   }
 
+  const tl::expected<TransitionCacheKey, CompositeImageError> &key =
+      getCacheKey();
+  if (!key.has_value()) {
+    return tl::unexpected(key.error());
+  }
+  if (packFrames) {
+    return getPackedImage(key.value(), percentage);
+  }
+
+  const std::string fileName = key->imageFileName(percentage);
+  const std::filesystem::path compositeImagePath = cacheDirectory / fileName;
+  if (manifest.contains(fileName)) {
+    if (preparedPercentages.contains(percentage)) {
+      statistics.misses++;
+    } else {
+      statistics.hits++;
+      usedImages.push_back(fileName);
+    }
+    return compositeImagePath;
+  }
+
+  statistics.misses++;
+  compositedImages++;
   const tl::expected<std::filesystem::path, CompositeImageError>
-      compositeImagePath =
-          pathForCompositeImage(commonImageDirectory, startImageName,
-                                endImageName, percentage, cacheDirectory);
+      createdImagePath = transitionSession->writeFrame(
+          key->cachedPercentage(percentage), compositeImagePath, frameFormat);
+  if (createdImagePath.has_value()) {
+    const std::optional<CacheManifestEntry> entry =
+        newCacheManifestEntry(createdImagePath.value());
+    if (entry.has_value()) {
+      manifest.add(std::span(&entry.value(), 1));
+    }
+  }
+  return createdImagePath;
+}
+
+tl::expected<void, CompositeImageError>
+ImageCompositor::Session::prepareCompositedFrames() {
+  return transitionSession->decodeSources();
+}
+
+tl::expected<RGBImage, CompositeImageError>
+ImageCompositor::Session::getCompositedFrame(const unsigned int percentage) {
+  logAssert(percentage <= MAX_PERCENT,
+            "percentage must be in range [0..{}] but was {}", MAX_PERCENT,
+            percentage);
+
+  // `transitionSession` goes the other way if a cached image was looked up
+  const bool reversed = cacheKey.has_value() && cacheKey->has_value() &&
+                        cacheKey->value().reversed;
+  compositedImages++;
+  return transitionSession->getFrame(reversed ? MAX_PERCENT - percentage
+                                              : percentage);
+}
+
+std::size_t ImageCompositor::Session::numberCompositedImages() const {
+  return compositedImages;
+}
+
+const tl::expected<TransitionCacheKey, CompositeImageError> &
+ImageCompositor::Session::getCacheKey() {
+  if (!cacheKey.has_value()) {
+    cacheKey = cacheKeyForTransition(commonImageDirectory, startImageName,
+                                     endImageName, cacheDirectory, fit,
+                                     frameFormat);
+
+    // Makes the cached images the same whichever direction creates them, as
+    // the end image is resized to the start image
+    if (cacheKey->has_value() && cacheKey->value().reversed) {
+      transitionSession = std::make_shared<TransitionSession>(
+          commonImageDirectory / endImageName,
+          commonImageDirectory / startImageName, fit, decodedSourceDirectory);
+    }
+  }
+  return cacheKey.value();
+}
+
+tl::expected<void, CompositeImageError>
+ImageCompositor::Session::preparePackedImages(
+    const TransitionCacheKey &key, const std::vector<unsigned int> &percentages,
+    ThreadPool &threadPool, const std::stop_token &stopToken) {
+  using EncodeResult = tl::expected<std::vector<std::uint8_t>, CompositeImageError>;
+
+  const std::string packName = key.packFileName();
+  const std::filesystem::path packPath = cacheDirectory / packName;
+  if (!framePack.has_value() && manifest.contains(packName)) {
+    framePack = FramePack::map(packPath);
+  }
+
+  std::vector<unsigned int> missingPercentages;
+  std::vector<std::future<EncodeResult>> pendingFrames;
+  const std::chrono::milliseconds prepareTime = timeToRunCodeBlock([&]() {
+    for (const unsigned int percentage : percentages) {
+      if (percentage == EMPTY_PERCENT || percentage >= MAX_PERCENT) {
+        continue;
+      }
+
+      const unsigned int cachedPercentage = key.cachedPercentage(percentage);
+      if ((framePack.has_value() && framePack->contains(cachedPercentage)) ||
+          std::ranges::find(missingPercentages, cachedPercentage) !=
+              missingPercentages.end()) {
+        continue;
+      }
+
+      preparedPercentages.insert(percentage);
+      missingPercentages.push_back(cachedPercentage);
+      compositedImages++;
+      pendingFrames.push_back(threadPool.submit(
+          [session = transitionSession, cachedPercentage,
+           extension = key.extension, format = frameFormat,
+           stopToken]() -> EncodeResult {
+            if (stopToken.stop_requested()) {
+              return tl::unexpected(CompositeImageError::Stopped);
+            }
+            return session->encodeFrame(cachedPercentage, extension, format);
+          }));
+    }
+
+    for (const std::future<EncodeResult> &pendingFrame : pendingFrames) {
+      pendingFrame.wait();
+    }
+  });
+
+  if (pendingFrames.empty()) {
+    return {};
+  }
+  logDebug("Prepared {} packed images of {} -> {} in {}", pendingFrames.size(),
+           startImageName, endImageName, prepareTime);
+
+  std::vector<PackedFrame> frames;
+  std::optional<CompositeImageError> firstError = std::nullopt;
+  for (std::size_t i = 0; i < pendingFrames.size(); i++) {
+    EncodeResult result = pendingFrames.at(i).get();
+    if (!result.has_value()) {
+      firstError = firstError.value_or(result.error());
+      continue;
+    }
+    frames.push_back({.percentage = missingPercentages.at(i),
+                      .data = std::move(result.value())});
+  }
+
+  // Merged with the newest pack while holding the lock, so frames another
+  // process adds to it at the same time are not lost
+  bool packWritten = false;
+  if (!frames.empty()) {
+    const CacheDirectoryLock directoryLock(cacheDirectory);
+    packWritten = writeFramePack(frames, FramePack::map(packPath), packPath);
+  }
+  if (packWritten) {
+    framePack = FramePack::map(packPath);
+    const std::optional<CacheManifestEntry> entry =
+        newCacheManifestEntry(packPath);
+    if (entry.has_value()) {
+      manifest.add(std::span(&entry.value(), 1));
+    }
+  }
+
+  if (firstError.has_value()) {
+    return tl::unexpected(firstError.value());
+  }
+  if (!framePack.has_value()) {
+    return tl::unexpected(CompositeImageError::UnableToCreatePath);
+  }
+  return {};
+}
 
-  if (!compositeImagePath.has_value()) {
-    return tl::unexpected(compositeImagePath.error());
+tl::expected<std::filesystem::path, CompositeImageError>
+ImageCompositor::Session::getPackedImage(const TransitionCacheKey &key,
+                                         const unsigned int percentage) {
+  const std::string packName = key.packFileName();
+  if (!framePack.has_value() && manifest.contains(packName)) {
+    framePack = FramePack::map(cacheDirectory / packName);
   }
 
-  if (std::filesystem::exists(compositeImagePath.value())) {
-    return compositeImagePath.value();
+  const unsigned int cachedPercentage = key.cachedPercentage(percentage);
+  if (framePack.has_value() && framePack->contains(cachedPercentage)) {
+    if (preparedPercentages.contains(percentage)) {
+      statistics.misses++;
+    } else {
+      statistics.hits++;
+      usedImages.push_back(packName);
+    }
+  } else {
+    statistics.misses++;
+    // The other images of the transition are likely missing too, so they are
+    // all added to the pack in one write instead of one write per image
+    std::vector<unsigned int> missingPercentages = transitionPercentages;
+    missingPercentages.push_back(percentage);
+    const tl::expected<void, CompositeImageError> result = preparePackedImages(
+        key, missingPercentages, compositingThreadPool());
+    if (!result.has_value()) {
+      return tl::unexpected(result.error());
+    }
   }
 
-  return createCompositeImage(commonImageDirectory / startImageName,
-                              commonImageDirectory / endImageName,
-                              compositeImagePath.value(), percentage);
+  // Setters read files, so the frame is copied out of the pack to memory
+  const std::filesystem::path framePath = inPlaceFramePath(
+      startImageName, endImageName, nextInPlaceBuffer(), frameFormat);
+  if (!framePack->extractFrame(cachedPercentage, framePath)) {
+    return tl::unexpected(CompositeImageError::UnableToCreatePath);
+  }
+  return framePath;
+}
+
+ImageCompositorInPlace::Session::Session(
+    std::filesystem::path commonImageDirectory, std::string startImageName,
+    std::string endImageName,
+    const std::filesystem::path &cacheDirectory,
+    const std::optional<DisplayFit> &fit, const bool cacheDecodedSources,
+    const TransitionFrameFormat frameFormat, const bool /*packFrames*/)
+    : commonImageDirectory(std::move(commonImageDirectory)),
+      startImageName(std::move(startImageName)),
+      endImageName(std::move(endImageName)), frameFormat(frameFormat),
+      transitionSession(std::make_shared<TransitionSession>(
+          this->commonImageDirectory / this->startImageName,
+          this->commonImageDirectory / this->endImageName, fit,
+          cacheDecodedSources ? std::make_optional(cacheDirectory)
+                              : std::nullopt)) {}
+
+tl::expected<void, CompositeImageError>
+ImageCompositorInPlace::Session::prepareCompositedImages(
+    const std::vector<unsigned int> & /*percentages*/) {
+  return transitionSession->decodeSources();
 }
 
 tl::expected<std::filesystem::path, CompositeImageError>
-ImageCompositorInPlace::getCompositedImage(
-    const std::filesystem::path &commonImageDirectory,
-    const std::string &startImageName, const std::string &endImageName,
-    const std::filesystem::path &cacheDirectory, // NOLINT
+ImageCompositorInPlace::Session::getCompositedImage(
     const unsigned int percentage) {
   if (percentage == EMPTY_PERCENT) {
     return commonImageDirectory / startImageName;
@@ -155,19 +510,28 @@ ImageCompositorInPlace::getCompositedImage(
     return commonImageDirectory / endImageName;
   }
 
-  const std::string compositeExtension =
-      getExtension(startImageName, endImageName);
-  const std::string compositeFileName =
-      dynamic_paper::format("{}{}", IN_PLACE_FILE_NAME, compositeExtension);
+  compositedImages++;
+  return transitionSession->writeFrame(
+      percentage,
+      inPlaceFramePath(startImageName, endImageName, nextInPlaceBuffer(),
+                       frameFormat),
+      frameFormat);
+}
 
-  const std::filesystem::path compositeImagePath =
-      std::filesystem::temp_directory_path() / compositeFileName;
+tl::expected<void, CompositeImageError>
+ImageCompositorInPlace::Session::prepareCompositedFrames() {
+  return transitionSession->decodeSources();
+}
 
-  FilesystemHandler::createFileIfDoesntExist(compositeImagePath, "");
+tl::expected<RGBImage, CompositeImageError>
+ImageCompositorInPlace::Session::getCompositedFrame(
+    const unsigned int percentage) {
+  compositedImages++;
+  return transitionSession->getFrame(percentage);
+}
 
-  return createCompositeImage(commonImageDirectory / startImageName,
-                              commonImageDirectory / endImageName,
-                              compositeImagePath, percentage);
+std::size_t ImageCompositorInPlace::Session::numberCompositedImages() const {
+  return compositedImages;
 }
 
 } // namespace dynamic_paper
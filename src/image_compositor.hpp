@@ -2,87 +2,328 @@
 
 /** Logic of creating and caching composited backgrounds */
 
+#include <concepts>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <stop_token>
 #include <string>
+#include <unordered_set>
+#include <vector>
 #include <cstdint>
 
 #include <tl/expected.hpp>
 
+#include "cache_key.hpp"
+#include "display_geometry.hpp"
+#include "frame_pack.hpp"
+#include "image_cache.hpp"
+#include "rgb_image.hpp"
+#include "thread_pool.hpp"
+#include "transition_frame_format.hpp"
+
 namespace dynamic_paper {
 
-enum class CompositeImageError: std::uint8_t { UnableToCreatePath, FileDoesntExist };
+/** `Stopped` is returned for images that were not created because a stop was
+ * requested */
+enum class CompositeImageError: std::uint8_t { UnableToCreatePath, FileDoesntExist, Stopped };
 
 static constexpr std::string_view IN_PLACE_FILE_NAME =
     "dynamic_paper_interpolation_file";
+/** Number of files in place transitions take turns writing to */
+static constexpr unsigned int IN_PLACE_BUFFERS = 2;
 
-/** Returns the path location of where a composited image created from
- * `startImageName` and `endImageName` with a ratio of `percentage` would be.
+/** Returns a readable path for a composited image created from
+ * `startImageName` and `endImageName` with a ratio of `percentage`. Images in
+ * the cache are named with `cacheKeyForTransition` instead, so they don't
+ * depend on the names of the images.
  *
  * The path is formatted:
  * {common image dir basename}-{start img}-{end img}-{percentage}{extension}`
  * Start and End Image is the name without the extension.
  *
- * Extension is decided by the extension of the
- * `startImageName`. If `startImageName` has no extension, will use the
- * `endImageName`. If neither have an extension, will use blank ("").
+ * Extension is decided by `frameFormat`, or for `TransitionFrameFormat::Source`
+ * by the extension of the `startImageName`. If `startImageName` has no
+ * extension, will use the `endImageName`. If neither have an extension, will
+ * use blank ("").
  */
 tl::expected<std::filesystem::path, CompositeImageError>
-pathForCompositeImage(const std::filesystem::path &commonImageDirectory,
+pathForCompositeImage(
+    const std::filesystem::path &commonImageDirectory,
+    const std::string &startImageName, const std::string &endImageName,
+    unsigned int percentage, const std::filesystem::path &cacheDirectory,
+    TransitionFrameFormat frameFormat = TransitionFrameFormat::Source);
+
+/**
+ * Returns the key naming the composited images created from
+ * `commonImageDirectory / startImageName` and `commonImageDirectory /
+ * endImageName` in the cache, which depends on the content of both images and
+ * the size `fit` blends them at.
+ * The extension is decided like in `pathForCompositeImage`.
+ */
+tl::expected<TransitionCacheKey, CompositeImageError>
+cacheKeyForTransition(const std::filesystem::path &commonImageDirectory,
                       const std::string &startImageName,
-                      const std::string &endImageName, unsigned int percentage,
-                      const std::filesystem::path &cacheDirectory);
+                      const std::string &endImageName,
+                      const std::filesystem::path &cacheDirectory,
+                      const std::optional<DisplayFit> &fit = std::nullopt,
+                      TransitionFrameFormat frameFormat =
+                          TransitionFrameFormat::Source);
+
+/**
+ * Returns the directory in place transitions write to. Uses `/dev/shm`, or
+ * `$XDG_RUNTIME_DIR`, when they are writable so frames stay in memory instead
+ * of being written to disk.
+ */
+std::filesystem::path inPlaceFrameDirectory();
+
+/**
+ * Returns the file in place transitions write to for `buffer`, in the range
+ * [0..IN_PLACE_BUFFERS). Formatted:
+ * `{IN_PLACE_FILE_NAME}-{user id}-{buffer}{extension}`
+ *
+ * Extension is decided like in `pathForCompositeImage`.
+ */
+std::filesystem::path inPlaceFramePath(
+    const std::string &startImageName, const std::string &endImageName,
+    unsigned int buffer,
+    TransitionFrameFormat frameFormat = TransitionFrameFormat::Source);
+
+class TransitionSession;
 
 /**
- * Type used to create interpolated images
+ * Type used to create interpolated images.
+ *
+ * `T::Session` creates every image of one transition, so work like decoding
+ * the start and end images can be shared between the steps of the transition.
+ * Images are only looked up through a session, as sessions check the cache
+ * for changes once and save which images were used once, for the whole
+ * transition.
+ * `prepareCompositedImages` is called with every percentage of the transition
+ * before any of them are shown, so the images can be made ahead of time.
+ * Sessions given a `DisplayFit` resample the start and end image to what the
+ * display shows before blending them, and sessions told to cache decoded
+ * sources keep the decoded start and end image in the cache directory. Images
+ * are saved in the `TransitionFrameFormat` sessions are given, and sessions
+ * told to pack frames save the images of a transition in one `FramePack`.
  */
 template <typename T>
 concept GetsCompositeImages =
-    requires(const std::filesystem::path &commonImageDirectory,
-             const std::string &startImageName, const std::string &endImageName,
-             const std::filesystem::path &cacheDirectory,
-             unsigned int percentage) {
+    requires(unsigned int percentage,
+             const std::vector<unsigned int> &percentages,
+             typename T::Session &session) {
       {
-        T::getCompositedImage(commonImageDirectory, startImageName,
-                              endImageName, cacheDirectory, percentage)
+        session.getCompositedImage(percentage)
       } -> std::convertible_to<
             tl::expected<std::filesystem::path, CompositeImageError>>;
+      {
+        session.prepareCompositedImages(percentages)
+      } -> std::convertible_to<tl::expected<void, CompositeImageError>>;
+      requires std::constructible_from<
+          typename T::Session, const std::filesystem::path &,
+          const std::string &, const std::string &,
+          const std::filesystem::path &, const std::optional<DisplayFit> &,
+          bool, TransitionFrameFormat, bool>;
+    };
+
+/**
+ * Type used to create interpolated images that can also give each image of a
+ * transition as a decoded frame, without saving it to a file.
+ * `prepareCompositedFrames` is called before the first frame, so the start
+ * and end images can be decoded ahead of time.
+ */
+template <typename T>
+concept GetsCompositeFrames =
+    GetsCompositeImages<T> &&
+    requires(unsigned int percentage, typename T::Session &session) {
+      {
+        session.getCompositedFrame(percentage)
+      } -> std::convertible_to<tl::expected<RGBImage, CompositeImageError>>;
+      {
+        session.prepareCompositedFrames()
+      } -> std::convertible_to<tl::expected<void, CompositeImageError>>;
     };
 
 /** Contains functions to create composite images */
 class ImageCompositor {
 public:
   /**
-   * Returns the path to an image that is interpolated between
-   * `commonImageDirectory /startImageName` and `commonImageDirectory /
-   * endImageName` by `percentage`%. Uses the library `CImg` to
-   * create the interpolated image
+   * Creates the composite images of one transition from `commonImageDirectory
+   * / startImageName` to `commonImageDirectory / endImageName`. The start and
+   * end image are decoded at most once for the whole session, and only if an
+   * image is not already in the cache.
    *
-   * `percentage` should be in the range [0..100]
+   * Whether an image is cached is looked up in the cache's `CacheManifest`,
+   * without touching the filesystem. Images it creates are added to the
+   * manifest. When destroyed it marks the cached images it returned as used,
+   * and adds how many of them were already in the cache to the cache's
+   * `CacheStatistics`.
+   *
+   * If `cacheDecodedSources` is set, the decoded start and end image are also
+   * kept in the cache, so later transitions between them map them instead of
+   * decoding them.
+   *
+   * If `packFrames` is set, the images are cached together in the
+   * `FramePack` named by `TransitionCacheKey::packFileName`, which is in the
+   * manifest as one image. Images returned from it are copied to an in place
+   * frame file, like `ImageCompositorInPlace` does, for setters that read
+   * files.
    */
-  static tl::expected<std::filesystem::path, CompositeImageError>
-  getCompositedImage(const std::filesystem::path &commonImageDirectory,
-                     const std::string &startImageName,
-                     const std::string &endImageName,
-                     const std::filesystem::path &cacheDirectory,
-                     unsigned int percentage);
+  class Session {
+  public:
+    Session(std::filesystem::path commonImageDirectory,
+            std::string startImageName, std::string endImageName,
+            std::filesystem::path cacheDirectory,
+            std::optional<DisplayFit> fit = std::nullopt,
+            bool cacheDecodedSources = false,
+            TransitionFrameFormat frameFormat = TransitionFrameFormat::Source,
+            bool packFrames = false);
+    ~Session();
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+    Session(Session &&) = delete;
+    Session &operator=(Session &&) = delete;
+
+    /**
+     * Creates every image in `percentages` that is not already in the cache,
+     * in parallel on `threadPool`. Returns once all of them are written, or
+     * once the images being created are written if `stopToken` is stopped.
+     */
+    tl::expected<void, CompositeImageError>
+    prepareCompositedImages(const std::vector<unsigned int> &percentages,
+                            ThreadPool &threadPool = compositingThreadPool(),
+                            const std::stop_token &stopToken = {});
+
+    /**
+     * Returns the path to the image interpolated between the start and end
+     * image by `percentage`%, creating it with the native lerp kernels if it
+     * is not in the cache.
+     *
+     * `percentage` should be in the range [0..100]
+     */
+    tl::expected<std::filesystem::path, CompositeImageError>
+    getCompositedImage(unsigned int percentage);
+
+    /** Decodes the start and end image, without looking in the cache */
+    tl::expected<void, CompositeImageError> prepareCompositedFrames();
+
+    /** Returns the image `percentage`% of the way through the transition.
+     * Frames are not saved to or read from the cache */
+    tl::expected<RGBImage, CompositeImageError>
+    getCompositedFrame(unsigned int percentage);
+
+    /** Number of images the session composited, leaving out images that
+     * were already in the cache */
+    [[nodiscard]] std::size_t numberCompositedImages() const;
+
+  private:
+    std::filesystem::path commonImageDirectory;
+    std::string startImageName;
+    std::string endImageName;
+    std::filesystem::path cacheDirectory;
+    std::optional<DisplayFit> fit;
+    std::optional<std::filesystem::path> decodedSourceDirectory;
+    TransitionFrameFormat frameFormat;
+    bool packFrames;
+
+    const tl::expected<TransitionCacheKey, CompositeImageError> &
+    getCacheKey();
+
+    /** `prepareCompositedImages` for sessions that pack frames. Adds the
+     * missing images to the pack in one write */
+    tl::expected<void, CompositeImageError>
+    preparePackedImages(const TransitionCacheKey &key,
+                        const std::vector<unsigned int> &percentages,
+                        ThreadPool &threadPool,
+                        const std::stop_token &stopToken = {});
+
+    /** `getCompositedImage` for sessions that pack frames. An image missing
+     * from the pack is created along with every other missing image of the
+     * transition */
+    tl::expected<std::filesystem::path, CompositeImageError>
+    getPackedImage(const TransitionCacheKey &key, unsigned int percentage);
+
+    std::shared_ptr<TransitionSession> transitionSession;
+    CacheManifest &manifest;
+    /** Found the first time an image is looked up in the cache, as it reads
+     * the start and end image if they changed. `transitionSession` is swapped
+     * to go in the same direction as the images cached for the key */
+    std::optional<tl::expected<TransitionCacheKey, CompositeImageError>>
+        cacheKey;
+    /** Pack of the cached images, mapped the first time it is needed */
+    std::optional<FramePack> framePack;
+
+    /** Percentages `prepareCompositedImages` was last given, so images of
+     * the transition missing from its pack later are created together */
+    std::vector<unsigned int> transitionPercentages;
+    /** Images that `prepareCompositedImages` had to create */
+    std::unordered_set<unsigned int> preparedPercentages;
+    std::size_t compositedImages = 0;
+    /** File names of images that were already in the cache when returned */
+    std::vector<std::string> usedImages;
+    CacheStatistics statistics;
+  };
 };
 
-/** Contains functions to create copmosite images by overwriting one file in
- * place. */
+/**
+ * Contains functions to create copmosite images by overwriting files in
+ * place, instead of caching them.
+ *
+ * Steps take turns writing to one of `IN_PLACE_BUFFERS` files in
+ * `inPlaceFrameDirectory`, so the background never changes to the path it is
+ * already set to. Each frame is written to a temporary file and renamed over
+ * its buffer, so a setter still reading the previous frame never sees a
+ * partially written one.
+ */
 class ImageCompositorInPlace {
 public:
-  /**
-   * Does the same as `ImageCompositor` but will edit `IN_PLACE_FILE_NAME`
-   * instead of returning unique paths based on the start and end image names.
-   *
-   * `percentage` should be in the range [0..100]
-   */
-  static tl::expected<std::filesystem::path, CompositeImageError>
-  getCompositedImage(const std::filesystem::path &commonImageDirectory,
-                     const std::string &startImageName,
-                     const std::string &endImageName,
-                     const std::filesystem::path &cacheDirectory,
-                     unsigned int percentage);
+  /** Creates the composite images of one transition, decoding the start and
+   * end image at most once. Keeps the decoded images in `cacheDirectory` if
+   * `cacheDecodedSources` is set. Frames are never cached, so `packFrames` is
+   * ignored */
+  class Session {
+  public:
+    Session(std::filesystem::path commonImageDirectory,
+            std::string startImageName, std::string endImageName,
+            const std::filesystem::path &cacheDirectory,
+            const std::optional<DisplayFit> &fit = std::nullopt,
+            bool cacheDecodedSources = false,
+            TransitionFrameFormat frameFormat = TransitionFrameFormat::Source,
+            bool packFrames = false);
+
+    /**
+     * Decodes the start and end image. Every image of an in place transition
+     * is written to the same file, so they can't be created ahead of time.
+     */
+    tl::expected<void, CompositeImageError>
+    prepareCompositedImages(const std::vector<unsigned int> &percentages);
+
+    /** Does the same as `ImageCompositor::Session::getCompositedImage`, but
+     * replaces the next in place frame file instead of caching the image */
+    tl::expected<std::filesystem::path, CompositeImageError>
+    getCompositedImage(unsigned int percentage);
+
+    /** Decodes the start and end image */
+    tl::expected<void, CompositeImageError> prepareCompositedFrames();
+
+    /** Returns the image `percentage`% of the way through the transition,
+     * without writing it to the in place file */
+    tl::expected<RGBImage, CompositeImageError>
+    getCompositedFrame(unsigned int percentage);
+
+    /** Number of images the session composited */
+    [[nodiscard]] std::size_t numberCompositedImages() const;
+
+  private:
+    std::filesystem::path commonImageDirectory;
+    std::string startImageName;
+    std::string endImageName;
+    TransitionFrameFormat frameFormat;
+
+    std::shared_ptr<TransitionSession> transitionSession;
+    std::size_t compositedImages = 0;
+  };
 };
 
 } // namespace dynamic_paper
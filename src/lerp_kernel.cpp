@@ -0,0 +1,237 @@
+#include "lerp_kernel.hpp"
+
+#include <cstddef>
+
+#include "logger.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DYNAMIC_PAPER_LERP_X86
+#include <immintrin.h>
+#endif
+
+namespace dynamic_paper {
+
+namespace {
+
+constexpr unsigned int MAX_PERCENT = 100;
+
+/**
+ * Weights are fixed point values in the range [0..256], so the lerp of each
+ * byte is `(start * (256 - weight) + end * weight + 128) >> 8`. The sum never
+ * exceeds 16 bits, which lets the SIMD kernels work in 16-bit lanes.
+ */
+constexpr std::uint16_t WEIGHT_ONE = 256;
+constexpr std::uint16_t WEIGHT_ROUNDING = 128;
+constexpr int WEIGHT_SHIFT = 8;
+
+constexpr std::uint16_t weightFromPercentage(const unsigned int percentage) {
+  return static_cast<std::uint16_t>(
+      ((percentage * WEIGHT_ONE) + (MAX_PERCENT / 2)) / MAX_PERCENT);
+}
+
+inline std::uint8_t lerpByte(const std::uint8_t start, const std::uint8_t end,
+                             const std::uint16_t endWeight) {
+  const std::uint16_t startWeight = WEIGHT_ONE - endWeight;
+  return static_cast<std::uint8_t>(
+      ((start * startWeight) + (end * endWeight) + WEIGHT_ROUNDING) >>
+      WEIGHT_SHIFT);
+}
+
+void lerpScalar(const std::uint8_t *start, const std::uint8_t *end,
+                std::uint8_t *destination, const std::size_t count,
+                const std::uint16_t endWeight) {
+  for (std::size_t i = 0; i < count; i++) {
+    destination[i] = lerpByte(start[i], end[i], endWeight); // NOLINT
+  }
+}
+
+#ifdef DYNAMIC_PAPER_LERP_X86
+
+// NOLINTBEGIN (intrinsics work on raw pointers)
+
+__attribute__((target("sse4.1"))) inline __m128i
+lerpWordsSSE41(const __m128i start, const __m128i end,
+               const __m128i startWeight, const __m128i endWeight,
+               const __m128i rounding) {
+  const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(start, startWeight),
+                                    _mm_mullo_epi16(end, endWeight));
+  return _mm_srli_epi16(_mm_add_epi16(sum, rounding), WEIGHT_SHIFT);
+}
+
+__attribute__((target("sse4.1"))) void
+lerpSSE41(const std::uint8_t *start, const std::uint8_t *end,
+          std::uint8_t *destination, const std::size_t count,
+          const std::uint16_t endWeight) {
+  constexpr std::size_t WIDTH = 16;
+  constexpr int HALF_WIDTH = 8;
+
+  const __m128i startWeightVec =
+      _mm_set1_epi16(static_cast<short>(WEIGHT_ONE - endWeight));
+  const __m128i endWeightVec = _mm_set1_epi16(static_cast<short>(endWeight));
+  const __m128i roundingVec = _mm_set1_epi16(WEIGHT_ROUNDING);
+
+  std::size_t i = 0;
+  for (; i + WIDTH <= count; i += WIDTH) {
+    const __m128i startBytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(start + i));
+    const __m128i endBytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(end + i));
+
+    const __m128i low = lerpWordsSSE41(
+        _mm_cvtepu8_epi16(startBytes), _mm_cvtepu8_epi16(endBytes),
+        startWeightVec, endWeightVec, roundingVec);
+    const __m128i high =
+        lerpWordsSSE41(_mm_cvtepu8_epi16(_mm_srli_si128(startBytes, HALF_WIDTH)),
+                       _mm_cvtepu8_epi16(_mm_srli_si128(endBytes, HALF_WIDTH)),
+                       startWeightVec, endWeightVec, roundingVec);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i),
+                     _mm_packus_epi16(low, high));
+  }
+
+  lerpScalar(start + i, end + i, destination + i, count - i, endWeight);
+}
+
+__attribute__((target("avx2"))) inline __m128i
+lerpSixteenBytesAVX2(const std::uint8_t *start, const std::uint8_t *end,
+                     const __m256i startWeight, const __m256i endWeight,
+                     const __m256i rounding) {
+  const __m256i startWords = _mm256_cvtepu8_epi16(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(start)));
+  const __m256i endWords = _mm256_cvtepu8_epi16(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(end)));
+
+  const __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(startWords, startWeight),
+                                       _mm256_mullo_epi16(endWords, endWeight));
+  const __m256i words =
+      _mm256_srli_epi16(_mm256_add_epi16(sum, rounding), WEIGHT_SHIFT);
+
+  return _mm_packus_epi16(_mm256_castsi256_si128(words),
+                          _mm256_extracti128_si256(words, 1));
+}
+
+__attribute__((target("avx2"))) void
+lerpAVX2(const std::uint8_t *start, const std::uint8_t *end,
+         std::uint8_t *destination, const std::size_t count,
+         const std::uint16_t endWeight) {
+  constexpr std::size_t WIDTH = 32;
+  constexpr std::size_t HALF_WIDTH = 16;
+
+  const __m256i startWeightVec =
+      _mm256_set1_epi16(static_cast<short>(WEIGHT_ONE - endWeight));
+  const __m256i endWeightVec = _mm256_set1_epi16(static_cast<short>(endWeight));
+  const __m256i roundingVec = _mm256_set1_epi16(WEIGHT_ROUNDING);
+
+  std::size_t i = 0;
+  for (; i + WIDTH <= count; i += WIDTH) {
+    const __m128i low = lerpSixteenBytesAVX2(
+        start + i, end + i, startWeightVec, endWeightVec, roundingVec);
+    const __m128i high =
+        lerpSixteenBytesAVX2(start + i + HALF_WIDTH, end + i + HALF_WIDTH,
+                             startWeightVec, endWeightVec, roundingVec);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), low);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i + HALF_WIDTH),
+                     high);
+  }
+
+  lerpScalar(start + i, end + i, destination + i, count - i, endWeight);
+}
+
+// NOLINTEND
+
+#endif
+
+} // namespace
+
+// ===== Header ===============
+
+bool lerpKernelIsSupported(const LerpKernel kernel) {
+  switch (kernel) {
+  case LerpKernel::Scalar: {
+    return true;
+  }
+  case LerpKernel::SSE41: {
+#ifdef DYNAMIC_PAPER_LERP_X86
+    return __builtin_cpu_supports("sse4.1");
+#else
+    return false;
+#endif
+  }
+  case LerpKernel::AVX2: {
+#ifdef DYNAMIC_PAPER_LERP_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+  }
+  }
+  return false;
+}
+
+LerpKernel bestSupportedLerpKernel() {
+  static const LerpKernel bestKernel = []() {
+    if (lerpKernelIsSupported(LerpKernel::AVX2)) {
+      return LerpKernel::AVX2;
+    }
+    if (lerpKernelIsSupported(LerpKernel::SSE41)) {
+      return LerpKernel::SSE41;
+    }
+    return LerpKernel::Scalar;
+  }();
+  return bestKernel;
+}
+
+void lerpPixels(const std::span<const std::uint8_t> start,
+                const std::span<const std::uint8_t> end,
+                const std::span<std::uint8_t> destination,
+                const unsigned int percentage) {
+  lerpPixelsUsingKernel(bestSupportedLerpKernel(), start, end, destination,
+                        percentage);
+}
+
+void lerpPixelsUsingKernel(const LerpKernel kernel,
+                           const std::span<const std::uint8_t> start,
+                           const std::span<const std::uint8_t> end,
+                           const std::span<std::uint8_t> destination,
+                           const unsigned int percentage) {
+  logAssert(percentage <= MAX_PERCENT,
+            "percentage must be in range [0..{}] but was {}", MAX_PERCENT,
+            percentage);
+  logAssert(start.size() == end.size() && start.size() == destination.size(),
+            "Cannot lerp pixel buffers of different sizes ({}, {}, {})",
+            start.size(), end.size(), destination.size());
+
+  const std::uint16_t endWeight = weightFromPercentage(percentage);
+
+  switch (kernel) {
+  case LerpKernel::Scalar: {
+    lerpScalar(start.data(), end.data(), destination.data(), start.size(),
+               endWeight);
+    return;
+  }
+  case LerpKernel::SSE41: {
+#ifdef DYNAMIC_PAPER_LERP_X86
+    lerpSSE41(start.data(), end.data(), destination.data(), start.size(),
+              endWeight);
+    return;
+#else
+    break;
+#endif
+  }
+  case LerpKernel::AVX2: {
+#ifdef DYNAMIC_PAPER_LERP_X86
+    lerpAVX2(start.data(), end.data(), destination.data(), start.size(),
+             endWeight);
+    return;
+#else
+    break;
+#endif
+  }
+  }
+
+  logAssert(false, "Lerp kernel {} is not available on this platform",
+            lerpKernelString(kernel));
+}
+
+} // namespace dynamic_paper
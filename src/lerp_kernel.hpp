@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+ * Kernels that linearly interpolate between two 8-bit pixel buffers.
+ *
+ * The kernel is chosen at runtime based on what the CPU supports, falling back
+ * to a scalar implementation.
+ */
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace dynamic_paper {
+
+enum class LerpKernel : std::uint8_t { Scalar, SSE41, AVX2 };
+
+constexpr std::string_view lerpKernelString(const LerpKernel kernel) {
+  switch (kernel) {
+  case LerpKernel::Scalar: {
+    return "scalar";
+  }
+  case LerpKernel::SSE41: {
+    return "sse4.1";
+  }
+  case LerpKernel::AVX2: {
+    return "avx2";
+  }
+  }
+  return "unknown";
+}
+
+/** Returns `true` if the CPU running the program can use `kernel` */
+bool lerpKernelIsSupported(LerpKernel kernel);
+
+/** Returns the fastest kernel the CPU running the program can use */
+LerpKernel bestSupportedLerpKernel();
+
+/**
+ * Writes `start * (1 - percentage) + end * percentage` into `destination` for
+ * every byte, using the fastest kernel available.
+ *
+ * `percentage` should be in the range [0..100] and all spans must be the same
+ * size.
+ */
+void lerpPixels(std::span<const std::uint8_t> start,
+                std::span<const std::uint8_t> end,
+                std::span<std::uint8_t> destination, unsigned int percentage);
+
+/**
+ * Does the same as `lerpPixels`, but using `kernel`. `kernel` must be
+ * supported by the CPU.
+ */
+void lerpPixelsUsingKernel(LerpKernel kernel,
+                           std::span<const std::uint8_t> start,
+                           std::span<const std::uint8_t> end,
+                           std::span<std::uint8_t> destination,
+                           unsigned int percentage);
+
+} // namespace dynamic_paper
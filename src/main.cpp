@@ -15,6 +15,8 @@
 #include "background_set_enums.hpp"
 #include "cmdline_helper.hpp"
 #include "config.hpp"
+#include "control_socket.hpp"
+#include "daemon.hpp"
 #include "defaults.hpp"
 #include "logger.hpp"
 
@@ -73,11 +75,7 @@ void showRandomImageFromAllBackgroundSets(
   logDebug("Showing image: {} with mode {}", image.string(),
            backgroundSetModeString(mode));
 
-  if (shouldUseScriptToSetBackground(config)) {
-    useScriptToSetBackground(config, image, optMode.value_or(mode));
-  } else {
-    setBackgroundToImage(image, optMode.value_or(mode));
-  }
+  setBackgroundUsingMethod(config, image, optMode.value_or(mode));
 
   std::cout << "Set background to " << ANSI_COLOR_CYAN << image.string()
             << ANSI_COLOR_RESET << "\n";
@@ -87,24 +85,102 @@ void showRandomImageFromAllBackgroundSets(
   }
 }
 
+/**
+ * Sends `request` to the daemon if one is running, and prints what it
+ * answered. Returns `false` if no daemon is running, otherwise exits the
+ * program
+ */
+bool forwardToDaemon(const ControlRequest &request) {
+  const tl::expected<ControlResponse, ControlSocketError> response =
+      sendControlRequest(controlSocketPath(), request);
+
+  if (!response.has_value()) {
+    if (response.error() == ControlSocketError::NoDaemon) {
+      return false;
+    }
+    if (response.error() == ControlSocketError::WrongUser) {
+      errorMsg("Control socket {} belongs to another user",
+               controlSocketPath().string());
+    } else {
+      errorMsg("Unable to send {} request to the running daemon",
+               controlCommandString(request.command));
+    }
+    exit(EXIT_FAILURE);
+  }
+
+  if (!response->ok) {
+    errorMsg("{}", response->message);
+    exit(EXIT_FAILURE);
+  }
+  std::cout << response->message;
+  if (!response->message.empty() && !response->message.ends_with('\n')) {
+    std::cout << '\n';
+  }
+  exit(EXIT_SUCCESS);
+}
+
 // ===== Command Line Arguements ===============
 
+/** Mode given to `command` with `--mode`, or `nullopt` if none was given.
+ * Exits the program if it isn't a mode */
+std::optional<BackgroundSetMode>
+modeOption(const argparse::ArgumentParser &command) {
+  const std::string modeString = command.present("--mode").value_or("");
+  if (modeString.empty()) {
+    return std::nullopt;
+  }
+
+  const std::optional<BackgroundSetMode> mode =
+      stringToBackgroundSetMode(modeString);
+  if (!mode.has_value()) {
+    errorMsg("Unknown mode {}, expected Center, Fill, Tile, or Scale",
+             modeString);
+    exit(EXIT_FAILURE);
+  }
+  return mode;
+}
+
+/** `--mode` of `command` as it is sent to the daemon */
+std::string modeArgument(const argparse::ArgumentParser &command) {
+  const std::optional<BackgroundSetMode> mode = modeOption(command);
+  return mode.has_value() ? backgroundSetModeString(mode.value()) : "";
+}
+
+/** Asks a running daemon to show what `showCommand` names instead, so the
+ * config doesn't need to be loaded */
+void forwardShowCommand(argparse::ArgumentParser &showCommand) {
+  const std::string &name = showCommand.get("name");
+  const std::string modeString = modeArgument(showCommand);
+
+  if (std::filesystem::is_regular_file(name)) {
+    forwardToDaemon({.command = ControlCommand::Image,
+                     .arguments = {std::filesystem::absolute(name).string(),
+                                   modeString}});
+  } else {
+    forwardToDaemon(
+        {.command = ControlCommand::Show, .arguments = {name, modeString}});
+  }
+}
+
+/** Asks a running daemon to choose what to show out of the sets it has
+ * parsed */
+void forwardRandomCommand(argparse::ArgumentParser &randomCommand) {
+  forwardToDaemon({.command = ControlCommand::Random,
+                   .arguments = {randomCommand["--image"] == true ? "image"
+                                                                  : "set",
+                                 modeArgument(randomCommand)}});
+}
+
 void handleShowCommand(argparse::ArgumentParser &showCommand,
                        const Config &config) {
   const std::string &name = showCommand.get("name");
-  const std::string modeString = showCommand.present("--mode").value_or("");
-  const std::optional<BackgroundSetMode> mode =
-      stringToBackgroundSetMode(modeString);
+  const std::optional<BackgroundSetMode> mode = modeOption(showCommand);
 
   if (std::filesystem::is_regular_file(name)) {
     logDebug("Showing image path {}", name);
 
-    if (shouldUseScriptToSetBackground(config)) {
-      useScriptToSetBackground(config, name,
-                               mode.value_or(BackgroundSetMode::Scale));
-    } else {
-      setBackgroundToImage(name, mode.value_or(BackgroundSetMode::Scale));
-    }
+    setBackgroundUsingMethod(config, name,
+                             mode.value_or(BackgroundSetMode::Scale));
   } else {
     std::optional<BackgroundSet> optBackgroundSet =
         getBackgroundSetWithNameFromFile(name, config);
@@ -118,11 +194,30 @@ void handleShowCommand(argparse::ArgumentParser &showCommand,
   }
 }
 
+void handleDaemonCommand(argparse::ArgumentParser &daemonCommand,
+                         const Config &config,
+                         const std::filesystem::path &configFile) {
+  const std::optional<BackgroundSetMode> mode = modeOption(daemonCommand);
+
+  std::vector<DaemonSetBinding> bindings;
+  for (const std::string &setArgument :
+       daemonCommand.get<std::vector<std::string>>("sets")) {
+    std::optional<DaemonSetBinding> binding =
+        parseDaemonSetBinding(setArgument);
+    if (!binding.has_value()) {
+      errorMsg("Expected a background set as name or name@output, got: {}",
+               setArgument);
+      exit(EXIT_FAILURE);
+    }
+    bindings.push_back(std::move(binding.value()));
+  }
+
+  runDaemon(bindings, config, configFile, mode);
+}
+
 void handleRandomCommand(argparse::ArgumentParser &randomCommand,
                          const Config &config) {
-  const std::string modeString = randomCommand.present("--mode").value_or("");
-  const std::optional<BackgroundSetMode> optMode =
-      stringToBackgroundSetMode(modeString);
+  const std::optional<BackgroundSetMode> optMode = modeOption(randomCommand);
 
   if (randomCommand["--image"] == true) {
     showRandomImageFromAllBackgroundSets(config, optMode);
@@ -188,9 +283,16 @@ void handleInfoCommand(argparse::ArgumentParser &showCommand,
 
 void handleCacheCommand(const Config &config,
                         const argparse::ArgumentParser &cache,
-                        const argparse::ArgumentParser &info) {
+                        const argparse::ArgumentParser &info,
+                        const argparse::ArgumentParser &build,
+                        const argparse::ArgumentParser &clean) {
   if (cache.is_subcommand_used(info)) {
     showCacheInfo(config);
+  } else if (cache.is_subcommand_used(build)) {
+    buildCache(config, build.present<std::size_t>("--jobs"),
+               build.get<std::vector<std::string>>("sets"));
+  } else if (cache.is_subcommand_used(clean)) {
+    cleanCache(config);
   } else {
     errorMsg("No subcommand was chosen");
     std::cout << cache.help().str();
@@ -215,8 +317,6 @@ void showHelp(const argparse::ArgumentParser &program) {
 // ===== Main ===============
 
 auto main(int argc, char *argv[]) -> int {
-  Magick::InitializeMagick(*argv);
-
   argparse::ArgumentParser program("dynamic_paper");
   program.add_argument(CONFIG_FLAG_NAME)
       .default_value<std::string>(std::string(DEFAULT_CONFIG_FILE_NAME))
@@ -229,11 +329,30 @@ auto main(int argc, char *argv[]) -> int {
   argparse::ArgumentParser showCommand("show");
   showCommand.add_description("Show image or wallpaper set with name");
   showCommand.add_argument("name").help(
-      "Image path or name of wallpaper set to show");
+      "Image path or name of wallpaper set to show, as name@output to show "
+      "one only on the monitor called output of a running daemon");
   showCommand.add_argument("--mode", "-m")
       .help("Center, Fill, Tile, or Scale (Background Set config specified or "
             "Scale by default)");
 
+  argparse::ArgumentParser daemonCommand("daemon");
+  daemonCommand.add_description(
+      "Show several wallpaper sets at once, each on its own monitor");
+  daemonCommand.add_argument("sets")
+      .help("Names of wallpaper sets to show, as name@output to show one only "
+            "on the monitor called output")
+      .nargs(argparse::nargs_pattern::at_least_one);
+  daemonCommand.add_argument("--mode", "-m")
+      .help("Center, Fill, Tile, or Scale (Background Set config specified or "
+            "Scale by default)");
+
+  argparse::ArgumentParser statusCommand("status");
+  statusCommand.add_description("Show what the running daemon shows");
+
+  argparse::ArgumentParser reloadCommand("reload");
+  reloadCommand.add_description(
+      "Make the running daemon parse the config and wallpaper sets again");
+
   argparse::ArgumentParser randomCommand("random");
   randomCommand.add_description("Show a random wallpaper set");
   randomCommand.add_argument("--image")
@@ -263,12 +382,29 @@ auto main(int argc, char *argv[]) -> int {
   cacheInfoCommand.add_description(
       "Show information about cached interpolated images");
   cacheCommand.add_subparser(cacheInfoCommand);
+  argparse::ArgumentParser cacheBuildCommand("build");
+  cacheBuildCommand.add_description(
+      "Create every interpolated image used by dynamic wallpaper sets");
+  cacheBuildCommand.add_argument("--jobs", "-j")
+      .help("Number of images to create at once")
+      .scan<'u', std::size_t>();
+  cacheBuildCommand.add_argument("sets")
+      .help("Names of wallpaper sets to create images for (all by default)")
+      .nargs(argparse::nargs_pattern::any);
+  cacheCommand.add_subparser(cacheBuildCommand);
+  argparse::ArgumentParser cacheCleanCommand("clean");
+  cacheCleanCommand.add_description(
+      "Remove interpolated images no wallpaper set uses anymore");
+  cacheCommand.add_subparser(cacheCleanCommand);
 
   argparse::ArgumentParser validateCommand("validate");
   validateCommand.add_description(
       "Identify background sets from config that are missing images");
 
   program.add_subparser(showCommand);
+  program.add_subparser(daemonCommand);
+  program.add_subparser(statusCommand);
+  program.add_subparser(reloadCommand);
   program.add_subparser(randomCommand);
   program.add_subparser(listCommand);
   program.add_subparser(infoCommand);
@@ -285,9 +421,34 @@ auto main(int argc, char *argv[]) -> int {
     errorMsg("An unknown error occurred!\n{}", generalException.what());
   }
 
+  // A running daemon already has everything loaded, so requests it can
+  // answer are sent to it before loading anything here. It shows sets with
+  // its own config, so they are shown here when given another config. `list`
+  // only reads the background set file, so it is never sent
+  const bool usesDaemonConfig = !program.is_used(CONFIG_FLAG_NAME);
+  if (program.is_subcommand_used(showCommand) && usesDaemonConfig) {
+    forwardShowCommand(showCommand);
+  } else if (program.is_subcommand_used(randomCommand) && usesDaemonConfig) {
+    forwardRandomCommand(randomCommand);
+  } else if (program.is_subcommand_used(statusCommand) ||
+             program.is_subcommand_used(reloadCommand)) {
+    const ControlCommand command = program.is_subcommand_used(statusCommand)
+                                       ? ControlCommand::Status
+                                       : ControlCommand::Reload;
+    if (!forwardToDaemon({.command = command, .arguments = {}})) {
+      errorMsg("No daemon is running");
+      return EXIT_FAILURE;
+    }
+  }
+
+  Magick::InitializeMagick(*argv);
+
   if (program.is_subcommand_used(showCommand)) {
     const Config config = getConfigAndSetupLogging(program, true);
     handleShowCommand(showCommand, config);
+  } else if (program.is_subcommand_used(daemonCommand)) {
+    const Config config = getConfigAndSetupLogging(program, true);
+    handleDaemonCommand(daemonCommand, config, getConfigFilePath(program));
   } else if (program.is_subcommand_used(listCommand)) {
     const Config config = getConfigAndSetupLogging(program, false);
     handleListCommand(listCommand, config);
@@ -299,7 +460,8 @@ auto main(int argc, char *argv[]) -> int {
     handleRandomCommand(randomCommand, config);
   } else if (program.is_subcommand_used(cacheCommand)) {
     const Config config = getConfigAndSetupLogging(program, false);
-    handleCacheCommand(config, cacheCommand, cacheInfoCommand);
+    handleCacheCommand(config, cacheCommand, cacheInfoCommand,
+                       cacheBuildCommand, cacheCleanCommand);
   } else if (program.is_subcommand_used(helpCommand)) {
     showHelp(program);
   } else if (program.is_subcommand_used(validateCommand)) {
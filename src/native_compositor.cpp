@@ -0,0 +1,362 @@
+#include "native_compositor.hpp"
+
+#include "format.hpp"
+#include "lerp_kernel.hpp"
+#include "logger.hpp"
+
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+#include <Magick++.h>
+
+namespace dynamic_paper {
+
+namespace {
+
+constexpr std::string_view RGB_MAP = "RGB";
+constexpr std::size_t FAST_PNG_QUALITY = 10;
+constexpr unsigned int NETPBM_MAX_VALUE = 255;
+
+/** Returns the text header of `image` as a binary PPM or PAM image, which is
+ * followed by the pixels exactly as they are stored in `RGBImage` */
+std::string netpbmHeader(const RGBImage &image,
+                         const TransitionFrameFormat format) {
+  return (format == TransitionFrameFormat::Pam)
+             ? dynamic_paper::format("P7\nWIDTH {}\nHEIGHT {}\nDEPTH {}\nMAXVAL "
+                                     "{}\nTUPLTYPE RGB\nENDHDR\n",
+                                     image.width, image.height,
+                                     RGBImage::CHANNELS, NETPBM_MAX_VALUE)
+             : dynamic_paper::format("P6\n{} {}\n{}\n", image.width,
+                                     image.height, NETPBM_MAX_VALUE);
+}
+
+bool isNetpbmFormat(const TransitionFrameFormat format) {
+  return format == TransitionFrameFormat::Ppm ||
+         format == TransitionFrameFormat::Pam;
+}
+
+/** Writes `image` as a binary PPM or PAM image. Throws `std::runtime_error` if
+ * it can't be written */
+void writeNetpbmImage(const RGBImage &image,
+                      const std::filesystem::path &destinationImagePath,
+                      const TransitionFrameFormat format) {
+  const std::string header = netpbmHeader(image, format);
+
+  std::ofstream file(destinationImagePath, std::ios::binary | std::ios::trunc);
+  file.write(header.data(), static_cast<std::streamsize>(header.size()));
+  file.write(reinterpret_cast<const char *>(image.pixels.data()), // NOLINT
+             static_cast<std::streamsize>(image.pixels.size()));
+  // Thrown like the errors of images written by ImageMagick
+  if (!file) {
+    throw std::runtime_error(dynamic_paper::format(
+        "Unable to write {}", destinationImagePath.string()));
+  }
+}
+
+constexpr std::array<std::uint8_t, 4> QOI_MAGIC = {'q', 'o', 'i', 'f'};
+/** Every pixel is opaque, so frames are saved as RGB in sRGB */
+constexpr std::uint8_t QOI_CHANNELS = 3;
+constexpr std::uint8_t QOI_COLORSPACE_SRGB = 0;
+constexpr std::uint8_t QOI_OPAQUE = 255;
+constexpr std::size_t QOI_HEADER_SIZE = 14;
+constexpr std::uint8_t QOI_OP_INDEX = 0x00;
+constexpr std::uint8_t QOI_OP_DIFF = 0x40;
+constexpr std::uint8_t QOI_OP_LUMA = 0x80;
+constexpr std::uint8_t QOI_OP_RUN = 0xc0;
+constexpr std::uint8_t QOI_OP_RGB = 0xfe;
+constexpr std::size_t QOI_INDEX_SIZE = 64;
+constexpr unsigned int QOI_MAX_RUN = 62;
+constexpr std::array<std::uint8_t, 8> QOI_END_MARKER = {0, 0, 0, 0,
+                                                        0, 0, 0, 1};
+
+struct QoiPixel {
+  std::uint8_t r = 0;
+  std::uint8_t g = 0;
+  std::uint8_t b = 0;
+  std::uint8_t a = 0;
+
+  bool operator==(const QoiPixel &) const = default;
+
+  [[nodiscard]] std::size_t indexPosition() const {
+    return (r * 3 + g * 5 + b * 7 + a * 11) % QOI_INDEX_SIZE; // NOLINT
+  }
+};
+
+void appendBigEndian(std::vector<std::uint8_t> &encoded,
+                     const std::uint32_t value) {
+  for (const unsigned int shift : {24U, 16U, 8U, 0U}) {
+    encoded.push_back(static_cast<std::uint8_t>(value >> shift));
+  }
+}
+
+/**
+ * Returns `image` encoded as QOI (https://qoiformat.org/qoi-specification.pdf).
+ * Encoding is a single pass over the pixels, so it is done here instead of
+ * relying on the ImageMagick build having a QOI coder.
+ */
+std::vector<std::uint8_t> encodeQoiImage(const RGBImage &image) {
+  std::vector<std::uint8_t> encoded(QOI_MAGIC.begin(), QOI_MAGIC.end());
+  // Worst case is every pixel being written as `QOI_OP_RGB`
+  encoded.reserve(QOI_HEADER_SIZE + (image.width * image.height * 4) +
+                  QOI_END_MARKER.size());
+  appendBigEndian(encoded, static_cast<std::uint32_t>(image.width));
+  appendBigEndian(encoded, static_cast<std::uint32_t>(image.height));
+  encoded.push_back(QOI_CHANNELS);
+  encoded.push_back(QOI_COLORSPACE_SRGB);
+
+  std::array<QoiPixel, QOI_INDEX_SIZE> index{};
+  QoiPixel previous{.a = QOI_OPAQUE};
+  unsigned int run = 0;
+
+  const std::size_t pixelCount = image.width * image.height;
+  for (std::size_t pixel = 0; pixel < pixelCount; pixel++) {
+    const std::size_t offset = pixel * RGBImage::CHANNELS;
+    const QoiPixel current{.r = image.pixels[offset],
+                           .g = image.pixels[offset + 1],
+                           .b = image.pixels[offset + 2],
+                           .a = QOI_OPAQUE};
+
+    if (current == previous) {
+      run++;
+      if (run == QOI_MAX_RUN || pixel == pixelCount - 1) {
+        encoded.push_back(QOI_OP_RUN | static_cast<std::uint8_t>(run - 1));
+        run = 0;
+      }
+      continue;
+    }
+
+    if (run > 0) {
+      encoded.push_back(QOI_OP_RUN | static_cast<std::uint8_t>(run - 1));
+      run = 0;
+    }
+
+    const std::size_t indexPosition = current.indexPosition();
+    if (index[indexPosition] == current) {
+      encoded.push_back(QOI_OP_INDEX |
+                        static_cast<std::uint8_t>(indexPosition));
+    } else {
+      index[indexPosition] = current;
+
+      // Differences wrap around, like the spec expects
+      const auto dr = static_cast<std::int8_t>(current.r - previous.r);
+      const auto dg = static_cast<std::int8_t>(current.g - previous.g);
+      const auto db = static_cast<std::int8_t>(current.b - previous.b);
+      const auto drDg = static_cast<std::int8_t>(dr - dg);
+      const auto dbDg = static_cast<std::int8_t>(db - dg);
+
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        encoded.push_back(QOI_OP_DIFF |
+                          static_cast<std::uint8_t>(((dr + 2) << 4) |
+                                                    ((dg + 2) << 2) | (db + 2)));
+      } else if (dg >= -32 && dg <= 31 && drDg >= -8 && drDg <= 7 &&
+                 dbDg >= -8 && dbDg <= 7) {
+        encoded.push_back(QOI_OP_LUMA | static_cast<std::uint8_t>(dg + 32));
+        encoded.push_back(
+            static_cast<std::uint8_t>(((drDg + 8) << 4) | (dbDg + 8)));
+      } else {
+        encoded.insert(encoded.end(),
+                       {QOI_OP_RGB, current.r, current.g, current.b});
+      }
+    }
+
+    previous = current;
+  }
+
+  encoded.insert(encoded.end(), QOI_END_MARKER.begin(), QOI_END_MARKER.end());
+  return encoded;
+}
+
+/** Writes the already encoded `encoded` to `destinationImagePath`. Throws
+ * `std::runtime_error` if it can't be written */
+void writeEncodedImage(const std::vector<std::uint8_t> &encoded,
+                       const std::filesystem::path &destinationImagePath) {
+  std::ofstream file(destinationImagePath, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(encoded.data()), // NOLINT
+             static_cast<std::streamsize>(encoded.size()));
+  if (!file) {
+    throw std::runtime_error(dynamic_paper::format(
+        "Unable to write {}", destinationImagePath.string()));
+  }
+}
+
+/** Returns `image` as an ImageMagick image, set to be encoded with the fastest
+ * settings of `format` */
+Magick::Image toMagickImage(const RGBImage &image,
+                            const TransitionFrameFormat format) {
+  Magick::Image magickImage(image.width, image.height, std::string(RGB_MAP),
+                            Magick::CharPixel, image.pixels.data());
+  if (format == TransitionFrameFormat::Png) {
+    // zlib level 1 (tens digit), with no filter (ones digit)
+    magickImage.quality(FAST_PNG_QUALITY);
+  } else if (format == TransitionFrameFormat::WebP) {
+    magickImage.defineValue("webp", "lossless", "true");
+    magickImage.defineValue("webp", "method", "0");
+  }
+  return magickImage;
+}
+
+/**
+ * Asks the JPEG decoder to decode the image at `imagePath` into `image` at the
+ * smallest scale that still covers what `fit` shows, using libjpeg's DCT
+ * scaling. Other formats ignore the hint and are decoded at full size.
+ */
+void hintDecodeSize(Magick::Image &image,
+                    const std::filesystem::path &imagePath,
+                    const DisplayFit &fit) {
+  const std::optional<std::pair<std::size_t, std::size_t>> imageSize =
+      readImageSize(imagePath);
+  if (!imageSize.has_value()) {
+    return;
+  }
+
+  const auto [width, height] = imageSize.value();
+  const unsigned int denominator = fit.decodeScaleDenominator(width, height);
+  if (denominator == 1) {
+    return;
+  }
+
+  logDebug("Decoding {} at 1/{} of its size", imagePath.string(), denominator);
+  image.defineValue("jpeg", "size",
+                    dynamic_paper::format("{}x{}",
+                                          (width + denominator - 1) / denominator,
+                                          (height + denominator - 1) /
+                                              denominator));
+}
+
+} // namespace
+
+// ===== Header ===============
+
+RGBImage
+readRGBImage(const std::filesystem::path &imagePath,
+             const std::optional<std::pair<std::size_t, std::size_t>> size) {
+  return readRGBImage(imagePath, std::nullopt, size);
+}
+
+RGBImage
+readRGBImage(const std::filesystem::path &imagePath,
+             const std::optional<DisplayFit> &fit,
+             const std::optional<std::pair<std::size_t, std::size_t>> size) {
+  Magick::Image image;
+  if (fit.has_value()) {
+    hintDecodeSize(image, imagePath, fit.value());
+  }
+  image.read(imagePath.c_str());
+
+  if (fit.has_value()) {
+    const SourceRegion region =
+        fit->sourceRegion(image.columns(), image.rows());
+    if (!region.isWholeImage(image.columns(), image.rows())) {
+      logDebug("Resampling {} from {}x{} to {}x{} for a {} display",
+               imagePath.string(), image.columns(), image.rows(), region.width,
+               region.height, fit->cacheTag());
+      if (region.cropWidth != image.columns() ||
+          region.cropHeight != image.rows()) {
+        image.crop(Magick::Geometry(region.cropWidth, region.cropHeight,
+                                    static_cast<ssize_t>(region.x),
+                                    static_cast<ssize_t>(region.y)));
+      }
+      if (region.width != region.cropWidth ||
+          region.height != region.cropHeight) {
+        Magick::Geometry geometry(region.width, region.height);
+        geometry.aspect(true);
+        image.resize(geometry);
+      }
+    }
+  }
+
+  if (size.has_value() &&
+      (image.columns() != size->first || image.rows() != size->second)) {
+    logDebug("Resizing {} from {}x{} to {}x{}", imagePath.string(),
+             image.columns(), image.rows(), size->first, size->second);
+    Magick::Geometry geometry(size->first, size->second);
+    geometry.aspect(true);
+    image.resize(geometry);
+  }
+
+  RGBImage rgbImage(image.columns(), image.rows());
+  image.write(0, 0, rgbImage.width, rgbImage.height, std::string(RGB_MAP),
+              Magick::CharPixel, rgbImage.pixels.data());
+  return rgbImage;
+}
+
+RGBImage resizeRGBPixels(const std::span<const std::uint8_t> pixels,
+                         const std::size_t width, const std::size_t height,
+                         const std::pair<std::size_t, std::size_t> size) {
+  Magick::Image image(width, height, std::string(RGB_MAP), Magick::CharPixel,
+                      pixels.data());
+  Magick::Geometry geometry(size.first, size.second);
+  geometry.aspect(true);
+  image.resize(geometry);
+
+  RGBImage rgbImage(image.columns(), image.rows());
+  image.write(0, 0, rgbImage.width, rgbImage.height, std::string(RGB_MAP),
+              Magick::CharPixel, rgbImage.pixels.data());
+  return rgbImage;
+}
+
+std::optional<std::pair<std::size_t, std::size_t>>
+readImageSize(const std::filesystem::path &imagePath) {
+  try {
+    Magick::Image image;
+    image.ping(imagePath.c_str());
+    return std::make_pair(image.columns(), image.rows());
+  } catch (const Magick::Exception &e) {
+    logDebug("Unable to read size of {}: {}", imagePath.string(), e.what());
+    return std::nullopt;
+  }
+}
+
+void writeRGBImage(const RGBImage &image,
+                   const std::filesystem::path &destinationImagePath,
+                   const TransitionFrameFormat format) {
+  if (isNetpbmFormat(format)) {
+    writeNetpbmImage(image, destinationImagePath, format);
+    return;
+  }
+  if (format == TransitionFrameFormat::Qoi) {
+    writeEncodedImage(encodeQoiImage(image), destinationImagePath);
+    return;
+  }
+
+  toMagickImage(image, format).write(destinationImagePath.c_str());
+}
+
+std::vector<std::uint8_t> encodeRGBImage(const RGBImage &image,
+                                         const std::string_view extension,
+                                         const TransitionFrameFormat format) {
+  if (isNetpbmFormat(format)) {
+    const std::string header = netpbmHeader(image, format);
+    std::vector<std::uint8_t> encoded(header.begin(), header.end());
+    encoded.insert(encoded.end(), image.pixels.begin(), image.pixels.end());
+    return encoded;
+  }
+  if (format == TransitionFrameFormat::Qoi) {
+    return encodeQoiImage(image);
+  }
+
+  Magick::Image magickImage = toMagickImage(image, format);
+  magickImage.magick(std::string(extension.starts_with('.')
+                                     ? extension.substr(1)
+                                     : extension));
+  Magick::Blob blob;
+  magickImage.write(&blob);
+
+  const auto *data = static_cast<const std::uint8_t *>(blob.data());
+  return {data, data + blob.length()}; // NOLINT
+}
+
+RGBImage lerpRGBImages(const RGBImage &startImage, const RGBImage &endImage,
+                       const unsigned int percentage) {
+  logAssert(startImage.sameSizeAs(endImage),
+            "Cannot lerp images of different sizes ({}x{} and {}x{})",
+            startImage.width, startImage.height, endImage.width,
+            endImage.height);
+
+  RGBImage destImage(startImage.width, startImage.height);
+  lerpPixels(startImage.pixels, endImage.pixels, destImage.pixels, percentage);
+  return destImage;
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+ * Compositing of images done in one pass over 8-bit RGB buffers, instead of
+ * using ImageMagick's alpha channel operations. ImageMagick is only used to
+ * decode and encode the images.
+ */
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "display_geometry.hpp"
+#include "rgb_image.hpp"
+#include "transition_frame_format.hpp"
+
+namespace dynamic_paper {
+
+/**
+ * Decodes the image at `imagePath` into 8-bit RGB. If `size` is provided, will
+ * resize the image to be exactly `size`, ignoring its aspect ratio.
+ */
+RGBImage readRGBImage(const std::filesystem::path &imagePath,
+                      std::optional<std::pair<std::size_t, std::size_t>> size =
+                          std::nullopt);
+
+/**
+ * Decodes the image at `imagePath` into 8-bit RGB, keeping only the part `fit`
+ * shows on the display at the size it is shown at. If `size` is provided, will
+ * then resize the image to be exactly `size`, ignoring its aspect ratio.
+ *
+ * JPEG images much larger than the display are decoded at 1/2, 1/4 or 1/8 of
+ * their size, using the smallest scale that still covers what is shown (see
+ * `DisplayFit::decodeScaleDenominator`).
+ */
+RGBImage readRGBImage(const std::filesystem::path &imagePath,
+                      const std::optional<DisplayFit> &fit,
+                      std::optional<std::pair<std::size_t, std::size_t>> size =
+                          std::nullopt);
+
+/** Returns the image of `width` x `height` with `pixels`, resized to be
+ * exactly `size`, ignoring its aspect ratio */
+RGBImage resizeRGBPixels(std::span<const std::uint8_t> pixels,
+                         std::size_t width, std::size_t height,
+                         std::pair<std::size_t, std::size_t> size);
+
+/** Returns the width and height of the image at `imagePath`, reading only its
+ * header, or `nullopt` if it can't be read as an image */
+std::optional<std::pair<std::size_t, std::size_t>>
+readImageSize(const std::filesystem::path &imagePath);
+
+/**
+ * Encodes `image` to `destinationImagePath`, using the format implied by its
+ * extension. If given a `format` other than `Source`, it is encoded using the
+ * fastest settings of that format instead. PPM and PAM images are written
+ * directly, and QOI images are encoded here, without going through ImageMagick.
+ */
+void writeRGBImage(
+    const RGBImage &image, const std::filesystem::path &destinationImagePath,
+    TransitionFrameFormat format = TransitionFrameFormat::Source);
+
+/**
+ * Returns `image` encoded like `writeRGBImage` would write it to a file with
+ * `extension`, such as `.jpg`, without writing it anywhere.
+ */
+std::vector<std::uint8_t>
+encodeRGBImage(const RGBImage &image, std::string_view extension,
+               TransitionFrameFormat format = TransitionFrameFormat::Source);
+
+/**
+ * Returns an image that is `percentage`% of the way from `startImage` to
+ * `endImage`. Both images must be the same size.
+ */
+RGBImage lerpRGBImages(const RGBImage &startImage, const RGBImage &endImage,
+                       unsigned int percentage);
+
+} // namespace dynamic_paper
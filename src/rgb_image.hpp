@@ -0,0 +1,29 @@
+#pragma once
+
+/** Decoded image stored as tightly packed 8-bit RGB pixels */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dynamic_paper {
+
+struct RGBImage {
+  static constexpr std::size_t CHANNELS = 3;
+
+  std::size_t width = 0;
+  std::size_t height = 0;
+
+  /** `width * height * CHANNELS` bytes, row by row */
+  std::vector<std::uint8_t> pixels;
+
+  RGBImage() = default;
+  RGBImage(const std::size_t width, const std::size_t height)
+      : width(width), height(height), pixels(width * height * CHANNELS) {}
+
+  [[nodiscard]] bool sameSizeAs(const RGBImage &other) const {
+    return width == other.width && height == other.height;
+  }
+};
+
+} // namespace dynamic_paper
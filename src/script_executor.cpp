@@ -98,8 +98,14 @@ runHookScript(const std::filesystem::path &scriptPath,
 [[nodiscard]] tl::expected<void, ScriptError>
 runBackgroundSetScript(const std::filesystem::path &scriptPath,
                        const std::filesystem::path &imagePath,
-                       BackgroundSetMode mode) {
-  runScript(scriptPath, imagePath.string(), backgroundSetModeString(mode));
+                       BackgroundSetMode mode,
+                       const std::optional<std::string> &output) {
+  if (output.has_value()) {
+    runScript(scriptPath, imagePath.string(), backgroundSetModeString(mode),
+              output.value());
+  } else {
+    runScript(scriptPath, imagePath.string(), backgroundSetModeString(mode));
+  }
   return {};
 }
 
@@ -6,6 +6,8 @@
 
 #include <filesystem>
 #include <cstdint>
+#include <optional>
+#include <string>
 
 #include <tl/expected.hpp>
 
@@ -24,11 +26,13 @@ runHookScript(const std::filesystem::path &scriptPath,
               const std::filesystem::path &imagePath);
 /**
  * Executes the script pointed to by `scriptPath`, to set the background image.
- * Passes in `imagePath` and `method` as arguments to the script
+ * Passes in `imagePath` and `method` as arguments to the script, followed by
+ * `output` if the background is only set on one monitor
  */
 [[nodiscard]] tl::expected<void, ScriptError>
 runBackgroundSetScript(const std::filesystem::path &scriptPath,
               const std::filesystem::path &imagePath,
-              BackgroundSetMode mode);
+              BackgroundSetMode mode,
+              const std::optional<std::string> &output = std::nullopt);
 
 } // namespace dynamic_paper
@@ -0,0 +1,127 @@
+#include "step_throughput.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+#include "cache_manifest.hpp"
+#include "defaults.hpp"
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+/** How much each new measurement counts towards the saved estimate */
+constexpr double NEW_MEASUREMENT_WEIGHT = 0.25;
+
+std::filesystem::path
+stepThroughputPath(const std::filesystem::path &cacheDirectory) {
+  std::array<char, 256> hostName{};
+  if (gethostname(hostName.data(), hostName.size() - 1) != 0 ||
+      hostName[0] == '\0') {
+    return cacheDirectory /
+           (std::string(STEP_THROUGHPUT_FILE_PREFIX) + "localhost");
+  }
+  return cacheDirectory /
+         (std::string(STEP_THROUGHPUT_FILE_PREFIX) + hostName.data());
+}
+
+} // namespace
+
+// ===== Header ===============
+
+std::optional<StepThroughput>
+readStepThroughput(const std::filesystem::path &cacheDirectory) {
+  StepThroughput throughput;
+
+  std::ifstream file(stepThroughputPath(cacheDirectory));
+  if (!(file >> throughput.compositeMilliseconds >>
+        throughput.setMilliseconds) ||
+      throughput.compositeMilliseconds < 0.0 ||
+      throughput.setMilliseconds < 0.0) {
+    return std::nullopt;
+  }
+  return throughput;
+}
+
+void recordStepThroughput(const std::filesystem::path &cacheDirectory,
+                          const StepThroughput &measured) {
+  // Other processes on this host record their measurements between the read
+  // and the write
+  const CacheDirectoryLock directoryLock(cacheDirectory);
+  StepThroughput estimate = measured;
+  const std::optional<StepThroughput> previous =
+      readStepThroughput(cacheDirectory);
+  if (previous.has_value()) {
+    estimate.compositeMilliseconds =
+        std::lerp(previous->compositeMilliseconds,
+                  measured.compositeMilliseconds, NEW_MEASUREMENT_WEIGHT);
+    estimate.setMilliseconds =
+        std::lerp(previous->setMilliseconds, measured.setMilliseconds,
+                  NEW_MEASUREMENT_WEIGHT);
+  }
+
+  const std::filesystem::path throughputPath =
+      stepThroughputPath(cacheDirectory);
+  const std::filesystem::path partialPath = partialPathFor(throughputPath);
+  {
+    std::ofstream file(partialPath, std::ios::trunc);
+    file << estimate.compositeMilliseconds << ' ' << estimate.setMilliseconds
+         << '\n';
+    if (!file) {
+      logWarning("Unable to save step throughput to {}",
+                 throughputPath.string());
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(partialPath, throughputPath, error);
+  if (error) {
+    logWarning("Unable to save step throughput to {}: {}",
+               throughputPath.string(), error.message());
+  }
+}
+
+unsigned int chooseAutoSteps(const std::chrono::seconds duration,
+                             const std::optional<StepThroughput> &throughput,
+                             const double cpuBudget) {
+  if (!throughput.has_value() || throughput->stepMilliseconds() <= 0.0) {
+    return BackgroundSetDefaults::transitionSteps;
+  }
+
+  const double budgetMilliseconds =
+      std::chrono::duration<double, std::milli>(duration).count() *
+      std::clamp(cpuBudget, 0.0, 1.0);
+  const double affordableSteps =
+      std::floor(budgetMilliseconds / throughput->stepMilliseconds());
+  return static_cast<unsigned int>(
+      std::clamp(affordableSteps, 1.0, static_cast<double>(MAX_AUTO_STEPS)));
+}
+
+TransitionInfo resolveAutoSteps(const TransitionInfo &transition,
+                                const std::filesystem::path &cacheDirectory,
+                                const double cpuBudget) {
+  if (!transition.autoSteps) {
+    return transition;
+  }
+
+  const unsigned int steps = chooseAutoSteps(
+      transition.duration, readStepThroughput(cacheDirectory), cpuBudget);
+  logDebug("Chose {} steps for a transition of {}", steps,
+           transition.duration);
+  TransitionInfo resolved = transition;
+  resolved.steps = steps;
+  resolved.autoSteps = false;
+  return resolved;
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * Measuring how long each step of a transition takes on this machine, so
+ * transitions with `auto` steps show as many steps as it can afford.
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "transition_info.hpp"
+
+namespace dynamic_paper {
+
+/** Start of the name of the file in the cache directory that stores the
+ * `StepThroughput` of a machine. It ends with the name of the machine, so a
+ * cache directory shared between machines keeps an estimate for each */
+constexpr std::string_view STEP_THROUGHPUT_FILE_PREFIX =
+    ".dynamic_paper_step_throughput-";
+
+/** Most steps `auto` chooses; steps are whole percentages between 0% and
+ * 100%, so any more would repeat images */
+constexpr unsigned int MAX_AUTO_STEPS = 99;
+
+/** Average time one step of a transition takes on this machine */
+struct StepThroughput {
+  /** Time spent blending the images of one step */
+  double compositeMilliseconds = 0.0;
+  /** Time spent setting the background to one step */
+  double setMilliseconds = 0.0;
+
+  [[nodiscard]] double stepMilliseconds() const {
+    return compositeMilliseconds + setMilliseconds;
+  }
+};
+
+/** Reads the throughput saved for this machine in `cacheDirectory`, or
+ * `nullopt` if no transition has been timed yet */
+std::optional<StepThroughput>
+readStepThroughput(const std::filesystem::path &cacheDirectory);
+
+/**
+ * Adds the throughput `measured` over one transition to the estimate saved for
+ * this machine in `cacheDirectory`. Older measurements count for less, so the
+ * estimate follows changes such as a new display size.
+ */
+void recordStepThroughput(const std::filesystem::path &cacheDirectory,
+                          const StepThroughput &measured);
+
+/**
+ * Most steps that can be shown in `duration` while spending at most
+ * `cpuBudget` of it, a fraction in the range (0..1], compositing and setting
+ * the background. Returns the default number of steps if there is no
+ * `throughput` yet.
+ */
+unsigned int chooseAutoSteps(std::chrono::seconds duration,
+                             const std::optional<StepThroughput> &throughput,
+                             double cpuBudget);
+
+/** Returns `transition` with its number of steps chosen from the throughput
+ * saved in `cacheDirectory` if it has `auto` steps */
+TransitionInfo resolveAutoSteps(const TransitionInfo &transition,
+                                const std::filesystem::path &cacheDirectory,
+                                double cpuBudget);
+
+} // namespace dynamic_paper
@@ -0,0 +1,166 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+constexpr int BACKGROUND_NICE_VALUE = 19;
+
+/** The pool and queue of the worker running on this thread, so tasks
+ * submitted by a task stay on the same worker */
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local std::size_t currentWorkerIndex = 0;
+
+/** Lowers the scheduling priority of the calling thread */
+void lowerCurrentThreadPriority() {
+#ifdef __linux__
+  // On Linux the nice value is per thread, so this leaves the rest of the
+  // process alone
+  const auto threadId = static_cast<id_t>(syscall(SYS_gettid));
+  if (setpriority(PRIO_PROCESS, threadId, BACKGROUND_NICE_VALUE) != 0) {
+    logWarning("Unable to lower priority of background thread");
+  }
+#endif
+}
+
+} // namespace
+
+// ===== Header ===============
+
+std::size_t defaultThreadPoolSize() {
+  const std::size_t hardwareThreads = std::thread::hardware_concurrency();
+  if (hardwareThreads <= 1) {
+    return 1;
+  }
+  return std::clamp<std::size_t>(hardwareThreads - 1, 1, MAX_THREAD_POOL_SIZE);
+}
+
+ThreadPool::ThreadPool(const std::size_t numberThreads,
+                       const ThreadPriority priority) {
+  logAssert(numberThreads > 0, "Thread pool needs at least 1 thread");
+
+  queues.reserve(numberThreads);
+  for (std::size_t i = 0; i < numberThreads; i++) {
+    queues.push_back(std::make_unique<WorkerQueue>());
+  }
+
+  workers.reserve(numberThreads);
+  for (std::size_t i = 0; i < numberThreads; i++) {
+    workers.emplace_back([this, i, priority]() { runWorker(i, priority); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    const std::scoped_lock lock(stateMutex);
+    stopping = true;
+  }
+  tasksAvailable.notify_all();
+
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+std::size_t ThreadPool::size() const { return workers.size(); }
+
+void ThreadPool::enqueue(std::function<void()> &&task) {
+  const std::size_t queueIndex =
+      (currentPool == this) ? currentWorkerIndex
+                            : nextQueue.fetch_add(1) % queues.size();
+
+  // Counted before being queued so a worker can never take a task that isn't
+  // counted yet
+  {
+    const std::scoped_lock lock(stateMutex);
+    logAssert(!stopping || currentPool == this,
+              "Cannot submit work to a thread pool being destroyed");
+    queuedTasks++;
+  }
+  {
+    WorkerQueue &queue = *queues[queueIndex];
+    const std::scoped_lock lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  tasksAvailable.notify_one();
+}
+
+std::optional<std::function<void()>>
+ThreadPool::takeTask(const std::size_t workerIndex) {
+  std::optional<std::function<void()>> task = std::nullopt;
+
+  {
+    WorkerQueue &ownQueue = *queues[workerIndex];
+    const std::scoped_lock lock(ownQueue.mutex);
+    if (!ownQueue.tasks.empty()) {
+      task = std::move(ownQueue.tasks.back());
+      ownQueue.tasks.pop_back();
+    }
+  }
+
+  for (std::size_t offset = 1; !task.has_value() && offset < queues.size();
+       offset++) {
+    WorkerQueue &otherQueue = *queues[(workerIndex + offset) % queues.size()];
+    const std::scoped_lock lock(otherQueue.mutex);
+    if (!otherQueue.tasks.empty()) {
+      task = std::move(otherQueue.tasks.front());
+      otherQueue.tasks.pop_front();
+    }
+  }
+
+  if (task.has_value()) {
+    const std::scoped_lock lock(stateMutex);
+    queuedTasks--;
+  }
+  return task;
+}
+
+void ThreadPool::runWorker(const std::size_t workerIndex,
+                           const ThreadPriority priority) {
+  currentPool = this;
+  currentWorkerIndex = workerIndex;
+
+  if (priority == ThreadPriority::Background) {
+    lowerCurrentThreadPriority();
+  }
+
+  while (true) {
+    std::optional<std::function<void()>> task = takeTask(workerIndex);
+    if (task.has_value()) {
+      (*task)();
+      continue;
+    }
+
+    std::unique_lock lock(stateMutex);
+    tasksAvailable.wait(lock,
+                        [this]() { return stopping || queuedTasks > 0; });
+    if (stopping && queuedTasks == 0) {
+      return;
+    }
+  }
+}
+
+ThreadPool &compositingThreadPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool &backgroundCompositingThreadPool() {
+  static ThreadPool pool(std::max<std::size_t>(defaultThreadPoolSize() / 2, 1),
+                         ThreadPriority::Background);
+  return pool;
+}
+
+} // namespace dynamic_paper
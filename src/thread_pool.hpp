@@ -0,0 +1,103 @@
+#pragma once
+
+/** A fixed size pool of threads used to run work like compositing images */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dynamic_paper {
+
+/** The most threads `defaultThreadPoolSize` will return */
+constexpr std::size_t MAX_THREAD_POOL_SIZE = 8;
+
+/**
+ * Number of threads to use for a pool doing CPU bound work. Leaves one core
+ * free so the machine stays responsive, and caps the result at
+ * `MAX_THREAD_POOL_SIZE`.
+ */
+std::size_t defaultThreadPoolSize();
+
+/** Scheduling priority of a pool's worker threads */
+enum class ThreadPriority : std::uint8_t {
+  Normal,
+  /** Lowest priority the OS offers, for work that can wait for idle CPU time */
+  Background
+};
+
+/**
+ * Runs submitted tasks on a fixed number of worker threads. Destroying the pool
+ * finishes every task already submitted before joining the workers.
+ *
+ * Each worker has its own queue. Tasks submitted from outside the pool are
+ * spread between the queues, and tasks submitted by a task go to the queue of
+ * the worker running it. Workers take their newest task first, and when their
+ * own queue is empty steal the oldest task of another worker.
+ */
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t numberThreads = defaultThreadPoolSize(),
+                      ThreadPriority priority = ThreadPriority::Normal);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ThreadPool(ThreadPool &&) = delete;
+  ThreadPool &operator=(ThreadPool &&) = delete;
+
+  /** Runs `function` on one of the pool's threads. The returned future holds
+   * the result of `function` once it has finished */
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F &&function) {
+    using ResultType = std::invoke_result_t<F>;
+
+    auto task = std::make_shared<std::packaged_task<ResultType()>>(
+        std::forward<F>(function));
+    std::future<ResultType> result = task->get_future();
+    enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  /** Number of worker threads in the pool */
+  [[nodiscard]] std::size_t size() const;
+
+private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<std::size_t> nextQueue = 0;
+
+  /** Guards `queuedTasks` and `stopping`, used to sleep idle workers */
+  std::mutex stateMutex;
+  std::condition_variable tasksAvailable;
+  std::size_t queuedTasks = 0;
+  bool stopping = false;
+
+  void enqueue(std::function<void()> &&task);
+  std::optional<std::function<void()>> takeTask(std::size_t workerIndex);
+  void runWorker(std::size_t workerIndex, ThreadPriority priority);
+};
+
+/** Pool shared by everything that composites images, so that the number of
+ * threads compositing at once stays bounded */
+ThreadPool &compositingThreadPool();
+
+/** Pool with `ThreadPriority::Background` threads, for compositing images that
+ * aren't needed yet */
+ThreadPool &backgroundCompositingThreadPool();
+
+} // namespace dynamic_paper
@@ -0,0 +1,100 @@
+#include "tile_mask.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "lerp_kernel.hpp"
+#include "logger.hpp"
+#include "rgb_image.hpp"
+
+namespace dynamic_paper {
+
+// ===== Header ===============
+
+std::size_t TileMask::numberChanged() const {
+  return static_cast<std::size_t>(std::ranges::count(changed, 1));
+}
+
+double TileMask::changedFraction() const {
+  if (changed.empty()) {
+    return 0.0;
+  }
+  return static_cast<double>(numberChanged()) /
+         static_cast<double>(changed.size());
+}
+
+TileMask computeTileMask(const std::span<const std::uint8_t> start,
+                         const std::span<const std::uint8_t> end,
+                         const std::size_t width, const std::size_t height,
+                         const std::size_t tileSize) {
+  logAssert(start.size() == end.size() &&
+                start.size() == width * height * RGBImage::CHANNELS,
+            "Cannot compare images of different sizes");
+
+  TileMask mask = {.width = width,
+                   .height = height,
+                   .tileSize = tileSize,
+                   .columns = (width + tileSize - 1) / tileSize,
+                   .rows = (height + tileSize - 1) / tileSize,
+                   .changed = {}};
+  mask.changed.resize(mask.columns * mask.rows, 0);
+
+  const std::size_t rowBytes = width * RGBImage::CHANNELS;
+  const std::size_t tileBytes = tileSize * RGBImage::CHANNELS;
+  for (std::size_t y = 0; y < height; y++) {
+    const std::size_t tileRow = y / tileSize;
+    for (std::size_t column = 0; column < mask.columns; column++) {
+      std::uint8_t &tileChanged = mask.changed[(tileRow * mask.columns) + column];
+      if (tileChanged != 0) {
+        continue;
+      }
+
+      const std::size_t offset = (y * rowBytes) + (column * tileBytes);
+      const std::size_t length = std::min(tileBytes, rowBytes - (column * tileBytes));
+      if (std::memcmp(start.data() + offset, end.data() + offset, length) != 0) {
+        tileChanged = 1;
+      }
+    }
+  }
+  return mask;
+}
+
+void lerpChangedTiles(const std::span<const std::uint8_t> start,
+                      const std::span<const std::uint8_t> end,
+                      const std::span<std::uint8_t> destination,
+                      const TileMask &mask, const unsigned int percentage) {
+  logAssert(destination.size() == mask.width * mask.height * RGBImage::CHANNELS,
+            "Tile mask is for a {}x{} image but the frame is {} bytes",
+            mask.width, mask.height, destination.size());
+
+  const std::size_t rowBytes = mask.width * RGBImage::CHANNELS;
+  const std::size_t tileBytes = mask.tileSize * RGBImage::CHANNELS;
+  for (std::size_t y = 0; y < mask.height; y++) {
+    const std::size_t tileRow = y / mask.tileSize;
+
+    // Neighbouring tiles in the same state are done in one run
+    std::size_t column = 0;
+    while (column < mask.columns) {
+      const bool changed = mask.tileChanged(column, tileRow);
+      std::size_t runEnd = column + 1;
+      while (runEnd < mask.columns &&
+             mask.tileChanged(runEnd, tileRow) == changed) {
+        runEnd++;
+      }
+
+      const std::size_t offset = (y * rowBytes) + (column * tileBytes);
+      const std::size_t length =
+          std::min(runEnd * tileBytes, rowBytes) - (column * tileBytes);
+      if (changed) {
+        lerpPixels(start.subspan(offset, length), end.subspan(offset, length),
+                   destination.subspan(offset, length), percentage);
+      } else {
+        std::memcpy(destination.data() + offset, start.data() + offset,
+                    length);
+      }
+      column = runEnd;
+    }
+  }
+}
+
+} // namespace dynamic_paper
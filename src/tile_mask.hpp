@@ -0,0 +1,61 @@
+#pragma once
+
+/**
+ * Comparison of the start and end image of a transition in square tiles, so
+ * frames only blend the parts of the picture that change. Many sets share
+ * large identical regions between images, such as a foreground or a frame.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace dynamic_paper {
+
+/** Width and height of the tiles images are compared in, in pixels */
+constexpr std::size_t TILE_SIZE = 64;
+
+/** Which tiles of two images of the same size are different */
+struct TileMask {
+  /** Size of the images, in pixels */
+  std::size_t width = 0;
+  std::size_t height = 0;
+  std::size_t tileSize = TILE_SIZE;
+  /** Number of tiles across and down. Tiles on the right and bottom edge are
+   * smaller if the images are not a multiple of `tileSize` */
+  std::size_t columns = 0;
+  std::size_t rows = 0;
+  /** `columns * rows` flags, row by row, that are 1 if the tile differs */
+  std::vector<std::uint8_t> changed;
+
+  [[nodiscard]] bool tileChanged(const std::size_t column,
+                                 const std::size_t row) const {
+    return changed[(row * columns) + column] != 0;
+  }
+
+  [[nodiscard]] std::size_t numberChanged() const;
+
+  /** Fraction of tiles that differ in the range [0..1] */
+  [[nodiscard]] double changedFraction() const;
+};
+
+/**
+ * Compares `start` and `end`, both RGB images of `width` x `height`, in tiles
+ * of `tileSize`.
+ */
+TileMask computeTileMask(std::span<const std::uint8_t> start,
+                         std::span<const std::uint8_t> end, std::size_t width,
+                         std::size_t height, std::size_t tileSize = TILE_SIZE);
+
+/**
+ * Does the same as `lerpPixels`, but only blends the tiles `mask` marks as
+ * changed. Every other tile is the same in both images, so it is copied from
+ * `start`.
+ */
+void lerpChangedTiles(std::span<const std::uint8_t> start,
+                      std::span<const std::uint8_t> end,
+                      std::span<std::uint8_t> destination,
+                      const TileMask &mask, unsigned int percentage);
+
+} // namespace dynamic_paper
@@ -5,6 +5,7 @@
 #include "time_util.hpp"
 
 #ifndef dynamic_paper_use_std_chrono_zoned_time
+#include <ctime>
 #include <iomanip>
 #include <sstream>
 #endif
@@ -43,6 +44,13 @@ TimeFromMidnight getCurrentTime() {
 
   return timeFromString(timeString);
 }
+
+std::chrono::year_month_day getCurrentDay() {
+  const std::chrono::zoned_time zonedTime{std::chrono::current_zone(),
+                                          std::chrono::system_clock::now()};
+  return std::chrono::year_month_day(
+      std::chrono::floor<std::chrono::days>(zonedTime.get_local_time()));
+}
 #else
 TimeFromMidnight getCurrentTime() {
   const auto now_c =
@@ -55,5 +63,17 @@ TimeFromMidnight getCurrentTime() {
 
   return timeFromString(timeString);
 }
+
+std::chrono::year_month_day getCurrentDay() {
+  const auto now_c =
+      std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  const std::tm *localTime = std::localtime(&now_c);
+
+  // `tm_year` counts from 1900 and `tm_mon` from 0
+  constexpr int TM_FIRST_YEAR = 1900;
+  return {std::chrono::year(localTime->tm_year + TM_FIRST_YEAR),
+          std::chrono::month(static_cast<unsigned int>(localTime->tm_mon + 1)),
+          std::chrono::day(static_cast<unsigned int>(localTime->tm_mday))};
+}
 #endif
 } // namespace dynamic_paper
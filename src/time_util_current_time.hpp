@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+
 #include "time_from_midnight.hpp"
 
 namespace dynamic_paper {
@@ -9,4 +11,9 @@ namespace dynamic_paper {
  */
 TimeFromMidnight getCurrentTime();
 
+/**
+ * Returns the current day in the local time zone
+ */
+std::chrono::year_month_day getCurrentDay();
+
 } // namespace dynamic_paper
@@ -0,0 +1,90 @@
+#pragma once
+
+/** Formats the frames of transitions are saved in */
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "constants.hpp"
+#include "logger.hpp"
+#include "string_util.hpp"
+
+namespace dynamic_paper {
+
+/**
+ * Format the frames of transitions are saved in. Frames are only shown for a
+ * few seconds, so the formats other than `Source` are lossless and chosen to
+ * be fast to encode and decode instead of small.
+ */
+enum class TransitionFrameFormat : std::uint8_t {
+  /** Same format as the images the transition is between */
+  Source,
+  /** Quite OK Image format, about as small as PNG but much faster */
+  Qoi,
+  /** Uncompressed binary PPM (P6), written without encoding */
+  Ppm,
+  /** Uncompressed PAM (P7), written without encoding */
+  Pam,
+  /** PNG at the lowest compression level */
+  Png,
+  /** Lossless WebP using its fastest method */
+  WebP
+};
+
+constexpr std::string
+transitionFrameFormatString(const TransitionFrameFormat format) {
+  switch (format) {
+  case TransitionFrameFormat::Source: {
+    return std::string(SOURCE_FORMAT_STRING);
+  }
+  case TransitionFrameFormat::Qoi: {
+    return std::string(QOI_FORMAT_STRING);
+  }
+  case TransitionFrameFormat::Ppm: {
+    return std::string(PPM_FORMAT_STRING);
+  }
+  case TransitionFrameFormat::Pam: {
+    return std::string(PAM_FORMAT_STRING);
+  }
+  case TransitionFrameFormat::Png: {
+    return std::string(PNG_FORMAT_STRING);
+  }
+  case TransitionFrameFormat::WebP: {
+    return std::string(WEBP_FORMAT_STRING);
+  }
+  }
+
+  logAssert(false, "Unable to construct format string from passed format");
+  return "";
+}
+
+constexpr std::optional<TransitionFrameFormat>
+stringToTransitionFrameFormat(const std::string_view formatString) {
+  const std::string formatStringNormalized = normalize(std::string(formatString));
+
+  for (const TransitionFrameFormat format :
+       {TransitionFrameFormat::Source, TransitionFrameFormat::Qoi,
+        TransitionFrameFormat::Ppm, TransitionFrameFormat::Pam,
+        TransitionFrameFormat::Png, TransitionFrameFormat::WebP}) {
+    if (formatStringNormalized == transitionFrameFormatString(format)) {
+      return format;
+    }
+  }
+
+  return std::nullopt;
+}
+
+/** Returns the extension of frames saved in `format`, or `sourceExtension` if
+ * they are saved in the format of their sources */
+constexpr std::string
+transitionFrameExtension(const TransitionFrameFormat format,
+                         const std::string &sourceExtension) {
+  if (format == TransitionFrameFormat::Source) {
+    return sourceExtension;
+  }
+  return "." + transitionFrameFormatString(format);
+}
+
+} // namespace dynamic_paper
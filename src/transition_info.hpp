@@ -4,7 +4,10 @@
  * Helper struct used to represent transitions
  */
 
+#include <algorithm>
 #include <chrono>
+#include <optional>
+#include <vector>
 
 #include "logger.hpp"
 
@@ -20,11 +23,72 @@ struct TransitionInfo {
    */
   bool inPlace;
 
+  /**
+   * If `true`, the number of steps is chosen when the transition is shown from
+   * how fast this machine shows each step, and `steps` is unused
+   */
+  bool autoSteps;
+
+  /**
+   * Percentage of the end image the transition starts from, which is only
+   * above 0 for transitions started late. `steps` are spread between it and
+   * 100%
+   */
+  unsigned int startPercentage = 0;
+
   constexpr TransitionInfo(const std::chrono::seconds duration,
-                           const unsigned int steps, const bool inPlace)
-      : duration(duration), steps(steps), inPlace(inPlace) {
+                           const unsigned int steps, const bool inPlace,
+                           const bool autoSteps = false)
+      : duration(duration), steps(steps), inPlace(inPlace),
+        autoSteps(autoSteps) {
     logAssert(duration.count() > 0, "Transition duration must be > 0");
   }
+
+  /**
+   * The percentage of the end image shown at each step of the transition.
+   * Steps are spread evenly so that the `startPercentage`% and 100% images are
+   * not part of the transition.
+   *
+   * If `percentageStep` is given, every percentage is rounded to a multiple of
+   * it, so transitions with a different number of steps share images.
+   */
+  [[nodiscard]] std::vector<unsigned int>
+  stepPercentages(const std::optional<unsigned int> percentageStep =
+                      std::nullopt) const {
+    const unsigned int denominator = steps + 1;
+
+    std::vector<unsigned int> percentages;
+    percentages.reserve(steps);
+    for (unsigned int i = 0; i < steps; i++) {
+      const float percentageFloat =
+          static_cast<float>(i + 1) / static_cast<float>(denominator);
+      const unsigned int percentage = std::clamp(
+          startPercentage +
+              static_cast<unsigned int>(
+                  percentageFloat *
+                  static_cast<float>(100U - std::min(startPercentage, 100U))),
+          0U, 100U);
+      percentages.push_back(
+          percentageStep.has_value()
+              ? snapPercentage(percentage, percentageStep.value())
+              : percentage);
+    }
+    return percentages;
+  }
+
+  /**
+   * Rounds `percentage` to the nearest multiple of `percentageStep`, keeping
+   * it between 0% and 100% so the step still shows part of both images.
+   *
+   * `percentageStep` should be in the range [1..50]
+   */
+  static constexpr unsigned int snapPercentage(const unsigned int percentage,
+                                               const unsigned int percentageStep) {
+    const unsigned int nearestMultiple =
+        ((percentage + (percentageStep / 2)) / percentageStep) * percentageStep;
+    const unsigned int largestMultiple = (99 / percentageStep) * percentageStep;
+    return std::clamp(nearestMultiple, percentageStep, largestMultiple);
+  }
 };
 
 } // namespace dynamic_paper
@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+ * Helper struct used to decide when each step of a transition is shown
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace dynamic_paper {
+
+/**
+ * Fixed times each step of a transition is shown at, measured from when the
+ * transition started. A step that is slow makes the steps after it late
+ * instead of delaying the end of the whole transition.
+ */
+class TransitionSchedule {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  TransitionSchedule(const Clock::time_point start,
+                     const std::chrono::seconds duration,
+                     const std::size_t steps)
+      : start(start), steps(std::max<std::size_t>(steps, 1)),
+        stepDuration(std::chrono::duration_cast<Clock::duration>(duration) /
+                     this->steps) {}
+
+  /** Time step `step` should be shown at */
+  [[nodiscard]] Clock::time_point stepStart(const std::size_t step) const {
+    return start + (stepDuration * step);
+  }
+
+  /** Time step `step` is replaced by the next step */
+  [[nodiscard]] Clock::time_point stepEnd(const std::size_t step) const {
+    return stepStart(step + 1);
+  }
+
+  /** Time the transition should be finished by */
+  [[nodiscard]] Clock::time_point end() const { return stepStart(steps); }
+
+  /**
+   * Returns `true` if it is too late at `now` to show step `step`, as the
+   * next step should already be shown. The last step is never stale, so the
+   * transition always ends on the image closest to its end.
+   */
+  [[nodiscard]] bool isStale(const std::size_t step,
+                             const Clock::time_point now) const {
+    return step + 1 < steps && now >= stepEnd(step);
+  }
+
+  /** How late step `step` is when shown at `now`, or 0 if it is on time */
+  [[nodiscard]] Clock::duration lateness(const std::size_t step,
+                                         const Clock::time_point now) const {
+    return std::max(now - stepStart(step), Clock::duration{0});
+  }
+
+private:
+  Clock::time_point start;
+  std::size_t steps;
+  Clock::duration stepDuration;
+};
+
+} // namespace dynamic_paper
@@ -0,0 +1,177 @@
+#include "transition_session.hpp"
+
+#include <exception>
+#include <system_error>
+
+#include "cache_key.hpp"
+#include "cache_manifest.hpp"
+#include "image_cache.hpp"
+#include "lerp_kernel.hpp"
+#include "logger.hpp"
+#include "native_compositor.hpp"
+#include "tile_mask.hpp"
+#include "time_util.hpp"
+
+namespace dynamic_paper {
+
+// ===== Header ===============
+
+TransitionSession::TransitionSession(
+    std::filesystem::path startImagePath, std::filesystem::path endImagePath,
+    std::optional<DisplayFit> fit,
+    std::optional<std::filesystem::path> decodedSourceDirectory)
+    : startImagePath(std::move(startImagePath)),
+      endImagePath(std::move(endImagePath)), fit(std::move(fit)),
+      decodedSourceDirectory(std::move(decodedSourceDirectory)) {}
+
+bool TransitionSession::sourcesAreDecoded() const {
+  const std::scoped_lock lock(decodeMutex);
+  return startImage.has_value() && endImage.has_value();
+}
+
+tl::expected<RGBImage, CompositeImageError>
+TransitionSession::getFrame(const unsigned int percentage) {
+  const tl::expected<void, CompositeImageError> decodeResult = decodeSources();
+  if (!decodeResult.has_value()) {
+    return tl::unexpected(decodeResult.error());
+  }
+
+  RGBImage frame(startImage->width(), startImage->height());
+  lerpChangedTiles(startImage->pixels(), endImage->pixels(), frame.pixels,
+                   tileMask.value(), percentage);
+  return frame;
+}
+
+tl::expected<std::filesystem::path, CompositeImageError>
+TransitionSession::writeFrame(
+    const unsigned int percentage,
+    const std::filesystem::path &destinationImagePath,
+    const TransitionFrameFormat format) {
+  const tl::expected<RGBImage, CompositeImageError> frame =
+      getFrame(percentage);
+  if (!frame.has_value()) {
+    return tl::unexpected(frame.error());
+  }
+
+  const std::filesystem::path partialPath =
+      partialPathFor(destinationImagePath);
+  try {
+    writeRGBImage(frame.value(), partialPath, format);
+    std::filesystem::rename(partialPath, destinationImagePath);
+  } catch (const std::exception &e) {
+    logError("Unable to save composite image {}: {}",
+             destinationImagePath.string(), e.what());
+    std::error_code error;
+    std::filesystem::remove(partialPath, error);
+    return tl::unexpected(CompositeImageError::UnableToCreatePath);
+  }
+
+  return destinationImagePath;
+}
+
+tl::expected<std::vector<std::uint8_t>, CompositeImageError>
+TransitionSession::encodeFrame(const unsigned int percentage,
+                               const std::string_view extension,
+                               const TransitionFrameFormat format) {
+  const tl::expected<RGBImage, CompositeImageError> frame =
+      getFrame(percentage);
+  if (!frame.has_value()) {
+    return tl::unexpected(frame.error());
+  }
+
+  try {
+    return encodeRGBImage(frame.value(), extension, format);
+  } catch (const std::exception &e) {
+    logError("Unable to encode composite image: {}", e.what());
+    return tl::unexpected(CompositeImageError::UnableToCreatePath);
+  }
+}
+
+tl::expected<void, CompositeImageError> TransitionSession::decodeSources() {
+  const std::scoped_lock lock(decodeMutex);
+  if (startImage.has_value() && endImage.has_value()) {
+    return {};
+  }
+
+  if (!std::filesystem::exists(startImagePath)) {
+    logWarning(
+        "Trying to make a composite image using {} but it doesn't exist!",
+        startImagePath.string());
+    return tl::unexpected(CompositeImageError::FileDoesntExist);
+  }
+
+  if (!std::filesystem::exists(endImagePath)) {
+    logWarning(
+        "Trying to make a composite image using {} but it doesn't exist!",
+        endImagePath.string());
+    return tl::unexpected(CompositeImageError::FileDoesntExist);
+  }
+
+  std::chrono::milliseconds decodeTime{0};
+  try {
+    decodeTime = timeToRunCodeBlock([this]() {
+      startImage = loadSource(startImagePath);
+      endImage = loadSource(endImagePath);
+      if (startImage->width() != endImage->width() ||
+          startImage->height() != endImage->height()) {
+        endImage = DecodedSource(resizeRGBPixels(
+            endImage->pixels(), endImage->width(), endImage->height(),
+            std::make_pair(startImage->width(), startImage->height())));
+      }
+      tileMask = computeTileMask(startImage->pixels(), endImage->pixels(),
+                                 startImage->width(), startImage->height());
+    });
+  } catch (const std::exception &e) {
+    logError("Unable to decode {} and {} for transition: {}",
+             startImagePath.string(), endImagePath.string(), e.what());
+    startImage = std::nullopt;
+    endImage = std::nullopt;
+    tileMask = std::nullopt;
+    return tl::unexpected(CompositeImageError::UnableToCreatePath);
+  }
+
+  logDebug("Decoded {} and {} for transition in {}, {} of {} tiles differ",
+           startImagePath.string(), endImagePath.string(), decodeTime,
+           tileMask->numberChanged(), tileMask->changed.size());
+
+  return {};
+}
+
+DecodedSource
+TransitionSession::loadSource(const std::filesystem::path &imagePath) {
+  if (!decodedSourceDirectory.has_value()) {
+    return DecodedSource(readRGBImage(imagePath, fit));
+  }
+
+  const std::optional<std::uint64_t> digest =
+      sourceImageDigest(imagePath, decodedSourceDirectory.value());
+  if (!digest.has_value()) {
+    return DecodedSource(readRGBImage(imagePath, fit));
+  }
+
+  const std::string fileName = decodedSourceFileName(digest.value(), fit);
+  const std::filesystem::path decodedPath =
+      decodedSourceDirectory.value() / fileName;
+  CacheManifest &manifest = sharedCacheManifest(decodedSourceDirectory.value());
+
+  std::optional<DecodedSource> mapped =
+      DecodedSource::map(decodedPath, digest.value());
+  if (mapped.has_value()) {
+    logDebug("Mapped decoded {} from {}", imagePath.string(),
+             decodedPath.string());
+    manifest.markUsed(std::span(&fileName, 1));
+    return std::move(mapped.value());
+  }
+
+  RGBImage image = readRGBImage(imagePath, fit);
+  if (writeDecodedSource(image, digest.value(), decodedPath)) {
+    const std::optional<CacheManifestEntry> entry =
+        newCacheManifestEntry(decodedPath);
+    if (entry.has_value()) {
+      manifest.add(std::span(&entry.value(), 1));
+    }
+  }
+  return DecodedSource(std::move(image));
+}
+
+} // namespace dynamic_paper
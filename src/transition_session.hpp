@@ -0,0 +1,100 @@
+#pragma once
+
+/**
+ * Holds the decoded images of a single transition, so that every frame of it
+ * can be made from memory.
+ */
+
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include "decoded_source_cache.hpp"
+#include "display_geometry.hpp"
+#include "image_compositor.hpp"
+#include "rgb_image.hpp"
+#include "tile_mask.hpp"
+#include "transition_frame_format.hpp"
+
+namespace dynamic_paper {
+
+/**
+ * The start and end image of one transition. The images are decoded the first
+ * time a frame is needed, and are then kept for the rest of the transition.
+ * If given a `DisplayFit`, both images are resampled to what the display shows
+ * once when decoded, so every frame is blended at that size.
+ *
+ * If given a `decodedSourceDirectory`, decoded images are saved to it, and
+ * images already saved there are memory mapped instead of being decoded.
+ *
+ * The images are compared in tiles once when decoded, and frames only blend
+ * the tiles that differ, copying the rest.
+ *
+ * Frames can be created from multiple threads at once.
+ */
+class TransitionSession {
+public:
+  TransitionSession(std::filesystem::path startImagePath,
+                    std::filesystem::path endImagePath,
+                    std::optional<DisplayFit> fit = std::nullopt,
+                    std::optional<std::filesystem::path>
+                        decodedSourceDirectory = std::nullopt);
+
+  /**
+   * Returns an image that is `percentage`% of the way from the start image to
+   * the end image.
+   *
+   * `percentage` should be in the range [0..100]
+   */
+  tl::expected<RGBImage, CompositeImageError> getFrame(unsigned int percentage);
+
+  /**
+   * Creates the frame that is `percentage`% of the way from the start image to
+   * the end image, and saves it to `destinationImagePath`.
+   *
+   * The frame is written to a temporary file first and then renamed, so
+   * `destinationImagePath` never contains a partially written image. It is
+   * encoded as described by `writeRGBImage` for `format`. Errors writing it
+   * are returned instead of thrown, as frames are written on worker threads.
+   */
+  tl::expected<std::filesystem::path, CompositeImageError>
+  writeFrame(unsigned int percentage,
+             const std::filesystem::path &destinationImagePath,
+             TransitionFrameFormat format = TransitionFrameFormat::Source);
+
+  /** Creates the frame that is `percentage`% of the way from the start image
+   * to the end image, encoded as `encodeRGBImage` does for `extension` and
+   * `format` */
+  tl::expected<std::vector<std::uint8_t>, CompositeImageError>
+  encodeFrame(unsigned int percentage, std::string_view extension,
+              TransitionFrameFormat format = TransitionFrameFormat::Source);
+
+  /** Decodes the start and end images if they have not been already */
+  tl::expected<void, CompositeImageError> decodeSources();
+
+  /** Returns `true` if the start and end images have been decoded */
+  [[nodiscard]] bool sourcesAreDecoded() const;
+
+private:
+  std::filesystem::path startImagePath;
+  std::filesystem::path endImagePath;
+  std::optional<DisplayFit> fit;
+  std::optional<std::filesystem::path> decodedSourceDirectory;
+
+  std::optional<DecodedSource> startImage = std::nullopt;
+  std::optional<DecodedSource> endImage = std::nullopt;
+  /** Tiles that differ between `startImage` and `endImage` */
+  std::optional<TileMask> tileMask = std::nullopt;
+
+  /** Maps `imagePath` from `decodedSourceDirectory` if it was decoded before,
+   * or decodes it and saves it there */
+  DecodedSource loadSource(const std::filesystem::path &imagePath);
+
+  mutable std::mutex decodeMutex;
+};
+
+} // namespace dynamic_paper
@@ -0,0 +1,170 @@
+#include "wakeup_timer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+#include "logger.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+/** Offset of local time from UTC at `time` */
+std::chrono::seconds utcOffsetAt(const std::chrono::system_clock::time_point time) {
+  const std::time_t timeC = std::chrono::system_clock::to_time_t(time);
+  std::tm localTime{};
+  if (localtime_r(&timeC, &localTime) == nullptr) {
+    return std::chrono::seconds(0);
+  }
+  return std::chrono::seconds(localTime.tm_gmtoff);
+}
+
+#ifdef __linux__
+/** Reads the 8 byte counter of a `timerfd` or `eventfd`, retrying if
+ * interrupted by a signal. Returns `false` with `errno` set if unable to */
+bool readCounter(const int fileDescriptor) {
+  std::uint64_t counter = 0;
+  while (read(fileDescriptor, &counter, sizeof(counter)) == -1) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return true;
+}
+#endif
+
+} // namespace
+
+// ===== Header ===============
+
+WakeupTimer::WakeupTimer() {
+#ifdef __linux__
+  fileDescriptor = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+  interruptDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fileDescriptor == -1 || interruptDescriptor == -1) {
+    logWarning("Unable to create a timer, so waking after a suspend may be "
+               "late: {}",
+               std::strerror(errno));
+    for (int *descriptor : {&fileDescriptor, &interruptDescriptor}) {
+      if (*descriptor != -1) {
+        close(*descriptor);
+        *descriptor = -1;
+      }
+    }
+  }
+#endif
+}
+
+WakeupTimer::~WakeupTimer() {
+#ifdef __linux__
+  for (const int descriptor : {fileDescriptor, interruptDescriptor}) {
+    if (descriptor != -1) {
+      close(descriptor);
+    }
+  }
+#endif
+}
+
+WakeupReason
+WakeupTimer::sleepUntil(const std::chrono::system_clock::time_point deadline) {
+#ifdef __linux__
+  if (fileDescriptor != -1) {
+    const auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        deadline.time_since_epoch());
+    const auto seconds = std::chrono::floor<std::chrono::seconds>(sinceEpoch);
+    // A zero `it_value` disarms the timer, so deadlines are at least 1ns
+    const itimerspec timerSpec = {
+        .it_interval = {.tv_sec = 0, .tv_nsec = 0},
+        .it_value = {.tv_sec = std::max<std::time_t>(
+                         0, static_cast<std::time_t>(seconds.count())),
+                     .tv_nsec = std::max<long>(
+                         1, static_cast<long>((sinceEpoch - seconds).count()))}};
+
+    // Cancelled when the clock is set, which also happens when the machine
+    // resumes from suspend
+    if (timerfd_settime(fileDescriptor,
+                        TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &timerSpec,
+                        nullptr) == 0) {
+      std::array<pollfd, 2> descriptors = {
+          pollfd{.fd = fileDescriptor, .events = POLLIN, .revents = 0},
+          pollfd{.fd = interruptDescriptor, .events = POLLIN, .revents = 0}};
+      while (poll(descriptors.data(), descriptors.size(), -1) == -1) {
+        if (errno != EINTR) {
+          break;
+        }
+      }
+
+      if ((descriptors[1].revents & POLLIN) != 0) {
+        readCounter(interruptDescriptor);
+        return WakeupReason::Interrupted;
+      }
+      if ((descriptors[0].revents & POLLIN) != 0) {
+        if (readCounter(fileDescriptor)) {
+          return WakeupReason::Deadline;
+        }
+        if (errno == ECANCELED) {
+          return WakeupReason::ClockChanged;
+        }
+      }
+    }
+    logWarning("Unable to wait on timer, so sleeping instead: {}",
+               std::strerror(errno));
+  }
+#endif
+
+  return sleepUntilWithoutTimer(deadline);
+}
+
+void WakeupTimer::interrupt() {
+#ifdef __linux__
+  if (interruptDescriptor != -1) {
+    const std::uint64_t increment = 1;
+    if (write(interruptDescriptor, &increment, sizeof(increment)) ==
+        sizeof(increment)) {
+      return;
+    }
+  }
+#endif
+
+  {
+    const std::scoped_lock lock(mutex);
+    interruptPending = true;
+  }
+  interrupted.notify_all();
+}
+
+WakeupReason WakeupTimer::sleepUntilWithoutTimer(
+    const std::chrono::system_clock::time_point deadline) {
+  std::unique_lock lock(mutex);
+  if (interrupted.wait_until(lock, deadline,
+                             [this]() { return interruptPending; })) {
+    interruptPending = false;
+    return WakeupReason::Interrupted;
+  }
+  return WakeupReason::Deadline;
+}
+
+std::chrono::system_clock::time_point
+wallClockDeadlineAfter(const std::chrono::seconds localDuration,
+                       const std::chrono::system_clock::time_point from) {
+  const std::chrono::system_clock::time_point naiveDeadline =
+      from + localDuration;
+
+  // Local time skips ahead when the offset grows, so less real time passes
+  return naiveDeadline - (utcOffsetAt(naiveDeadline) - utcOffsetAt(from));
+}
+
+} // namespace dynamic_paper
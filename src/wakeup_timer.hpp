@@ -0,0 +1,76 @@
+#pragma once
+
+/**
+ * Sleeping until a time on the wall clock, so the daemon wakes when an event
+ * is due even if the machine was suspended or the clock was changed while it
+ * slept.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace dynamic_paper {
+
+/** Why `WakeupTimer::sleepUntil` returned */
+enum class WakeupReason : std::uint8_t {
+  /** The deadline was reached */
+  Deadline,
+  /** The wall clock was set, or the machine resumed from suspend, so the
+   * deadline may no longer be the right time */
+  ClockChanged,
+  /** `WakeupTimer::interrupt` was called */
+  Interrupted
+};
+
+/**
+ * Timer that sleeps until an absolute time on the wall clock.
+ *
+ * On Linux this is a `timerfd` on `CLOCK_REALTIME`, which keeps counting while
+ * the machine is suspended and is woken as soon as the clock is set. Elsewhere
+ * it falls back to sleeping on `std::chrono::system_clock`.
+ */
+class WakeupTimer {
+public:
+  WakeupTimer();
+  ~WakeupTimer();
+
+  WakeupTimer(const WakeupTimer &) = delete;
+  WakeupTimer &operator=(const WakeupTimer &) = delete;
+  WakeupTimer(WakeupTimer &&) = delete;
+  WakeupTimer &operator=(WakeupTimer &&) = delete;
+
+  /** Sleeps until `deadline`, returning early if the wall clock changes or
+   * `interrupt` is called */
+  WakeupReason sleepUntil(std::chrono::system_clock::time_point deadline);
+
+  /** Wakes the thread in `sleepUntil`, or makes the next call return at once
+   * if no thread is sleeping. Can be called from any thread */
+  void interrupt();
+
+private:
+  /** The `timerfd`, or -1 if there isn't one */
+  int fileDescriptor = -1;
+  /** `eventfd` written to by `interrupt`, or -1 if there isn't one */
+  int interruptDescriptor = -1;
+
+  /** Used instead of the descriptors when there is no `timerfd` */
+  std::mutex mutex;
+  std::condition_variable interrupted;
+  bool interruptPending = false;
+
+  WakeupReason sleepUntilWithoutTimer(
+      std::chrono::system_clock::time_point deadline);
+};
+
+/**
+ * Time on the wall clock that is `localDuration` of local time after `from`.
+ * Differs from `from + localDuration` when the UTC offset changes in between,
+ * such as at the start or end of daylight saving time.
+ */
+std::chrono::system_clock::time_point wallClockDeadlineAfter(
+    std::chrono::seconds localDuration,
+    std::chrono::system_clock::time_point from = std::chrono::system_clock::now());
+
+} // namespace dynamic_paper
@@ -0,0 +1,627 @@
+#include "x11_background_setter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include "logger.hpp"
+#include "native_compositor.hpp"
+
+namespace dynamic_paper {
+
+// ===== Helper ===============
+
+namespace {
+
+constexpr std::string_view ROOT_PIXMAP_PROPERTY = "_XROOTPMAP_ID";
+constexpr std::string_view ESETROOT_PIXMAP_PROPERTY = "ESETROOT_PMAP_ID";
+
+constexpr unsigned int CHANNEL_BITS = 8;
+
+/** Code of the last X error, as errors are reported asynchronously */
+std::atomic<int> lastXErrorCode = Success;
+
+int recordXError(Display * /* display */, XErrorEvent *event) {
+  lastXErrorCode = event->error_code;
+  return 0;
+}
+
+/** Index of the pixel of the image each pixel on one axis of the screen
+ * shows, when the image is scaled by `scale` and centered */
+std::vector<std::ptrdiff_t> scaledAxis(const std::size_t imageLength,
+                                       const std::size_t screenLength,
+                                       const double scale) {
+  const double offset = (static_cast<double>(screenLength) -
+                         (static_cast<double>(imageLength) * scale)) /
+                        2.0;
+
+  std::vector<std::ptrdiff_t> axis(screenLength, ScreenMapping::NO_PIXEL);
+  for (std::size_t i = 0; i < screenLength; i++) {
+    const double imageIndex =
+        std::floor((static_cast<double>(i) + 0.5 - offset) / scale);
+    if (imageIndex >= 0.0 && imageIndex < static_cast<double>(imageLength)) {
+      axis[i] = static_cast<std::ptrdiff_t>(imageIndex);
+    }
+  }
+  return axis;
+}
+
+std::vector<std::ptrdiff_t> tiledAxis(const std::size_t imageLength,
+                                      const std::size_t screenLength) {
+  std::vector<std::ptrdiff_t> axis(screenLength);
+  for (std::size_t i = 0; i < screenLength; i++) {
+    axis[i] = static_cast<std::ptrdiff_t>(i % imageLength);
+  }
+  return axis;
+}
+
+/** Converts 8 bit channels to pixels of a TrueColor visual */
+struct PixelFormat {
+  unsigned long redMask;
+  unsigned long greenMask;
+  unsigned long blueMask;
+
+  [[nodiscard]] unsigned long pack(const std::uint8_t red,
+                                   const std::uint8_t green,
+                                   const std::uint8_t blue) const {
+    return packChannel(red, redMask) | packChannel(green, greenMask) |
+           packChannel(blue, blueMask);
+  }
+
+  [[nodiscard]] std::uint8_t unpack(const unsigned long pixel,
+                                    const unsigned long mask) const {
+    const int bits = std::popcount(mask);
+    const unsigned long value = (pixel & mask) >> std::countr_zero(mask);
+    return static_cast<std::uint8_t>(
+        bits >= static_cast<int>(CHANNEL_BITS)
+            ? value >> (bits - CHANNEL_BITS)
+            : value << (CHANNEL_BITS - bits));
+  }
+
+private:
+  static unsigned long packChannel(const std::uint8_t value,
+                                   const unsigned long mask) {
+    const int bits = std::popcount(mask);
+    const unsigned long scaled =
+        bits >= static_cast<int>(CHANNEL_BITS)
+            ? static_cast<unsigned long>(value) << (bits - CHANNEL_BITS)
+            : static_cast<unsigned long>(value) >> (CHANNEL_BITS - bits);
+    return (scaled << std::countr_zero(mask)) & mask;
+  }
+};
+
+/**
+ * Connection to the X server, kept for the whole process so each frame only
+ * has to upload its pixels. The pixmap and the image used to upload to it are
+ * reused for as long as the screen stays the same size.
+ */
+class X11Connection {
+public:
+  /** Connects to the default display, or returns `nullptr` if unable to */
+  static std::unique_ptr<X11Connection> connect() {
+    Display *display = XOpenDisplay(nullptr);
+    if (display == nullptr) {
+      return nullptr;
+    }
+    return std::unique_ptr<X11Connection>(new X11Connection(display));
+  }
+
+  ~X11Connection() {
+    destroyImage();
+    XFreeGC(display, graphicsContext);
+    XCloseDisplay(display);
+  }
+
+  X11Connection(const X11Connection &) = delete;
+  X11Connection &operator=(const X11Connection &) = delete;
+  X11Connection(X11Connection &&) = delete;
+  X11Connection &operator=(X11Connection &&) = delete;
+
+  tl::expected<void, X11BackgroundError>
+  show(const RGBImage &rgbImage, const BackgroundSetMode mode,
+       const std::optional<MonitorArea> &monitor) {
+    if (visual->c_class != TrueColor) {
+      return tl::unexpected(X11BackgroundError::UnsupportedVisual);
+    }
+
+    const auto [screenWidth, screenHeight] = screenSize();
+    if (image == nullptr || image->width != static_cast<int>(screenWidth) ||
+        image->height != static_cast<int>(screenHeight)) {
+      destroyImage();
+      if (!createImage(screenWidth, screenHeight)) {
+        return tl::unexpected(X11BackgroundError::UnableToCreateImage);
+      }
+    }
+
+    // The image keeps what every monitor shows, so showing one monitor leaves
+    // the others as they were
+    const MonitorArea area = areaOnScreen(monitor, screenWidth, screenHeight);
+    drawToImage(rgbImage, mode, area);
+
+    const Pixmap previousPixmap = pixmap;
+    if (pixmap == None || pixmapWidth != screenWidth ||
+        pixmapHeight != screenHeight) {
+      pixmap = XCreatePixmap(display, root, screenWidth, screenHeight, depth);
+      pixmapWidth = screenWidth;
+      pixmapHeight = screenHeight;
+    }
+
+    // New pixmaps start empty, so every monitor is uploaded to them
+    const MonitorArea uploadArea =
+        pixmap != previousPixmap
+            ? MonitorArea{.geometry = {.width = screenWidth,
+                                       .height = screenHeight}}
+            : area;
+    const auto uploadX = static_cast<int>(uploadArea.x);
+    const auto uploadY = static_cast<int>(uploadArea.y);
+    const auto uploadWidth = static_cast<unsigned int>(uploadArea.geometry.width);
+    const auto uploadHeight =
+        static_cast<unsigned int>(uploadArea.geometry.height);
+    if (shmInfo.has_value()) {
+      XShmPutImage(display, pixmap, graphicsContext, image, uploadX, uploadY,
+                   uploadX, uploadY, uploadWidth, uploadHeight, False);
+    } else {
+      XPutImage(display, pixmap, graphicsContext, image, uploadX, uploadY,
+                uploadX, uploadY, uploadWidth, uploadHeight);
+    }
+
+    if (pixmap != previousPixmap) {
+      if (previousPixmap == None) {
+        freeBackgroundOfOtherClient();
+      }
+      setRootPixmapProperties();
+      if (previousPixmap != None) {
+        XFreePixmap(display, previousPixmap);
+      }
+    } else {
+      // Set again so programs watching the properties know it changed
+      setRootPixmapProperties();
+    }
+    XSetWindowBackgroundPixmap(display, root, pixmap);
+    XClearWindow(display, root);
+
+    // Waits for the server to read the image before it is drawn to again
+    XSync(display, False);
+    return {};
+  }
+
+  tl::expected<RGBImage, X11BackgroundError> read() {
+    const std::optional<Pixmap> rootPixmap =
+        pixmapProperty(internAtom(ROOT_PIXMAP_PROPERTY));
+    if (!rootPixmap.has_value()) {
+      return tl::unexpected(X11BackgroundError::NoBackground);
+    }
+
+    Window rootOfPixmap = None;
+    int x = 0;
+    int y = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int borderWidth = 0;
+    unsigned int pixmapDepth = 0;
+    lastXErrorCode = Success;
+    const Status hasGeometry =
+        XGetGeometry(display, rootPixmap.value(), &rootOfPixmap, &x, &y,
+                     &width, &height, &borderWidth, &pixmapDepth);
+    if (hasGeometry == 0 || lastXErrorCode != Success) {
+      return tl::unexpected(X11BackgroundError::NoBackground);
+    }
+
+    XImage *pixmapImage = XGetImage(display, rootPixmap.value(), 0, 0, width,
+                                    height, AllPlanes, ZPixmap);
+    if (pixmapImage == nullptr) {
+      return tl::unexpected(X11BackgroundError::NoBackground);
+    }
+
+    // Pixmaps have no visual, so their pixels are read like the screen's
+    RGBImage rgbImage(width, height);
+    std::uint8_t *destination = rgbImage.pixels.data();
+    for (unsigned int row = 0; row < height; row++) {
+      for (unsigned int column = 0; column < width; column++) {
+        const unsigned long pixel = XGetPixel(
+            pixmapImage, static_cast<int>(column), static_cast<int>(row));
+        *destination++ = format.unpack(pixel, format.redMask);
+        *destination++ = format.unpack(pixel, format.greenMask);
+        *destination++ = format.unpack(pixel, format.blueMask);
+      }
+    }
+    XDestroyImage(pixmapImage);
+    return rgbImage;
+  }
+
+private:
+  explicit X11Connection(Display *display)
+      : display(display), screen(DefaultScreen(display)),
+        root(DefaultRootWindow(display)),
+        visual(DefaultVisual(display, screen)),
+        depth(static_cast<unsigned int>(DefaultDepth(display, screen))),
+        graphicsContext(XCreateGC(display, root, 0, nullptr)),
+        format({.redMask = visual->red_mask,
+                .greenMask = visual->green_mask,
+                .blueMask = visual->blue_mask}),
+        supportsShm(XShmQueryExtension(display) != 0) {
+    XSetErrorHandler(recordXError);
+    // Keeps the background once the program exits
+    XSetCloseDownMode(display, RetainPermanent);
+  }
+
+  Display *display;
+  int screen;
+  Window root;
+  Visual *visual;
+  unsigned int depth;
+  GC graphicsContext;
+  PixelFormat format;
+  bool supportsShm;
+
+  XImage *image = nullptr;
+  std::optional<XShmSegmentInfo> shmInfo = std::nullopt;
+
+  Pixmap pixmap = None;
+  unsigned int pixmapWidth = 0;
+  unsigned int pixmapHeight = 0;
+
+  [[nodiscard]] std::pair<unsigned int, unsigned int> screenSize() const {
+    XWindowAttributes attributes;
+    XGetWindowAttributes(display, root, &attributes);
+    return {static_cast<unsigned int>(attributes.width),
+            static_cast<unsigned int>(attributes.height)};
+  }
+
+  /** Part of the screen `monitor` covers, or the whole screen if `nullopt`,
+   * clipped to the screen */
+  static MonitorArea areaOnScreen(const std::optional<MonitorArea> &monitor,
+                                  const std::size_t screenWidth,
+                                  const std::size_t screenHeight) {
+    if (!monitor.has_value()) {
+      return {.geometry = {.width = screenWidth, .height = screenHeight}};
+    }
+
+    MonitorArea area = monitor.value();
+    area.x = std::min(area.x, screenWidth);
+    area.y = std::min(area.y, screenHeight);
+    area.geometry.width = std::min(area.geometry.width, screenWidth - area.x);
+    area.geometry.height =
+        std::min(area.geometry.height, screenHeight - area.y);
+    return area;
+  }
+
+  [[nodiscard]] Atom internAtom(const std::string_view name) const {
+    return XInternAtom(display, name.data(), False);
+  }
+
+  /** Creates the image frames are drawn to before uploading, in shared memory
+   * if the server can attach to it */
+  bool createImage(const unsigned int width, const unsigned int height) {
+    if (supportsShm && createSharedImage(width, height)) {
+      return true;
+    }
+
+    image = XCreateImage(display, visual, depth, ZPixmap, 0, nullptr, width,
+                         height, BitmapPad(display), 0);
+    if (image == nullptr) {
+      return false;
+    }
+    // Freed by `XDestroyImage`
+    image->data = static_cast<char *>(
+        std::malloc(static_cast<std::size_t>(image->bytes_per_line) * height));
+    if (image->data == nullptr) {
+      XDestroyImage(image);
+      image = nullptr;
+      return false;
+    }
+    clearImage();
+    logDebug("Uploading backgrounds without shared memory");
+    return true;
+  }
+
+  bool createSharedImage(const unsigned int width, const unsigned int height) {
+    XShmSegmentInfo info{};
+    XImage *sharedImage = XShmCreateImage(display, visual, depth, ZPixmap,
+                                          nullptr, &info, width, height);
+    if (sharedImage == nullptr) {
+      return false;
+    }
+
+    info.shmid = shmget(IPC_PRIVATE,
+                        static_cast<std::size_t>(sharedImage->bytes_per_line) *
+                            height,
+                        IPC_CREAT | 0600); // NOLINT
+    if (info.shmid < 0) {
+      XDestroyImage(sharedImage);
+      return false;
+    }
+    info.shmaddr = static_cast<char *>(shmat(info.shmid, nullptr, 0));
+    sharedImage->data = info.shmaddr;
+    info.readOnly = False;
+
+    // Attaching fails on displays on other machines, which is only reported
+    // once the server has handled the request
+    lastXErrorCode = Success;
+    const bool mapped = info.shmaddr != reinterpret_cast<char *>(-1); // NOLINT
+    const bool attached = mapped && XShmAttach(display, &info) != 0;
+    XSync(display, False);
+    // Removed once both the server and this process detach from it
+    shmctl(info.shmid, IPC_RMID, nullptr);
+
+    if (!attached || lastXErrorCode != Success) {
+      if (mapped) {
+        shmdt(info.shmaddr);
+      }
+      XDestroyImage(sharedImage);
+      supportsShm = false;
+      return false;
+    }
+
+    image = sharedImage;
+    shmInfo = info;
+    clearImage();
+    return true;
+  }
+
+  /** Fills the image with black, so monitors not shown yet are black */
+  void clearImage() {
+    std::memset(image->data, 0,
+                static_cast<std::size_t>(image->bytes_per_line) *
+                    static_cast<std::size_t>(image->height));
+  }
+
+  void destroyImage() {
+    if (image == nullptr) {
+      return;
+    }
+    if (shmInfo.has_value()) {
+      XShmDetach(display, &shmInfo.value());
+      XSync(display, False);
+      XDestroyImage(image);
+      shmdt(shmInfo->shmaddr);
+      shmInfo = std::nullopt;
+    } else {
+      XDestroyImage(image);
+    }
+    image = nullptr;
+  }
+
+  /** Draws `rgbImage` to `area` of the image, shown with `mode` */
+  void drawToImage(const RGBImage &rgbImage, const BackgroundSetMode mode,
+                   const MonitorArea &area) {
+    const std::size_t width = area.geometry.width;
+    const std::size_t height = area.geometry.height;
+    const ScreenMapping mapping =
+        screenMapping(rgbImage.width, rgbImage.height, width, height, mode);
+
+    constexpr int PIXEL_BITS = 32;
+    const bool nativeByteOrder =
+        (image->byte_order == LSBFirst) ==
+        (std::endian::native == std::endian::little);
+    const bool packsWords =
+        image->bits_per_pixel == PIXEL_BITS && nativeByteOrder;
+
+    for (std::size_t row = 0; row < height; row++) {
+      const std::ptrdiff_t imageRow = mapping.rows[row];
+      const std::uint8_t *sourceRow =
+          imageRow == ScreenMapping::NO_PIXEL
+              ? nullptr
+              : rgbImage.pixels.data() + (static_cast<std::size_t>(imageRow) *
+                                          rgbImage.width * RGBImage::CHANNELS);
+      char *destinationRow =
+          image->data + ((area.y + row) *
+                         static_cast<std::size_t>(image->bytes_per_line));
+
+      for (std::size_t column = 0; column < width; column++) {
+        const std::ptrdiff_t imageColumn = mapping.columns[column];
+        unsigned long pixel = 0;
+        if (sourceRow != nullptr && imageColumn != ScreenMapping::NO_PIXEL) {
+          const std::uint8_t *source =
+              sourceRow + (static_cast<std::size_t>(imageColumn) *
+                           RGBImage::CHANNELS);
+          pixel = format.pack(source[0], source[1], source[2]);
+        }
+
+        if (packsWords) {
+          const auto word = static_cast<std::uint32_t>(pixel);
+          std::memcpy(destinationRow + ((area.x + column) * sizeof(word)),
+                      &word, sizeof(word));
+        } else {
+          XPutPixel(image, static_cast<int>(area.x + column),
+                    static_cast<int>(area.y + row), pixel);
+        }
+      }
+    }
+  }
+
+  [[nodiscard]] std::optional<Pixmap>
+  pixmapProperty(const Atom property) const {
+    Atom type = None;
+    int propertyFormat = 0;
+    unsigned long numberItems = 0;
+    unsigned long bytesAfter = 0;
+    unsigned char *data = nullptr;
+    const int result = XGetWindowProperty(
+        display, root, property, 0, 1, False, XA_PIXMAP, &type,
+        &propertyFormat, &numberItems, &bytesAfter, &data);
+
+    std::optional<Pixmap> pixmapId = std::nullopt;
+    if (result == Success && type == XA_PIXMAP && numberItems == 1 &&
+        data != nullptr) {
+      pixmapId = *reinterpret_cast<Pixmap *>(data); // NOLINT
+    }
+    if (data != nullptr) {
+      XFree(data);
+    }
+    return pixmapId;
+  }
+
+  /**
+   * Frees the background another program left behind, as programs that set
+   * `ESETROOT_PMAP_ID` keep their pixmap once they exit and expect the next
+   * one to free it.
+   */
+  void freeBackgroundOfOtherClient() {
+    const std::optional<Pixmap> rootPixmap =
+        pixmapProperty(internAtom(ROOT_PIXMAP_PROPERTY));
+    const std::optional<Pixmap> esetrootPixmap =
+        pixmapProperty(internAtom(ESETROOT_PIXMAP_PROPERTY));
+    if (rootPixmap.has_value() && rootPixmap == esetrootPixmap) {
+      lastXErrorCode = Success;
+      XKillClient(display, rootPixmap.value());
+      XSync(display, False);
+      if (lastXErrorCode != Success) {
+        logDebug("Previous background pixmap was already freed");
+      }
+    }
+  }
+
+  void setRootPixmapProperties() {
+    for (const std::string_view property :
+         {ROOT_PIXMAP_PROPERTY, ESETROOT_PIXMAP_PROPERTY}) {
+      XChangeProperty(display, root, internAtom(property), XA_PIXMAP, 32,
+                      PropModeReplace,
+                      reinterpret_cast<unsigned char *>(&pixmap), 1); // NOLINT
+    }
+  }
+};
+
+struct SharedConnection {
+  std::mutex mutex;
+  std::unique_ptr<X11Connection> connection;
+};
+
+SharedConnection &sharedConnection() {
+  static SharedConnection shared;
+  return shared;
+}
+
+/** Runs `fn` with the connection to the default display, connecting to it
+ * if not already */
+template <typename Result, typename F>
+tl::expected<Result, X11BackgroundError> withConnection(F &&fn) {
+  SharedConnection &shared = sharedConnection();
+  const std::scoped_lock lock(shared.mutex);
+  if (shared.connection == nullptr) {
+    shared.connection = X11Connection::connect();
+    if (shared.connection == nullptr) {
+      return tl::unexpected(X11BackgroundError::NoDisplay);
+    }
+  }
+  return std::forward<F>(fn)(*shared.connection);
+}
+
+void logX11BackgroundError(const X11BackgroundError error) {
+  switch (error) {
+  case X11BackgroundError::NoDisplay: {
+    logError("Unable to set the background: could not connect to an X11 "
+             "display");
+    break;
+  }
+  case X11BackgroundError::UnsupportedVisual: {
+    logError("Unable to set the background: the X11 display does not use "
+             "TrueColor");
+    break;
+  }
+  case X11BackgroundError::UnableToCreateImage: {
+    logError("Unable to set the background: could not create an image to "
+             "upload to the X11 display");
+    break;
+  }
+  case X11BackgroundError::NoBackground: {
+    logError("Unable to set the background: no background pixmap");
+    break;
+  }
+  }
+}
+
+} // namespace
+
+// ===== Header ===============
+
+ScreenMapping screenMapping(const std::size_t imageWidth,
+                            const std::size_t imageHeight,
+                            const std::size_t screenWidth,
+                            const std::size_t screenHeight,
+                            const BackgroundSetMode mode) {
+  if (imageWidth == 0 || imageHeight == 0) {
+    return {
+        .columns = std::vector<std::ptrdiff_t>(screenWidth,
+                                               ScreenMapping::NO_PIXEL),
+        .rows = std::vector<std::ptrdiff_t>(screenHeight,
+                                            ScreenMapping::NO_PIXEL)};
+  }
+
+  const double widthScale =
+      static_cast<double>(screenWidth) / static_cast<double>(imageWidth);
+  const double heightScale =
+      static_cast<double>(screenHeight) / static_cast<double>(imageHeight);
+
+  switch (mode) {
+  case BackgroundSetMode::Center: {
+    return {.columns = scaledAxis(imageWidth, screenWidth, 1.0),
+            .rows = scaledAxis(imageHeight, screenHeight, 1.0)};
+  }
+  case BackgroundSetMode::Fill: {
+    const double scale = std::max(widthScale, heightScale);
+    return {.columns = scaledAxis(imageWidth, screenWidth, scale),
+            .rows = scaledAxis(imageHeight, screenHeight, scale)};
+  }
+  case BackgroundSetMode::Tile: {
+    return {.columns = tiledAxis(imageWidth, screenWidth),
+            .rows = tiledAxis(imageHeight, screenHeight)};
+  }
+  case BackgroundSetMode::Scale: {
+    return {.columns = scaledAxis(imageWidth, screenWidth, widthScale),
+            .rows = scaledAxis(imageHeight, screenHeight, heightScale)};
+  }
+  }
+
+  logAssert(false, "Unable to map image to the screen with passed mode");
+  return {};
+}
+
+tl::expected<void, X11BackgroundError>
+setX11Background(const RGBImage &image, const BackgroundSetMode mode,
+                 const std::optional<MonitorArea> &monitor) {
+  return withConnection<void>(
+      [&image, mode, &monitor](X11Connection &connection) {
+        return connection.show(image, mode, monitor);
+      });
+}
+
+tl::expected<RGBImage, X11BackgroundError> getX11Background() {
+  return withConnection<RGBImage>(
+      [](X11Connection &connection) { return connection.read(); });
+}
+
+void X11BackgroundSetter::operator()(const std::filesystem::path &imagePath,
+                                     const BackgroundSetMode mode) const {
+  logTrace("Setting background to image ({})", imagePath.string());
+
+  (*this)(readRGBImage(imagePath), mode);
+}
+
+void X11BackgroundSetter::operator()(const RGBImage &frame,
+                                     const BackgroundSetMode mode) const {
+  // Shows the whole screen if the monitor is unplugged
+  const std::optional<MonitorArea> monitor =
+      output.has_value() ? queryMonitorArea(output.value()) : std::nullopt;
+  const tl::expected<void, X11BackgroundError> result =
+      setX11Background(frame, mode, monitor);
+  if (!result.has_value()) {
+    logX11BackgroundError(result.error());
+  }
+}
+
+} // namespace dynamic_paper
@@ -0,0 +1,90 @@
+#pragma once
+
+/**
+ * Sets the background of an X11 display from decoded images, by uploading
+ * them to the pixmap the root window shows. Frames of a transition are shown
+ * straight from memory, without being written to a file and decoded again.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include "background_set_enums.hpp"
+#include "display_geometry.hpp"
+#include "rgb_image.hpp"
+
+namespace dynamic_paper {
+
+/** Errors that can occur when showing an image on an X11 display */
+enum class X11BackgroundError : std::uint8_t {
+  NoDisplay,
+  UnsupportedVisual,
+  UnableToCreateImage,
+  NoBackground,
+};
+
+/**
+ * Which pixel of an image each pixel of the screen shows. The pixel of the
+ * screen at (x, y) shows the image's pixel at (`columns[x]`, `rows[y]`), or
+ * black if either is `NO_PIXEL`.
+ */
+struct ScreenMapping {
+  static constexpr std::ptrdiff_t NO_PIXEL = -1;
+
+  std::vector<std::ptrdiff_t> columns;
+  std::vector<std::ptrdiff_t> rows;
+};
+
+/**
+ * Returns how an image of `imageWidth` x `imageHeight` is shown on a screen
+ * of `screenWidth` x `screenHeight` with `mode`:
+ * - Center: not scaled, in the middle of the screen
+ * - Fill: scaled to cover the screen keeping its aspect ratio, cropping the
+ *   sides that don't fit
+ * - Tile: not scaled, repeated from the top left of the screen
+ * - Scale: stretched to the size of the screen
+ */
+ScreenMapping screenMapping(std::size_t imageWidth, std::size_t imageHeight,
+                            std::size_t screenWidth, std::size_t screenHeight,
+                            BackgroundSetMode mode);
+
+/**
+ * Shows `image` as the background of the default X11 display, scaled using
+ * `mode`. If `monitor` is given the image only covers that part of the screen,
+ * and the rest keeps what it showed before.
+ *
+ * The connection to the display is kept open between calls, and the image is
+ * uploaded through shared memory (MIT-SHM) when the display supports it.
+ * `_XROOTPMAP_ID` and `ESETROOT_PMAP_ID` are set to the pixmap shown, so
+ * compositors and pseudo transparent programs see the new background. The
+ * pixmap is kept once the program exits.
+ */
+tl::expected<void, X11BackgroundError>
+setX11Background(const RGBImage &image, BackgroundSetMode mode,
+                 const std::optional<MonitorArea> &monitor = std::nullopt);
+
+/** Returns the background shown on the default X11 display, read from the
+ * pixmap in `_XROOTPMAP_ID` */
+tl::expected<RGBImage, X11BackgroundError> getX11Background();
+
+/**
+ * Sets the background using `setX11Background`. Transitions show their frames
+ * with it directly, while images given by path are decoded first.
+ */
+struct X11BackgroundSetter {
+  /** Name of the monitor to show backgrounds on, or `nullopt` for the whole
+   * screen. See `queryMonitorArea` */
+  std::optional<std::string> output = std::nullopt;
+
+  void operator()(const std::filesystem::path &imagePath,
+                  BackgroundSetMode mode) const;
+  void operator()(const RGBImage &frame, BackgroundSetMode mode) const;
+};
+
+} // namespace dynamic_paper
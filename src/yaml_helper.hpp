@@ -11,11 +11,14 @@
 
 #include "background_set_enums.hpp"
 #include "background_set_method.hpp"
+#include "byte_size.hpp"
 #include "constants.hpp"
+#include "display_geometry.hpp"
 #include "logger.hpp"
 #include "string_util.hpp"
 #include "time_from_midnight.hpp"
 #include "time_util.hpp"
+#include "transition_frame_format.hpp"
 #include "type_helper.hpp"
 
 namespace dynamic_paper {
@@ -94,6 +97,16 @@ template <typename T> constexpr std::optional<T> yamlStringTo(const std::string
   return std::nullopt;
 }
 
+// - ByteSize
+template <> constexpr std::optional<ByteSize> yamlStringTo(const std::string &text) {
+  return parseByteSize(text);
+}
+
+// - DisplayGeometry
+template <> constexpr std::optional<DisplayGeometry> yamlStringTo(const std::string &text) {
+  return parseDisplayGeometry(text);
+}
+
 // --- Specialization Matching string to enums
 
 // - BackgroundSetMode
@@ -107,6 +120,9 @@ template <> constexpr std::optional<BackgroundSetMethod> yamlStringTo(const std:
   if (configString == WALLUTILS_STRING) {
     return std::make_optional(BackgroundSetMethod(MethodWallUtils{}));
   }
+  if (configString == X11_STRING) {
+    return std::make_optional(BackgroundSetMethod(MethodX11{}));
+  }
 
   if (std::filesystem::exists(configString)) {
     return std::make_optional(BackgroundSetMethod(std::filesystem::path(configString)));
@@ -114,6 +130,11 @@ template <> constexpr std::optional<BackgroundSetMethod> yamlStringTo(const std:
   return std::nullopt;
 }
 
+// - TransitionFrameFormat
+template <> constexpr std::optional<TransitionFrameFormat> yamlStringTo(const std::string &text) {
+  return stringToTransitionFrameFormat(text);
+}
+
 // - BackgroundSetOrder
 template <> constexpr std::optional<BackgroundSetOrder> yamlStringTo(const std::string &text) {
   const std::string configString = normalize(text);
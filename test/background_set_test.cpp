@@ -21,6 +21,7 @@
 #include "src/background_set.hpp"
 #include "src/background_set_enums.hpp"
 #include "src/config.hpp"
+#include "src/defaults.hpp"
 #include "src/dynamic_background_set.hpp"
 #include "src/file_util.hpp"
 #include "src/solar_day.hpp"
@@ -204,6 +205,20 @@ dynamic_paper:
     - "sunset"
 )"""";
 
+const std::string_view DYNAMIC_BACKGROUND_AUTO_STEPS = R""""(
+dynamic_paper:
+  image_directory: "./backgrounds/dynamic"
+  type: dynamic
+  transition_length: 55
+  number_transition_steps: auto
+  images:
+    - 1.jpg
+    - 2.jpg
+  times:
+    - "00:00"
+    - "01:00"
+)"""";
+
 const std::string_view DYNAMIC_BACKGROUND_NOT_IN_PLACE = R""""(
 dynamic_paper:
   image_directory: "./backgrounds/dynamic"
@@ -543,3 +558,20 @@ TEST_F(BackgroundSetTests, DynamicBackgroundSetInPlaceIsFalse) {
               ElementsAre(sunriseTime - std::chrono::hours(1), sunriseTime,
                           sunsetTime - std::chrono::hours(1), sunsetTime));
 }
+
+TEST_F(BackgroundSetTests, DynamicBackgroundSetAutoSteps) {
+  BackgroundSet backgroundSet =
+      getBackgroundSetFrom(DYNAMIC_BACKGROUND_AUTO_STEPS);
+
+  const std::optional<DynamicBackgroundData> dynamicData =
+      backgroundSet.getDynamicBackgroundData();
+  EXPECT_TRUE(dynamicData.has_value());
+  assert(dynamicData.has_value());
+
+  EXPECT_EQ(dynamicData->transition.has_value(), true);
+  assert(dynamicData->transition.has_value());
+  EXPECT_EQ(dynamicData->transition->duration, std::chrono::seconds(55));
+  EXPECT_TRUE(dynamicData->transition->autoSteps);
+  EXPECT_EQ(dynamicData->transition->steps,
+            BackgroundSetDefaults::transitionSteps);
+}
@@ -0,0 +1,200 @@
+/**
+ *   Test naming cached images after the content of their source images
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "helper.hpp"
+#include "src/cache_key.hpp"
+#include "src/transition_info.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+/** Cache directory and some source images, removed once the test finishes */
+class TemporaryImages {
+public:
+  TemporaryImages() { std::filesystem::create_directories(cache); }
+
+  /** Creates the image `name` containing `content`, returning its path */
+  [[nodiscard]] std::filesystem::path
+  createImage(const std::filesystem::path &name,
+              const std::string &content) const {
+    std::filesystem::create_directories((path / name).parent_path());
+    std::ofstream(path / name) << content;
+    return path / name;
+  }
+
+  TemporaryDirectory directory;
+  std::filesystem::path path = directory.path;
+  std::filesystem::path cache = path / "cache";
+};
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(CacheKey, FileNameFormat) {
+  const TransitionCacheKey key = {
+      .startDigest = 0xAB, .endDigest = 0x12345, .extension = ".jpg"};
+  EXPECT_EQ(key.imageFileName(33), "00000000000000ab-0000000000012345-33.jpg");
+}
+
+TEST(CacheKey, FileNameIncludesDisplayTag) {
+  const TransitionCacheKey key = {.startDigest = 0xAB,
+                                  .endDigest = 0x12345,
+                                  .extension = ".jpg",
+                                  .reversed = false,
+                                  .displayTag = "fill-1920x1080"};
+  EXPECT_EQ(key.imageFileName(33),
+            "00000000000000ab-0000000000012345-fill-1920x1080-33.jpg");
+}
+
+TEST(CacheKey, SameContentSharesKey) {
+  const TemporaryImages images;
+  const std::filesystem::path dawn = images.createImage("one/dawn.jpg", "dawn");
+  const std::filesystem::path day = images.createImage("one/day.jpg", "day");
+  // Same images in a directory with the same name, and renamed
+  const std::filesystem::path copiedDawn =
+      images.createImage("two/one/sunrise.jpg", "dawn");
+  const std::filesystem::path copiedDay =
+      images.createImage("two/one/noon.jpg", "day");
+
+  const std::optional<TransitionCacheKey> key =
+      transitionCacheKey(dawn, day, ".jpg", images.cache);
+  const std::optional<TransitionCacheKey> copiedKey =
+      transitionCacheKey(copiedDawn, copiedDay, ".jpg", images.cache);
+
+  ASSERT_TRUE(key.has_value());
+  ASSERT_TRUE(copiedKey.has_value());
+  EXPECT_EQ(key->imageFileName(50), copiedKey->imageFileName(50));
+  EXPECT_NE(key->startDigest, key->endDigest);
+}
+
+TEST(CacheKey, ReversedTransitionSharesImages) {
+  const TemporaryImages images;
+  const std::filesystem::path dawn = images.createImage("dawn.jpg", "dawn");
+  const std::filesystem::path day = images.createImage("day.jpg", "day");
+
+  const std::optional<TransitionCacheKey> dawnToDay =
+      transitionCacheKey(dawn, day, ".jpg", images.cache);
+  const std::optional<TransitionCacheKey> dayToDawn =
+      transitionCacheKey(day, dawn, ".jpg", images.cache);
+
+  ASSERT_TRUE(dawnToDay.has_value());
+  ASSERT_TRUE(dayToDawn.has_value());
+  EXPECT_NE(dawnToDay->reversed, dayToDawn->reversed);
+  for (unsigned int percentage = 1; percentage < 100; percentage++) {
+    EXPECT_EQ(dawnToDay->imageFileName(percentage),
+              dayToDawn->imageFileName(100 - percentage));
+  }
+}
+
+TEST(CacheKey, DisplaySizesDontShareImages) {
+  const TemporaryImages images;
+  const std::filesystem::path dawn = images.createImage("dawn.jpg", "dawn");
+  const std::filesystem::path day = images.createImage("day.jpg", "day");
+
+  const std::optional<TransitionCacheKey> fullSize =
+      transitionCacheKey(dawn, day, ".jpg", images.cache);
+  const std::optional<TransitionCacheKey> smallDisplay =
+      transitionCacheKey(dawn, day, ".jpg", images.cache, "fill-1280x720");
+  const std::optional<TransitionCacheKey> largeDisplay =
+      transitionCacheKey(dawn, day, ".jpg", images.cache, "fill-1920x1080");
+
+  ASSERT_TRUE(fullSize.has_value());
+  ASSERT_TRUE(smallDisplay.has_value());
+  ASSERT_TRUE(largeDisplay.has_value());
+  EXPECT_NE(fullSize->imageFileName(50), smallDisplay->imageFileName(50));
+  EXPECT_NE(smallDisplay->imageFileName(50), largeDisplay->imageFileName(50));
+}
+
+TEST(CacheKey, PercentageStepSharesImages) {
+  const TransitionInfo threeSteps(std::chrono::seconds(1), 3, false);
+  const TransitionInfo fourSteps(std::chrono::seconds(1), 4, false);
+
+  EXPECT_EQ(threeSteps.stepPercentages(), std::vector<unsigned int>({25, 50, 75}));
+  EXPECT_EQ(fourSteps.stepPercentages(),
+            std::vector<unsigned int>({20, 40, 60, 80}));
+  EXPECT_EQ(threeSteps.stepPercentages(10),
+            std::vector<unsigned int>({30, 50, 80}));
+  EXPECT_EQ(fourSteps.stepPercentages(10),
+            std::vector<unsigned int>({20, 40, 60, 80}));
+
+  // Never rounded to an image that is only the start or end image
+  EXPECT_EQ(TransitionInfo::snapPercentage(1, 10), 10U);
+  EXPECT_EQ(TransitionInfo::snapPercentage(98, 10), 90U);
+  EXPECT_EQ(TransitionInfo::snapPercentage(99, 50), 50U);
+}
+
+TEST(CacheKey, EditedImageChangesOnlyItsKeys) {
+  const TemporaryImages images;
+  const std::filesystem::path dawn = images.createImage("dawn.jpg", "dawn");
+  const std::filesystem::path day = images.createImage("day.jpg", "day");
+  const std::filesystem::path dusk = images.createImage("dusk.jpg", "dusk");
+
+  const std::optional<TransitionCacheKey> dawnToDay =
+      transitionCacheKey(dawn, day, ".jpg", images.cache);
+  const std::optional<TransitionCacheKey> dayToDusk =
+      transitionCacheKey(day, dusk, ".jpg", images.cache);
+
+  std::ofstream(dawn) << "edited dawn";
+
+  const std::optional<TransitionCacheKey> editedDawnToDay =
+      transitionCacheKey(dawn, day, ".jpg", images.cache);
+  const std::optional<TransitionCacheKey> editedDayToDusk =
+      transitionCacheKey(day, dusk, ".jpg", images.cache);
+
+  EXPECT_NE(dawnToDay->imageFileName(50), editedDawnToDay->imageFileName(50));
+  EXPECT_EQ(dayToDusk->imageFileName(50), editedDayToDusk->imageFileName(50));
+}
+
+TEST(CacheKey, UnchangedSizeAndTimeSkipsHashing) {
+  const TemporaryImages images;
+  const std::filesystem::path dawn = images.createImage("dawn.jpg", "dawn");
+  const std::optional<std::uint64_t> digest =
+      sourceImageDigest(dawn, images.cache);
+  ASSERT_TRUE(digest.has_value());
+  EXPECT_TRUE(
+      std::filesystem::exists(images.cache / SOURCE_FINGERPRINTS_FILE_NAME));
+
+  // Same size and modification time, so the saved digest is trusted
+  const std::filesystem::file_time_type modifiedTime =
+      std::filesystem::last_write_time(dawn);
+  std::ofstream(dawn) << "DAWN";
+  std::filesystem::last_write_time(dawn, modifiedTime);
+  EXPECT_EQ(sourceImageDigest(dawn, images.cache), digest);
+
+  std::filesystem::last_write_time(dawn,
+                                   modifiedTime + std::chrono::seconds(1));
+  EXPECT_NE(sourceImageDigest(dawn, images.cache), digest);
+}
+
+TEST(CacheKey, MissingImageHasNoKey) {
+  const TemporaryImages images;
+  const std::filesystem::path dawn = images.createImage("dawn.jpg", "dawn");
+
+  EXPECT_EQ(transitionCacheKey(dawn, images.path / "missing.jpg", ".jpg",
+                               images.cache),
+            std::nullopt);
+}
+
+TEST(CacheKey, ForgetsMissingImages) {
+  const TemporaryImages images;
+  const std::filesystem::path dawn = images.createImage("dawn.jpg", "dawn");
+  const std::filesystem::path day = images.createImage("day.jpg", "day");
+  ASSERT_TRUE(transitionCacheKey(dawn, day, ".jpg", images.cache));
+
+  std::filesystem::remove(day);
+
+  EXPECT_EQ(forgetMissingSourceImages(images.cache), 1U);
+  EXPECT_EQ(forgetMissingSourceImages(images.cache), 0U);
+}
@@ -0,0 +1,205 @@
+/**
+ *   Test the memory mapped index of the images in the cache
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "helper.hpp"
+#include "src/cache_manifest.hpp"
+#include "src/format.hpp"
+#include "src/hash.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+/** Name of an image the cache could have made */
+constexpr const char *CACHED_IMAGE_NAME =
+    "0123456789abcdef-fedcba9876543210-0.jpg";
+
+CacheManifestEntry makeEntry(const std::string &fileName,
+                             const std::uintmax_t size) {
+  return {.fileName = fileName,
+          .size = {size},
+          .lastUsed = std::chrono::system_clock::now()};
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(XXHash64, KnownValues) {
+  EXPECT_EQ(xxHash64(""), 0xEF46DB3751D8E999ULL);
+  EXPECT_EQ(xxHash64("a"), 0xD24EC4F1A98C6E5BULL);
+  EXPECT_EQ(xxHash64("abc"), 0x44BC2CF5AD770999ULL);
+  EXPECT_EQ(xxHash64("Nobody inspects the spammish repetition"),
+            0xFBCEA83C8A378BF1ULL);
+}
+
+TEST(XXHash64, PiecesHashLikeTheWhole) {
+  std::string data;
+  for (int i = 0; i < 1000; i++) {
+    data += static_cast<char>(i * 7);
+  }
+
+  XXHash64 hasher;
+  for (std::size_t i = 0; i < data.size(); i += 13) {
+    hasher.update(std::string_view(data).substr(i, 13));
+  }
+  EXPECT_EQ(hasher.digest(), xxHash64(data));
+}
+
+TEST(CacheManifest, EmptyWithoutImages) {
+  const TemporaryDirectory cache;;
+  const CacheManifest manifest(cache.path);
+
+  EXPECT_FALSE(manifest.contains("image.jpg"));
+  EXPECT_EQ(manifest.numberImages(), 0U);
+  EXPECT_EQ(manifest.totalSize(), ByteSize{0});
+  EXPECT_FALSE(std::filesystem::exists(cache.path / CACHE_MANIFEST_FILE_NAME));
+}
+
+TEST(CacheManifest, AddedImagesAreSaved) {
+  const TemporaryDirectory cache;;
+  const std::vector<CacheManifestEntry> entries = {makeEntry("a.jpg", 10),
+                                                   makeEntry("b.jpg", 20)};
+  {
+    CacheManifest manifest(cache.path);
+    EXPECT_TRUE(manifest.add(entries));
+    EXPECT_TRUE(manifest.contains("a.jpg"));
+    EXPECT_FALSE(manifest.contains("c.jpg"));
+  }
+
+  const CacheManifest reopened(cache.path);
+  EXPECT_EQ(reopened.numberImages(), 2U);
+  EXPECT_EQ(reopened.totalSize(), ByteSize{30});
+  EXPECT_EQ(reopened.find("b.jpg"), entries[1]);
+}
+
+TEST(CacheManifest, HoldsManyImages) {
+  const TemporaryDirectory cache;;
+  CacheManifest manifest(cache.path);
+
+  std::vector<CacheManifestEntry> entries;
+  for (int i = 0; i < 1000; i++) {
+    entries.push_back(makeEntry(dynamic_paper::format("image-{}.jpg", i), 1));
+  }
+  ASSERT_TRUE(manifest.add(entries));
+
+  EXPECT_EQ(manifest.numberImages(), 1000U);
+  EXPECT_EQ(manifest.entries().size(), 1000U);
+  for (const CacheManifestEntry &entry : entries) {
+    EXPECT_TRUE(manifest.contains(entry.fileName)) << entry.fileName;
+  }
+}
+
+TEST(CacheManifest, SeesChangesFromOtherManifests) {
+  const TemporaryDirectory cache;;
+  CacheManifest first(cache.path);
+  CacheManifest second(cache.path);
+
+  const std::vector<CacheManifestEntry> firstEntries = {makeEntry("a.jpg", 1)};
+  ASSERT_TRUE(first.add(firstEntries));
+  EXPECT_FALSE(second.contains("a.jpg"));
+  second.refresh();
+  EXPECT_TRUE(second.contains("a.jpg"));
+
+  // Changes are made to the newest manifest, so neither image is lost
+  const std::vector<CacheManifestEntry> secondEntries = {
+      makeEntry("b.jpg", 1)};
+  ASSERT_TRUE(second.add(secondEntries));
+  first.refresh();
+  EXPECT_TRUE(first.contains("a.jpg"));
+  EXPECT_TRUE(first.contains("b.jpg"));
+}
+
+TEST(CacheManifest, MarkingUsedUpdatesTime) {
+  const TemporaryDirectory cache;;
+  CacheManifest manifest(cache.path);
+
+  CacheManifestEntry entry = makeEntry("a.jpg", 1);
+  entry.lastUsed -= std::chrono::hours(1);
+  ASSERT_TRUE(manifest.add(std::span(&entry, 1)));
+
+  const std::vector<std::string> usedImages = {"a.jpg", "missing.jpg"};
+  ASSERT_TRUE(manifest.markUsed(usedImages));
+
+  EXPECT_GT(manifest.find("a.jpg")->lastUsed, entry.lastUsed);
+  EXPECT_FALSE(manifest.contains("missing.jpg"));
+}
+
+TEST(CacheManifest, MarkingUsedWritesInPlace) {
+  const TemporaryDirectory cache;;
+  CacheManifest first(cache.path);
+  CacheManifest second(cache.path);
+
+  CacheManifestEntry entry = makeEntry("a.jpg", 1);
+  entry.lastUsed -= std::chrono::hours(1);
+  ASSERT_TRUE(first.add(std::span(&entry, 1)));
+  second.refresh();
+  const std::filesystem::path manifestPath =
+      cache.path / CACHE_MANIFEST_FILE_NAME;
+  struct stat before {};
+  ASSERT_EQ(stat(manifestPath.c_str(), &before), 0);
+
+  const std::vector<std::string> usedImages = {"a.jpg"};
+  ASSERT_TRUE(first.markUsed(usedImages));
+
+  // The same file is changed, so mappings of it see the new time
+  struct stat after {};
+  ASSERT_EQ(stat(manifestPath.c_str(), &after), 0);
+  EXPECT_EQ(after.st_ino, before.st_ino);
+  EXPECT_GT(second.find("a.jpg")->lastUsed, entry.lastUsed);
+  EXPECT_EQ(first.find("a.jpg")->lastUsed, second.find("a.jpg")->lastUsed);
+}
+
+TEST(CacheManifest, RebuiltFromDirectory) {
+  const TemporaryDirectory cache;;
+  const std::string partialName =
+      std::string(CACHED_IMAGE_NAME) + ".partial-1";
+  std::ofstream(cache.path / CACHED_IMAGE_NAME) << "1234";
+  std::ofstream(cache.path / partialName) << "1234";
+  // Not made by the cache
+  std::ofstream(cache.path / "notes.txt") << "1234";
+
+  const CacheManifest manifest(cache.path);
+
+  EXPECT_TRUE(manifest.contains(CACHED_IMAGE_NAME));
+  EXPECT_FALSE(manifest.contains(partialName));
+  EXPECT_FALSE(manifest.contains("notes.txt"));
+  EXPECT_EQ(manifest.totalSize(), ByteSize{4});
+  EXPECT_TRUE(std::filesystem::exists(cache.path / CACHE_MANIFEST_FILE_NAME));
+}
+
+TEST(CacheManifest, DamagedManifestIsRebuilt) {
+  const TemporaryDirectory cache;;
+  std::ofstream(cache.path / CACHED_IMAGE_NAME) << "1234";
+  std::ofstream(cache.path / CACHE_MANIFEST_FILE_NAME)
+      << "not a manifest, but long enough to have a header";
+
+  const CacheManifest manifest(cache.path);
+
+  EXPECT_TRUE(manifest.contains(CACHED_IMAGE_NAME));
+  EXPECT_EQ(manifest.numberImages(), 1U);
+}
+
+TEST(CacheManifest, PartialPathKeepsExtension) {
+  const std::filesystem::path path =
+      std::filesystem::path("cache") / CACHED_IMAGE_NAME;
+  const std::filesystem::path partialPath = partialPathFor(path);
+
+  EXPECT_EQ(partialPath.parent_path(), path.parent_path());
+  EXPECT_EQ(partialPath.extension(), path.extension());
+  EXPECT_FALSE(isCacheImageFileName(partialPath.filename().string()));
+  EXPECT_TRUE(partialPath.filename().string().contains(
+      dynamic_paper::format("{}{}-", PARTIAL_IMAGE_MARKER, getpid())));
+}
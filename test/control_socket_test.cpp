@@ -0,0 +1,117 @@
+/**
+ *   Test controlling a running daemon over its socket
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "helper.hpp"
+#include "src/control_socket.hpp"
+
+using namespace dynamic_paper;
+
+// ===== Tests ===============
+
+TEST(ControlSocket, RequestRoundTrip) {
+  const ControlRequest request{.command = ControlCommand::Image,
+                               .arguments = {"/tmp/a b.png", "fill", ""}};
+
+  const auto line = encodeControlRequest(request);
+  ASSERT_TRUE(line.has_value());
+  EXPECT_EQ(line.value(), "image\t/tmp/a b.png\tfill\t\n");
+
+  std::string_view withoutNewline = line.value();
+  withoutNewline.remove_suffix(1);
+  EXPECT_EQ(parseControlRequest(withoutNewline), request);
+
+  EXPECT_EQ(parseControlRequest("status"),
+            (ControlRequest{.command = ControlCommand::Status, .arguments = {}}));
+  EXPECT_EQ(parseControlRequest("random\timage\tfill"),
+            (ControlRequest{.command = ControlCommand::Random,
+                            .arguments = {"image", "fill"}}));
+}
+
+TEST(ControlSocket, RejectsInvalidRequests) {
+  EXPECT_FALSE(encodeControlRequest({.command = ControlCommand::Show,
+                                     .arguments = {"a\tb"}})
+                   .has_value());
+  EXPECT_FALSE(encodeControlRequest({.command = ControlCommand::Show,
+                                     .arguments = {"a\nb"}})
+                   .has_value());
+
+  EXPECT_FALSE(parseControlRequest("").has_value());
+  EXPECT_FALSE(parseControlRequest("restart\tday").has_value());
+}
+
+TEST(ControlSocket, ResponseRoundTrip) {
+  const ControlResponse ok{.ok = true, .message = "day on HDMI-1\nnight\n"};
+  EXPECT_EQ(parseControlResponse(encodeControlResponse(ok)), ok);
+
+  const ControlResponse error{.ok = false, .message = "No set called day"};
+  EXPECT_EQ(parseControlResponse(encodeControlResponse(error)), error);
+
+  EXPECT_FALSE(parseControlResponse("maybe\n").has_value());
+}
+
+TEST(ControlSocket, NoDaemonWithoutServer) {
+  const TemporaryDirectory directory;
+  const std::filesystem::path socketPath = directory / CONTROL_SOCKET_NAME;
+
+  const auto response = sendControlRequest(
+      socketPath, {.command = ControlCommand::Status, .arguments = {}});
+  ASSERT_FALSE(response.has_value());
+  EXPECT_EQ(response.error(), ControlSocketError::NoDaemon);
+}
+
+TEST(ControlSocket, ServerAnswersRequests) {
+  const TemporaryDirectory directory;
+  const std::filesystem::path socketPath = directory / CONTROL_SOCKET_NAME;
+
+  auto server = ControlServer::listen(socketPath);
+  ASSERT_TRUE(server.has_value());
+
+  std::vector<ControlRequest> received;
+  {
+    std::jthread serverThread([&](const std::stop_token &stopToken) {
+      server.value()->serve(stopToken, [&](const ControlRequest &request) {
+        received.push_back(request);
+        return ControlResponse{.ok = true,
+                               .message = "shown " + request.arguments.front()};
+      });
+    });
+
+    const auto response = sendControlRequest(
+        socketPath,
+        {.command = ControlCommand::Show, .arguments = {"day@HDMI-1"}});
+    ASSERT_TRUE(response.has_value());
+    EXPECT_EQ(response.value(),
+              (ControlResponse{.ok = true, .message = "shown day@HDMI-1"}));
+
+    // Only one daemon can listen at a time
+    const auto second = ControlServer::listen(socketPath);
+    ASSERT_FALSE(second.has_value());
+    EXPECT_EQ(second.error(), ControlSocketError::AlreadyRunning);
+  }
+
+  ASSERT_EQ(received.size(), 1);
+  EXPECT_EQ(received.front().command, ControlCommand::Show);
+
+  // Socket is removed once the server stops
+  server.value().reset();
+  EXPECT_FALSE(std::filesystem::exists(socketPath));
+}
+
+TEST(ControlSocket, ReplacesStaleSocket) {
+  const TemporaryDirectory directory;
+  const std::filesystem::path socketPath = directory / CONTROL_SOCKET_NAME;
+
+  // Left behind by a daemon that was killed, so nothing answers on it
+  std::ofstream(socketPath) << "stale";
+
+  EXPECT_TRUE(ControlServer::listen(socketPath).has_value());
+}
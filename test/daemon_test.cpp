@@ -0,0 +1,97 @@
+/**
+ *   Test the parts of the daemon that show several background sets at once
+ */
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/daemon.hpp"
+
+using namespace dynamic_paper;
+using ::testing::ElementsAre;
+
+namespace {
+
+const WakeupQueue::TimePoint START = std::chrono::sys_days(
+    std::chrono::year(2024) / 3 / 9);
+
+WakeupQueue::TimePoint at(const std::chrono::seconds afterStart) {
+  return START + afterStart;
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(Daemon, ParsesSetBindings) {
+  EXPECT_EQ(parseDaemonSetBinding("day"), DaemonSetBinding{.setName = "day"});
+  EXPECT_EQ(parseDaemonSetBinding("day@HDMI-1"),
+            (DaemonSetBinding{.setName = "day", .output = "HDMI-1"}));
+  // Only the last separator splits off the output
+  EXPECT_EQ(parseDaemonSetBinding("a@b@DP-2"),
+            (DaemonSetBinding{.setName = "a@b", .output = "DP-2"}));
+
+  EXPECT_FALSE(parseDaemonSetBinding("").has_value());
+  EXPECT_FALSE(parseDaemonSetBinding("@HDMI-1").has_value());
+  EXPECT_FALSE(parseDaemonSetBinding("day@").has_value());
+}
+
+TEST(Daemon, WakesSlotsInOrderOfDeadline) {
+  WakeupQueue queue;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.nextDeadline().has_value());
+
+  queue.schedule(0, at(std::chrono::seconds(30)));
+  queue.schedule(1, at(std::chrono::seconds(10)));
+  queue.schedule(2, at(std::chrono::seconds(20)));
+  EXPECT_EQ(queue.nextDeadline(), at(std::chrono::seconds(10)));
+
+  EXPECT_THAT(queue.popDue(at(std::chrono::seconds(5))), ElementsAre());
+  EXPECT_THAT(queue.popDue(at(std::chrono::seconds(20))), ElementsAre(1, 2));
+  EXPECT_FALSE(queue.contains(1));
+  EXPECT_TRUE(queue.contains(0));
+  EXPECT_EQ(queue.nextDeadline(), at(std::chrono::seconds(30)));
+
+  EXPECT_THAT(queue.popDue(at(std::chrono::seconds(60))), ElementsAre(0));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(Daemon, SchedulingAgainReplacesDeadline) {
+  WakeupQueue queue;
+  queue.schedule(0, at(std::chrono::seconds(10)));
+  queue.schedule(1, at(std::chrono::seconds(20)));
+
+  // Moved later, so the old deadline no longer wakes it
+  queue.schedule(0, at(std::chrono::seconds(40)));
+  EXPECT_EQ(queue.nextDeadline(), at(std::chrono::seconds(20)));
+  EXPECT_THAT(queue.popDue(at(std::chrono::seconds(30))), ElementsAre(1));
+
+  // Moved earlier
+  queue.schedule(0, at(std::chrono::seconds(35)));
+  EXPECT_THAT(queue.popDue(at(std::chrono::seconds(40))), ElementsAre(0));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(Daemon, DiffsBackgroundSets) {
+  const std::unordered_map<std::string, std::string> before = {
+      {"day", "type: static"},
+      {"night", "type: dynamic"},
+      {"old", "type: static"}};
+  const std::unordered_map<std::string, std::string> after = {
+      {"day", "type: static"},
+      {"night", "type: dynamic\ntimes: [\"12:00\"]"},
+      {"new", "type: static"},
+      {"another", "type: static"}};
+
+  EXPECT_EQ(diffBackgroundSets(before, after),
+            (BackgroundSetChanges{.added = {"another", "new"},
+                                  .changed = {"night"},
+                                  .removed = {"old"}}));
+  EXPECT_EQ(diffBackgroundSets(after, after), BackgroundSetChanges{});
+}
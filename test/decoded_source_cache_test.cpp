@@ -0,0 +1,116 @@
+/**
+ *   Test saving decoded source images to the cache and mapping them back
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "helper.hpp"
+#include "src/background_set_enums.hpp"
+#include "src/decoded_source_cache.hpp"
+#include "src/display_geometry.hpp"
+#include "src/rgb_image.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+constexpr std::uint64_t SOURCE_DIGEST = 0xAB;
+
+/** 3 x 2 image with every byte set to a different value */
+RGBImage gradientImage() {
+  RGBImage image(3, 2);
+  for (std::size_t i = 0; i < image.pixels.size(); i++) {
+    image.pixels[i] = static_cast<std::uint8_t>(i * 10);
+  }
+  return image;
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(DecodedSourceCache, FileNameFormat) {
+  EXPECT_EQ(decodedSourceFileName(SOURCE_DIGEST, std::nullopt),
+            "00000000000000ab.rgb");
+  EXPECT_EQ(decodedSourceFileName(
+                SOURCE_DIGEST,
+                DisplayFit{.display = {.width = 1920, .height = 1080},
+                           .mode = BackgroundSetMode::Fill}),
+            "00000000000000ab-fill-1920x1080.rgb");
+}
+
+TEST(DecodedSourceCache, MapsWrittenImage) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "source.rgb";
+  const RGBImage image = gradientImage();
+
+  ASSERT_TRUE(writeDecodedSource(image, SOURCE_DIGEST, path));
+  const std::optional<DecodedSource> mapped =
+      DecodedSource::map(path, SOURCE_DIGEST);
+
+  ASSERT_TRUE(mapped.has_value());
+  EXPECT_TRUE(mapped->isMapped());
+  EXPECT_EQ(mapped->width(), image.width);
+  EXPECT_EQ(mapped->height(), image.height);
+  EXPECT_EQ(std::vector(mapped->pixels().begin(), mapped->pixels().end()),
+            image.pixels);
+}
+
+TEST(DecodedSourceCache, PixelsStartOnPageBoundary) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "source.rgb";
+  const RGBImage image = gradientImage();
+
+  ASSERT_TRUE(writeDecodedSource(image, SOURCE_DIGEST, path));
+  const std::optional<DecodedSource> mapped =
+      DecodedSource::map(path, SOURCE_DIGEST);
+
+  ASSERT_TRUE(mapped.has_value());
+  EXPECT_EQ(std::filesystem::file_size(path) - image.pixels.size(),
+            static_cast<std::uintmax_t>(sysconf(_SC_PAGESIZE)));
+}
+
+TEST(DecodedSourceCache, IgnoresImageOfOtherSource) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "source.rgb";
+
+  ASSERT_TRUE(writeDecodedSource(gradientImage(), SOURCE_DIGEST, path));
+
+  EXPECT_FALSE(DecodedSource::map(path, SOURCE_DIGEST + 1).has_value());
+}
+
+TEST(DecodedSourceCache, IgnoresDamagedImage) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "source.rgb";
+
+  ASSERT_TRUE(writeDecodedSource(gradientImage(), SOURCE_DIGEST, path));
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  EXPECT_FALSE(DecodedSource::map(path, SOURCE_DIGEST).has_value());
+
+  std::ofstream(path, std::ios::trunc) << "not a decoded image";
+  EXPECT_FALSE(DecodedSource::map(path, SOURCE_DIGEST).has_value());
+}
+
+TEST(DecodedSourceCache, IgnoresMissingImage) {
+  const TemporaryDirectory cache;;
+
+  EXPECT_FALSE(
+      DecodedSource::map(cache.path / "source.rgb", SOURCE_DIGEST).has_value());
+}
+
+TEST(DecodedSourceCache, KeepsImageDecodedInMemory) {
+  const DecodedSource source(gradientImage());
+
+  EXPECT_FALSE(source.isMapped());
+  EXPECT_EQ(source.width(), 3U);
+  EXPECT_EQ(source.height(), 2U);
+  EXPECT_EQ(source.pixels().size(), 3U * 2U * RGBImage::CHANNELS);
+}
@@ -0,0 +1,142 @@
+/**
+ *   Test finding the part of a source image a display shows
+ */
+
+#include <optional>
+
+#include <gtest/gtest.h>
+
+#include "src/background_set_enums.hpp"
+#include "src/background_set_method.hpp"
+#include "src/display_geometry.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+constexpr DisplayGeometry FULL_HD = {.width = 1920, .height = 1080};
+
+DisplayFit fullHDFit(const BackgroundSetMode mode) {
+  return {.display = FULL_HD, .mode = mode};
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(DisplayGeometry, Parse) {
+  EXPECT_EQ(parseDisplayGeometry("1920x1080"), std::make_optional(FULL_HD));
+  EXPECT_EQ(parseDisplayGeometry(" 1920X1080 "), std::make_optional(FULL_HD));
+
+  EXPECT_EQ(parseDisplayGeometry("1920"), std::nullopt);
+  EXPECT_EQ(parseDisplayGeometry("1920x"), std::nullopt);
+  EXPECT_EQ(parseDisplayGeometry("x1080"), std::nullopt);
+  EXPECT_EQ(parseDisplayGeometry("0x1080"), std::nullopt);
+  EXPECT_EQ(parseDisplayGeometry("1920x1080x2"), std::nullopt);
+  EXPECT_EQ(parseDisplayGeometry("wide"), std::nullopt);
+}
+
+TEST(DisplayFit, FillShrinksAndCropsToDisplay) {
+  // Shrunk by 1080 / 4000, so 1920 pixels of the display cover 7111 pixels
+  const SourceRegion region =
+      fullHDFit(BackgroundSetMode::Fill).sourceRegion(8000, 4000);
+
+  EXPECT_EQ(region, (SourceRegion{.x = 444,
+                                  .y = 0,
+                                  .cropWidth = 7111,
+                                  .cropHeight = 4000,
+                                  .width = 1920,
+                                  .height = 1080}));
+}
+
+TEST(DisplayFit, FillOnlyCropsSmallImage) {
+  const SourceRegion region =
+      fullHDFit(BackgroundSetMode::Fill).sourceRegion(960, 960);
+
+  EXPECT_EQ(region, (SourceRegion{.x = 0,
+                                  .y = 210,
+                                  .cropWidth = 960,
+                                  .cropHeight = 540,
+                                  .width = 960,
+                                  .height = 540}));
+}
+
+TEST(DisplayFit, ScaleShrinksEachSide) {
+  const SourceRegion region =
+      fullHDFit(BackgroundSetMode::Scale).sourceRegion(6000, 800);
+
+  EXPECT_EQ(region, (SourceRegion{.x = 0,
+                                  .y = 0,
+                                  .cropWidth = 6000,
+                                  .cropHeight = 800,
+                                  .width = 1920,
+                                  .height = 800}));
+}
+
+TEST(DisplayFit, CenterCropsToDisplay) {
+  const SourceRegion region =
+      fullHDFit(BackgroundSetMode::Center).sourceRegion(6000, 800);
+
+  EXPECT_EQ(region, (SourceRegion{.x = 2040,
+                                  .y = 0,
+                                  .cropWidth = 1920,
+                                  .cropHeight = 800,
+                                  .width = 1920,
+                                  .height = 800}));
+}
+
+TEST(DisplayFit, KeepsImagesTheDisplayShowsWhole) {
+  for (const BackgroundSetMode mode :
+       {BackgroundSetMode::Center, BackgroundSetMode::Scale,
+        BackgroundSetMode::Tile}) {
+    EXPECT_TRUE(fullHDFit(mode).sourceRegion(640, 480).isWholeImage(640, 480))
+        << backgroundSetModeString(mode);
+  }
+  EXPECT_TRUE(fullHDFit(BackgroundSetMode::Fill)
+                  .sourceRegion(1920, 1080)
+                  .isWholeImage(1920, 1080));
+}
+
+TEST(DisplayFit, DecodesLargeImagesAtReducedScale) {
+  const DisplayFit fill = fullHDFit(BackgroundSetMode::Fill);
+
+  // 8K covers the display at 1/4 of its size, but not at 1/8
+  EXPECT_EQ(fill.decodeScaleDenominator(7680, 4320), 4U);
+  EXPECT_EQ(fill.decodeScaleDenominator(3840, 2160), 2U);
+  EXPECT_EQ(fill.decodeScaleDenominator(3000, 2000), 1U);
+  EXPECT_EQ(fill.decodeScaleDenominator(40000, 20000),
+            MAX_DECODE_SCALE_DENOMINATOR);
+
+  // A short image only covers the display's height at full size
+  EXPECT_EQ(
+      fullHDFit(BackgroundSetMode::Scale).decodeScaleDenominator(6000, 800),
+      1U);
+}
+
+TEST(DisplayFit, CenteredImagesAreDecodedAtFullSize) {
+  EXPECT_EQ(
+      fullHDFit(BackgroundSetMode::Center).decodeScaleDenominator(7680, 4320),
+      1U);
+  EXPECT_EQ(
+      fullHDFit(BackgroundSetMode::Tile).decodeScaleDenominator(7680, 4320),
+      1U);
+}
+
+TEST(DisplayFit, CacheTag) {
+  EXPECT_EQ(fullHDFit(BackgroundSetMode::Fill).cacheTag(), "fill-1920x1080");
+  EXPECT_EQ(fullHDFit(BackgroundSetMode::Center).cacheTag(),
+            "center-1920x1080");
+}
+
+TEST(DisplayFit, UsesConfiguredSize) {
+  const std::optional<DisplayFit> fit = displayFitFor(
+      FULL_HD, BackgroundSetMethod(MethodWallUtils{}), BackgroundSetMode::Scale);
+
+  EXPECT_EQ(fit, std::make_optional(fullHDFit(BackgroundSetMode::Scale)));
+}
+
+TEST(DisplayFit, TiledBackgroundsAreNotResampled) {
+  EXPECT_EQ(displayFitFor(FULL_HD, BackgroundSetMethod(MethodWallUtils{}),
+                          BackgroundSetMode::Tile),
+            std::nullopt);
+}
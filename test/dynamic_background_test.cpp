@@ -9,6 +9,8 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <variant>
 #include <vector>
 
 #include <gmock/gmock.h>
@@ -21,6 +23,7 @@
 #include "src/background_setter.hpp"
 #include "src/config.hpp"
 #include "src/dynamic_background_set.hpp"
+#include "src/rgb_image.hpp"
 #include "src/time_from_midnight.hpp"
 #include "src/time_util.hpp"
 #include "src/transition_info.hpp"
@@ -55,15 +58,48 @@ public:
 
 class TestCompositeImages {
 public:
-  static tl::expected<std::filesystem::path, CompositeImageError>
-  getCompositedImage(const std::filesystem::path &commonImageDirectory,
-                     const std::string &startImageName,
-                     const std::string &endImageName,
-                     const std::filesystem::path &cacheDirectory,
-                     unsigned int percentage) {
-    return pathForCompositeImage(commonImageDirectory, startImageName,
-                                 endImageName, percentage, cacheDirectory);
-  }
+  class Session {
+  public:
+    Session(std::filesystem::path commonImageDirectory,
+            std::string startImageName, std::string endImageName,
+            std::filesystem::path cacheDirectory,
+            const std::optional<DisplayFit> & /*unused*/ = std::nullopt,
+            bool /*unused*/ = false,
+            TransitionFrameFormat /*unused*/ = TransitionFrameFormat::Source,
+            bool /*unused*/ = false)
+        : commonImageDirectory(std::move(commonImageDirectory)),
+          startImageName(std::move(startImageName)),
+          endImageName(std::move(endImageName)),
+          cacheDirectory(std::move(cacheDirectory)) {}
+
+    tl::expected<void, CompositeImageError>
+    prepareCompositedImages(const std::vector<unsigned int> & /*unused*/) {
+      return {};
+    }
+
+    tl::expected<std::filesystem::path, CompositeImageError>
+    getCompositedImage(unsigned int percentage) {
+      return pathForCompositeImage(commonImageDirectory, startImageName,
+                                   endImageName, percentage, cacheDirectory);
+    }
+
+    tl::expected<void, CompositeImageError> prepareCompositedFrames() {
+      return {};
+    }
+
+    /** Frame that is `percentage` pixels wide, so tests can tell which
+     * frame was shown */
+    tl::expected<RGBImage, CompositeImageError>
+    getCompositedFrame(unsigned int percentage) {
+      return RGBImage(percentage, 1);
+    }
+
+  private:
+    std::filesystem::path commonImageDirectory;
+    std::string startImageName;
+    std::string endImageName;
+    std::filesystem::path cacheDirectory;
+  };
 };
 
 } // namespace
@@ -854,14 +890,13 @@ TEST_F(DynamicBackgroundTest, OverlappingTransitions2) {
           SetEvent{.imagePath = cache("test_dir-1-2-66.jpg"), .mode = mode},
           // show 2
           SetEvent{.imagePath = data("2.jpg"), .mode = mode},
-          // lerp 2->3
-          SetEvent{.imagePath = cache("test_dir-2-3-33.jpg"), .mode = mode},
-          SetEvent{.imagePath = cache("test_dir-2-3-66.jpg"), .mode = mode},
+          // lerp 2->3, started two of its three hours late so it starts
+          // from 66%
+          SetEvent{.imagePath = cache("test_dir-2-3-83.jpg"), .mode = mode},
           // show 3
           SetEvent{.imagePath = data("3.jpg"), .mode = mode},
-          // show 3->1
-          SetEvent{.imagePath = cache("test_dir-3-1-33.jpg"), .mode = mode},
-          SetEvent{.imagePath = cache("test_dir-3-1-66.jpg"), .mode = mode}));
+          // lerp 3->1, started an hour late so it starts from 10%
+          SetEvent{.imagePath = cache("test_dir-3-1-55.jpg"), .mode = mode}));
 }
 
 /**
@@ -921,3 +956,239 @@ TEST_F(DynamicBackgroundTest, SameTimeTransitions) {
                   // show 3 (transition is removed for the set event)
                   SetEvent{.imagePath = data("3.jpg"), .mode = mode}));
 }
+
+TEST_F(DynamicBackgroundTest, UpcomingTransition) {
+  const TransitionInfo transition(std::chrono::seconds(1), 2, false);
+  const std::vector<std::string> imageNames = {"1.jpg", "2.jpg"};
+  const std::vector<TimeFromMidnight> times = timesArray({"01:00", "03:00"});
+
+  const DynamicBackgroundData linearData(
+      this->testDataDir, BackgroundSetMode::Fill, transition,
+      BackgroundSetOrder::Linear, imageNames, times);
+
+  const DynamicSchedule linearSchedule(linearData, 0);
+
+  const std::optional<detail::LerpBackgroundEvent> afterShowing1 =
+      getUpcomingTransition(linearData, linearSchedule, time("01:00:00"));
+  ASSERT_TRUE(afterShowing1.has_value());
+  EXPECT_EQ(afterShowing1->startImageName, "1.jpg");
+  EXPECT_EQ(afterShowing1->endImageName, "2.jpg");
+
+  const std::optional<detail::LerpBackgroundEvent> afterShowing2 =
+      getUpcomingTransition(linearData, linearSchedule, time("03:00:00"));
+  ASSERT_TRUE(afterShowing2.has_value());
+  EXPECT_EQ(afterShowing2->startImageName, "2.jpg");
+  EXPECT_EQ(afterShowing2->endImageName, "1.jpg");
+
+  // Next event is showing an image, not a transition
+  EXPECT_FALSE(
+      getUpcomingTransition(linearData, linearSchedule, time("02:59:59"))
+          .has_value());
+
+  // The schedule fixes the order of random sets, so their transitions are
+  // known too
+  const DynamicBackgroundData randomData(
+      this->testDataDir, BackgroundSetMode::Fill, transition,
+      BackgroundSetOrder::Random, imageNames, times);
+  const DynamicSchedule randomSchedule(randomData, 0);
+  const std::optional<detail::LerpBackgroundEvent> randomTransition =
+      getUpcomingTransition(randomData, randomSchedule, time("01:00:00"));
+  ASSERT_TRUE(randomTransition.has_value());
+  EXPECT_NE(randomTransition->startImageName,
+            randomTransition->endImageName);
+}
+
+TEST_F(DynamicBackgroundTest, ScheduleFindsCurrentEvent) {
+  const TransitionInfo transition(std::chrono::seconds(1), 2, false);
+  const DynamicBackgroundData data(
+      this->testDataDir, BackgroundSetMode::Fill, transition,
+      BackgroundSetOrder::Linear, {"1.jpg", "2.jpg"},
+      timesArray({"01:00", "03:00"}));
+  const DynamicSchedule schedule(data, 0);
+
+  ASSERT_EQ(schedule.events().size(), 4);
+
+  const auto [current, next] = schedule.currentEventAndNextTime(time("02:00"));
+  EXPECT_EQ(current.first, time("01:00"));
+  EXPECT_TRUE(std::holds_alternative<detail::SetBackgroundEvent>(current.second));
+  EXPECT_EQ(next, time("02:59:59"));
+
+  // Before the first event is the last event of the day before
+  const auto [lastEvent, firstTime] =
+      schedule.currentEventAndNextTime(time("00:30"));
+  EXPECT_EQ(lastEvent.first, time("03:00"));
+  EXPECT_EQ(firstTime, time("00:59:59"));
+
+  const std::optional<detail::LerpBackgroundEvent> upcoming =
+      getUpcomingTransition(data, schedule, time("01:00"));
+  ASSERT_TRUE(upcoming.has_value());
+  EXPECT_EQ(upcoming->endImageName, "2.jpg");
+}
+
+TEST_F(DynamicBackgroundTest, ScheduleIsBuiltOncePerDay) {
+  const DynamicBackgroundData data(
+      this->testDataDir, BackgroundSetMode::Fill, std::nullopt,
+      BackgroundSetOrder::Random, {"1.jpg", "2.jpg", "3.jpg"},
+      timesArray({"01:00", "03:00", "05:00"}));
+  DynamicScheduleCache schedules(data);
+
+  using namespace std::chrono_literals;
+  const std::chrono::year_month_day today = 2024y / 3 / 9;
+  const std::chrono::year_month_day tomorrow = 2024y / 3 / 10;
+
+  const DynamicSchedule *first = &schedules.scheduleFor(today);
+  EXPECT_EQ(&schedules.scheduleFor(today), first);
+  EXPECT_EQ(schedules.numberBuilds(), 1);
+
+  std::ignore = schedules.scheduleFor(tomorrow);
+  EXPECT_EQ(schedules.numberBuilds(), 2);
+  std::ignore = schedules.scheduleFor(tomorrow);
+  EXPECT_EQ(schedules.numberBuilds(), 2);
+}
+
+TEST_F(DynamicBackgroundTest, RandomOrderIsFixedForEachDay) {
+  const DynamicBackgroundData data(
+      this->testDataDir, BackgroundSetMode::Fill,
+      TransitionInfo(std::chrono::seconds(1), 2, false),
+      BackgroundSetOrder::Random,
+      {"1.jpg", "2.jpg", "3.jpg", "4.jpg", "5.jpg", "6.jpg"},
+      timesArray({"01:00", "03:00", "05:00", "07:00", "09:00", "11:00"}));
+
+  const auto shownImages = [](const DynamicSchedule &schedule) {
+    std::vector<std::filesystem::path> images;
+    for (const detail::TimeAndEvent &timeAndEvent : schedule.events()) {
+      if (const auto *event =
+              std::get_if<detail::SetBackgroundEvent>(&timeAndEvent.second)) {
+        images.push_back(event->imagePath);
+      }
+    }
+    return images;
+  };
+
+  using namespace std::chrono_literals;
+  const std::chrono::year_month_day today = 2024y / 3 / 9;
+  EXPECT_EQ(detail::dailyRandomSeed(data, today),
+            detail::dailyRandomSeed(data, today));
+  EXPECT_NE(detail::dailyRandomSeed(data, today),
+            detail::dailyRandomSeed(data, 2024y / 3 / 10));
+
+  // Same order after a restart, which builds the schedule again
+  DynamicScheduleCache schedules(data);
+  DynamicScheduleCache restartedSchedules(data);
+  EXPECT_EQ(shownImages(schedules.scheduleFor(today)),
+            shownImages(restartedSchedules.scheduleFor(today)));
+
+  // The transition after an image ends on the image shown next
+  const DynamicSchedule &schedule = schedules.scheduleFor(today);
+  const std::optional<detail::LerpBackgroundEvent> upcoming =
+      getUpcomingTransition(data, schedule, time("01:00"));
+  ASSERT_TRUE(upcoming.has_value());
+  const auto [current, next] =
+      schedule.currentEventAndNextTime(time("03:00"));
+  EXPECT_EQ(std::get<detail::SetBackgroundEvent>(current.second).imagePath,
+            data.imageDirectory / upcoming->endImageName);
+}
+
+TEST_F(DynamicBackgroundTest, LateTransitionIsShortened) {
+  const TransitionInfo transition(std::chrono::seconds(600), 10, false);
+  const DynamicBackgroundData data(
+      this->testDataDir, BackgroundSetMode::Fill, transition,
+      BackgroundSetOrder::Linear, {"1.jpg", "2.jpg"},
+      timesArray({"01:00", "03:00"}));
+  const DynamicSchedule schedule(data, 0);
+
+  // Transition to 2.jpg runs from 02:50 to 03:00
+  const auto [onTime, onTimeNext] =
+      schedule.currentEventAndNextTime(time("02:50:01"));
+  const auto onTimeEvent = std::get<detail::LerpBackgroundEvent>(
+      detail::catchUpEvent(onTime, time("02:50:01")));
+  EXPECT_EQ(onTimeEvent.transition.duration, std::chrono::seconds(600));
+  EXPECT_EQ(onTimeEvent.transition.steps, 10);
+
+  // Woken from suspend halfway through, so only the second half is shown in
+  // the time left
+  const auto [late, lateNext] = schedule.currentEventAndNextTime(time("02:55"));
+  const auto lateEvent = std::get<detail::LerpBackgroundEvent>(
+      detail::catchUpEvent(late, time("02:55")));
+  EXPECT_EQ(lateEvent.transition.duration, std::chrono::seconds(300));
+  EXPECT_EQ(lateEvent.transition.startPercentage, 50);
+  EXPECT_EQ(lateEvent.transition.steps, 5);
+  EXPECT_EQ(lateEvent.transition.stepPercentages(),
+            std::vector<unsigned int>({58, 66, 75, 83, 91}));
+  EXPECT_EQ(lateEvent.endImageName, "2.jpg");
+}
+
+TEST_F(DynamicBackgroundTest, AllTransitions) {
+  const TransitionInfo transition(std::chrono::seconds(1), 2, false);
+  const std::vector<std::string> imageNames = {"1.jpg", "2.jpg", "3.jpg"};
+  const std::vector<TimeFromMidnight> times =
+      timesArray({"01:00", "03:00", "05:00"});
+
+  const auto startAndEndNames =
+      [](const std::vector<detail::LerpBackgroundEvent> &transitions) {
+        std::vector<std::pair<std::string, std::string>> names;
+        for (const detail::LerpBackgroundEvent &event : transitions) {
+          names.emplace_back(event.startImageName, event.endImageName);
+        }
+        return names;
+      };
+
+  const DynamicBackgroundData linearData(
+      this->testDataDir, BackgroundSetMode::Fill, transition,
+      BackgroundSetOrder::Linear, imageNames, times);
+  EXPECT_THAT(startAndEndNames(getAllTransitions(linearData)),
+              UnorderedElementsAre(std::make_pair("3.jpg", "1.jpg"),
+                                   std::make_pair("1.jpg", "2.jpg"),
+                                   std::make_pair("2.jpg", "3.jpg")));
+
+  const DynamicBackgroundData randomData(
+      this->testDataDir, BackgroundSetMode::Fill, transition,
+      BackgroundSetOrder::Random, imageNames, times);
+  EXPECT_EQ(getAllTransitions(randomData).size(), 6U);
+
+  const DynamicBackgroundData noTransitionData(
+      this->testDataDir, BackgroundSetMode::Fill, std::nullopt,
+      BackgroundSetOrder::Linear, imageNames, times);
+  EXPECT_TRUE(getAllTransitions(noTransitionData).empty());
+}
+
+TEST_F(DynamicBackgroundTest, TransitionShowsFramesFromMemory) {
+  std::vector<std::filesystem::path> shownImages;
+  std::vector<std::size_t> shownFrames;
+
+  // Setter that can show decoded frames, like `X11BackgroundSetter`
+  struct FrameSetter {
+    std::vector<std::filesystem::path> *shownImages;
+    std::vector<std::size_t> *shownFrames;
+
+    void operator()(const std::filesystem::path &imagePath,
+                    BackgroundSetMode /* mode */) const {
+      shownImages->push_back(imagePath);
+    }
+    void operator()(const RGBImage &frame,
+                    BackgroundSetMode /* mode */) const {
+      shownFrames->push_back(frame.width);
+    }
+  };
+
+  const DynamicBackgroundData dynamicData(
+      this->testDataDir, BackgroundSetMode::Fill,
+      TransitionInfo(std::chrono::seconds(1), 2, false),
+      BackgroundSetOrder::Linear, {"1.jpg", "2.jpg"},
+      timesArray({"01:00", "03:00"}));
+
+  for (const TimeFromMidnight currentTime :
+       {time("01:00:00"), time("02:59:59")}) {
+    std::ignore =
+        dynamicData.updateBackground<FrameSetter, TestFilesystemHandler,
+                                     TestCompositeImages>(
+            currentTime, this->config,
+            FrameSetter{.shownImages = &shownImages,
+                        .shownFrames = &shownFrames},
+            std::nullopt);
+  }
+
+  // Only the transition is shown from memory, without any cached images
+  EXPECT_THAT(shownImages, ElementsAre(data("1.jpg")));
+  EXPECT_THAT(shownFrames, ElementsAre(33, 66));
+}
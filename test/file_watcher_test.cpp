@@ -0,0 +1,83 @@
+/**
+ *   Test watching files for changes
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "helper.hpp"
+#include "src/file_watcher.hpp"
+
+using namespace dynamic_paper;
+using ::testing::ElementsAre;
+using ::testing::Optional;
+
+namespace {
+
+void writeFile(const std::filesystem::path &file, const std::string &contents) {
+  std::ofstream(file) << contents;
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(FileWatcher, ReportsWrittenFile) {
+  const TemporaryDirectory directory;
+  const std::filesystem::path config = directory / "config.yaml";
+  const std::filesystem::path sets = directory / "background_sets.yaml";
+  writeFile(config, "a: 1");
+  writeFile(sets, "b: 2");
+
+  FileWatcher watcher({config, sets});
+  std::jthread writer([&sets, &directory]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    writeFile(directory / "unrelated.yaml", "c: 3");
+    writeFile(sets, "b: 3");
+  });
+
+  EXPECT_THAT(watcher.waitForChanges(std::stop_token()),
+              Optional(ElementsAre(sets)));
+}
+
+TEST(FileWatcher, ReportsFileReplacedByRename) {
+  const TemporaryDirectory directory;
+  const std::filesystem::path sets = directory / "background_sets.yaml";
+  writeFile(sets, "b: 2");
+
+  FileWatcher watcher({sets});
+  std::jthread writer([&sets, &directory]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    // Saved as many editors do
+    const std::filesystem::path temporary = directory / ".background_sets.swp";
+    writeFile(temporary, "b: 3");
+    std::filesystem::rename(temporary, sets);
+  });
+
+  EXPECT_THAT(watcher.waitForChanges(std::stop_token()),
+              Optional(ElementsAre(sets)));
+}
+
+TEST(FileWatcher, ReturnsNothingOnceStopped) {
+  const TemporaryDirectory directory;
+  const std::filesystem::path sets = directory / "background_sets.yaml";
+  writeFile(sets, "b: 2");
+
+  FileWatcher watcher({sets});
+  std::stop_source stopSource;
+  std::jthread stopper([&stopSource]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    stopSource.request_stop();
+  });
+
+  const auto changedFiles = watcher.waitForChanges(stopSource.get_token());
+  ASSERT_TRUE(changedFiles.has_value());
+  EXPECT_TRUE(changedFiles->empty());
+}
@@ -0,0 +1,120 @@
+/**
+ *   Test saving the frames of a transition to one frame pack and reading them
+ *   back
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "helper.hpp"
+#include "src/cache_key.hpp"
+#include "src/frame_pack.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+std::vector<std::uint8_t> bytes(const std::span<const std::uint8_t> data) {
+  return {data.begin(), data.end()};
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(FramePack, FileNameFormat) {
+  const TransitionCacheKey key = {.startDigest = 0xAB,
+                                  .endDigest = 0xCD,
+                                  .extension = ".jpg",
+                                  .reversed = false,
+                                  .displayTag = ""};
+  EXPECT_EQ(key.packFileName(), "00000000000000ab-00000000000000cd.jpg.frames");
+
+  const TransitionCacheKey taggedKey = {.startDigest = 0xAB,
+                                        .endDigest = 0xCD,
+                                        .extension = ".qoi",
+                                        .reversed = true,
+                                        .displayTag = "fill-1920x1080"};
+  EXPECT_EQ(taggedKey.packFileName(),
+            "00000000000000ab-00000000000000cd-fill-1920x1080.qoi.frames");
+}
+
+TEST(FramePack, WriteThenMap) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "pack.jpg.frames";
+
+  const std::vector<PackedFrame> frames = {{.percentage = 60, .data = {6, 6}},
+                                           {.percentage = 20, .data = {2}}};
+  ASSERT_TRUE(writeFramePack(frames, std::nullopt, path));
+
+  const std::optional<FramePack> pack = FramePack::map(path);
+  ASSERT_TRUE(pack.has_value());
+  ASSERT_EQ(pack->entries().size(), 2);
+  EXPECT_EQ(pack->entries().at(0).percentage, 20);
+  EXPECT_EQ(pack->entries().at(1).percentage, 60);
+  EXPECT_EQ(bytes(pack->frame(20)), std::vector<std::uint8_t>({2}));
+  EXPECT_EQ(bytes(pack->frame(60)), std::vector<std::uint8_t>({6, 6}));
+  EXPECT_FALSE(pack->contains(40));
+  EXPECT_TRUE(pack->frame(40).empty());
+}
+
+TEST(FramePack, AddsToExistingPack) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "pack.jpg.frames";
+
+  const std::vector<PackedFrame> firstFrames = {
+      {.percentage = 20, .data = {2}}, {.percentage = 40, .data = {4}}};
+  ASSERT_TRUE(writeFramePack(firstFrames, std::nullopt, path));
+
+  const std::vector<PackedFrame> newFrames = {
+      {.percentage = 40, .data = {44}}, {.percentage = 80, .data = {8}}};
+  ASSERT_TRUE(writeFramePack(newFrames, FramePack::map(path), path));
+
+  const std::optional<FramePack> pack = FramePack::map(path);
+  ASSERT_TRUE(pack.has_value());
+  EXPECT_EQ(pack->entries().size(), 3);
+  EXPECT_EQ(bytes(pack->frame(20)), std::vector<std::uint8_t>({2}));
+  EXPECT_EQ(bytes(pack->frame(40)), std::vector<std::uint8_t>({44}));
+  EXPECT_EQ(bytes(pack->frame(80)), std::vector<std::uint8_t>({8}));
+}
+
+TEST(FramePack, ExtractsFrameToFile) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "pack.jpg.frames";
+  const std::filesystem::path framePath = cache.path / "frame.jpg";
+
+  const std::vector<PackedFrame> frames = {
+      {.percentage = 50, .data = {'a', 'b', 'c'}}};
+  ASSERT_TRUE(writeFramePack(frames, std::nullopt, path));
+  const std::optional<FramePack> pack = FramePack::map(path);
+  ASSERT_TRUE(pack.has_value());
+
+  ASSERT_TRUE(pack->extractFrame(50, framePath));
+  EXPECT_FALSE(pack->extractFrame(10, framePath));
+
+  std::ifstream file(framePath, std::ios::binary);
+  const std::string content((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  EXPECT_EQ(content, "abc");
+}
+
+TEST(FramePack, RejectsDamagedPack) {
+  const TemporaryDirectory cache;;
+  const std::filesystem::path path = cache.path / "pack.jpg.frames";
+
+  EXPECT_FALSE(FramePack::map(path).has_value());
+
+  const std::vector<PackedFrame> frames = {
+      {.percentage = 50, .data = std::vector<std::uint8_t>(100, 1)}};
+  ASSERT_TRUE(writeFramePack(frames, std::nullopt, path));
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 10);
+
+  EXPECT_FALSE(FramePack::map(path).has_value());
+}
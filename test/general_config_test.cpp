@@ -6,6 +6,7 @@
 #include <string>
 #include <string_view>
 #include <utility>
+#include <variant>
 
 #include <gtest/gtest.h>
 #include <tl/expected.hpp>
@@ -26,6 +27,13 @@ sun_poller: "sunwait"
 background_config: "./an_image_dir"
 hook_script: "./hook_script.sh"
 cache_dir: "~/.cache/backgrounds"
+cache_max_size: 2GiB
+transition_percentage_step: 5
+display_size: 1920x1080
+decoded_source_cache: true
+transition_frame_format: qoi
+pack_transition_frames: true
+transition_cpu_budget: 0.25
 )"""";
 
 constexpr std::string EMPTY_YAML;
@@ -106,6 +114,10 @@ longitude: 70.0
 use_config_file_location: true
 )"""";
 
+constexpr std::string_view X11_METHOD = R""""(
+method: x11
+)"""";
+
 Config loadConfigFromString(const std::string_view configString) {
   return loadConfigFromYAML(YAML::Load(std::string(configString)), true);
 }
@@ -131,6 +143,15 @@ TEST(GeneralConfig, AllFilled) {
             std::make_optional(std::filesystem::path("./hook_script.sh")));
   EXPECT_EQ(config.imageCacheDirectory,
             getHomeDirectory() / std::filesystem::path(".cache/backgrounds"));
+  EXPECT_EQ(config.cacheMaxSize,
+            std::make_optional(ByteSize{.bytes = 2ULL * 1024 * 1024 * 1024}));
+  EXPECT_EQ(config.transitionPercentageStep, std::make_optional(5U));
+  EXPECT_EQ(config.displaySize,
+            std::make_optional(DisplayGeometry{.width = 1920, .height = 1080}));
+  EXPECT_TRUE(config.cacheDecodedSources);
+  EXPECT_EQ(config.transitionFrameFormat, TransitionFrameFormat::Qoi);
+  EXPECT_TRUE(config.packTransitionFrames);
+  EXPECT_EQ(config.transitionCpuBudget, 0.25);
 }
 
 TEST(GeneralConfig, DefaultValues) {
@@ -141,6 +162,20 @@ TEST(GeneralConfig, DefaultValues) {
   EXPECT_EQ(config.hookScript, std::nullopt);
   EXPECT_EQ(config.imageCacheDirectory,
             std::filesystem::path(ConfigDefaults::imageCacheDirectory()));
+  EXPECT_EQ(config.cacheMaxSize, std::nullopt);
+  EXPECT_EQ(config.transitionPercentageStep, std::nullopt);
+  EXPECT_EQ(config.displaySize, std::nullopt);
+  EXPECT_FALSE(config.cacheDecodedSources);
+  EXPECT_EQ(config.transitionFrameFormat, TransitionFrameFormat::Source);
+  EXPECT_FALSE(config.packTransitionFrames);
+  EXPECT_EQ(config.transitionCpuBudget, ConfigDefaults::transitionCpuBudget);
+}
+
+TEST(GeneralConfig, X11Method) {
+  EXPECT_TRUE(std::holds_alternative<MethodX11>(
+      loadConfigFromString(X11_METHOD).method));
+  EXPECT_TRUE(std::holds_alternative<MethodWallUtils>(
+      loadConfigFromString(EMPTY_YAML).method));
 }
 
 // Should use default solar day times if no info related to it is provided
@@ -1,7 +1,16 @@
+#pragma once
+
 /**
  * Functions used in multiple places across tests
  */
 
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#include <gtest/gtest.h>
+
 #include "src/config.hpp"
 #include "src/defaults.hpp"
 #include "src/solar_day_provider.hpp"
@@ -22,3 +31,38 @@ dynamic_paper::Config getConfig();
 
 dynamic_paper::Config
 getConfig(const std::filesystem::path &backgroundSetConfigPath);
+
+/** Empty directory named after the test that is running, removed once the
+ * test finishes */
+class TemporaryDirectory {
+public:
+  TemporaryDirectory() : path(std::filesystem::temp_directory_path()) {
+    const testing::TestInfo *test =
+        testing::UnitTest::GetInstance()->current_test_info();
+    std::string name = "dynamic_paper_test";
+    if (test != nullptr) {
+      name += '_' + std::string(test->test_suite_name()) + '_' + test->name();
+    }
+    std::ranges::replace(name, '/', '_');
+    path /= name;
+
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+  }
+  ~TemporaryDirectory() {
+    std::error_code error;
+    std::filesystem::remove_all(path, error);
+  }
+
+  TemporaryDirectory(const TemporaryDirectory &) = delete;
+  TemporaryDirectory &operator=(const TemporaryDirectory &) = delete;
+  TemporaryDirectory(TemporaryDirectory &&) = delete;
+  TemporaryDirectory &operator=(TemporaryDirectory &&) = delete;
+
+  [[nodiscard]] std::filesystem::path
+  operator/(const std::filesystem::path &name) const {
+    return path / name;
+  }
+
+  std::filesystem::path path;
+};
@@ -0,0 +1,142 @@
+/**
+ *   Test management of the directory composite images are cached in
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "helper.hpp"
+#include "src/byte_size.hpp"
+#include "src/cache_manifest.hpp"
+#include "src/image_cache.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+constexpr std::uintmax_t KIB = 1024;
+
+/** Name of a cached composite image, `percentage`% of the way through a
+ * transition */
+std::string frameName(const unsigned int percentage) {
+  return "0123456789abcdef-fedcba9876543210-" + std::to_string(percentage) +
+         ".jpg";
+}
+
+/** Creates an image of `size` bytes that was last used `age` ago */
+void createImage(const std::filesystem::path &path, const std::uintmax_t size,
+                 const std::chrono::hours age) {
+  std::ofstream(path) << std::string(size, 'x');
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now() - age);
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(ByteSize, Parsing) {
+  EXPECT_EQ(parseByteSize("4096"), ByteSize{4096});
+  EXPECT_EQ(parseByteSize("10B"), ByteSize{10});
+  EXPECT_EQ(parseByteSize("2GiB"), ByteSize{2 * KIB * KIB * KIB});
+  EXPECT_EQ(parseByteSize(" 2 gib "), ByteSize{2 * KIB * KIB * KIB});
+  EXPECT_EQ(parseByteSize("2G"), ByteSize{2 * KIB * KIB * KIB});
+  EXPECT_EQ(parseByteSize("500MB"), ByteSize{500ULL * 1000 * 1000});
+  EXPECT_EQ(parseByteSize("1.5KiB"), ByteSize{KIB + (KIB / 2)});
+
+  EXPECT_EQ(parseByteSize(""), std::nullopt);
+  EXPECT_EQ(parseByteSize("GiB"), std::nullopt);
+  EXPECT_EQ(parseByteSize("2 potatoes"), std::nullopt);
+}
+
+TEST(ByteSize, HumanReadable) {
+  EXPECT_EQ(byteSizeString({512}), "512 B");
+  EXPECT_EQ(byteSizeString({KIB + (KIB / 2)}), "1.5 KiB");
+  EXPECT_EQ(byteSizeString({2 * KIB * KIB * KIB}), "2.0 GiB");
+}
+
+TEST(ImageCache, EvictsLeastRecentlyUsed) {
+  const TemporaryDirectory cache;;
+  createImage(cache.path / frameName(0), KIB, std::chrono::hours(3));
+  createImage(cache.path / frameName(25), KIB, std::chrono::hours(2));
+  createImage(cache.path / frameName(50), KIB, std::chrono::hours(1));
+  createImage(cache.path / (frameName(75) + ".partial-1"), KIB,
+              std::chrono::hours(4));
+
+  // Using an image makes it the most recently used
+  const std::vector<std::string> usedImages = {frameName(0)};
+  sharedCacheManifest(cache.path).markUsed(usedImages);
+
+  const CacheContents evicted =
+      evictLeastRecentlyUsed(cache.path, ByteSize{2 * KIB});
+
+  EXPECT_EQ(evicted.numberImages, 1U);
+  EXPECT_EQ(evicted.size, ByteSize{KIB});
+  EXPECT_TRUE(std::filesystem::exists(cache.path / frameName(0)));
+  EXPECT_FALSE(std::filesystem::exists(cache.path / frameName(25)));
+  EXPECT_TRUE(std::filesystem::exists(cache.path / frameName(50)));
+  // Images still being written are left alone
+  EXPECT_TRUE(
+      std::filesystem::exists(cache.path / (frameName(75) + ".partial-1")));
+
+  const CacheContents contents = getCacheContents(cache.path);
+  EXPECT_EQ(contents.numberImages, 2U);
+  EXPECT_EQ(contents.size, ByteSize{2 * KIB});
+}
+
+TEST(ImageCache, RemovesUnusedImages) {
+  const TemporaryDirectory cache;;
+  const std::string used = frameName(0);
+  const std::string unused = frameName(25);
+  createImage(cache.path / used, KIB, std::chrono::hours(1));
+  createImage(cache.path / unused, KIB, std::chrono::hours(1));
+  recordCacheStatistics(cache.path, {.hits = 1, .misses = 1});
+  EXPECT_EQ(getCacheContents(cache.path).numberImages, 2U);
+
+  // Not in the manifest, so only found by looking in the directory
+  const std::string unknown = "0123456789abcdef-fedcba9876543210.jpg.frames";
+  const std::string unknownToKeep = "0123456789abcdef-fill-1920x1080.rgb";
+  const std::string justWritten = frameName(50);
+  createImage(cache.path / unknown, KIB, std::chrono::hours(1));
+  createImage(cache.path / unknownToKeep, KIB, std::chrono::hours(1));
+  createImage(cache.path / justWritten, KIB, std::chrono::hours(0));
+  createImage(cache.path / "notes.txt", KIB, std::chrono::hours(1));
+
+  const CacheContents removed =
+      removeCacheImagesExcept(cache.path, {used, unknownToKeep});
+
+  EXPECT_EQ(removed.numberImages, 2U);
+  EXPECT_TRUE(std::filesystem::exists(cache.path / used));
+  EXPECT_FALSE(std::filesystem::exists(cache.path / unused));
+  EXPECT_FALSE(std::filesystem::exists(cache.path / unknown));
+  EXPECT_TRUE(std::filesystem::exists(cache.path / unknownToKeep));
+  // May be part of a transition still being composited
+  EXPECT_TRUE(std::filesystem::exists(cache.path / justWritten));
+  // Not made by the cache
+  EXPECT_TRUE(std::filesystem::exists(cache.path / "notes.txt"));
+  EXPECT_TRUE(
+      std::filesystem::exists(cache.path / CACHE_STATISTICS_FILE_NAME));
+  EXPECT_TRUE(std::filesystem::exists(cache.path / CACHE_MANIFEST_FILE_NAME));
+  EXPECT_EQ(getCacheContents(cache.path).numberImages, 1U);
+}
+
+TEST(ImageCache, StatisticsAccumulate) {
+  const TemporaryDirectory cache;;
+
+  EXPECT_EQ(readCacheStatistics(cache.path).hitRate(), 0.0);
+
+  recordCacheStatistics(cache.path, {.hits = 2, .misses = 1});
+  recordCacheStatistics(cache.path, {.hits = 1, .misses = 0});
+
+  const CacheStatistics statistics = readCacheStatistics(cache.path);
+  EXPECT_EQ(statistics.hits, 3U);
+  EXPECT_EQ(statistics.misses, 1U);
+  EXPECT_DOUBLE_EQ(statistics.hitRate(), 0.75);
+}
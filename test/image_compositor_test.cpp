@@ -0,0 +1,99 @@
+/**
+ *   Test where composite images are written
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "src/image_compositor.hpp"
+#include "src/native_compositor.hpp"
+#include "src/transition_frame_format.hpp"
+
+using namespace dynamic_paper;
+
+// ===== Tests ===============
+
+TEST(InPlaceFrames, BuffersUseDifferentFiles) {
+  const std::filesystem::path first = inPlaceFramePath("1.jpg", "2.png", 0);
+  const std::filesystem::path second = inPlaceFramePath("1.jpg", "2.png", 1);
+
+  EXPECT_NE(first, second);
+  EXPECT_EQ(first.parent_path(), inPlaceFrameDirectory());
+  EXPECT_EQ(second.parent_path(), inPlaceFrameDirectory());
+  EXPECT_EQ(first.extension(), ".jpg");
+  EXPECT_EQ(inPlaceFramePath("1", "2.png", 0).extension(), ".png");
+}
+
+TEST(InPlaceFrames, DirectoryIsWritable) {
+  const std::filesystem::path directory = inPlaceFrameDirectory();
+  ASSERT_TRUE(std::filesystem::is_directory(directory));
+
+  const std::filesystem::path file = inPlaceFramePath("test", "test", 0);
+  std::filesystem::remove(file);
+  EXPECT_TRUE(std::filesystem::copy_file(__FILE__, file));
+  std::filesystem::remove(file);
+}
+
+TEST(TransitionFrameFormat, ChangesExtensionOfFrames) {
+  EXPECT_EQ(inPlaceFramePath("1.jpg", "2.jpg", 0, TransitionFrameFormat::Qoi)
+                .extension(),
+            ".qoi");
+  EXPECT_EQ(inPlaceFramePath("1.jpg", "2.jpg", 0, TransitionFrameFormat::Source)
+                .extension(),
+            ".jpg");
+
+  const auto path = pathForCompositeImage("/images/forest", "1.jpg", "2.jpg",
+                                          40, "/cache",
+                                          TransitionFrameFormat::WebP);
+  ASSERT_TRUE(path.has_value());
+  EXPECT_EQ(path.value(), "/cache/forest-1-2-40.webp");
+}
+
+TEST(TransitionFrameFormat, ParsesEveryFormat) {
+  for (const TransitionFrameFormat format :
+       {TransitionFrameFormat::Source, TransitionFrameFormat::Qoi,
+        TransitionFrameFormat::Ppm, TransitionFrameFormat::Pam,
+        TransitionFrameFormat::Png, TransitionFrameFormat::WebP}) {
+    EXPECT_EQ(stringToTransitionFrameFormat(transitionFrameFormatString(format)),
+              format);
+  }
+  EXPECT_EQ(stringToTransitionFrameFormat(" WebP "),
+            TransitionFrameFormat::WebP);
+  EXPECT_EQ(stringToTransitionFrameFormat("jpeg"), std::nullopt);
+}
+
+TEST(TransitionFrameFormat, WritesPPMWithoutEncoding) {
+  RGBImage image(2, 1);
+  image.pixels = {1, 2, 3, 4, 5, 6};
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "dynamic_paper_frame_test.ppm";
+
+  writeRGBImage(image, path, TransitionFrameFormat::Ppm);
+  std::ifstream file(path, std::ios::binary);
+  const std::string content((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  std::filesystem::remove(path);
+
+  EXPECT_EQ(content, std::string("P6\n2 1\n255\n\x01\x02\x03\x04\x05\x06"));
+}
+
+TEST(TransitionFrameFormat, EncodesQOIWithoutImageMagick) {
+  RGBImage image(4, 1);
+  image.pixels = {1, 2, 3, 4, 5, 6, 4, 5, 6, 1, 2, 3};
+
+  const std::vector<std::uint8_t> encoded =
+      encodeRGBImage(image, ".qoi", TransitionFrameFormat::Qoi);
+
+  // A luma difference for each new pixel, a run of the repeated pixel and an
+  // index to the first pixel
+  const std::vector<std::uint8_t> expected = {
+      'q',  'o',  'i',  'f',  0, 0, 0, 4, 0, 0, 0, 1, 3, 0, // header
+      0xa2, 0x79, 0xa3, 0x88, 0xc0, 0x17,                   // pixels
+      0,    0,    0,    0,    0, 0, 0, 1};                  // end marker
+  EXPECT_EQ(encoded, expected);
+}
@@ -0,0 +1,102 @@
+/**
+ *   Test the kernels used to interpolate between images
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "src/lerp_kernel.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+// Not a multiple of any SIMD width, so the scalar tail is used too
+constexpr std::size_t BUFFER_SIZE = (3 * 64) + 7;
+
+constexpr std::array ALL_KERNELS = {LerpKernel::Scalar, LerpKernel::SSE41,
+                                    LerpKernel::AVX2};
+
+std::vector<std::uint8_t> patternBuffer(const std::size_t size,
+                                        const unsigned int seed) {
+  std::vector<std::uint8_t> buffer(size);
+  for (std::size_t i = 0; i < size; i++) {
+    buffer[i] = static_cast<std::uint8_t>((i * seed) + (seed >> 1));
+  }
+  return buffer;
+}
+
+std::vector<std::uint8_t> lerp(const LerpKernel kernel,
+                               const std::vector<std::uint8_t> &start,
+                               const std::vector<std::uint8_t> &end,
+                               const unsigned int percentage) {
+  std::vector<std::uint8_t> destination(start.size());
+  lerpPixelsUsingKernel(kernel, start, end, destination, percentage);
+  return destination;
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(LerpKernel, EndpointsAreExact) {
+  const std::vector<std::uint8_t> start = patternBuffer(BUFFER_SIZE, 7);
+  const std::vector<std::uint8_t> end = patternBuffer(BUFFER_SIZE, 13);
+
+  for (const LerpKernel kernel : ALL_KERNELS) {
+    if (!lerpKernelIsSupported(kernel)) {
+      continue;
+    }
+    EXPECT_EQ(lerp(kernel, start, end, 0), start) << lerpKernelString(kernel);
+    EXPECT_EQ(lerp(kernel, start, end, 100), end) << lerpKernelString(kernel);
+  }
+}
+
+TEST(LerpKernel, HalfwayIsAverage) {
+  const std::vector<std::uint8_t> start(BUFFER_SIZE, 0);
+  const std::vector<std::uint8_t> end(BUFFER_SIZE, 200);
+
+  const std::vector<std::uint8_t> halfway =
+      lerp(LerpKernel::Scalar, start, end, 50);
+
+  EXPECT_EQ(halfway, std::vector<std::uint8_t>(BUFFER_SIZE, 100));
+}
+
+TEST(LerpKernel, ReversedTransitionIsMirrored) {
+  const std::vector<std::uint8_t> start = patternBuffer(BUFFER_SIZE, 31);
+  const std::vector<std::uint8_t> end = patternBuffer(BUFFER_SIZE, 97);
+
+  // Cached images are shared between both directions of a transition
+  for (unsigned int percentage = 0; percentage <= 100; percentage++) {
+    EXPECT_EQ(lerp(LerpKernel::Scalar, start, end, percentage),
+              lerp(LerpKernel::Scalar, end, start, 100 - percentage))
+        << "at " << percentage << "%";
+  }
+}
+
+TEST(LerpKernel, SIMDKernelsMatchScalar) {
+  const std::vector<std::uint8_t> start = patternBuffer(BUFFER_SIZE, 31);
+  const std::vector<std::uint8_t> end = patternBuffer(BUFFER_SIZE, 97);
+
+  for (unsigned int percentage = 0; percentage <= 100; percentage++) {
+    const std::vector<std::uint8_t> expected =
+        lerp(LerpKernel::Scalar, start, end, percentage);
+
+    for (const LerpKernel kernel : ALL_KERNELS) {
+      if (!lerpKernelIsSupported(kernel)) {
+        continue;
+      }
+      EXPECT_EQ(lerp(kernel, start, end, percentage), expected)
+          << lerpKernelString(kernel) << " at " << percentage << "%";
+    }
+  }
+}
+
+TEST(LerpKernel, BestKernelIsSupported) {
+  EXPECT_TRUE(lerpKernelIsSupported(bestSupportedLerpKernel()));
+  EXPECT_TRUE(lerpKernelIsSupported(LerpKernel::Scalar));
+}
@@ -0,0 +1,77 @@
+/**
+ *   Test choosing the number of steps of `auto` transitions from how fast
+ *   steps were shown before
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "helper.hpp"
+#include "src/defaults.hpp"
+#include "src/step_throughput.hpp"
+#include "src/transition_info.hpp"
+
+using namespace dynamic_paper;
+
+// ===== Tests ===============
+
+TEST(StepThroughput, ChoosesStepsThatFitTheBudget) {
+  const StepThroughput throughput = {.compositeMilliseconds = 40.0,
+                                     .setMilliseconds = 10.0};
+
+  // Half of 10 seconds is 100 steps of 50ms, so it is capped
+  EXPECT_EQ(chooseAutoSteps(std::chrono::seconds(10), throughput, 0.5),
+            MAX_AUTO_STEPS);
+  EXPECT_EQ(chooseAutoSteps(std::chrono::seconds(2), throughput, 0.5), 20);
+  EXPECT_EQ(chooseAutoSteps(std::chrono::seconds(2), throughput, 0.25), 10);
+}
+
+TEST(StepThroughput, AlwaysChoosesAtLeastOneStep) {
+  const StepThroughput throughput = {.compositeMilliseconds = 5000.0,
+                                     .setMilliseconds = 0.0};
+  EXPECT_EQ(chooseAutoSteps(std::chrono::seconds(1), throughput, 0.5), 1);
+}
+
+TEST(StepThroughput, UsesDefaultStepsWithoutMeasurements) {
+  EXPECT_EQ(chooseAutoSteps(std::chrono::seconds(10), std::nullopt, 0.5),
+            BackgroundSetDefaults::transitionSteps);
+}
+
+TEST(StepThroughput, RecordsAndBlendsMeasurements) {
+  const TemporaryDirectory cache;;
+
+  EXPECT_FALSE(readStepThroughput(cache.path).has_value());
+
+  recordStepThroughput(cache.path,
+                       {.compositeMilliseconds = 100.0, .setMilliseconds = 20.0});
+  std::optional<StepThroughput> throughput = readStepThroughput(cache.path);
+  ASSERT_TRUE(throughput.has_value());
+  EXPECT_DOUBLE_EQ(throughput->compositeMilliseconds, 100.0);
+  EXPECT_DOUBLE_EQ(throughput->setMilliseconds, 20.0);
+
+  recordStepThroughput(cache.path,
+                       {.compositeMilliseconds = 20.0, .setMilliseconds = 20.0});
+  throughput = readStepThroughput(cache.path);
+  ASSERT_TRUE(throughput.has_value());
+  EXPECT_DOUBLE_EQ(throughput->compositeMilliseconds, 80.0);
+  EXPECT_DOUBLE_EQ(throughput->setMilliseconds, 20.0);
+}
+
+TEST(StepThroughput, ResolvesOnlyAutoTransitions) {
+  const TemporaryDirectory cache;;
+  recordStepThroughput(cache.path,
+                       {.compositeMilliseconds = 50.0, .setMilliseconds = 50.0});
+
+  const TransitionInfo fixed(std::chrono::seconds(4), 3, false);
+  EXPECT_EQ(resolveAutoSteps(fixed, cache.path, 0.5).steps, 3);
+
+  const TransitionInfo automatic(std::chrono::seconds(4), 3, true, true);
+  const TransitionInfo resolved = resolveAutoSteps(automatic, cache.path, 0.5);
+  EXPECT_EQ(resolved.steps, 20);
+  EXPECT_FALSE(resolved.autoSteps);
+  EXPECT_TRUE(resolved.inPlace);
+}
@@ -0,0 +1,100 @@
+/**
+ *   Test the pool of threads used to composite images
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "src/thread_pool.hpp"
+
+using namespace dynamic_paper;
+
+// ===== Tests ===============
+
+TEST(ThreadPool, DefaultSizeIsBounded) {
+  const std::size_t size = defaultThreadPoolSize();
+  EXPECT_GE(size, 1U);
+  EXPECT_LE(size, MAX_THREAD_POOL_SIZE);
+}
+
+TEST(ThreadPool, ReturnsResults) {
+  ThreadPool pool(3);
+  EXPECT_EQ(pool.size(), 3U);
+
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 20; i++) {
+    results.push_back(pool.submit([i]() { return i * i; }));
+  }
+
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(results[i].get(), i * i);
+  }
+}
+
+TEST(ThreadPool, NeverRunsMoreTasksThanThreads) {
+  constexpr std::size_t NUMBER_THREADS = 2;
+
+  std::atomic<int> running = 0;
+  std::atomic<int> mostRunning = 0;
+  {
+    ThreadPool pool(NUMBER_THREADS);
+    for (int i = 0; i < 16; i++) {
+      pool.submit([&running, &mostRunning]() {
+        const int nowRunning = ++running;
+        int previousMost = mostRunning.load();
+        while (nowRunning > previousMost &&
+               !mostRunning.compare_exchange_weak(previousMost, nowRunning)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        running--;
+      });
+    }
+  }
+
+  EXPECT_GE(mostRunning.load(), 1);
+  EXPECT_LE(mostRunning.load(), static_cast<int>(NUMBER_THREADS));
+}
+
+TEST(ThreadPool, ExceptionsArePassedToFuture) {
+  ThreadPool pool(1);
+  std::future<void> result =
+      pool.submit([]() { throw std::runtime_error("failed"); });
+  EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, IdleWorkersStealTasks) {
+  constexpr int NUMBER_SUBTASKS = 32;
+
+  std::mutex threadsMutex;
+  std::set<std::thread::id> threadsUsed;
+  std::atomic<int> subtasksRun = 0;
+  {
+    ThreadPool pool(4);
+
+    // Subtasks are all queued on the worker running this task, so other
+    // workers can only run them by stealing
+    pool.submit([&]() {
+      for (int i = 0; i < NUMBER_SUBTASKS; i++) {
+        pool.submit([&]() {
+          {
+            const std::scoped_lock lock(threadsMutex);
+            threadsUsed.insert(std::this_thread::get_id());
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+          subtasksRun++;
+        });
+      }
+    });
+  }
+
+  EXPECT_EQ(subtasksRun.load(), NUMBER_SUBTASKS);
+  EXPECT_GT(threadsUsed.size(), 1U);
+}
@@ -0,0 +1,82 @@
+/**
+ *   Test comparing images in tiles and blending only the tiles that differ
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "src/lerp_kernel.hpp"
+#include "src/rgb_image.hpp"
+#include "src/tile_mask.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+// Not a multiple of the tile size, so the edge tiles are smaller
+constexpr std::size_t WIDTH = 10;
+constexpr std::size_t HEIGHT = 7;
+constexpr std::size_t SMALL_TILE = 4;
+
+std::vector<std::uint8_t> patternImage(const unsigned int seed) {
+  std::vector<std::uint8_t> pixels(WIDTH * HEIGHT * RGBImage::CHANNELS);
+  for (std::size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = static_cast<std::uint8_t>((i * seed) + (seed >> 1));
+  }
+  return pixels;
+}
+
+std::size_t pixelOffset(const std::size_t x, const std::size_t y) {
+  return ((y * WIDTH) + x) * RGBImage::CHANNELS;
+}
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(TileMask, IdenticalImagesHaveNoChangedTiles) {
+  const std::vector<std::uint8_t> image = patternImage(7);
+  const TileMask mask = computeTileMask(image, image, WIDTH, HEIGHT, SMALL_TILE);
+
+  EXPECT_EQ(mask.columns, 3);
+  EXPECT_EQ(mask.rows, 2);
+  EXPECT_EQ(mask.numberChanged(), 0);
+  EXPECT_EQ(mask.changedFraction(), 0.0);
+}
+
+TEST(TileMask, MarksOnlyTheTileThatChanged) {
+  const std::vector<std::uint8_t> start = patternImage(7);
+  std::vector<std::uint8_t> end = start;
+  // In the bottom right tile, which is 2 x 3 pixels
+  end[pixelOffset(9, 6) + 1] += 1;
+
+  const TileMask mask = computeTileMask(start, end, WIDTH, HEIGHT, SMALL_TILE);
+  EXPECT_EQ(mask.numberChanged(), 1);
+  EXPECT_TRUE(mask.tileChanged(2, 1));
+}
+
+TEST(TileMask, BlendingChangedTilesMatchesBlendingEverything) {
+  const std::vector<std::uint8_t> start = patternImage(7);
+  std::vector<std::uint8_t> end = start;
+  for (std::size_t y = 0; y < 3; y++) {
+    for (std::size_t x = 4; x < 6; x++) {
+      end[pixelOffset(x, y)] = 255;
+    }
+  }
+  end[pixelOffset(0, 5) + 2] = 0;
+
+  const TileMask mask = computeTileMask(start, end, WIDTH, HEIGHT, SMALL_TILE);
+  EXPECT_EQ(mask.numberChanged(), 2);
+
+  for (const unsigned int percentage : {0U, 33U, 50U, 100U}) {
+    std::vector<std::uint8_t> expected(start.size());
+    lerpPixels(start, end, expected, percentage);
+
+    std::vector<std::uint8_t> blended(start.size());
+    lerpChangedTiles(start, end, blended, mask, percentage);
+    EXPECT_EQ(blended, expected) << percentage << "%";
+  }
+}
@@ -0,0 +1,63 @@
+/**
+ *   Test the deadlines steps of a transition are shown at
+ */
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "src/transition_schedule.hpp"
+
+using namespace dynamic_paper;
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+// ===== Tests ===============
+
+TEST(TransitionSchedule, StepsAreEvenlySpaced) {
+  const TransitionSchedule::Clock::time_point start{};
+  const TransitionSchedule schedule(start, seconds(2), 4);
+
+  EXPECT_EQ(schedule.stepStart(0), start);
+  EXPECT_EQ(schedule.stepStart(1), start + milliseconds(500));
+  EXPECT_EQ(schedule.stepEnd(1), start + milliseconds(1000));
+  EXPECT_EQ(schedule.end(), start + seconds(2));
+}
+
+TEST(TransitionSchedule, LateStepsAreStale) {
+  const TransitionSchedule::Clock::time_point start{};
+  const TransitionSchedule schedule(start, seconds(2), 4);
+
+  EXPECT_FALSE(schedule.isStale(0, start + milliseconds(499)));
+  EXPECT_TRUE(schedule.isStale(0, start + milliseconds(500)));
+  EXPECT_TRUE(schedule.isStale(1, start + milliseconds(1200)));
+  EXPECT_FALSE(schedule.isStale(2, start + milliseconds(1200)));
+}
+
+TEST(TransitionSchedule, LastStepIsNeverStale) {
+  const TransitionSchedule::Clock::time_point start{};
+  const TransitionSchedule schedule(start, seconds(2), 4);
+
+  EXPECT_FALSE(schedule.isStale(3, start + seconds(10)));
+
+  const TransitionSchedule oneStep(start, seconds(2), 1);
+  EXPECT_FALSE(oneStep.isStale(0, start + seconds(10)));
+}
+
+TEST(TransitionSchedule, Lateness) {
+  const TransitionSchedule::Clock::time_point start{};
+  const TransitionSchedule schedule(start, seconds(2), 4);
+
+  EXPECT_EQ(schedule.lateness(1, start + milliseconds(200)),
+            TransitionSchedule::Clock::duration{0});
+  EXPECT_EQ(schedule.lateness(1, start + milliseconds(700)), milliseconds(200));
+}
+
+TEST(TransitionSchedule, NoStepsIsOneStep) {
+  const TransitionSchedule::Clock::time_point start{};
+  const TransitionSchedule schedule(start, seconds(2), 0);
+
+  EXPECT_EQ(schedule.end(), start + seconds(2));
+  EXPECT_FALSE(schedule.isStale(0, start + seconds(10)));
+}
@@ -0,0 +1,133 @@
+/**
+ *   Test sleeping until times on the wall clock
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "src/wakeup_timer.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+/** Sets the time zone used by local time, restoring the previous one once the
+ * test finishes */
+class TemporaryTimeZone {
+public:
+  explicit TemporaryTimeZone(const char *timeZone) {
+    const char *previous = std::getenv("TZ");
+    if (previous != nullptr) {
+      previousTimeZone = previous;
+    }
+    setenv("TZ", timeZone, 1);
+    tzset();
+  }
+  ~TemporaryTimeZone() {
+    if (previousTimeZone.has_value()) {
+      setenv("TZ", previousTimeZone->c_str(), 1);
+    } else {
+      unsetenv("TZ");
+    }
+    tzset();
+  }
+
+  TemporaryTimeZone(const TemporaryTimeZone &) = delete;
+  TemporaryTimeZone &operator=(const TemporaryTimeZone &) = delete;
+  TemporaryTimeZone(TemporaryTimeZone &&) = delete;
+  TemporaryTimeZone &operator=(TemporaryTimeZone &&) = delete;
+
+private:
+  std::optional<std::string> previousTimeZone;
+};
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(WakeupTimer, ReturnsAtOnceForPastDeadline) {
+  WakeupTimer timer;
+  const auto start = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(timer.sleepUntil(std::chrono::system_clock::now() -
+                             std::chrono::seconds(5)),
+            WakeupReason::Deadline);
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(100));
+}
+
+TEST(WakeupTimer, SleepsUntilDeadline) {
+  WakeupTimer timer;
+  const auto deadline =
+      std::chrono::system_clock::now() + std::chrono::milliseconds(50);
+
+  EXPECT_EQ(timer.sleepUntil(deadline), WakeupReason::Deadline);
+  EXPECT_GE(std::chrono::system_clock::now(), deadline);
+
+  // Can be used again for the next deadline
+  EXPECT_EQ(timer.sleepUntil(std::chrono::system_clock::now() +
+                             std::chrono::milliseconds(10)),
+            WakeupReason::Deadline);
+}
+
+TEST(WakeupTimer, DeadlineMatchesDurationWithoutOffsetChange) {
+  const TemporaryTimeZone timeZone("UTC");
+  const std::chrono::sys_seconds from =
+      std::chrono::sys_days(std::chrono::year(2024) / 3 / 10);
+
+  EXPECT_EQ(wallClockDeadlineAfter(std::chrono::hours(3), from),
+            from + std::chrono::hours(3));
+}
+
+TEST(WakeupTimer, DeadlineFollowsDaylightSavingChanges) {
+  const TemporaryTimeZone timeZone("America/New_York");
+
+  // 00:00 EST, clocks go forward from 02:00 to 03:00, so 05:00 EDT is only 4
+  // hours later
+  const std::chrono::sys_seconds startOfSpring =
+      std::chrono::sys_days(std::chrono::year(2024) / 3 / 10) +
+      std::chrono::hours(5);
+  EXPECT_EQ(wallClockDeadlineAfter(std::chrono::hours(5), startOfSpring),
+            startOfSpring + std::chrono::hours(4));
+
+  // 00:00 EDT, clocks go back from 02:00 to 01:00, so 05:00 EST is 6 hours
+  // later
+  const std::chrono::sys_seconds startOfAutumn =
+      std::chrono::sys_days(std::chrono::year(2024) / 11 / 3) +
+      std::chrono::hours(4);
+  EXPECT_EQ(wallClockDeadlineAfter(std::chrono::hours(5), startOfAutumn),
+            startOfAutumn + std::chrono::hours(6));
+}
+
+TEST(WakeupTimer, InterruptWakesSleepingThread) {
+  WakeupTimer timer;
+  const auto start = std::chrono::steady_clock::now();
+
+  std::jthread interrupter([&timer]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    timer.interrupt();
+  });
+  EXPECT_EQ(timer.sleepUntil(std::chrono::system_clock::now() +
+                             std::chrono::hours(1)),
+            WakeupReason::Interrupted);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
+TEST(WakeupTimer, InterruptBeforeSleepIsNotLost) {
+  WakeupTimer timer;
+  timer.interrupt();
+
+  EXPECT_EQ(timer.sleepUntil(std::chrono::system_clock::now() +
+                             std::chrono::hours(1)),
+            WakeupReason::Interrupted);
+  // Only wakes one sleep
+  EXPECT_EQ(timer.sleepUntil(std::chrono::system_clock::now() +
+                             std::chrono::milliseconds(10)),
+            WakeupReason::Deadline);
+}
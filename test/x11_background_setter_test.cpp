@@ -0,0 +1,163 @@
+/**
+ *   Test setting the background of an X11 display from decoded images
+ *
+ *   Tests that need a display are skipped unless `DISPLAY` is set, such as
+ *   when run with `xvfb-run`
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <tl/expected.hpp>
+
+#include "src/background_set_enums.hpp"
+#include "src/rgb_image.hpp"
+#include "src/x11_background_setter.hpp"
+
+using namespace dynamic_paper;
+
+namespace {
+
+constexpr std::ptrdiff_t NO = ScreenMapping::NO_PIXEL;
+
+using Color = std::array<std::uint8_t, RGBImage::CHANNELS>;
+
+Color pixelAt(const RGBImage &image, const std::size_t column,
+              const std::size_t row) {
+  const std::size_t index =
+      ((row * image.width) + column) * RGBImage::CHANNELS;
+  return {image.pixels[index], image.pixels[index + 1],
+          image.pixels[index + 2]};
+}
+
+/** 2x2 image with a different color in each corner */
+RGBImage cornersImage() {
+  RGBImage image(2, 2);
+  image.pixels = {255, 0,   0,   0, 255, 0, // top
+                  0,   0,   255, 255, 255, 255}; // bottom
+  return image;
+}
+
+bool hasDisplay() { return std::getenv("DISPLAY") != nullptr; }
+
+} // namespace
+
+// ===== Tests ===============
+
+TEST(ScreenMapping, CenterPadsSmallImage) {
+  const ScreenMapping mapping =
+      screenMapping(2, 2, 4, 3, BackgroundSetMode::Center);
+
+  EXPECT_EQ(mapping.columns, std::vector<std::ptrdiff_t>({NO, 0, 1, NO}));
+  EXPECT_EQ(mapping.rows, std::vector<std::ptrdiff_t>({0, 1, NO}));
+}
+
+TEST(ScreenMapping, CenterCropsLargeImage) {
+  const ScreenMapping mapping =
+      screenMapping(6, 2, 2, 2, BackgroundSetMode::Center);
+
+  EXPECT_EQ(mapping.columns, std::vector<std::ptrdiff_t>({2, 3}));
+  EXPECT_EQ(mapping.rows, std::vector<std::ptrdiff_t>({0, 1}));
+}
+
+TEST(ScreenMapping, FillCoversScreen) {
+  // Scaled by 2 to cover the height, cropping the sides
+  const ScreenMapping mapping =
+      screenMapping(4, 2, 4, 4, BackgroundSetMode::Fill);
+
+  EXPECT_EQ(mapping.columns, std::vector<std::ptrdiff_t>({1, 1, 2, 2}));
+  EXPECT_EQ(mapping.rows, std::vector<std::ptrdiff_t>({0, 0, 1, 1}));
+}
+
+TEST(ScreenMapping, TileRepeats) {
+  const ScreenMapping mapping =
+      screenMapping(2, 3, 5, 4, BackgroundSetMode::Tile);
+
+  EXPECT_EQ(mapping.columns, std::vector<std::ptrdiff_t>({0, 1, 0, 1, 0}));
+  EXPECT_EQ(mapping.rows, std::vector<std::ptrdiff_t>({0, 1, 2, 0}));
+}
+
+TEST(ScreenMapping, ScaleStretches) {
+  const ScreenMapping mapping =
+      screenMapping(2, 4, 4, 2, BackgroundSetMode::Scale);
+
+  EXPECT_EQ(mapping.columns, std::vector<std::ptrdiff_t>({0, 0, 1, 1}));
+  EXPECT_EQ(mapping.rows, std::vector<std::ptrdiff_t>({1, 3}));
+}
+
+TEST(ScreenMapping, EmptyImageIsBlack) {
+  const ScreenMapping mapping =
+      screenMapping(0, 0, 2, 1, BackgroundSetMode::Fill);
+
+  EXPECT_EQ(mapping.columns, std::vector<std::ptrdiff_t>({NO, NO}));
+  EXPECT_EQ(mapping.rows, std::vector<std::ptrdiff_t>({NO}));
+}
+
+TEST(X11Background, ShowsImageOnRootPixmap) {
+  if (!hasDisplay()) {
+    GTEST_SKIP() << "No X11 display to set the background of";
+  }
+
+  ASSERT_TRUE(setX11Background(cornersImage(), BackgroundSetMode::Scale));
+
+  const tl::expected<RGBImage, X11BackgroundError> background =
+      getX11Background();
+  ASSERT_TRUE(background.has_value());
+  ASSERT_GE(background->width, 2U);
+  ASSERT_GE(background->height, 2U);
+
+  const std::size_t right = background->width - 1;
+  const std::size_t bottom = background->height - 1;
+  EXPECT_EQ(pixelAt(background.value(), 0, 0), Color({255, 0, 0}));
+  EXPECT_EQ(pixelAt(background.value(), right, 0), Color({0, 255, 0}));
+  EXPECT_EQ(pixelAt(background.value(), 0, bottom), Color({0, 0, 255}));
+  EXPECT_EQ(pixelAt(background.value(), right, bottom),
+            Color({255, 255, 255}));
+}
+
+TEST(X11Background, ReusesPixmapBetweenFrames) {
+  if (!hasDisplay()) {
+    GTEST_SKIP() << "No X11 display to set the background of";
+  }
+
+  RGBImage frame(1, 1);
+  for (const std::uint8_t value : {0, 128, 255}) {
+    frame.pixels = {value, value, value};
+    ASSERT_TRUE(setX11Background(frame, BackgroundSetMode::Fill));
+
+    const tl::expected<RGBImage, X11BackgroundError> background =
+        getX11Background();
+    ASSERT_TRUE(background.has_value());
+    EXPECT_EQ(pixelAt(background.value(), 0, 0),
+              Color({value, value, value}));
+  }
+}
+
+TEST(X11Background, ShowsImageOnOneMonitor) {
+  if (!hasDisplay()) {
+    GTEST_SKIP() << "No X11 display to set the background of";
+  }
+
+  RGBImage white(1, 1);
+  white.pixels = {255, 255, 255};
+  ASSERT_TRUE(setX11Background(white, BackgroundSetMode::Fill));
+
+  // Only the second pixel of the top row is covered by the monitor
+  RGBImage black(1, 1);
+  black.pixels = {0, 0, 0};
+  const MonitorArea monitor = {.x = 1, .y = 0,
+                               .geometry = {.width = 1, .height = 1}};
+  ASSERT_TRUE(setX11Background(black, BackgroundSetMode::Fill, monitor));
+
+  const tl::expected<RGBImage, X11BackgroundError> background =
+      getX11Background();
+  ASSERT_TRUE(background.has_value());
+  EXPECT_EQ(pixelAt(background.value(), 0, 0), Color({255, 255, 255}));
+  EXPECT_EQ(pixelAt(background.value(), 1, 0), Color({0, 0, 0}));
+  EXPECT_EQ(pixelAt(background.value(), 1, 1), Color({255, 255, 255}));
+}